@@ -10,12 +10,17 @@ OutputItem {
     required property PrimaryOutput targetOutputItem
     property OutputViewport screenViewport: targetOutputItem.screenViewport
 
+    // The frames of the primary output are displayed as is if the outputs have the same
+    // orientation, the scene is rendered only once for both outputs.
+    readonly property bool mirroring: output?.orientation === screenViewport.output?.orientation
+
     devicePixelRatio: output?.scale ?? devicePixelRatio
 
     Rectangle {
         id: content
         anchors.fill: parent
         color: "gray"
+        visible: !outputItem.mirroring
 
         TextureProxy {
             id: proxy
@@ -48,7 +53,8 @@ OutputItem {
         id: viewport
 
         anchors.centerIn: parent
-        depends: [screenViewport]
+        depends: outputItem.mirroring ? [] : [screenViewport]
+        mirrorSource: outputItem.mirroring ? screenViewport : null
         devicePixelRatio: outputItem.devicePixelRatio
         input: content
         output: outputItem.output
@@ -0,0 +1,48 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+struct wl_display;
+struct wl_client;
+struct wlr_buffer;
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+class WClient;
+// Collects the counters of WClient::Stats, only used in the thread of WServer
+class Q_DECL_HIDDEN WClientStats
+{
+public:
+    // The protocol logger of the display counts the requests and the events of the
+    // clients, it's installed only while it's referenced, e.g. by WClientStatsModel and
+    // the Budgeted dispatch mode of WServer.
+    static void init(wl_display *display);
+    static void cleanup();
+    static void ref();
+    static void deref();
+
+    // The time between two requests of the same client is spent on the former one
+    static void beginDispatch();
+    static void endDispatch();
+
+    static void addRequest(wl_client *client);
+    // The client has events to be flushed
+    static void addEvent(wl_client *client);
+    static void addCommit(wl_client *client, int frameCallbacks);
+    static void addFrameDone(wl_client *client, int frameCallbacks);
+    // The buffer shown by several items is counted once
+    static void addLockedBuffer(WClient *client, wlr_buffer *buffer);
+    static void removeLockedBuffer(wlr_buffer *buffer);
+
+    static qint64 bytesOf(wlr_buffer *buffer);
+
+    // Flushes the clients have events since the last call, all clients are flushed
+    // if "all" is true or the protocol logger isn't installed, returns the number of
+    // the clients have events.
+    static int flushClients(wl_display *display, bool all);
+};
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -10,6 +10,7 @@ struct wl_event_loop;
 
 QT_BEGIN_NAMESPACE
 class QSocketNotifier;
+class QTimer;
 QT_END_NAMESPACE
 
 QW_BEGIN_NAMESPACE
@@ -29,6 +30,10 @@ public:
 
     void initSocket(WSocket *socketServer);
 
+    void processWaylandEvents();
+    // The sources of the event loop have pending events, at most 64
+    int readySources() const;
+
     W_DECLARE_PUBLIC(WServer)
     std::unique_ptr<QSocketNotifier> sockNot;
 
@@ -42,6 +47,14 @@ public:
 
     GlobalFilterFunc globalFilterFunc = nullptr;
     void *globalFilterFuncData = nullptr;
+
+    // for WServer::DispatchMode::Budgeted
+    WServer::DispatchMode dispatchMode = WServer::DispatchMode::Unbounded;
+    int dispatchBudget = 2000;
+    QDeadlineTimer frameDeadline;
+    // Enables sockNot again after yielding to the frame deadline
+    QTimer *resumeTimer = nullptr;
+    WServer::DispatchStats dispatchStats;
 };
 
 WAYLIB_SERVER_END_NAMESPACE
@@ -9,6 +9,7 @@
 #include <qwcompositor.h>
 #include <QObject>
 #include <QPointer>
+#include <QRegion>
 
 struct wlr_surface;
 struct wlr_subsurface;
@@ -39,6 +40,7 @@ public:
     void updateOutputs();
     void setBuffer(QW_NAMESPACE::qw_buffer *newBuffer);
     void updateBuffer();
+    void updateBufferDamage();
     void updateBufferOffset();
     void updatePreferredBufferScale();
     void preferredBufferScaleChange();
@@ -60,6 +62,10 @@ public:
     QVector<WOutput*> outputs;
     QMetaObject::Connection frameDoneConnection;
     QPoint bufferOffset;
+    // surface-local coordinates, only valid for the current buffer
+    QRegion bufferDamage;
+    // The frame callbacks not done, for WClient::Stats
+    int frameCallbacks = 0;
 };
 
 WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,312 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "wclientstatsmodel.h"
+#include "wsocket.h"
+#include "private/wclientstats_p.h"
+
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <private/qabstractitemmodel_p.h>
+
+#include <algorithm>
+#include <numeric>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+class Q_DECL_HIDDEN WClientStatsModelPrivate : public QAbstractItemModelPrivate
+{
+public:
+    W_DECLARE_PUBLIC(WClientStatsModel)
+
+    struct Row {
+        QPointer<WClient> client;
+        // The stats at the last refresh
+        WClient::Stats stats;
+        qreal commitsPerSecond = 0;
+        qreal frameCallbacksDonePerSecond = 0;
+        qreal requestsPerSecond = 0;
+        qreal dispatchTimePerSecond = 0;
+    };
+
+    void setClients(const QList<WClient*> &clients);
+    void addClient(WClient *client);
+    void removeClient(WClient *client);
+    int indexOf(const WClient *client) const;
+    QVariant value(const Row &row, int role) const;
+    void sort();
+
+    QPointer<WSocket> socket;
+    QList<QMetaObject::Connection> connections;
+    QList<Row> rows;
+    QTimer *timer = nullptr;
+    QElapsedTimer elapsed;
+    int sortRole = -1;
+};
+
+void WClientStatsModelPrivate::setClients(const QList<WClient*> &clients)
+{
+    W_Q(WClientStatsModel);
+
+    q->beginResetModel();
+    rows.clear();
+    for (auto client : clients)
+        rows.append({client, client->stats()});
+    q->endResetModel();
+}
+
+void WClientStatsModelPrivate::addClient(WClient *client)
+{
+    W_Q(WClientStatsModel);
+
+    q->beginInsertRows({}, rows.size(), rows.size());
+    rows.append({client, client->stats()});
+    q->endInsertRows();
+}
+
+void WClientStatsModelPrivate::removeClient(WClient *client)
+{
+    W_Q(WClientStatsModel);
+
+    const int index = indexOf(client);
+    if (index < 0)
+        return;
+
+    q->beginRemoveRows({}, index, index);
+    rows.removeAt(index);
+    q->endRemoveRows();
+}
+
+int WClientStatsModelPrivate::indexOf(const WClient *client) const
+{
+    for (int i = 0; i < rows.size(); ++i) {
+        if (rows.at(i).client == client)
+            return i;
+    }
+    return -1;
+}
+
+QVariant WClientStatsModelPrivate::value(const Row &row, int role) const
+{
+    if (!row.client)
+        return {};
+
+    const auto &stats = row.client->stats();
+    switch (role) {
+    case WClientStatsModel::ClientRole:
+        return QVariant::fromValue(row.client.get());
+    case WClientStatsModel::PidRole:
+        return row.client->credentials()->pid;
+    case WClientStatsModel::CommitsRole:
+        return stats.commits;
+    case WClientStatsModel::CommitsPerSecondRole:
+        return row.commitsPerSecond;
+    case WClientStatsModel::FrameCallbacksRequestedRole:
+        return stats.frameCallbacksRequested;
+    case WClientStatsModel::FrameCallbacksDoneRole:
+        return stats.frameCallbacksDone;
+    case WClientStatsModel::FrameCallbacksDonePerSecondRole:
+        return row.frameCallbacksDonePerSecond;
+    case WClientStatsModel::RequestsRole:
+        return stats.requests;
+    case WClientStatsModel::RequestsPerSecondRole:
+        return row.requestsPerSecond;
+    case WClientStatsModel::DispatchTimeRole:
+        return stats.dispatchTime / 1e6;
+    case WClientStatsModel::DispatchTimePerSecondRole:
+        return row.dispatchTimePerSecond;
+    case WClientStatsModel::LockedBufferBytesRole:
+        return stats.lockedBufferBytes;
+    default:
+        return {};
+    }
+}
+
+void WClientStatsModelPrivate::sort()
+{
+    W_Q(WClientStatsModel);
+
+    if (sortRole < 0 || rows.size() < 2)
+        return;
+
+    QList<int> order(rows.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this] (int a, int b) {
+        return value(rows.at(a), sortRole).toDouble() > value(rows.at(b), sortRole).toDouble();
+    });
+    if (std::is_sorted(order.cbegin(), order.cend()))
+        return;
+
+    Q_EMIT q->layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    QList<Row> sorted;
+    sorted.reserve(rows.size());
+    QList<int> newIndexes(rows.size());
+    for (int i = 0; i < order.size(); ++i) {
+        sorted.append(rows.at(order.at(i)));
+        newIndexes[order.at(i)] = i;
+    }
+    rows = std::move(sorted);
+
+    const auto persistent = q->persistentIndexList();
+    for (const QModelIndex &index : persistent)
+        q->changePersistentIndex(index, q->index(newIndexes.at(index.row())));
+
+    Q_EMIT q->layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+WClientStatsModel::WClientStatsModel(QObject *parent)
+    : QAbstractListModel(*new WClientStatsModelPrivate(), parent)
+{
+    W_D(WClientStatsModel);
+
+    d->timer = new QTimer(this);
+    d->timer->setInterval(1000);
+    connect(d->timer, &QTimer::timeout, this, &WClientStatsModel::refresh);
+    // The requests are counted only while any model exists
+    WClientStats::ref();
+}
+
+WClientStatsModel::~WClientStatsModel()
+{
+    WClientStats::deref();
+}
+
+WSocket *WClientStatsModel::socket() const
+{
+    W_DC(WClientStatsModel);
+    return d->socket;
+}
+
+void WClientStatsModel::setSocket(WSocket *newSocket)
+{
+    W_D(WClientStatsModel);
+
+    if (d->socket == newSocket)
+        return;
+
+    for (const auto &connection : std::as_const(d->connections))
+        disconnect(connection);
+    d->connections.clear();
+
+    d->socket = newSocket;
+    d->setClients(newSocket ? newSocket->clients() : QList<WClient*>());
+
+    if (newSocket) {
+        d->connections << connect(newSocket, &WSocket::clientAdded, this, [d] (WClient *client) {
+            d->addClient(client);
+        });
+        d->connections << connect(newSocket, &WSocket::aboutToBeDestroyedClient, this, [d] (WClient *client) {
+            d->removeClient(client);
+        });
+        d->elapsed.start();
+        d->timer->start();
+    } else {
+        d->timer->stop();
+    }
+
+    Q_EMIT socketChanged();
+}
+
+int WClientStatsModel::interval() const
+{
+    W_DC(WClientStatsModel);
+    return d->timer->interval();
+}
+
+void WClientStatsModel::setInterval(int newInterval)
+{
+    W_D(WClientStatsModel);
+
+    newInterval = qMax(1, newInterval);
+    if (d->timer->interval() == newInterval)
+        return;
+
+    d->timer->setInterval(newInterval);
+    Q_EMIT intervalChanged();
+}
+
+int WClientStatsModel::sortRole() const
+{
+    W_DC(WClientStatsModel);
+    return d->sortRole;
+}
+
+void WClientStatsModel::setSortRole(int newSortRole)
+{
+    W_D(WClientStatsModel);
+
+    if (d->sortRole == newSortRole)
+        return;
+
+    d->sortRole = newSortRole;
+    d->sort();
+    Q_EMIT sortRoleChanged();
+}
+
+int WClientStatsModel::rowCount(const QModelIndex &parent) const
+{
+    W_DC(WClientStatsModel);
+    return parent.isValid() ? 0 : d->rows.size();
+}
+
+QVariant WClientStatsModel::data(const QModelIndex &index, int role) const
+{
+    W_DC(WClientStatsModel);
+
+    if (!checkIndex(index, CheckIndexOption::IndexIsValid | CheckIndexOption::ParentIsInvalid))
+        return {};
+    return d->value(d->rows.at(index.row()), role);
+}
+
+QHash<int, QByteArray> WClientStatsModel::roleNames() const
+{
+    return {
+        {ClientRole, "client"},
+        {PidRole, "pid"},
+        {CommitsRole, "commits"},
+        {CommitsPerSecondRole, "commitsPerSecond"},
+        {FrameCallbacksRequestedRole, "frameCallbacksRequested"},
+        {FrameCallbacksDoneRole, "frameCallbacksDone"},
+        {FrameCallbacksDonePerSecondRole, "frameCallbacksDonePerSecond"},
+        {RequestsRole, "requests"},
+        {RequestsPerSecondRole, "requestsPerSecond"},
+        {DispatchTimeRole, "dispatchTime"},
+        {DispatchTimePerSecondRole, "dispatchTimePerSecond"},
+        {LockedBufferBytesRole, "lockedBufferBytes"},
+    };
+}
+
+WClient *WClientStatsModel::clientAt(int row) const
+{
+    W_DC(WClientStatsModel);
+    return row >= 0 && row < d->rows.size() ? d->rows.at(row).client.get() : nullptr;
+}
+
+void WClientStatsModel::refresh()
+{
+    W_D(WClientStatsModel);
+
+    const qreal seconds = d->elapsed.restart() / 1000.0;
+    if (d->rows.isEmpty() || seconds <= 0)
+        return;
+
+    for (auto &row : d->rows) {
+        if (!row.client)
+            continue;
+
+        const auto &stats = row.client->stats();
+        row.commitsPerSecond = (stats.commits - row.stats.commits) / seconds;
+        row.frameCallbacksDonePerSecond = (stats.frameCallbacksDone - row.stats.frameCallbacksDone) / seconds;
+        row.requestsPerSecond = (stats.requests - row.stats.requests) / seconds;
+        row.dispatchTimePerSecond = (stats.dispatchTime - row.stats.dispatchTime) / 1e6 / seconds;
+        row.stats = stats;
+    }
+
+    Q_EMIT dataChanged(index(0), index(d->rows.size() - 1));
+    d->sort();
+    Q_EMIT refreshed();
+}
+
+WAYLIB_SERVER_END_NAMESPACE
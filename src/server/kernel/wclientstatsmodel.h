@@ -0,0 +1,78 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QAbstractListModel>
+#include <QQmlEngine>
+
+Q_MOC_INCLUDE("wsocket.h")
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+class WSocket;
+class WClient;
+class WClientStatsModelPrivate;
+// The WClient::Stats of the clients of a socket, and their rates in the last
+// interval, for a "top" view or the throttling policies of the compositor.
+class WAYLIB_SERVER_EXPORT WClientStatsModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(WClientStatsModel)
+    Q_PROPERTY(WSocket* socket READ socket WRITE setSocket NOTIFY socketChanged FINAL)
+    Q_PROPERTY(int interval READ interval WRITE setInterval NOTIFY intervalChanged FINAL)
+    // The rows are sorted by the role in descending order, -1 is the order of the clients
+    Q_PROPERTY(int sortRole READ sortRole WRITE setSortRole NOTIFY sortRoleChanged FINAL)
+    QML_NAMED_ELEMENT(ClientStatsModel)
+
+public:
+    enum Role {
+        ClientRole = Qt::UserRole + 1,
+        PidRole,
+        CommitsRole,
+        CommitsPerSecondRole,
+        FrameCallbacksRequestedRole,
+        FrameCallbacksDoneRole,
+        FrameCallbacksDonePerSecondRole,
+        RequestsRole,
+        RequestsPerSecondRole,
+        // In milliseconds
+        DispatchTimeRole,
+        // The milliseconds of dispatching per second
+        DispatchTimePerSecondRole,
+        LockedBufferBytesRole,
+    };
+    Q_ENUM(Role)
+
+    explicit WClientStatsModel(QObject *parent = nullptr);
+    ~WClientStatsModel();
+
+    WSocket *socket() const;
+    void setSocket(WSocket *newSocket);
+
+    int interval() const;
+    void setInterval(int newInterval);
+
+    int sortRole() const;
+    void setSortRole(int newSortRole);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    Q_INVOKABLE WAYLIB_SERVER_NAMESPACE::WClient *clientAt(int row) const;
+
+public Q_SLOTS:
+    void refresh();
+
+Q_SIGNALS:
+    void socketChanged();
+    void intervalChanged();
+    void sortRoleChanged();
+    // After the rates are updated
+    void refreshed();
+};
+
+WAYLIB_SERVER_END_NAMESPACE
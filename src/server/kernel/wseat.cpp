@@ -5,10 +5,12 @@
 #include "wcursor.h"
 #include "winputdevice.h"
 #include "woutput.h"
+#include "woutputlayout.h"
 #include "wsurface.h"
 #include "wxdgsurface.h"
 #include "platformplugin/qwlrootsintegration.h"
 #include "private/wglobal_p.h"
+#include "wquickhittestindex_p.h"
 
 #include <qwseat.h>
 #include <qwkeyboard.h>
@@ -19,12 +21,14 @@
 #include <qwcompositor.h>
 #include <qwdisplay.h>
 #include <qwprimaryselection.h>
+#include <qwoutput.h>
 
 #include <QQuickWindow>
 #include <QGuiApplication>
 #include <QQuickItem>
 #include <QDebug>
 #include <QTimer>
+#include <QtMath>
 
 #include <qpa/qwindowsysteminterface.h>
 #include <private/qxkbcommon_p.h>
@@ -76,6 +80,13 @@ public:
     {
         pendingEvents.reserve(2);
 
+        coalesceMotion = coalesceMotionByDefault();
+        indexedHitTest = indexedHitTestByDefault();
+        m_motionTimer.setSingleShot(true);
+        m_motionTimer.callOnTimeout([this] {
+            flushPendingMotion();
+        });
+
         m_repeatTimer.callOnTimeout([&](){
             if (!focusWindow) {
                 return;
@@ -290,6 +301,9 @@ public:
         const QPointF &global = cursor->position();
         const QPointF local = w ? global - QPointF(w->position()) : QPointF();
 
+        if (indexedHitTest && w && doIndexedMouseMove(cursor, device, w, local, global, timestamp))
+            return;
+
         QMouseEvent e(QEvent::MouseMove, local, global, Qt::NoButton,
                       cursor->state(), keyModifiers, device);
         Q_ASSERT(e.isUpdateEvent());
@@ -299,6 +313,52 @@ public:
             QCoreApplication::sendEvent(w, &e);
     }
 
+    static bool indexedHitTestByDefault() {
+        static bool on = qEnvironmentVariableIsSet("WAYLIB_INDEXED_HIT_TEST");
+        return on;
+    }
+
+    // If the event object of the focused surface is still the only hover item under the
+    // cursor, send the motion to it directly, without the delivery of QQuickDeliveryAgent.
+    bool doIndexedMouseMove(WCursor *cursor, const QPointingDevice *device, QWindow *w,
+                            const QPointF &local, const QPointF &global, uint32_t timestamp);
+
+    // Merge the pointer motions to one QMouseEvent, the cursor position is always
+    // the newest, so only the timestamp and device of the last motion need to keep.
+    static bool coalesceMotionByDefault() {
+        static bool on = qEnvironmentVariableIsSet("WAYLIB_COALESCE_POINTER_MOTION");
+        return on;
+    }
+
+    static WOutput *outputAt(WCursor *cursor) {
+        auto layout = cursor->layout();
+        if (!layout)
+            return nullptr;
+        const auto outputs = layout->getIntersectedOutputs(QRect(cursor->position().toPoint(), QSize(1, 1)));
+        return outputs.isEmpty() ? nullptr : outputs.first();
+    }
+
+    void addPendingMotion(WCursor *cursor, const QPointingDevice *device, uint32_t timestamp);
+
+    inline void clearPendingMotion() {
+        m_motionTimer.stop();
+        QObject::disconnect(pendingMotion.frameConnection);
+        pendingMotion = {};
+    }
+
+    // Must call before any other pointer event to keep the events order
+    inline void flushPendingMotion() {
+        if (!pendingMotion.cursor)
+            return;
+        auto motion = pendingMotion;
+        clearPendingMotion();
+
+        if (motion.device)
+            doMouseMove(motion.cursor, motion.device, motion.timestamp);
+        if (motion.needsFrame)
+            doNotifyFrame();
+    }
+
     // begin slot function
     void on_destroy();
     void on_request_set_cursor(wlr_seat_pointer_request_set_cursor_event *event);
@@ -401,8 +461,92 @@ public:
     WGlobal::CursorShape cursorShape = WGlobal::CursorShape::Invalid;
 
     QPointer<WSurface> dragSurface;
+
+    bool indexedHitTest = false;
+
+    // for pointer motion coalescing
+    bool coalesceMotion = false;
+    int coalesceMotionInterval = 0;
+    QTimer m_motionTimer;
+    struct {
+        QPointer<WCursor> cursor;
+        QPointer<const QPointingDevice> device;
+        uint32_t timestamp = 0;
+        // The wl_pointer.frame of the pending motion is also delayed
+        bool needsFrame = false;
+        // To the frame of the output under the cursor, the motion is flushed before rendering it
+        QMetaObject::Connection frameConnection;
+    } pendingMotion;
 };
 
+void WSeatPrivate::addPendingMotion(WCursor *cursor, const QPointingDevice *device, uint32_t timestamp)
+{
+    const bool first = !pendingMotion.cursor;
+    pendingMotion.cursor = cursor;
+    pendingMotion.device = device;
+    pendingMotion.timestamp = timestamp;
+    if (!first)
+        return;
+
+    auto output = outputAt(cursor);
+    if (!output) {
+        // Nothing will be rendered for the motion, not need to wait
+        flushPendingMotion();
+        return;
+    }
+
+    pendingMotion.frameConnection = QObject::connect(output->handle(), &qw_output::notify_frame,
+                                                     q_func(), [this] {
+        flushPendingMotion();
+    });
+    // The frame is not scheduled by moving the hardware cursor
+    output->handle()->schedule_frame();
+
+    // In case the frame is late or never emitted, e.g. nothing is damaged by the motion
+    int interval = coalesceMotionInterval;
+    if (interval <= 0) {
+        const int refresh = output->handle()->handle()->refresh;
+        interval = refresh > 0 ? qCeil(1000000.0 / refresh) : 16;
+    }
+    m_motionTimer.start(interval);
+}
+
+bool WSeatPrivate::doIndexedMouseMove(WCursor *cursor, const QPointingDevice *device, QWindow *w,
+                                      const QPointF &local, const QPointF &global, uint32_t timestamp)
+{
+    auto window = qobject_cast<QQuickWindow*>(w);
+    if (!window || !pointerFocusEventObject || !pointerFocusSurface())
+        return false;
+    // The pressed buttons and the grabs are handled by QQuickDeliveryAgent
+    if (cursor->state() != Qt::NoButton || handle()->pointer_has_grab())
+        return false;
+
+    // The other hover items under the cursor, e.g. the HoverHandler of the ancestors,
+    // need the HoverMove event from QQuickDeliveryAgent.
+    bool exclusive = false;
+    auto item = WQuickHitTestIndex::get(window)->hoverItemAt(local, &exclusive);
+    if (!item || item != pointerFocusEventObject || !exclusive)
+        return false;
+    auto target = WSurface::fromHandle(pointerFocusSurface());
+    if (!target)
+        return false;
+
+    QMouseEvent e(QEvent::MouseMove, item->mapFromScene(local), local, global, Qt::NoButton,
+                  cursor->state(), keyModifiers, device);
+    e.setTimestamp(timestamp);
+
+    // Same as WSeat::filterEventBeforeDisposeStage, QQuickDeliveryAgent need the last
+    // position to synchronous hover after the scene changed.
+    QQuickWindowPrivate::get(window)->deliveryAgentPrivate()->lastMousePosition = local;
+
+    W_Q(WSeat);
+    if (eventFilter && eventFilter->beforeDisposeEvent(q, w, &e))
+        return true;
+
+    WSeat::sendEvent(target, item->parent(), item, &e);
+    return true;
+}
+
 void WSeatPrivate::on_destroy()
 {
     q_func()->m_handle = nullptr;
@@ -499,6 +643,8 @@ void WSeatPrivate::on_keyboard_key(wlr_keyboard_key_event *event, WInputDevice *
 {
     auto keyboard = qobject_cast<qw_keyboard*>(device->handle());
 
+    flushPendingMotion();
+
     auto code = event->keycode + 8; // map to wl_keyboard::keymap_format::keymap_format_xkb_v1
     auto et = event->state == WL_KEYBOARD_KEY_STATE_PRESSED ? QEvent::KeyPress : QEvent::KeyRelease;
     xkb_keysym_t sym = xkb_state_key_get_one_sym(keyboard->handle()->xkb_state, code);
@@ -664,6 +810,7 @@ void WSeat::setCursor(WCursor *cursor)
         return;
 
     Q_ASSERT(!cursor || !cursor->seat());
+    d->clearPendingMotion();
 
     if (d->cursor) {
         for (auto i : std::as_const(d->deviceList)) {
@@ -697,6 +844,7 @@ void WSeat::setCursorPosition(const QPointF &pos)
         return;
 
     cursor()->setPosition(pos);
+    d->clearPendingMotion();
     d->doMouseMove(cursor(), QPointingDevice::primaryPointingDevice(), QDateTime::currentMSecsSinceEpoch());
 }
 
@@ -707,6 +855,7 @@ bool WSeat::setCursorPositionWithChecker(const QPointF &pos)
         return false;
 
     bool ok = cursor()->setPositionWithChecker(pos);
+    d->clearPendingMotion();
     d->doMouseMove(cursor(), QPointingDevice::primaryPointingDevice(), QDateTime::currentMSecsSinceEpoch());
     return ok;
 }
@@ -1037,18 +1186,73 @@ void WSeat::setKeyboard(WInputDevice *newKeyboard)
     Q_EMIT this->keyboardChanged();
 }
 
+bool WSeat::coalesceMotion() const
+{
+    W_DC(WSeat);
+    return d->coalesceMotion;
+}
+
+void WSeat::setCoalesceMotion(bool newCoalesceMotion)
+{
+    W_D(WSeat);
+    if (d->coalesceMotion == newCoalesceMotion)
+        return;
+    d->coalesceMotion = newCoalesceMotion;
+    if (!newCoalesceMotion)
+        d->flushPendingMotion();
+
+    Q_EMIT coalesceMotionChanged();
+}
+
+bool WSeat::indexedHitTest() const
+{
+    W_DC(WSeat);
+    return d->indexedHitTest;
+}
+
+void WSeat::setIndexedHitTest(bool newIndexedHitTest)
+{
+    W_D(WSeat);
+    if (d->indexedHitTest == newIndexedHitTest)
+        return;
+    d->indexedHitTest = newIndexedHitTest;
+
+    Q_EMIT indexedHitTestChanged();
+}
+
+int WSeat::coalesceMotionInterval() const
+{
+    W_DC(WSeat);
+    return d->coalesceMotionInterval;
+}
+
+void WSeat::setCoalesceMotionInterval(int newCoalesceMotionInterval)
+{
+    W_D(WSeat);
+    newCoalesceMotionInterval = qMax(0, newCoalesceMotionInterval);
+    if (d->coalesceMotionInterval == newCoalesceMotionInterval)
+        return;
+    d->coalesceMotionInterval = newCoalesceMotionInterval;
+
+    Q_EMIT coalesceMotionIntervalChanged();
+}
+
 void WSeat::notifyMotion(WCursor *cursor, WInputDevice *device, uint32_t timestamp)
 {
     W_D(WSeat);
 
     auto qwDevice = static_cast<QPointingDevice*>(device->qtDevice());
-    d->doMouseMove(cursor, qwDevice, timestamp);
+    if (d->coalesceMotion)
+        d->addPendingMotion(cursor, qwDevice, timestamp);
+    else
+        d->doMouseMove(cursor, qwDevice, timestamp);
 }
 
 void WSeat::notifyButton(WCursor *cursor, WInputDevice *device, Qt::MouseButton button,
                          wlr_button_state_t state, uint32_t timestamp)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
 
     auto qwDevice = static_cast<QPointingDevice*>(device->qtDevice());
     Q_ASSERT(qwDevice);
@@ -1075,6 +1279,7 @@ void WSeat::notifyAxis(WCursor *cursor, WInputDevice *device, wlr_axis_source_t
                        double delta, int32_t delta_discrete, uint32_t timestamp)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
 
     auto qwDevice = static_cast<QPointingDevice*>(device->qtDevice());
     Q_ASSERT(qwDevice);
@@ -1107,12 +1312,17 @@ void WSeat::notifyFrame(WCursor *cursor)
 {
     Q_UNUSED(cursor);
     W_D(WSeat);
+    if (d->pendingMotion.cursor) {
+        d->pendingMotion.needsFrame = true;
+        return;
+    }
     d->doNotifyFrame();
 }
 
 void WSeat::notifyGestureBegin(WCursor *cursor, WInputDevice *device, uint32_t time_msec, uint32_t fingers, WGestureEvent::WLibInputGestureType libInputGestureType)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
     if (d->gestureActive) {
         qCWarning(qLcWlrGestureEvents) << "Unexpected GestureBegin while already active";
     }
@@ -1132,6 +1342,7 @@ void WSeat::notifyGestureBegin(WCursor *cursor, WInputDevice *device, uint32_t t
 void WSeat::notifyGestureUpdate(WCursor *cursor, WInputDevice *device, uint32_t time_msec, const QPointF &delta, double scale, double rotation, WGestureEvent::WLibInputGestureType libInputGestureType)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
     if (!d->gestureActive) {
         qCWarning(qLcWlrGestureEvents) << "Unexpected GestureUpdate while not begin";
         return;
@@ -1164,6 +1375,7 @@ void WSeat::notifyGestureUpdate(WCursor *cursor, WInputDevice *device, uint32_t
 void WSeat::notifyGestureEnd(WCursor *cursor, WInputDevice *device, uint32_t time_msec, bool cancelled, WGestureEvent::WLibInputGestureType libInputGestureType)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
     if (!d->gestureActive) {
         qCWarning(qLcWlrGestureEvents) << "Unexpected GestureEnd while not begin";
         return;
@@ -1183,6 +1395,7 @@ void WSeat::notifyGestureEnd(WCursor *cursor, WInputDevice *device, uint32_t tim
 void WSeat::notifyHoldBegin(WCursor *cursor, WInputDevice *device, uint32_t time_msec, uint32_t fingers)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
     if (d->gestureActive) {
         qCWarning(qLcWlrGestureEvents) << "Unexpected HoldBegin while already active";
     }
@@ -1202,6 +1415,7 @@ void WSeat::notifyHoldBegin(WCursor *cursor, WInputDevice *device, uint32_t time
 void WSeat::notifyHoldEnd(WCursor *cursor, WInputDevice *device, uint32_t time_msec, bool cancelled)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
     if (!d->gestureActive) {
         qCWarning(qLcWlrGestureEvents) << "Unexpected HoldEnd while not begin";
         return;
@@ -1225,6 +1439,7 @@ void WSeat::notifyHoldEnd(WCursor *cursor, WInputDevice *device, uint32_t time_m
 void WSeat::notifyTouchDown(WCursor *cursor, WInputDevice *device, int32_t touch_id, uint32_t time_msec)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
     auto qwDevice = qobject_cast<QPointingDevice*>(device->qtDevice());
     Q_ASSERT(qwDevice);
     const QPointF &globalPos = cursor->position();
@@ -1405,6 +1620,7 @@ void WSeat::create(WServer *server)
 void WSeat::destroy(WServer *)
 {
     W_D(WSeat);
+    d->clearPendingMotion();
 
     for (auto i : std::as_const(d->deviceList)) {
         i->setSeat(nullptr);
@@ -57,6 +57,9 @@ class WAYLIB_SERVER_EXPORT WSeat : public WWrapObject, public WServerInterface
     W_DECLARE_PRIVATE(WSeat)
     Q_PROPERTY(WInputDevice* keyboard READ keyboard WRITE setKeyboard NOTIFY keyboardChanged FINAL)
     Q_PROPERTY(WSurface* keyboardFocus READ keyboardFocusSurface WRITE setKeyboardFocusSurface NOTIFY keyboardFocusSurfaceChanged FINAL)
+    Q_PROPERTY(bool coalesceMotion READ coalesceMotion WRITE setCoalesceMotion NOTIFY coalesceMotionChanged FINAL)
+    Q_PROPERTY(int coalesceMotionInterval READ coalesceMotionInterval WRITE setCoalesceMotionInterval NOTIFY coalesceMotionIntervalChanged FINAL)
+    Q_PROPERTY(bool indexedHitTest READ indexedHitTest WRITE setIndexedHitTest NOTIFY indexedHitTestChanged FINAL)
 
 public:
     WSeat(const QString &name = QStringLiteral("seat0"));
@@ -99,8 +102,26 @@ public:
     WInputDevice *keyboard() const;
     void setKeyboard(WInputDevice *newKeyboard);
 
+    // Merge the pointer motions to one QMouseEvent, it's delivered at the next frame of the
+    // output under the cursor or before the next non-motion event, so the events order is kept.
+    // The coalesceMotionInterval is the max delay in milliseconds in case the frame is late,
+    // it's one refresh period of the output if it's 0.
+    bool coalesceMotion() const;
+    void setCoalesceMotion(bool newCoalesceMotion);
+    int coalesceMotionInterval() const;
+    void setCoalesceMotionInterval(int newCoalesceMotionInterval);
+
+    // Resolve the hover target of the pointer motions by WQuickHitTestIndex, the motion is
+    // sent to the focused surface directly if it's still the only hover item under the
+    // cursor, otherwise it's delivered by QQuickDeliveryAgent.
+    bool indexedHitTest() const;
+    void setIndexedHitTest(bool newIndexedHitTest);
+
 Q_SIGNALS:
     void keyboardChanged();
+    void coalesceMotionChanged();
+    void coalesceMotionIntervalChanged();
+    void indexedHitTestChanged();
     void keyboardFocusSurfaceChanged();
     void requestCursorShape(WAYLIB_SERVER_NAMESPACE::WGlobal::CursorShape shape);
     void requestCursorSurface(WAYLIB_SERVER_NAMESPACE::WSurface *surface, const QPoint &hotspot);
@@ -9,6 +9,7 @@
 
 #include "wserver.h"
 #include "private/wserver_p.h"
+#include "private/wclientstats_p.h"
 #include "wsurface.h"
 #include "wsocket.h"
 #include "platformplugin/qwlrootsintegration.h"
@@ -24,6 +25,8 @@
 #include <QCoreApplication>
 #include <QAbstractEventDispatcher>
 #include <QSocketNotifier>
+#include <QTimer>
+#include <QElapsedTimer>
 #include <QMutex>
 #include <QDebug>
 #include <QProcess>
@@ -35,9 +38,14 @@
 #include <qpa/qplatformintegrationfactory_p.h>
 #include <qpa/qplatformtheme.h>
 
+#include <sys/epoll.h>
+
 QW_USE_NAMESPACE
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
+// The Budgeted mode yields to the frame deadline if the remaining time is less than it, in nanoseconds
+static constexpr qint64 MinDispatchRoundTime = 200000;
+
 static bool globalFilter(const wl_client *client,
                          const wl_global *global,
                          void *data) {
@@ -83,6 +91,8 @@ WServerPrivate::~WServerPrivate()
 {
     if (display)
         stop();
+    if (dispatchMode == WServer::DispatchMode::Budgeted)
+        WClientStats::deref();
 }
 
 void WServerPrivate::init()
@@ -106,19 +116,24 @@ void WServerPrivate::init()
 
     loop = wl_display_get_event_loop(display->handle());
     int fd = wl_event_loop_get_fd(loop);
-
-    auto processWaylandEvents = [this] {
-        int ret = wl_event_loop_dispatch(loop, 0);
-        if (ret)
-            fprintf(stderr, "wl_event_loop_dispatch error: %d\n", ret);
-        wl_display_flush_clients(display->handle());
-    };
+    WClientStats::init(display->handle());
 
     sockNot.reset(new QSocketNotifier(fd, QSocketNotifier::Read));
-    QObject::connect(sockNot.get(), &QSocketNotifier::activated, q, processWaylandEvents);
+    QObject::connect(sockNot.get(), &QSocketNotifier::activated, q, [this] {
+        processWaylandEvents();
+    });
+
+    resumeTimer = new QTimer(q);
+    resumeTimer->setSingleShot(true);
+    resumeTimer->setTimerType(Qt::PreciseTimer);
+    QObject::connect(resumeTimer, &QTimer::timeout, q, [this] {
+        processWaylandEvents();
+    });
 
     QAbstractEventDispatcher *dispatcher = QThread::currentThread()->eventDispatcher();
-    QObject::connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, q, processWaylandEvents);
+    QObject::connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, q, [this] {
+        processWaylandEvents();
+    });
 
     for (auto socket : std::as_const(sockets))
         initSocket(socket);
@@ -142,7 +157,10 @@ void WServerPrivate::stop()
     }
 
     sockNot.reset();
+    delete resumeTimer;
+    resumeTimer = nullptr;
     QThread::currentThread()->eventDispatcher()->disconnect(q);
+    WClientStats::cleanup();
     display.reset(nullptr);
 }
 
@@ -152,6 +170,81 @@ void WServerPrivate::initSocket(WSocket *socketServer)
     Q_ASSERT(ok);
 }
 
+void WServerPrivate::processWaylandEvents()
+{
+    QElapsedTimer timer;
+    timer.start();
+    auto &stats = dispatchStats;
+    ++stats.iterations;
+
+    const bool budgeted = dispatchMode == WServer::DispatchMode::Budgeted;
+    qint64 budget = qint64(dispatchBudget) * 1000;
+    bool yieldToFrame = false;
+
+    if (budgeted && !frameDeadline.hasExpired()) {
+        const qint64 remaining = frameDeadline.remainingTimeNSecs();
+        // Not enough for a round, don't delay the rendering
+        if (remaining < MinDispatchRoundTime) {
+            yieldToFrame = true;
+        } else {
+            budget = qMin(budget, remaining);
+        }
+    }
+
+    if (yieldToFrame) {
+        ++stats.deadlineYields;
+        // The fd stays readable, don't wake up the event loop until the deadline. The
+        // Qt timers are activated in the order of their timeouts, resuming a millisecond
+        // after the deadline lets the render timer of the same deadline go first.
+        sockNot->setEnabled(false);
+        resumeTimer->start(qMax<qint64>(1, frameDeadline.remainingTime() + 1));
+    } else {
+        if (!sockNot->isEnabled()) {
+            resumeTimer->stop();
+            sockNot->setEnabled(true);
+        }
+
+        // The ready sources are returned by epoll in the order of their readiness, the
+        // level-triggered ones still ready are requeued to the tail, and a client reads
+        // its socket only once for a round, so the clients are served in turn.
+        do {
+            WClientStats::beginDispatch();
+            int ret = wl_event_loop_dispatch(loop, 0);
+            WClientStats::endDispatch();
+            ++stats.rounds;
+            if (ret) {
+                fprintf(stderr, "wl_event_loop_dispatch error: %d\n", ret);
+                break;
+            }
+            // Peeked once for a round, it decides the next round and is reported
+            if (budgeted) {
+                stats.readySources = readySources();
+                stats.maxReadySources = qMax(stats.maxReadySources, stats.readySources);
+            }
+        } while (budgeted && stats.readySources > 0 && timer.nsecsElapsed() < budget);
+
+        // The rest of the events are dispatched in the next iteration, the rendering
+        // and the other events of Qt are processed before it.
+        if (budgeted && stats.readySources > 0)
+            ++stats.budgetYields;
+    }
+
+    stats.flushedClients = WClientStats::flushClients(display->handle(), !budgeted);
+    stats.totalFlushedClients += stats.flushedClients;
+
+    stats.lastDuration = timer.nsecsElapsed();
+    stats.maxDuration = qMax(stats.maxDuration, stats.lastDuration);
+    stats.totalDuration += stats.lastDuration;
+}
+
+int WServerPrivate::readySources() const
+{
+    // Only peek the level-triggered sources, they are still reported to wl_event_loop_dispatch
+    epoll_event events[64];
+    const int count = epoll_wait(wl_event_loop_get_fd(loop), events, std::size(events), 0);
+    return qMax(0, count);
+}
+
 WServer::WServer(QObject *parent)
     : WServer(*new WServerPrivate(this), parent)
 {
@@ -380,4 +473,49 @@ void WServer::setGlobalFilter(GlobalFilterFunc filter, void *data)
     d->globalFilterFuncData = data;
 }
 
+WServer::DispatchMode WServer::dispatchMode() const
+{
+    W_DC(WServer);
+    return d->dispatchMode;
+}
+
+void WServer::setDispatchMode(DispatchMode mode)
+{
+    W_D(WServer);
+    if (d->dispatchMode == mode)
+        return;
+
+    // The Budgeted mode flushes only the clients have events, they're found by the protocol logger
+    if (mode == DispatchMode::Budgeted)
+        WClientStats::ref();
+    else if (d->dispatchMode == DispatchMode::Budgeted)
+        WClientStats::deref();
+    d->dispatchMode = mode;
+}
+
+int WServer::dispatchBudget() const
+{
+    W_DC(WServer);
+    return d->dispatchBudget;
+}
+
+void WServer::setDispatchBudget(int usecs)
+{
+    W_D(WServer);
+    d->dispatchBudget = qMax(0, usecs);
+}
+
+void WServer::setFrameDeadline(const QDeadlineTimer &deadline)
+{
+    W_D(WServer);
+    if (d->frameDeadline.hasExpired() || deadline < d->frameDeadline)
+        d->frameDeadline = deadline;
+}
+
+const WServer::DispatchStats &WServer::dispatchStats() const
+{
+    W_DC(WServer);
+    return d->dispatchStats;
+}
+
 WAYLIB_SERVER_END_NAMESPACE
@@ -85,6 +85,35 @@ class WAYLIB_SERVER_EXPORT WServer : public QObject, public WObject
     friend class WShellInterface;
 
 public:
+    enum class DispatchMode {
+        // Dispatch the ready events once for every iteration of the event loop
+        Unbounded,
+        // Dispatch the ready events in rounds until the budget is spent or the frame
+        // deadline is near, and only flush the clients received events
+        Budgeted,
+    };
+    Q_ENUM(DispatchMode)
+
+    struct DispatchStats {
+        quint64 iterations = 0;
+        // The wl_event_loop_dispatch calls, every ready client reads once in a round
+        quint64 rounds = 0;
+        // The iterations stopped by the budget with the events left
+        quint64 budgetYields = 0;
+        // The iterations skipped for the frame deadline
+        quint64 deadlineYields = 0;
+        // In nanoseconds, including the flush
+        qint64 lastDuration = 0;
+        qint64 maxDuration = 0;
+        qint64 totalDuration = 0;
+        // The sources still ready after the last round of the Budgeted mode, at most 64
+        int readySources = 0;
+        int maxReadySources = 0;
+        // The clients have pending events in the last flush
+        int flushedClients = 0;
+        quint64 totalFlushedClients = 0;
+    };
+
     explicit WServer(QObject *parent = nullptr);
 
     QW_NAMESPACE::qw_display *handle() const;
@@ -144,6 +173,16 @@ public:
 
     void setGlobalFilter(GlobalFilterFunc filter, void *data);
 
+    DispatchMode dispatchMode() const;
+    void setDispatchMode(DispatchMode mode);
+    // In microseconds, the time of the Budgeted mode in an iteration of the event loop
+    int dispatchBudget() const;
+    void setDispatchBudget(int usecs);
+    // The Budgeted mode yields to the rendering before the deadline, the nearest
+    // deadline is kept until it's expired
+    void setFrameDeadline(const QDeadlineTimer &deadline);
+    const DispatchStats &dispatchStats() const;
+
 Q_SIGNALS:
     void started();
 
@@ -3,11 +3,16 @@
 
 #include "wsocket.h"
 #include "private/wglobal_p.h"
+#include "private/wclientstats_p.h"
+
+#include <qwbuffer.h>
 
 #include <QDir>
 #include <QStandardPaths>
 #include <QStringDecoder>
 #include <QPointer>
+#include <QElapsedTimer>
+#include <QHash>
 
 #include <wayland-server-core.h>
 
@@ -17,6 +22,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/un.h>
+#include <poll.h>
 #include <signal.h>
 
 struct wl_event_source;
@@ -248,6 +254,9 @@ public:
     WSocket *socket = nullptr;
     mutable QSharedPointer<WClient::Credentials> credentials;
     mutable int pidFD = -1;
+    WClient::Stats stats;
+    // In the list of WClientStats::flushClients
+    bool pendingFlush = false;
 };
 
 void WlClientDestroyListener::handle_destroy(wl_listener *listener, void *data)
@@ -324,6 +333,12 @@ WClient *WClient::get(const wl_client *client)
     return nullptr;
 }
 
+const WClient::Stats &WClient::stats() const
+{
+    W_DC(WClient);
+    return d->stats;
+}
+
 void WClient::freeze()
 {
     W_D(WClient);
@@ -336,6 +351,234 @@ void WClient::activate()
     pauseClient(d->handle, false);
 }
 
+// The dispatching state of WClientStats, the requests are dispatched one by one
+static struct {
+    QElapsedTimer timer;
+    bool dispatching = false;
+    qint64 lastTime = 0;
+    // The client of the last request, to avoid finding the WClient for every request
+    wl_client *lastHandle = nullptr;
+    QPointer<WClient> lastClient;
+} dispatchState;
+
+// The clients have events since the last WClientStats::flushClients
+static struct {
+    QList<QPointer<WClient>> clients;
+    // The events are sent to a client without WClient, such as Xwayland
+    bool unknownClient = false;
+    wl_client *lastHandle = nullptr;
+    QPointer<WClient> lastClient;
+} flushState;
+
+static void protocolLogger(void *, wl_protocol_logger_type type, const wl_protocol_logger_message *message)
+{
+    if (type == WL_PROTOCOL_LOGGER_REQUEST)
+        WClientStats::addRequest(wl_resource_get_client(message->resource));
+    else
+        WClientStats::addEvent(wl_resource_get_client(message->resource));
+}
+
+static struct {
+    wl_display *display = nullptr;
+    wl_protocol_logger *logger = nullptr;
+    int refs = 0;
+} loggerState;
+
+static void updateProtocolLogger()
+{
+    auto &state = loggerState;
+    if (state.display && state.refs > 0) {
+        if (!state.logger)
+            state.logger = wl_display_add_protocol_logger(state.display, protocolLogger, nullptr);
+    } else if (state.logger) {
+        wl_protocol_logger_destroy(state.logger);
+        state.logger = nullptr;
+    }
+}
+
+void WClientStats::init(wl_display *display)
+{
+    if (!dispatchState.timer.isValid())
+        dispatchState.timer.start();
+    loggerState.display = display;
+    updateProtocolLogger();
+}
+
+void WClientStats::cleanup()
+{
+    loggerState.display = nullptr;
+    updateProtocolLogger();
+}
+
+void WClientStats::ref()
+{
+    ++loggerState.refs;
+    updateProtocolLogger();
+}
+
+void WClientStats::deref()
+{
+    Q_ASSERT(loggerState.refs > 0);
+    --loggerState.refs;
+    updateProtocolLogger();
+}
+
+void WClientStats::addRequest(wl_client *client)
+{
+    auto &state = dispatchState;
+    if (state.dispatching) {
+        const qint64 now = state.timer.nsecsElapsed();
+        // The requests of a client are dispatched together by its source, the time
+        // before the request of another client maybe spent on the other sources, e.g.
+        // the backend, the timers and the idle sources, it isn't billed to anyone.
+        if (client == state.lastHandle && state.lastClient)
+            state.lastClient->d_func()->stats.dispatchTime += now - state.lastTime;
+        state.lastTime = now;
+    }
+
+    if (client != state.lastHandle || !state.lastClient) {
+        state.lastHandle = client;
+        state.lastClient = WClient::get(client);
+    }
+
+    if (state.lastClient)
+        ++state.lastClient->d_func()->stats.requests;
+}
+
+void WClientStats::addEvent(wl_client *client)
+{
+    auto &state = flushState;
+    if (client != state.lastHandle || !state.lastClient) {
+        state.lastHandle = client;
+        state.lastClient = WClient::get(client);
+    }
+
+    if (!state.lastClient) {
+        state.unknownClient = true;
+        return;
+    }
+
+    auto d = state.lastClient->d_func();
+    if (!d->pendingFlush) {
+        d->pendingFlush = true;
+        state.clients.append(state.lastClient);
+    }
+}
+
+void WClientStats::beginDispatch()
+{
+    auto &state = dispatchState;
+    state.dispatching = true;
+    state.lastTime = state.timer.nsecsElapsed();
+    state.lastHandle = nullptr;
+    state.lastClient = nullptr;
+}
+
+void WClientStats::endDispatch()
+{
+    auto &state = dispatchState;
+    // The time after the last request maybe spent on the other sources
+    state.dispatching = false;
+    state.lastHandle = nullptr;
+    state.lastClient = nullptr;
+}
+
+void WClientStats::addCommit(wl_client *client, int frameCallbacks)
+{
+    if (auto c = client ? WClient::get(client) : nullptr) {
+        auto &stats = c->d_func()->stats;
+        ++stats.commits;
+        stats.frameCallbacksRequested += frameCallbacks;
+    }
+}
+
+void WClientStats::addFrameDone(wl_client *client, int frameCallbacks)
+{
+    if (auto c = client ? WClient::get(client) : nullptr)
+        c->d_func()->stats.frameCallbacksDone += frameCallbacks;
+}
+
+// The buffers locked by the surface items, the items keep them alive
+struct LockedBuffer {
+    QPointer<WClient> client;
+    qint64 bytes = 0;
+    int refs = 0;
+};
+static QHash<wlr_buffer*, LockedBuffer> lockedBuffers;
+
+void WClientStats::addLockedBuffer(WClient *client, wlr_buffer *buffer)
+{
+    auto &locked = lockedBuffers[buffer];
+    if (locked.refs++ > 0)
+        return;
+
+    locked.client = client;
+    locked.bytes = bytesOf(buffer);
+    client->d_func()->stats.lockedBufferBytes += locked.bytes;
+}
+
+void WClientStats::removeLockedBuffer(wlr_buffer *buffer)
+{
+    auto it = lockedBuffers.find(buffer);
+    if (it == lockedBuffers.end() || --it->refs > 0)
+        return;
+
+    if (it->client)
+        it->client->d_func()->stats.lockedBufferBytes -= it->bytes;
+    lockedBuffers.erase(it);
+}
+
+qint64 WClientStats::bytesOf(wlr_buffer *buffer)
+{
+    wlr_shm_attributes shm;
+    if (wlr_buffer_get_shm(buffer, &shm))
+        return qint64(shm.stride) * shm.height;
+
+    wlr_dmabuf_attributes dmabuf;
+    if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+        qint64 bytes = 0;
+        for (int i = 0; i < dmabuf.n_planes; ++i)
+            bytes += qint64(dmabuf.stride[i]) * dmabuf.height;
+        return bytes;
+    }
+
+    // The layout is unknown, assume 4 bytes per pixel
+    return qint64(buffer->width) * buffer->height * 4;
+}
+
+int WClientStats::flushClients(wl_display *display, bool all)
+{
+    auto &state = flushState;
+    // The clients have events are unknown without the protocol logger
+    bool flushAll = all || state.unknownClient || !loggerState.logger;
+    int count = 0;
+
+    for (const auto &client : std::as_const(state.clients)) {
+        if (!client)
+            continue;
+        client->d_func()->pendingFlush = false;
+        ++count;
+        if (flushAll)
+            continue;
+
+        wl_client_flush(client->handle());
+        // The socket is full, let wl_display_flush_clients watch it to be writable,
+        // wl_client_flush keeps the rest of the events in the buffer silently.
+        pollfd pfd { wl_client_get_fd(client->handle()), POLLOUT, 0 };
+        if (poll(&pfd, 1, 0) == 0)
+            flushAll = true;
+    }
+
+    state.clients.clear();
+    state.unknownClient = false;
+    state.lastHandle = nullptr;
+    state.lastClient = nullptr;
+
+    if (flushAll)
+        wl_display_flush_clients(display);
+    return count;
+}
+
 WSocket::WSocket(bool freezeClientWhenDisable, WSocket *parentSocket, QObject *parent)
     : QObject(parent)
     , WObject(*new WSocketPrivate(this, freezeClientWhenDisable, parentSocket))
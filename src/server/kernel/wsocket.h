@@ -38,6 +38,23 @@ public:
     [[nodiscard]] static QSharedPointer<Credentials> getCredentials(const wl_client *client);
     static WClient *get(const wl_client *client);
 
+    // The counters since the client is connected, see WClientStatsModel for the rates
+    struct Stats {
+        quint64 commits = 0;
+        quint64 frameCallbacksRequested = 0;
+        quint64 frameCallbacksDone = 0;
+        // The protocol requests dispatched, they and the dispatchTime are counted
+        // only while any WClientStatsModel exists
+        quint64 requests = 0;
+        // In nanoseconds, the time of wl_event_loop_dispatch spent on the requests, the
+        // last request of a batch isn't counted, its end can't be told from the other sources
+        qint64 dispatchTime = 0;
+        // The buffers locked by the compositor to keep the last frame of the surfaces
+        qint64 lockedBufferBytes = 0;
+    };
+
+    const Stats &stats() const;
+
 public Q_SLOTS:
     void freeze();
     void activate();
@@ -45,6 +62,7 @@ public Q_SLOTS:
 private:
     friend class WSocket;
     friend class WlClientDestroyListener;
+    friend class WClientStats;
     explicit WClient(wl_client *client, WSocket *socket);
     ~WClient() = default;
     using QObject::deleteLater;
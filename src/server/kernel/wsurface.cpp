@@ -5,7 +5,9 @@
 #include "qwglobal.h"
 #include "wseat.h"
 #include "private/wsurface_p.h"
+#include "private/wclientstats_p.h"
 #include "woutput.h"
+#include "wtools.h"
 
 #include <qwoutput.h>
 #include <qwcompositor.h>
@@ -19,6 +21,8 @@ extern "C" {
 #include <wlr/util/edges.h>
 }
 
+#include <pixman.h>
+
 QW_USE_NAMESPACE
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
@@ -44,8 +48,15 @@ void WSurfacePrivate::on_commit()
 {
     W_Q(WSurface);
 
-    if (nativeHandle()->current.committed & WLR_SURFACE_STATE_BUFFER)
+    // The callbacks are appended to the list until the frame is done
+    const int callbacks = wl_list_length(&nativeHandle()->current.frame_callback_list);
+    WClientStats::addCommit(waylandClient(), qMax(0, callbacks - frameCallbacks));
+    frameCallbacks = callbacks;
+
+    if (nativeHandle()->current.committed & WLR_SURFACE_STATE_BUFFER) {
+        updateBufferDamage();
         updateBuffer();
+    }
 
     if (nativeHandle()->current.committed & WLR_SURFACE_STATE_OFFSET)
         updateBufferOffset();
@@ -60,6 +71,8 @@ void WSurfacePrivate::init()
     handle()->set_data(this, q);
 
     connect();
+    // The contents of the initial buffer are all new to us
+    bufferDamage = QRect(QPoint(0, 0), q->size());
     updateBuffer();
     updateHasSubsurface();
 
@@ -146,6 +159,15 @@ void WSurfacePrivate::updateBuffer()
     setBuffer(buffer);
 }
 
+void WSurfacePrivate::updateBufferDamage()
+{
+    pixman_region32_t damage;
+    pixman_region32_init(&damage);
+    wlr_surface_get_effective_damage(nativeHandle(), &damage);
+    bufferDamage = WTools::fromPixmanRegion(&damage);
+    pixman_region32_fini(&damage);
+}
+
 void WSurfacePrivate::updateBufferOffset()
 {
     W_Q(WSurface);
@@ -299,6 +321,12 @@ qw_buffer *WSurface::buffer() const
     return d->buffer.get();
 }
 
+QRegion WSurface::bufferDamage() const
+{
+    W_DC(WSurface);
+    return d->bufferDamage;
+}
+
 void WSurface::notifyFrameDone()
 {
     W_D(WSurface);
@@ -306,6 +334,9 @@ void WSurface::notifyFrameDone()
     * prepare another one now if it likes. */
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
+    if (const int callbacks = wl_list_length(&d->nativeHandle()->current.frame_callback_list))
+        WClientStats::addFrameDone(d->waylandClient(), callbacks);
+    d->frameCallbacks = 0;
     wlr_surface_send_frame_done(d->nativeHandle(), &now);
 }
 
@@ -9,6 +9,7 @@
 
 #include <QObject>
 #include <QRect>
+#include <QRegion>
 #include <QQmlEngine>
 
 struct wlr_surface;
@@ -51,6 +52,7 @@ public:
     int bufferScale() const;
     QPoint bufferOffset() const;
     QW_NAMESPACE::qw_buffer *buffer() const;
+    QRegion bufferDamage() const;
 
     void notifyFrameDone();
 
@@ -6,6 +6,7 @@
 #include "wqmlhelper_p.h"
 #include "wtools.h"
 #include "wsgtextureprovider.h"
+#include "wsoftwaretilerenderer_p.h"
 
 #include <qwbuffer.h>
 #include <qwtexture.h>
@@ -16,6 +17,8 @@
 #include <qwrendererinterface.h>
 
 #include <QSGImageNode>
+#include <QMetaMethod>
+#include <QThread>
 
 #define protected public
 #define private public
@@ -32,6 +35,7 @@
 #ifndef QT_NO_OPENGL
 #include <private/qrhigles2_p.h>
 #include <private/qopenglcontext_p.h>
+#include <QOpenGLFunctions>
 #endif
 
 #include <pixman.h>
@@ -250,10 +254,27 @@ qw_buffer *WBufferRenderer::lastBuffer() const
 
 QRhiTexture *WBufferRenderer::currentRenderTarget() const
 {
+    if (!state.buffer || !state.sgRenderTarget.rt)
+        return nullptr;
     auto textureRT = static_cast<QRhiTextureRenderTarget*>(state.sgRenderTarget.rt);
     return textureRT->description().colorAttachmentAt(0)->texture();
 }
 
+QRhiTexture *WBufferRenderer::lastRenderTarget() const
+{
+    if (!m_renderHelper || !m_lastBuffer)
+        return nullptr;
+
+    auto rt = m_renderHelper->lastRenderTarget();
+    if (rt.first != m_lastBuffer || rt.second.isNull())
+        return nullptr;
+    auto rtd = QQuickRenderTargetPrivate::get(&rt.second);
+    if (rtd->type != QQuickRenderTargetPrivate::Type::RhiRenderTarget)
+        return nullptr;
+    auto textureRT = static_cast<QRhiTextureRenderTarget*>(rtd->u.rhiRt);
+    return textureRT->description().colorAttachmentAt(0)->texture();
+}
+
 const qw_damage_ring *WBufferRenderer::damageRing() const
 {
     return &m_damageRing;
@@ -403,6 +424,9 @@ qw_buffer *WBufferRenderer::beginRender(const QSize &pixelSize, qreal devicePixe
     state.pixelSize = pixelSize;
     state.devicePixelRatio = devicePixelRatio;
     state.bufferAge = bufferAge;
+    state.lastDamageSerial = m_damageSerial;
+    m_damageSerial = static_cast<WOutputRenderWindow*>(window())->damageSerial();
+    state.repaintRect = {};
     state.lastRT = lastRT;
     state.buffer = buffer;
     state.renderTarget = rt;
@@ -416,9 +440,15 @@ inline static QRect scaleToRect(const QRectF &s, qreal scale) {
                  (s.size() * scale).toSize());
 }
 
+void WBufferRenderer::prepareRender(int sourceIndex)
+{
+    Q_ASSERT(state.buffer);
+    ensureRenderer(sourceIndex, state.context);
+}
+
 void WBufferRenderer::render(int sourceIndex, const QMatrix4x4 &renderMatrix,
                              const QRectF &sourceRect, const QRectF &targetRect,
-                             bool preserveColorContents)
+                             bool preserveColorContents, QRegion *damage)
 {
     Q_ASSERT(state.buffer);
 
@@ -435,6 +465,32 @@ void WBufferRenderer::render(int sourceIndex, const QMatrix4x4 &renderMatrix,
     const auto viewportRect = scaleToRect(targetRect, devicePixelRatio);
 
     auto softwareRenderer = dynamic_cast<QSGSoftwareRenderer*>(renderer);
+    QRegion itemDamages;
+    bool damageIsTracked = false;
+    if (!softwareRenderer) {
+        if (!preserveColorContents) {
+            // The item damages can't cover the changes of the render parameters
+            const bool renderChanged = m_lastRender.sourceIndex != sourceIndex
+                                       || m_lastRender.renderMatrix != renderMatrix
+                                       || m_lastRender.sourceRect != sourceRect
+                                       || m_lastRender.targetRect != targetRect
+                                       || m_lastRender.devicePixelRatio != devicePixelRatio
+                                       || m_lastRender.clearColor != renderer->clearColor();
+            m_lastRender = {sourceIndex, renderMatrix, sourceRect, targetRect,
+                            devicePixelRatio, renderer->clearColor()};
+
+            damageIsTracked = !renderChanged && state.flags.testFlag(UseItemDamage)
+                              && itemDamage(source.source, sourceRect, viewportRect, &itemDamages);
+            if (damageIsTracked && state.flags.testFlag(PartialRepaint))
+                state.repaintRect = repaintRect(itemDamages, viewportRect);
+            else
+                state.repaintRect = {};
+        } else {
+            damageIsTracked = state.flags.testFlag(UseItemDamage)
+                              && itemDamage(source.source, sourceRect, viewportRect, &itemDamages);
+        }
+    }
+
     { // before render
         if (softwareRenderer) {
             // because software renderer don't supports viewportRect,
@@ -469,19 +525,28 @@ void WBufferRenderer::render(int sourceIndex, const QMatrix4x4 &renderMatrix,
             if (state.renderTarget.mirrorVertically())
                 flipY = !flipY;
 
-            if (viewportRect.isValid()) {
-                QRect vr = viewportRect;
-                if (flipY)
-                    vr.moveTop(-vr.y() + state.pixelSize.height() - vr.height());
-                renderer->setViewportRect(vr);
-            } else {
-                renderer->setViewportRect(QRect(QPoint(0, 0), state.pixelSize));
-            }
-
+            QRect vr = viewportRect.isValid() ? viewportRect : QRect(QPoint(0, 0), state.pixelSize);
             QRectF rect = sourceRect;
             if (!rect.isValid())
                 rect = QRectF(QPointF(0, 0), QSizeF(state.pixelSize) / devicePixelRatio);
 
+            if (isPartialRepaint()) {
+                // Only render the part of source that is mapped to the repaint rect
+                const QRect subViewport = state.repaintRect & vr;
+                Q_ASSERT(!subViewport.isEmpty());
+                const qreal xScale = rect.width() / vr.width();
+                const qreal yScale = rect.height() / vr.height();
+                rect = QRectF(rect.x() + (subViewport.x() - vr.x()) * xScale,
+                              rect.y() + (subViewport.y() - vr.y()) * yScale,
+                              subViewport.width() * xScale,
+                              subViewport.height() * yScale);
+                vr = subViewport;
+            }
+
+            if (flipY)
+                vr.moveTop(-vr.y() + state.pixelSize.height() - vr.height());
+            renderer->setViewportRect(vr);
+
             const float left = rect.x();
             const float right = rect.x() + rect.width();
             float bottom = rect.y() + rect.height();
@@ -508,20 +573,41 @@ void WBufferRenderer::render(int sourceIndex, const QMatrix4x4 &renderMatrix,
             renderer->setProjectionMatrixWithNativeNDC(projectionMatrixWithNativeNDC);
 
             auto textureRT = static_cast<QRhiTextureRenderTarget*>(state.sgRenderTarget.rt);
-            if (preserveColorContents) {
+            if (preserveColorContents || isPartialRepaint()) {
                 textureRT->setFlags(textureRT->flags() | QRhiTextureRenderTarget::PreserveColorContents);
             } else {
                 textureRT->setFlags(textureRT->flags() & ~QRhiTextureRenderTarget::PreserveColorContents);
             }
+
+            // Keep the undamaged contents of the reused buffer, only clear the repaint rect
+            if (isPartialRepaint() && !preserveColorContents)
+                clearRepaintRect(renderer->clearColor());
         }
     }
 
-    state.context->renderNextFrame(renderer);
+    const int tileThreads = softwareRenderer
+        ? static_cast<WOutputRenderWindow*>(window())->softwareRenderThreads() : 1;
+    const bool concurrent = softwareRenderer && state.flags.testFlag(ConcurrentRendering);
+    if (tileThreads > 1 || concurrent)
+        WSoftwareTileRenderer::renderScene(renderer, tileThreads, concurrent);
+    else
+        state.context->renderNextFrame(renderer);
 
     { // after render
         if (!softwareRenderer) {
-            // TODO: get damage area from QRhi renderer
-            m_damageRing.add_whole();
+            if (damage) {
+                *damage += damageIsTracked ? itemDamages : QRegion(QRect(QPoint(0, 0), state.pixelSize));
+            } else if (damageIsTracked) {
+                if (!itemDamages.isEmpty()) {
+                    PixmanRegion pixmanDamage;
+                    bool ok = WTools::toPixmanRegion(itemDamages, pixmanDamage);
+                    Q_ASSERT(ok);
+                    m_damageRing.add(pixmanDamage);
+                }
+            } else {
+                // TODO: get damage area from QRhi renderer
+                m_damageRing.add_whole();
+            }
             // ###: maybe Qt bug? Before executing QRhi::endOffscreenFrame, we may
             // use the same QSGRenderer for multiple drawings. This can lead to
             // rendering the same content for different QSGRhiRenderTarget instances
@@ -605,6 +691,8 @@ void WBufferRenderer::endRender()
     state.renderer = nullptr;
 
     m_lastBuffer = buffer;
+    if (isSignalConnected(QMetaMethod::fromSignal(&WBufferRenderer::bufferRendered)))
+        Q_EMIT bufferRendered(buffer, WTools::fromPixmanRegion(&m_damageRing.handle()->current));
     m_damageRing.rotate();
     m_swapchain->set_buffer_submitted(*buffer);
     buffer->unlock();
@@ -741,6 +829,11 @@ QSGRenderer *WBufferRenderer::ensureRenderer(int sourceIndex, QSGRenderContext *
     if (Q_LIKELY(d.renderer))
         return d.renderer;
 
+    // The renderer is deleted by deleteLater and emits sceneGraphChanged to this,
+    // they need the event loop of the GUI thread, see prepareRender.
+    Q_ASSERT_X(QThread::currentThread() == thread(), "WBufferRenderer::ensureRenderer",
+               "The renderer must be created in the GUI thread");
+
     auto rootNode = WQmlHelper::getRootNode(d.source);
     Q_ASSERT(rootNode);
 
@@ -758,6 +851,102 @@ QSGRenderer *WBufferRenderer::ensureRenderer(int sourceIndex, QSGRenderContext *
     return d.renderer;
 }
 
+bool WBufferRenderer::itemDamage(QQuickItem *source, const QRectF &sourceRect,
+                                 const QRect &viewportRect, QRegion *damage) const
+{
+    auto w = qobject_cast<WOutputRenderWindow*>(window());
+    QList<std::pair<QQuickItem*, QRegion>> damages;
+    if (!w || !w->itemDamages(state.lastDamageSerial, &damages))
+        return false;
+
+    // Same as the projection matrix and viewport in render
+    QRectF rect = sourceRect;
+    if (!rect.isValid())
+        rect = QRectF(QPointF(0, 0), QSizeF(state.pixelSize) / state.devicePixelRatio);
+    const QRect bufferRect(QPoint(0, 0), state.pixelSize);
+    const QRectF vr = viewportRect.isValid() ? QRectF(viewportRect) : QRectF(bufferRect);
+
+    QTransform toBuffer = QTransform::fromTranslate(-rect.x(), -rect.y());
+    toBuffer *= QTransform::fromScale(vr.width() / rect.width(), vr.height() / rect.height());
+    toBuffer *= QTransform::fromTranslate(vr.x(), vr.y());
+
+    for (const auto &[item, region] : std::as_const(damages)) {
+        QTransform itemToSource = QQuickItemPrivate::get(item)->itemToWindowTransform();
+        if (!isRootItem(source)) {
+            if (item != source && !source->isAncestorOf(item))
+                continue;
+            itemToSource *= QQuickItemPrivate::get(source)->windowToItemTransform();
+        }
+
+        const QMatrix4x4 matrix = state.worldTransform * QMatrix4x4(itemToSource);
+        for (const QRect &r : region) {
+            const QRectF mapped = toBuffer.mapRect(matrix.mapRect(QRectF(r)));
+            *damage += mapped.toAlignedRect() & bufferRect;
+        }
+    }
+
+    return true;
+}
+
+QRect WBufferRenderer::repaintRect(const QRegion &damage, const QRect &viewportRect)
+{
+#ifndef QT_NO_OPENGL
+    // Only OpenGL supports to clear a part of the render target by clearRepaintRect
+    auto wd = QQuickWindowPrivate::get(window());
+    if (!wd->rhi || wd->rhi->backend() != QRhi::OpenGLES2)
+        return {};
+
+    // The contents of this buffer is unknown
+    if (state.bufferAge <= 0)
+        return {};
+
+    PixmanRegion bufferDamage;
+    m_damageRing.get_buffer_damage(state.bufferAge, bufferDamage);
+
+    const QRect bufferRect(QPoint(0, 0), state.pixelSize);
+    const QRect vr = viewportRect.isValid() ? viewportRect : bufferRect;
+    const QRegion region = damage + WTools::fromPixmanRegion(bufferDamage);
+    // QSGRenderer only supports one viewport, so repaint the bounding rect of damages
+    const QRect rect = region.boundingRect() & bufferRect;
+
+    // Fallback to repaint the whole buffer if nothing need to render
+    if (rect.isEmpty() || rect == bufferRect || !rect.intersects(vr))
+        return {};
+
+    return rect;
+#else
+    Q_UNUSED(damage);
+    Q_UNUSED(viewportRect);
+    return {};
+#endif
+}
+
+void WBufferRenderer::clearRepaintRect(const QColor &color) const
+{
+#ifndef QT_NO_OPENGL
+    Q_ASSERT(isPartialRepaint());
+    auto glRT = QRHI_RES(QGles2TextureRenderTarget, state.sgRenderTarget.rt);
+    const QRect &rect = state.repaintRect;
+    // The origin of OpenGL framebuffer is bottom-left
+    const int y = state.renderTarget.mirrorVertically()
+                      ? rect.y()
+                      : state.pixelSize.height() - rect.y() - rect.height();
+
+    state.sgRenderTarget.cb->beginExternal();
+    auto gl = QOpenGLContext::currentContext()->functions();
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, glRT->framebuffer);
+    gl->glEnable(GL_SCISSOR_TEST);
+    gl->glScissor(rect.x(), y, rect.width(), rect.height());
+    gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    gl->glClearColor(color.redF(), color.greenF(), color.blueF(), color.alphaF());
+    gl->glClear(GL_COLOR_BUFFER_BIT);
+    gl->glDisable(GL_SCISSOR_TEST);
+    state.sgRenderTarget.cb->endExternal();
+#else
+    Q_UNUSED(color);
+#endif
+}
+
 WAYLIB_SERVER_END_NAMESPACE
 
 #include "moc_wbufferrenderer_p.cpp"
@@ -15,6 +15,7 @@
 #undef protected
 
 Q_MOC_INCLUDE(<private/qsgplaintexture_p.h>)
+Q_MOC_INCLUDE(<qwbuffer.h>)
 
 QT_BEGIN_NAMESPACE
 class QSGPlainTexture;
@@ -45,6 +46,13 @@ public:
         DontTestSwapchain = 2,
         RedirectOpenGLContextDefaultFrameBufferObject = 4,
         UseCursorFormats = 8,
+        // Use the damages reported by WOutputRenderWindow::addDamage for the RHI renderer
+        UseItemDamage = 16,
+        // Only repaint the damaged area of the reused buffer, requires UseItemDamage
+        PartialRepaint = 32,
+        // Rendered at the same time with the other buffers, the glyph caches shared by
+        // the threads are locked, only for the software renderer
+        ConcurrentRendering = 64,
     };
     Q_DECLARE_FLAGS(RenderFlags, RenderFlag)
 
@@ -72,6 +80,13 @@ public:
     QW_NAMESPACE::qw_buffer *currentBuffer() const;
     QW_NAMESPACE::qw_buffer *lastBuffer() const;
     QRhiTexture *currentRenderTarget() const;
+    // The texture of lastBuffer, only for the RHI renderers
+    QRhiTexture *lastRenderTarget() const;
+    // Only the repaint rect of the current buffer is rendered, see PartialRepaint,
+    // it's kept until the next beginRender.
+    inline bool isPartialRepaint() const {
+        return state.repaintRect.isValid();
+    }
     const QW_NAMESPACE::qw_damage_ring *damageRing() const;
     QW_NAMESPACE::qw_damage_ring *damageRing();
 
@@ -88,13 +103,21 @@ Q_SIGNALS:
     void cacheBufferChanged();
     void beforeRendering();
     void afterRendering();
+    // Emitted at the end of the frame, after the buffer of the output is committed,
+    // the damage is in the pixel coordinates of the buffer. Only for WOutputCapture.
+    void bufferRendered(QW_NAMESPACE::qw_buffer *buffer, const QRegion &damage);
 
 protected:
     QW_NAMESPACE::qw_buffer *beginRender(const QSize &pixelSize, qreal devicePixelRatio,
                                         uint32_t format, RenderFlags flags = {});
+    // Creates the renderer of the source in the GUI thread, the render of it
+    // can be called in the other threads after that
+    void prepareRender(int sourceIndex);
+    // If damage isn't nullptr, the damage of the RHI renderer is returned by it
+    // instead of adding to the damage ring, the caller adds it once for the frame.
     void render(int sourceIndex, const QMatrix4x4 &renderMatrix,
                 const QRectF &sourceRect = {}, const QRectF &targetRect = {},
-                bool preserveColorContents = false);
+                bool preserveColorContents = false, QRegion *damage = nullptr);
     void endRender();
     void componentComplete() override;
 
@@ -123,6 +146,10 @@ private:
     void removeSource(int index);
     int indexOfSource(QQuickItem *item);
     QSGRenderer *ensureRenderer(int sourceIndex, QSGRenderContext *rc);
+    bool itemDamage(QQuickItem *source, const QRectF &sourceRect,
+                    const QRect &viewportRect, QRegion *damage) const;
+    QRect repaintRect(const QRegion &damage, const QRect &viewportRect);
+    void clearRepaintRect(const QColor &color) const;
 
     QW_NAMESPACE::qw_swapchain *m_swapchain = nullptr;
     WRenderHelper *m_renderHelper = nullptr;
@@ -136,6 +163,9 @@ private:
         QSize pixelSize;
         qreal devicePixelRatio;
         int bufferAge;
+        quint64 lastDamageSerial;
+        // Only valid when PartialRepaint is working for the current buffer
+        QRect repaintRect;
         std::pair<QW_NAMESPACE::qw_buffer*, QQuickRenderTarget> lastRT;
         QW_NAMESPACE::qw_buffer *buffer = nullptr;
         QQuickRenderTarget renderTarget;
@@ -154,6 +184,16 @@ private:
     mutable std::unique_ptr<WSGTextureProvider> m_textureProvider;
     QColor m_clearColor = Qt::transparent;
     QList<QObject*> m_cacheBufferLocker;
+    quint64 m_damageSerial = 0;
+
+    struct {
+        int sourceIndex = -1;
+        QMatrix4x4 renderMatrix;
+        QRectF sourceRect;
+        QRectF targetRect;
+        qreal devicePixelRatio = 0;
+        QColor clearColor;
+    } m_lastRender;
 
     uint m_cacheBuffer:1;
     uint m_hideSource:1;
@@ -0,0 +1,112 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "woutputlayertestcache_p.h"
+
+#include <qwbuffer.h>
+#include <qwoutputlayer.h>
+
+#include <drm_fourcc.h>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+static void appendBufferFingerprint(QList<quint64> *list, wlr_buffer *buffer)
+{
+    list->append((quint64(quint32(buffer->width)) << 32) | quint32(buffer->height));
+
+    wlr_dmabuf_attributes dmabuf;
+    wlr_shm_attributes shm;
+    if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+        list->append(dmabuf.format);
+        list->append(dmabuf.modifier);
+    } else if (wlr_buffer_get_shm(buffer, &shm)) {
+        list->append(shm.format);
+        list->append(DRM_FORMAT_MOD_INVALID);
+    } else {
+        list->append(DRM_FORMAT_INVALID);
+        list->append(DRM_FORMAT_MOD_INVALID);
+    }
+}
+
+bool WOutputLayerTestCache::reuse(wlr_buffer *primaryBuffer, const wlr_output_layer_state_array &layers, bool *ok)
+{
+    m_holding = false;
+    m_pendingStructure.clear();
+    m_pendingGeometry.clear();
+    m_pendingStructure.reserve(3 + layers.size() * 4);
+    m_pendingGeometry.reserve(layers.size() * 2);
+
+    if (primaryBuffer)
+        appendBufferFingerprint(&m_pendingStructure, primaryBuffer);
+    for (const auto &layer : layers) {
+        m_pendingStructure.append(quintptr(layer.layer));
+        appendBufferFingerprint(&m_pendingStructure, layer.buffer);
+        m_pendingGeometry.append((quint64(quint32(layer.dst_box.x)) << 32) | quint32(layer.dst_box.y));
+        m_pendingGeometry.append((quint64(quint32(layer.dst_box.width)) << 32) | quint32(layer.dst_box.height));
+    }
+
+    if (!m_valid || m_structure != m_pendingStructure || ++m_reusedFrames > MaxReusedFrames)
+        return false;
+
+    auto states = const_cast<wlr_output_layer_state*>(layers.data());
+    if (m_geometry == m_pendingGeometry) {
+        for (int i = 0; i < layers.size(); ++i)
+            states[i].accepted = m_accepted.at(i);
+        *ok = m_ok;
+        return true;
+    }
+
+    // The accepted layers maybe rejected at the new positions, they must be tested again.
+    const bool rejected = !m_ok || m_accepted.contains(false);
+    if (!rejected || m_reusedFrames > RejectedHoldFrames)
+        return false;
+
+    // Keep the moving layers in software composition instead of testing every frame,
+    // otherwise they maybe switched between the hardware and software every frame.
+    for (int i = 0; i < layers.size(); ++i)
+        states[i].accepted = false;
+    *ok = false;
+    m_holding = true;
+    return true;
+}
+
+void WOutputLayerTestCache::save(const wlr_output_layer_state_array &layers, bool ok)
+{
+    Q_ASSERT(m_pendingGeometry.size() == layers.size() * 2);
+
+    m_structure = std::move(m_pendingStructure);
+    m_geometry = std::move(m_pendingGeometry);
+    m_layers.resize(layers.size());
+    m_accepted.resize(layers.size());
+    for (int i = 0; i < layers.size(); ++i) {
+        m_layers[i] = layers.at(i).layer;
+        m_accepted[i] = layers.at(i).accepted;
+    }
+    m_ok = ok;
+    m_valid = true;
+    m_reusedFrames = 0;
+}
+
+void WOutputLayerTestCache::verifyCommit(const wlr_output_layer_state_array &layers, bool ok)
+{
+    if (!m_valid)
+        return;
+    if (!ok) {
+        m_valid = false;
+        return;
+    }
+    if (m_holding)
+        return;
+
+    // The committed layers maybe less than the tested, e.g. the top one is moved
+    // to the cursor plane.
+    for (const auto &state : layers) {
+        const int index = m_layers.indexOf(state.layer);
+        if (index >= 0 && m_accepted.at(index) != state.accepted) {
+            m_valid = false;
+            return;
+        }
+    }
+}
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,59 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+#include <woutputhelper.h>
+
+#include <QList>
+
+struct wlr_buffer;
+struct wlr_output_layer;
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// The result of the last atomic test of the output layers, it's reused while the layers
+// and the formats of their buffers are not changed, see WOutputHelper::testCommit.
+class WAYLIB_SERVER_EXPORT WOutputLayerTestCache
+{
+public:
+    // Test again after reusing a result for this number of frames
+    static constexpr int MaxReusedFrames = 120;
+    // The rejected layers are kept in software composition for this number of frames after they're moved
+    static constexpr int RejectedHoldFrames = 30;
+
+    // Sets the accepted of the layers and the ok to the last result if it can be reused,
+    // otherwise the layers must be tested and the result is saved by save.
+    bool reuse(wlr_buffer *primaryBuffer, const wlr_output_layer_state_array &layers, bool *ok);
+    // The result of the layers passed to the last reuse
+    void save(const wlr_output_layer_state_array &layers, bool ok);
+    // Compares the accepted of the committed layers with the result, the driver maybe
+    // reject a layer it accepted before, the layers are tested again after a mismatch.
+    void verifyCommit(const wlr_output_layer_state_array &layers, bool ok);
+    inline void invalidate() {
+        m_valid = false;
+    }
+
+    inline bool isValid() const {
+        return m_valid;
+    }
+
+private:
+    // The layers and the formats of their buffers, and the primary buffer
+    QList<quint64> m_structure;
+    // The positions and the sizes of the layers
+    QList<quint64> m_geometry;
+    QList<wlr_output_layer*> m_layers;
+    QList<bool> m_accepted;
+    // The keys of the last reuse, they're saved by save
+    QList<quint64> m_pendingStructure;
+    QList<quint64> m_pendingGeometry;
+    bool m_ok = false;
+    bool m_valid = false;
+    // The moving rejected layers are kept in software composition, not the result
+    bool m_holding = false;
+    int m_reusedFrames = 0;
+};
+
+WAYLIB_SERVER_END_NAMESPACE
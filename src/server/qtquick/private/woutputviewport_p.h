@@ -17,6 +17,7 @@ QW_USE_NAMESPACE
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
 class OutputTextureProvider;
+class WSurfaceItemContent;
 class Q_DECL_HIDDEN WOutputViewportPrivate : public QQuickItemPrivate
 {
 public:
@@ -68,9 +69,15 @@ public:
     void updateImplicitSize();
     void updateRenderBufferSource();
     void setExtraRenderSource(QQuickItem *source);
+    // Replaces the input in mirror mode, see WOutputViewport::mirrorSource
+    void setMirrorRenderSource(QQuickItem *source);
+    // Returns the topmost surface item on this viewport if its buffer covers the whole
+    // output without any transformation, the buffer can be attached to the output directly.
+    WSurfaceItemContent *scanoutCandidate() const;
 
     W_DECLARE_PUBLIC(WOutputViewport)
     QList<WOutputViewport*> depends;
+    QPointer<WOutputViewport> mirrorSource;
 
     QQuickItem *input = nullptr;
     WOutput *output = nullptr;
@@ -79,6 +86,7 @@ public:
     qreal devicePixelRatio = 1.0;
     WBufferRenderer *bufferRenderer = nullptr;
     QPointer<QQuickItem> extraRenderSource;
+    QPointer<QQuickItem> mirrorRenderSource;
     QRectF sourceRect;
     QRectF targetRect;
 
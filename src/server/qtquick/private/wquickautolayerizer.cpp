@@ -0,0 +1,257 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "wquickautolayerizer_p.h"
+#include "woutputviewport.h"
+#include "wrenderbufferblitter.h"
+#include "wbufferrenderer_p.h"
+#include "wsurfaceitem.h"
+
+#include <QQuickWindow>
+#include <QQuickItem>
+#include <QtMath>
+#include <private/qquickitem_p.h>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+#define LAYER "__layer_enabled_by_WQuickAutoLayerizer"
+
+// The smaller subtrees are cheaper to render than a texture
+static constexpr int MinContentItems = 3;
+
+WQuickAutoLayerizer::WQuickAutoLayerizer(QQuickWindow *window)
+    : QObject(window)
+{
+
+}
+
+WQuickAutoLayerizer *WQuickAutoLayerizer::get(QQuickWindow *window)
+{
+    auto layerizer = window->findChild<WQuickAutoLayerizer*>(QString(), Qt::FindDirectChildrenOnly);
+    if (!layerizer)
+        layerizer = new WQuickAutoLayerizer(window);
+    return layerizer;
+}
+
+void WQuickAutoLayerizer::setStaticFrames(int frames)
+{
+    m_staticFrames = qMax(1, frames);
+}
+
+void WQuickAutoLayerizer::setMemoryBudget(qint64 bytes)
+{
+    m_memoryBudget = qMax<qint64>(0, bytes);
+
+    // Release the latest layers first, the older ones are more likely to stay static
+    while (!m_layers.isEmpty() && m_stats.bytes > m_memoryBudget)
+        release(m_layers.size() - 1, false);
+}
+
+void WQuickAutoLayerizer::update(const QList<QQuickItem*> &roots, QQuickItem *dirtyItemList)
+{
+    ++m_frame;
+    markChanges(dirtyItemList);
+
+    for (QQuickItem *root : roots)
+        visit(root, true);
+
+    // The layers out of the roots, or under the hidden items
+    for (int i = m_layers.size() - 1; i >= 0; --i) {
+        if (m_layers.at(i).frame != m_frame)
+            release(i, false);
+    }
+
+    // The items not in the hash are static
+    for (auto it = m_changes.begin(); it != m_changes.end();) {
+        if (m_frame - it.value() >= quint64(m_staticFrames))
+            it = m_changes.erase(it);
+        else
+            ++it;
+    }
+
+    // Moved to the other windows
+    QQuickWindow *window = qobject_cast<QQuickWindow*>(parent());
+    for (auto it = m_rejected.begin(); it != m_rejected.end();) {
+        if ((*it)->window() != window)
+            it = m_rejected.erase(it);
+        else
+            ++it;
+    }
+}
+
+void WQuickAutoLayerizer::clear()
+{
+    while (!m_layers.isEmpty())
+        release(m_layers.size() - 1, false);
+
+    m_changes.clear();
+    m_rejected.clear();
+    m_frame = 0;
+}
+
+void WQuickAutoLayerizer::markChanges(QQuickItem *dirtyItemList)
+{
+    for (QQuickItem *item = dirtyItemList; item; item = QQuickItemPrivate::get(item)->nextDirtyItem) {
+        for (QQuickItem *i = item; i; i = i->parentItem()) {
+            quint64 &frame = m_changes[i];
+            // The ancestors are already marked by the other dirty items
+            if (frame == m_frame)
+                break;
+            if (frame == 0)
+                watch(i);
+            frame = m_frame;
+            m_rejected.remove(i);
+        }
+    }
+}
+
+void WQuickAutoLayerizer::visit(QQuickItem *item, bool isRoot)
+{
+    if (!item->isVisible() || qFuzzyIsNull(item->opacity()))
+        return;
+
+    const int index = indexOfLayer(item);
+    if (index >= 0) {
+        if (isStatic(item)) {
+            m_layers[index].frame = m_frame;
+            return;
+        }
+        release(index, true);
+    } else {
+        auto d = QQuickItemPrivate::get(item);
+        // Drawn by the output layers or the other effects
+        if (d->extra.isAllocated() && d->extra->hideRefCount > 0)
+            return;
+
+        if (!isRoot && isStatic(item) && !m_rejected.contains(item)) {
+            if (!canLayerize(item)) {
+                m_rejected.insert(item);
+                watch(item);
+            } else if (layerize(item)) {
+                return;
+            }
+        }
+    }
+
+    const auto children = QQuickItemPrivate::get(item)->paintOrderChildItems();
+    for (QQuickItem *child : children)
+        visit(child, false);
+}
+
+bool WQuickAutoLayerizer::isStatic(QQuickItem *item) const
+{
+    // Nothing is static in the first frames after the layerizer is started
+    return m_frame - m_changes.value(item, 0) >= quint64(m_staticFrames);
+}
+
+int WQuickAutoLayerizer::countContentItems(QQuickItem *item) const
+{
+    auto d = QQuickItemPrivate::get(item);
+    // The layers in the subtree are released if the subtree is layered
+    if (d->extra.isAllocated() && indexOfLayer(item) < 0) {
+        // Its contents are displayed by the others, or it's a layer already
+        if (d->extra->effectRefCount > 0 || d->extra->hideRefCount > 0
+            || (d->extra->layer && d->extra->layer->enabled())) {
+            return -1;
+        }
+    }
+
+    // They use the render target or the scene graph of the window directly
+    if (qobject_cast<WOutputViewport*>(item) || qobject_cast<WBufferRenderer*>(item)
+        || qobject_cast<WRenderBufferBlitter*>(item)) {
+        return -1;
+    }
+    // The layer hides the surfaces from the direct scanout and the occlusion culling,
+    // and their buffers are drawn as the textures already.
+    if (qobject_cast<WSurfaceItemContent*>(item))
+        return -1;
+
+    int count = item->flags().testFlag(QQuickItem::ItemHasContents) ? 1 : 0;
+    for (QQuickItem *child : d->childItems) {
+        if (!child->isVisible())
+            continue;
+        const int n = countContentItems(child);
+        if (n < 0)
+            return -1;
+        count += n;
+    }
+
+    return count;
+}
+
+bool WQuickAutoLayerizer::canLayerize(QQuickItem *item) const
+{
+    if (item->width() <= 0 || item->height() <= 0)
+        return false;
+    // The children out of the bounding rect are clipped by the texture
+    if (!item->clip() && !item->childrenRect().isEmpty()
+        && !QRectF(QPointF(0, 0), item->size()).contains(item->childrenRect())) {
+        return false;
+    }
+
+    return countContentItems(item) >= MinContentItems;
+}
+
+bool WQuickAutoLayerizer::layerize(QQuickItem *item)
+{
+    const qreal dpr = item->window()->effectiveDevicePixelRatio();
+    const qint64 bytes = qint64(qCeil(item->width() * dpr)) * qCeil(item->height() * dpr) * 4;
+
+    // The layers in the subtree are not needed anymore
+    for (int i = m_layers.size() - 1; i >= 0; --i) {
+        if (item->isAncestorOf(m_layers.at(i).item))
+            release(i, false);
+    }
+
+    if (m_stats.bytes + bytes > m_memoryBudget)
+        return false;
+
+    item->setProperty(LAYER, true);
+    QQuickItemPrivate::get(item)->layer()->setEnabled(true);
+
+    m_layers.append({item, bytes, m_frame});
+    ++m_stats.layers;
+    m_stats.bytes += bytes;
+    ++m_stats.created;
+
+    return true;
+}
+
+void WQuickAutoLayerizer::watch(QQuickItem *item)
+{
+    connect(item, &QObject::destroyed, this, &WQuickAutoLayerizer::onItemDestroyed,
+            Qt::UniqueConnection);
+}
+
+void WQuickAutoLayerizer::onItemDestroyed(QObject *object)
+{
+    // Only the address is used
+    auto item = static_cast<QQuickItem*>(object);
+    m_changes.remove(item);
+    m_rejected.remove(item);
+}
+
+int WQuickAutoLayerizer::indexOfLayer(const QQuickItem *item) const
+{
+    for (int i = 0; i < m_layers.size(); ++i) {
+        if (m_layers.at(i).item == item)
+            return i;
+    }
+    return -1;
+}
+
+void WQuickAutoLayerizer::release(int index, bool invalidated)
+{
+    const Layer layer = m_layers.takeAt(index);
+    --m_stats.layers;
+    m_stats.bytes -= layer.bytes;
+    if (invalidated)
+        ++m_stats.invalidated;
+
+    if (layer.item && layer.item->property(LAYER).toBool()) {
+        QQuickItemPrivate::get(layer.item)->layer()->setEnabled(false);
+        layer.item->setProperty(LAYER, QVariant());
+    }
+}
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,93 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QObject>
+#include <QPointer>
+#include <QHash>
+#include <QSet>
+
+QT_BEGIN_NAMESPACE
+class QQuickWindow;
+class QQuickItem;
+QT_END_NAMESPACE
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// Renders the subtrees not changed in the recent frames into the textures by the
+// QQuickItemLayer, they're drawn as single quads until any item in them is changed.
+// The topmost static subtree is layered, and the layers are released when they're
+// changed, so the animating items are always rendered directly.
+class WAYLIB_SERVER_EXPORT WQuickAutoLayerizer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        int layers = 0;
+        qint64 bytes = 0;
+        // The total number of the created layers, and the ones released by changes
+        quint64 created = 0;
+        quint64 invalidated = 0;
+    };
+
+    static WQuickAutoLayerizer *get(QQuickWindow *window);
+
+    // The number of the frames a subtree must stay unchanged before it's layered
+    inline int staticFrames() const {
+        return m_staticFrames;
+    }
+    void setStaticFrames(int frames);
+
+    // The maximum bytes of the textures of all layers
+    inline qint64 memoryBudget() const {
+        return m_memoryBudget;
+    }
+    void setMemoryBudget(qint64 bytes);
+
+    // Must be called after polishing the items, and before synchronizing the scene graph
+    void update(const QList<QQuickItem*> &roots, QQuickItem *dirtyItemList);
+    void clear();
+
+    inline const Stats &stats() const {
+        return m_stats;
+    }
+
+private:
+    explicit WQuickAutoLayerizer(QQuickWindow *window);
+
+    struct Layer {
+        QPointer<QQuickItem> item;
+        qint64 bytes = 0;
+        quint64 frame = 0;
+    };
+
+    void markChanges(QQuickItem *dirtyItemList);
+    void visit(QQuickItem *item, bool isRoot);
+    bool isStatic(QQuickItem *item) const;
+    // Returns the number of the items with contents, or -1 if the subtree can't be layered
+    int countContentItems(QQuickItem *item) const;
+    bool canLayerize(QQuickItem *item) const;
+    bool layerize(QQuickItem *item);
+    // Removes the destroyed item from m_changes and m_rejected
+    void watch(QQuickItem *item);
+    void onItemDestroyed(QObject *object);
+    int indexOfLayer(const QQuickItem *item) const;
+    void release(int index, bool invalidated);
+
+    int m_staticFrames = 60;
+    qint64 m_memoryBudget = 128 * 1024 * 1024;
+
+    quint64 m_frame = 0;
+    // The last frame in which the subtree is changed, only for the recently changed items
+    QHash<QQuickItem*, quint64> m_changes;
+    // The subtrees can't be layered until they're changed
+    QSet<QQuickItem*> m_rejected;
+    QList<Layer> m_layers;
+    Stats m_stats;
+};
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,382 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "wquickhittestindex_p.h"
+
+#include <QQuickWindow>
+#include <QQuickItem>
+#include <QVarLengthArray>
+#include <QtMath>
+#include <private/qquickitem_p.h>
+#include <private/qquickwindow_p.h>
+
+#include <algorithm>
+#include <limits>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+static constexpr int CellSize = 256;
+// An entry covers more than this number of cells is tested for every position
+static constexpr int MaxCellsOfEntry = 64;
+// The stacking order is resolved when hit-testing, so the SiblingOrder isn't needed.
+// The Matrix covers the scale and the transforms, e.g. the animations of the windows.
+static const QQuickItemPrivate::ChangeTypes ListenTypes = QQuickItemPrivate::Geometry
+                                                          | QQuickItemPrivate::Visibility
+                                                          | QQuickItemPrivate::Rotation
+                                                          | QQuickItemPrivate::Matrix
+                                                          | QQuickItemPrivate::Children
+                                                          | QQuickItemPrivate::Destroyed;
+
+static inline int cellOf(qreal value)
+{
+    return qFloor(value / CellSize);
+}
+
+static inline quint64 cellKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
+
+static inline QRectF unboundedRect()
+{
+    const qreal max = std::numeric_limits<int>::max();
+    return QRectF(QPointF(-max, -max), QPointF(max, max));
+}
+
+static inline bool isHoverItem(QQuickItem *item)
+{
+    auto d = QQuickItemPrivate::get(item);
+    // The items with the hover handlers are also counted, the hover handlers
+    // don't accept the event, but the delivery to them must be keep.
+    return d->hoverEnabled || d->hasHoverHandlers();
+}
+
+// Same order with QQuickDeliveryAgentPrivate::deliverHoverEventRecursive, the children
+// are tested before their parent, and the siblings are in the reversed paint order.
+static bool isAbove(QQuickItem *item, QQuickItem *other)
+{
+    if (other->isAncestorOf(item))
+        return true;
+    if (item->isAncestorOf(other))
+        return false;
+
+    // The children of the common ancestor
+    QQuickItem *child = item;
+    while (!child->parentItem()->isAncestorOf(other))
+        child = child->parentItem();
+    QQuickItem *otherChild = other;
+    while (otherChild->parentItem() != child->parentItem())
+        otherChild = otherChild->parentItem();
+
+    const auto children = QQuickItemPrivate::get(child->parentItem())->paintOrderChildItems();
+    return children.indexOf(child) > children.indexOf(otherChild);
+}
+
+WQuickHitTestIndex::WQuickHitTestIndex(QQuickWindow *window)
+    : QObject(window)
+    , m_window(window)
+{
+
+}
+
+WQuickHitTestIndex::~WQuickHitTestIndex()
+{
+    for (auto item : std::as_const(m_listenedItems))
+        QQuickItemPrivate::get(item)->removeItemChangeListener(this, ListenTypes);
+}
+
+WQuickHitTestIndex *WQuickHitTestIndex::get(QQuickWindow *window)
+{
+    auto index = window->findChild<WQuickHitTestIndex*>(QString(), Qt::FindDirectChildrenOnly);
+    if (!index)
+        index = new WQuickHitTestIndex(window);
+    return index;
+}
+
+QQuickItem *WQuickHitTestIndex::hoverItemAt(const QPointF &scenePos, bool *exclusive)
+{
+    // The items changed after the last synchronizing
+    updateDirtyItems();
+    if (m_dirty)
+        rebuild();
+    else if (!m_dirtyItems.isEmpty())
+        update();
+
+    QVarLengthArray<QQuickItem*, 16> items;
+    const auto it = m_cells.constFind(cellKey(cellOf(scenePos.x()), cellOf(scenePos.y())));
+    if (it != m_cells.constEnd()) {
+        for (auto item : it.value()) {
+            if (testEntry(item, scenePos))
+                items.append(item);
+        }
+    }
+    for (auto item : std::as_const(m_largeEntries)) {
+        if (testEntry(item, scenePos))
+            items.append(item);
+    }
+
+    if (exclusive)
+        *exclusive = items.size() <= 1;
+    if (items.isEmpty())
+        return nullptr;
+
+    return *std::max_element(items.cbegin(), items.cend(), [] (QQuickItem *a, QQuickItem *b) {
+        return isAbove(b, a);
+    });
+}
+
+void WQuickHitTestIndex::invalidate()
+{
+    m_dirty = true;
+}
+
+void WQuickHitTestIndex::updateDirtyItems()
+{
+    if (m_dirty)
+        return;
+
+    // The clip and the hover state are changed without the notification, but the items
+    // are marked dirty by setClip, setAcceptHoverEvents and the HoverHandler.
+    const auto windowD = QQuickWindowPrivate::get(m_window);
+    for (QQuickItem *item = windowD->dirtyItemList; item; item = QQuickItemPrivate::get(item)->nextDirtyItem) {
+        auto d = QQuickItemPrivate::get(item);
+        if (!d->subtreeHoverEnabled || !item->isVisible())
+            continue;
+        // The items stop hovering are skipped by testEntry
+        if (item->clip() != m_clipItems.contains(item)
+            || (isHoverItem(item) && !m_entries.contains(item))) {
+            markDirty(item);
+        }
+    }
+}
+
+void WQuickHitTestIndex::itemGeometryChanged(QQuickItem *item, QQuickGeometryChange change, const QRectF &oldGeometry)
+{
+    Q_UNUSED(change);
+    Q_UNUSED(oldGeometry);
+    markDirty(item);
+}
+
+void WQuickHitTestIndex::itemVisibilityChanged(QQuickItem *item)
+{
+    markDirty(item);
+}
+
+void WQuickHitTestIndex::itemRotationChanged(QQuickItem *item)
+{
+    markDirty(item);
+}
+
+void WQuickHitTestIndex::itemTransformChanged(QQuickItem *item, QQuickItem *transformedItem)
+{
+    Q_UNUSED(transformedItem);
+    markDirty(item);
+}
+
+void WQuickHitTestIndex::itemChildAdded(QQuickItem *item, QQuickItem *child)
+{
+    Q_UNUSED(item);
+    if (m_dirty)
+        return;
+    listen(child);
+    // The hover state of the new items is usually set after they're added
+    if (!m_dirtyItems.contains(child))
+        m_dirtyItems.append(child);
+}
+
+void WQuickHitTestIndex::itemChildRemoved(QQuickItem *item, QQuickItem *child)
+{
+    Q_UNUSED(item);
+    if (m_dirty)
+        return;
+    unlisten(child);
+}
+
+void WQuickHitTestIndex::itemDestroyed(QQuickItem *item)
+{
+    removeEntry(item);
+    m_clipItems.remove(item);
+    m_listenedItems.remove(item);
+}
+
+void WQuickHitTestIndex::rebuild()
+{
+    m_dirty = false;
+    m_dirtyItems.clear();
+    for (auto item : std::as_const(m_listenedItems))
+        QQuickItemPrivate::get(item)->removeItemChangeListener(this, ListenTypes);
+    m_listenedItems.clear();
+    m_entries.clear();
+    m_clipItems.clear();
+    m_cells.clear();
+    m_largeEntries.clear();
+    m_updatedSubtrees = 0;
+
+    listen(m_window->contentItem());
+    collect(m_window->contentItem(), unboundedRect());
+}
+
+void WQuickHitTestIndex::update()
+{
+    QSet<QQuickItem*> roots;
+    for (const auto &item : std::as_const(m_dirtyItems)) {
+        // It's removed from the window if it's not listened
+        if (item && m_listenedItems.contains(item))
+            roots.insert(item);
+    }
+    m_dirtyItems.clear();
+
+    for (auto item : std::as_const(roots)) {
+        QRectF clip = unboundedRect();
+        bool collected = false;
+        for (auto parent = item->parentItem(); parent; parent = parent->parentItem()) {
+            if (roots.contains(parent)) {
+                collected = true;
+                break;
+            }
+            if (parent->clip())
+                clip &= parent->mapRectToScene(parent->boundingRect());
+        }
+        // It's collected with the ancestor
+        if (collected)
+            continue;
+
+        removeEntries(item);
+        collect(item, clip);
+        ++m_updatedSubtrees;
+    }
+}
+
+void WQuickHitTestIndex::markDirty(QQuickItem *item)
+{
+    if (m_dirty || !m_listenedItems.contains(item))
+        return;
+    // Nothing is indexed in the subtree, e.g. the cursor
+    if (!QQuickItemPrivate::get(item)->subtreeHoverEnabled)
+        return;
+    if (!m_dirtyItems.contains(item))
+        m_dirtyItems.append(item);
+}
+
+void WQuickHitTestIndex::listen(QQuickItem *item)
+{
+    if (!m_listenedItems.contains(item)) {
+        m_listenedItems.insert(item);
+        QQuickItemPrivate::get(item)->addItemChangeListener(this, ListenTypes);
+    }
+
+    const auto children = item->childItems();
+    for (auto child : children)
+        listen(child);
+}
+
+void WQuickHitTestIndex::unlisten(QQuickItem *item)
+{
+    if (m_listenedItems.remove(item))
+        QQuickItemPrivate::get(item)->removeItemChangeListener(this, ListenTypes);
+    removeEntry(item);
+    m_clipItems.remove(item);
+
+    const auto children = item->childItems();
+    for (auto child : children)
+        unlisten(child);
+}
+
+void WQuickHitTestIndex::collect(QQuickItem *item, const QRectF &clip)
+{
+    auto d = QQuickItemPrivate::get(item);
+    if (!item->isVisible())
+        return;
+
+    if (isHoverItem(item)) {
+        const QRectF rect = item->mapRectToScene(item->boundingRect()) & clip;
+        if (!rect.isEmpty())
+            addEntry(item, rect);
+    }
+
+    QRectF childrenClip = clip;
+    if (item->clip()) {
+        m_clipItems.insert(item);
+        childrenClip &= item->mapRectToScene(item->boundingRect());
+    }
+    if (childrenClip.isEmpty())
+        return;
+
+    const auto children = d->paintOrderChildItems();
+    for (auto child : children) {
+        if (QQuickItemPrivate::get(child)->subtreeHoverEnabled)
+            collect(child, childrenClip);
+    }
+}
+
+void WQuickHitTestIndex::addEntry(QQuickItem *item, const QRectF &rect)
+{
+    const int left = cellOf(rect.left());
+    const int top = cellOf(rect.top());
+    const int right = cellOf(rect.right());
+    const int bottom = cellOf(rect.bottom());
+    const bool large = qint64(right - left + 1) * (bottom - top + 1) > MaxCellsOfEntry;
+    m_entries.insert(item, {rect, large});
+
+    if (large) {
+        m_largeEntries.append(item);
+        return;
+    }
+
+    for (int y = top; y <= bottom; ++y) {
+        for (int x = left; x <= right; ++x)
+            m_cells[cellKey(x, y)].append(item);
+    }
+}
+
+void WQuickHitTestIndex::removeEntries(QQuickItem *item)
+{
+    if (m_entries.isEmpty() && m_clipItems.isEmpty())
+        return;
+    removeEntry(item);
+    m_clipItems.remove(item);
+
+    const auto children = item->childItems();
+    for (auto child : children)
+        removeEntries(child);
+}
+
+void WQuickHitTestIndex::removeEntry(QQuickItem *item)
+{
+    auto it = m_entries.find(item);
+    if (it == m_entries.end())
+        return;
+
+    if (it->large) {
+        m_largeEntries.removeOne(item);
+    } else {
+        const QRectF &rect = it->rect;
+        for (int y = cellOf(rect.top()); y <= cellOf(rect.bottom()); ++y) {
+            for (int x = cellOf(rect.left()); x <= cellOf(rect.right()); ++x) {
+                auto cell = m_cells.find(cellKey(x, y));
+                if (cell == m_cells.end())
+                    continue;
+                cell->removeOne(item);
+                if (cell->isEmpty())
+                    m_cells.erase(cell);
+            }
+        }
+    }
+
+    m_entries.erase(it);
+}
+
+bool WQuickHitTestIndex::testEntry(QQuickItem *item, const QPointF &scenePos) const
+{
+    if (!m_entries.value(item).rect.contains(scenePos))
+        return false;
+
+    // The hover state of an item is changed without the notification, so it
+    // needs to check again.
+    if (!item->isVisible() || !isHoverItem(item))
+        return false;
+
+    return item->contains(item->mapFromScene(scenePos));
+}
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,97 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QObject>
+#include <QPointer>
+#include <QRectF>
+#include <QHash>
+#include <QSet>
+#include <private/qquickitemchangelistener_p.h>
+
+QT_BEGIN_NAMESPACE
+class QQuickWindow;
+class QQuickItem;
+QT_END_NAMESPACE
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// A uniform grid over the hover enabled items of a QQuickWindow, in scene coordinates.
+// The geometry, transform, visibility and children of the items are tracked, only the
+// cells of the changed subtrees are updated before the next hit-testing. The subtrees
+// without any hover item (e.g. the cursor) are ignored. The changes of the clip and the
+// hover state aren't notified by QQuickItem, they're found in the dirty items of the
+// window, see updateDirtyItems.
+class WAYLIB_SERVER_EXPORT WQuickHitTestIndex : public QObject, public QQuickItemChangeListener
+{
+    Q_OBJECT
+
+public:
+    ~WQuickHitTestIndex();
+
+    static WQuickHitTestIndex *get(QQuickWindow *window);
+
+    // Returns the topmost item that would receive the hover event at the position, the
+    // exclusive is false if any other hover item is also under the position, they will
+    // receive the HoverMove event in QQuickDeliveryAgent.
+    QQuickItem *hoverItemAt(const QPointF &scenePos, bool *exclusive = nullptr);
+    void invalidate();
+    // Checks the dirty items of the window, it's called before synchronizing clears
+    // them, and before hit-testing for the items changed after the last frame.
+    void updateDirtyItems();
+
+    inline int itemCount() const {
+        return m_entries.size();
+    }
+    // The subtrees updated since the index is built, for testing
+    inline int updatedSubtreeCount() const {
+        return m_updatedSubtrees;
+    }
+
+private:
+    explicit WQuickHitTestIndex(QQuickWindow *window);
+
+    void itemGeometryChanged(QQuickItem *item, QQuickGeometryChange change, const QRectF &oldGeometry) override;
+    void itemVisibilityChanged(QQuickItem *item) override;
+    void itemRotationChanged(QQuickItem *item) override;
+    void itemTransformChanged(QQuickItem *item, QQuickItem *transformedItem) override;
+    void itemChildAdded(QQuickItem *item, QQuickItem *child) override;
+    void itemChildRemoved(QQuickItem *item, QQuickItem *child) override;
+    void itemDestroyed(QQuickItem *item) override;
+
+    void rebuild();
+    void update();
+    void markDirty(QQuickItem *item);
+    void listen(QQuickItem *item);
+    void unlisten(QQuickItem *item);
+    void collect(QQuickItem *item, const QRectF &clip);
+    void addEntry(QQuickItem *item, const QRectF &rect);
+    void removeEntries(QQuickItem *item);
+    void removeEntry(QQuickItem *item);
+    bool testEntry(QQuickItem *item, const QPointF &scenePos) const;
+
+    struct Entry {
+        QRectF rect;
+        // Covers too many cells, it's tested for every position
+        bool large = false;
+    };
+
+    QQuickWindow *m_window;
+    QHash<QQuickItem*, Entry> m_entries;
+    // The collected items clip their children
+    QSet<QQuickItem*> m_clipItems;
+    // The items aren't sorted, the stacking order is resolved for the items under the position
+    QHash<quint64, QList<QQuickItem*>> m_cells;
+    QList<QQuickItem*> m_largeEntries;
+    // All items of the window, to know the hover items added to them
+    QSet<QQuickItem*> m_listenedItems;
+    // The roots of the changed subtrees, they're collected again before the next hit-testing
+    QList<QPointer<QQuickItem>> m_dirtyItems;
+    int m_updatedSubtrees = 0;
+    bool m_dirty = true;
+};
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,158 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "wquickocclusionculler_p.h"
+#include "wsurfaceitem.h"
+#include "wsurface.h"
+#include "wtools.h"
+
+#include <qwcompositor.h>
+
+#include <QQuickWindow>
+#include <QQuickItem>
+#include <QtMath>
+#include <private/qquickitem_p.h>
+
+QW_USE_NAMESPACE
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// The pixels fully inside the rect
+static inline QRect innerRect(const QRectF &rect)
+{
+    return QRect(QPoint(qCeil(rect.left()), qCeil(rect.top())),
+                 QPoint(qFloor(rect.right()) - 1, qFloor(rect.bottom()) - 1));
+}
+
+WQuickOcclusionCuller::WQuickOcclusionCuller(QQuickWindow *window)
+    : QObject(window)
+{
+
+}
+
+WQuickOcclusionCuller *WQuickOcclusionCuller::get(QQuickWindow *window)
+{
+    auto culler = window->findChild<WQuickOcclusionCuller*>(QString(), Qt::FindDirectChildrenOnly);
+    if (!culler)
+        culler = new WQuickOcclusionCuller(window);
+    return culler;
+}
+
+void WQuickOcclusionCuller::update(const QList<std::pair<QQuickItem*, QRectF>> &roots)
+{
+    for (const auto &root : roots) {
+        m_opaqueRegion = QRegion();
+        collect(root.first, root.second, 1.0, true, true);
+    }
+    m_opaqueRegion = QRegion();
+
+    QList<QPointer<WSurfaceItemContent>> occluded;
+    for (WSurfaceItemContent *content : std::as_const(m_covered)) {
+        if (!m_uncovered.contains(content))
+            occluded.append(content);
+    }
+    m_covered.clear();
+    m_uncovered.clear();
+
+    for (const auto &content : std::as_const(m_occluded)) {
+        if (content && !occluded.contains(content))
+            content->setOccluded(false);
+    }
+    for (const auto &content : std::as_const(occluded))
+        content->setOccluded(true);
+
+    m_occluded = std::move(occluded);
+}
+
+void WQuickOcclusionCuller::clear()
+{
+    for (const auto &content : std::exchange(m_occluded, {})) {
+        if (content)
+            content->setOccluded(false);
+    }
+}
+
+// From the topmost to the bottommost, same as the paint order in reverse
+void WQuickOcclusionCuller::collect(QQuickItem *item, const QRectF &clip, qreal opacity,
+                                    bool canOcclude, bool cullable)
+{
+    auto d = QQuickItemPrivate::get(item);
+    if (!item->isVisible())
+        return;
+    opacity *= item->opacity();
+    if (qFuzzyIsNull(opacity))
+        return;
+
+    auto content = qobject_cast<WSurfaceItemContent*>(item);
+    if (d->extra.isAllocated()) {
+        // Hidden by the item layer, ShaderEffectSource, WQuickTextureProxy or the output
+        // layers, it's drawn by them, don't know where it is.
+        if (d->extra->hideRefCount > 0 && !(content && content->occluded()))
+            return;
+        // The contents are displayed by the other items too
+        if (d->extra->effectRefCount > 0)
+            cullable = false;
+    }
+
+    const QTransform transform = d->itemToWindowTransform();
+    QRectF itemClip = clip;
+    if (item->clip()) {
+        if (transform.type() <= QTransform::TxScale)
+            itemClip &= transform.mapRect(item->boundingRect());
+        else // The clip is not a rect in the scene
+            canOcclude = false;
+    }
+
+    const auto children = d->paintOrderChildItems();
+    int i = children.size() - 1;
+    for (; i >= 0 && children.at(i)->z() >= 0; --i)
+        collect(children.at(i), itemClip, opacity, canOcclude, cullable);
+
+    if (content) {
+        visit(content, transform, itemClip,
+              canOcclude && qFuzzyCompare(opacity, 1.0), cullable);
+    }
+
+    // The children with negative z are painted below their parent
+    for (; i >= 0; --i)
+        collect(children.at(i), itemClip, opacity, canOcclude, cullable);
+}
+
+void WQuickOcclusionCuller::visit(WSurfaceItemContent *content, const QTransform &transform,
+                                  const QRectF &clip, bool canOcclude, bool cullable)
+{
+    WSurface *surface = content->surface();
+    if (!surface || transform.type() > QTransform::TxScale) {
+        m_uncovered.insert(content);
+        return;
+    }
+
+    // Same as the target geometry in WSurfaceItemContent::updatePaintNode
+    const QRectF geometry(content->ignoreBufferOffset() ? QPointF() : QPointF(content->bufferOffset()),
+                          content->size());
+    const QRectF sceneRect = transform.mapRect(geometry) & clip;
+    const bool covered = sceneRect.isEmpty()
+                         || (QRegion(sceneRect.toAlignedRect()) - m_opaqueRegion).isEmpty();
+    if (covered && cullable && content->occlusionCulling()) {
+        m_covered.insert(content);
+        return;
+    }
+    m_uncovered.insert(content);
+
+    const QSizeF surfaceSize = surface->size();
+    if (covered || !canOcclude || surfaceSize.isEmpty())
+        return;
+
+    QTransform surfaceToScene = QTransform::fromScale(geometry.width() / surfaceSize.width(),
+                                                      geometry.height() / surfaceSize.height());
+    surfaceToScene *= QTransform::fromTranslate(geometry.x(), geometry.y());
+    surfaceToScene *= transform;
+
+    const QRegion opaque = WTools::fromPixmanRegion(&surface->handle()->handle()->opaque_region);
+    for (const QRect &r : opaque) {
+        const QRect rect = innerRect(surfaceToScene.mapRect(QRectF(r)) & clip);
+        if (!rect.isEmpty())
+            m_opaqueRegion += rect;
+    }
+}
+
+WAYLIB_SERVER_END_NAMESPACE
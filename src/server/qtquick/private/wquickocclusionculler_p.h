@@ -0,0 +1,58 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QObject>
+#include <QPointer>
+#include <QRegion>
+#include <QRectF>
+#include <QSet>
+
+QT_BEGIN_NAMESPACE
+class QQuickWindow;
+class QQuickItem;
+QT_END_NAMESPACE
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+class WSurfaceItemContent;
+// Finds the WSurfaceItemContent covered by the opaque regions of the surfaces above them,
+// in scene coordinates, and marks them occluded (see WSurfaceItemContent::occluded). An
+// item is occluded only if it's covered in all the source items of the outputs.
+class WAYLIB_SERVER_EXPORT WQuickOcclusionCuller : public QObject
+{
+    Q_OBJECT
+
+public:
+    static WQuickOcclusionCuller *get(QQuickWindow *window);
+
+    // Must be called after polishing the items, and before synchronizing the scene graph.
+    // Each root is given with the scene rect shown by its output, the items outside of
+    // all the rects are occluded too.
+    void update(const QList<std::pair<QQuickItem*, QRectF>> &roots);
+    void clear();
+
+    inline int occludedCount() const {
+        return m_occluded.size();
+    }
+
+private:
+    explicit WQuickOcclusionCuller(QQuickWindow *window);
+
+    void collect(QQuickItem *item, const QRectF &clip, qreal opacity,
+                 bool canOcclude, bool cullable);
+    void visit(WSurfaceItemContent *content, const QTransform &transform,
+               const QRectF &clip, bool canOcclude, bool cullable);
+
+    QList<QPointer<WSurfaceItemContent>> m_occluded;
+
+    // The opaque region above the current item, and the results of all roots
+    QRegion m_opaqueRegion;
+    QSet<WSurfaceItemContent*> m_covered;
+    QSet<WSurfaceItemContent*> m_uncovered;
+};
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -11,9 +11,11 @@
 #include "wrenderbuffernode_p.h"
 #include "wbufferrenderer_p.h"
 #include "wqmlhelper_p.h"
+#include "wresourcepool_p.h"
 
 #include <QQuickItem>
 #include <QRunnable>
+#include <QMutex>
 #include <QSGImageNode>
 #include <private/qquickitem_p.h>
 #include <private/qsgplaintexture_p.h>
@@ -25,252 +27,45 @@
 #include <private/qquickrendercontrol_p.h>
 
 #include <algorithm>
+#include <atomic>
 
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
-class Q_DECL_HIDDEN DataManagerBase : public QObject
-{
-public:
-    mutable QAtomicInt ref;
-
-    explicit DataManagerBase(QQuickWindow *owner)
-        : QObject(owner) {}
-};
-
-template <class T>
-class Q_DECL_HIDDEN DataManagerPointer
-{
-    static_assert(std::is_base_of<DataManagerBase, T>::value);
-public:
-    DataManagerPointer() noexcept = default;
-    constexpr DataManagerPointer(std::nullptr_t) noexcept : DataManagerPointer{} {}
-    inline DataManagerPointer(T *p) : pointer(p) {
-        if (pointer)
-            pointer->ref.ref();
-    }
-
-    DataManagerPointer(DataManagerPointer<T> &&other) noexcept
-        : pointer(std::exchange(other.pointer, nullptr)) {}
-
-    DataManagerPointer(const DataManagerPointer<T> &other) noexcept
-        : pointer(other.pointer) {
-        ref();
-    }
-
-    DataManagerPointer &operator=(const DataManagerPointer<T> &other) noexcept
-    {
-        deref();
-        pointer = other.pointer;
-        ref();
-        return *this;
-    }
-
-    DataManagerPointer &operator=(DataManagerPointer<T> &&other) noexcept
-    {
-        pointer = std::exchange(other.pointer, nullptr);
-        return *this;
-    }
-
-    ~DataManagerPointer() {
-        deref();
-    }
-
-    inline DataManagerPointer<T> &operator=(T* p) {
-        deref();
-        pointer = p;
-        ref();
-        return *this;
-    }
-
-    T* data() const noexcept
-    { return pointer; }
-    T* get() const noexcept
-    { return data(); }
-    T* operator->() const noexcept
-    { return data(); }
-    T& operator*() const noexcept
-    { return *data(); }
-    operator T*() const noexcept
-    { return data(); }
-
-    bool isNull() const noexcept
-    { return pointer.isNull(); }
-
-    bool operator==(T *other) const noexcept
-    { return pointer == other; }
-    bool operator!=(T *other) const noexcept
-    { return pointer != other; }
-
-private:
-    void deref() {
-        if (!pointer)
-            return;
-        pointer->ref.deref();
-        if (pointer->ref == 0) {
-            pointer->DataManagerBase::deleteLater();
-            pointer.clear();
-        }
-    }
-
-    void ref() {
-        if (pointer)
-            pointer->ref.ref();
-    }
-
-    QPointer<T> pointer;
-};
-
-template <class Derive, class DataType, typename... DataKeys>
-class Q_DECL_HIDDEN DataManager : public DataManagerBase
-{
-public:
-    struct Data {
-        int released = 0;
-        DataType *data = nullptr;
-    };
-
-    static DataManagerPointer<Derive> get(QQuickWindow *owner) {
-        return owner->findChild<Derive*>({}, Qt::FindDirectChildrenOnly);
-    }
-
-    static DataManagerPointer<Derive> resolve(const DataManagerPointer<Derive> &other, QQuickWindow *owner) {
-        static_assert(&Derive::metaObject);
-        Q_ASSERT(owner);
-        if (other && other->owner() == owner)
-            return other;
-        {
-            Derive *other = get(owner);
-            if (!other)
-                other = new Derive(owner);
-            return other;
-        }
-    }
-
-    inline QQuickWindow *owner() const {
-        return static_cast<QQuickWindow*>(parent());
-    }
-
-    std::weak_ptr<Data> resolve(std::weak_ptr<Data> data, DataKeys&&... keys) {
-        struct TryClean {
-            TryClean(DataManager *m)
-                : manager(m) {}
-            ~TryClean() {
-                manager->tryClean();
-            }
-            DataManager *manager;
-        };
-
-        TryClean cleanJob(this);
-        Q_UNUSED(cleanJob)
-
-        {
-            auto d = data.lock();
-            if (d && dataList.contains(d)) {
-                if (get()->check(d->data, std::forward<DataKeys>(keys)...)) {
-                    d->released = 0;
-                    return data;
-                }
-                release(data);
-            }
-        }
-
-        for (auto data : std::as_const(dataList)) {
-            if (get()->check(data->data, std::forward<DataKeys>(keys)...)) {
-                data->released = 0;
-                return data;
-            }
-        }
-
-        auto newData = std::shared_ptr<Data>(new Data());
-        if ((newData->data = get()->create(std::forward<DataKeys>(keys)...))) {
-            dataList.append(newData);
-            return newData;
-        }
-
-        return {};
-    }
-
-    inline void release(std::weak_ptr<Data> data) {
-        auto d = data.lock();
-        if (!d)
-            return;
-        d->released++;
-    }
-
-protected:
-    struct CleanJob : public QRunnable {
-        CleanJob(DataManager *manager)
-            : manager(manager) {}
-
-        void run() override {
-            if (!manager)
-                return;
-
-            manager->cleanJob = nullptr;
-
-            QList<std::shared_ptr<Data>> tmp;
-            std::swap(manager->dataList, tmp);
-            manager->dataList.reserve(tmp.size());
-
-            for (const auto &data : std::as_const(tmp)) {
-                if (data->released > 2) {
-                    manager->get()->destroy(data->data);
-                } else {
-                    manager->dataList << data;
-
-                    if (data->released > 0)
-                        ++data->released;
-                }
-            }
-        }
-
-        QPointer<DataManager> manager;
-    };
-
-    inline void tryClean() {
-        if (Q_LIKELY(!cleanJob)) {
-            cleanJob = new CleanJob(this);
-            owner()->scheduleRenderJob(cleanJob, QQuickWindow::AfterRenderingStage);
-        }
-    }
-
-    inline const Derive *get() const {
-        return static_cast<const Derive*>(this);
-    }
-
-    inline Derive *get() {
-        return static_cast<Derive*>(this);
-    }
-
-    DataManager(QQuickWindow *owner)
-        : DataManagerBase(owner) {
-        Q_ASSERT(owner->findChildren<Derive*>(Qt::FindDirectChildrenOnly).size() == 0);
-    }
-
-    using QObject::deleteLater;
-    ~DataManager() {
-        for (auto data : std::as_const(dataList)) {
-            Derive::destroy(data->data);
-        }
-    }
-
-    QList<std::shared_ptr<Data>> dataList;
-    QRunnable *cleanJob = nullptr;
-};
-
-class Q_DECL_HIDDEN RhiTextureManager : public DataManager<RhiTextureManager, QRhiTexture, QRhiTexture::Format, const QSize&>
+class Q_DECL_HIDDEN RhiTextureManager : public WResourcePool<RhiTextureManager, QRhiTexture, QRhiTexture::Format>
 {
     Q_OBJECT
 
     friend class DataManager;
+    friend class WResourcePool;
 
     RhiTextureManager(QQuickWindow *owner)
-        : DataManager<RhiTextureManager, QRhiTexture, QRhiTexture::Format, const QSize&>(owner) {
+        : WResourcePool<RhiTextureManager, QRhiTexture, QRhiTexture::Format>(owner) {
         Q_ASSERT(owner->findChildren<RhiTextureManager*>(Qt::FindDirectChildrenOnly).size() == 1);
     }
 
-    static bool check(QRhiTexture *texture, QRhiTexture::Format format, const QSize &size) {
-        return texture->format() == format && texture->pixelSize() == size;
+    static qint64 bytesOf(QRhiTexture::Format format, const QSize &size) {
+        int bytesPerPixel = 4;
+        switch (format) {
+        case QRhiTexture::R8:
+        case QRhiTexture::RED_OR_ALPHA8:
+            bytesPerPixel = 1;
+            break;
+        case QRhiTexture::RG8:
+        case QRhiTexture::R16:
+        case QRhiTexture::R16F:
+            bytesPerPixel = 2;
+            break;
+        case QRhiTexture::RGBA16F:
+            bytesPerPixel = 8;
+            break;
+        case QRhiTexture::RGBA32F:
+            bytesPerPixel = 16;
+            break;
+        default:
+            break;
+        }
+
+        return qint64(size.width()) * size.height() * bytesPerPixel;
     }
 
     QRhiTexture *create(QRhiTexture::Format format, const QSize &size) {
@@ -288,7 +83,7 @@ class Q_DECL_HIDDEN RhiTextureManager : public DataManager<RhiTextureManager, QR
     }
 };
 
-class Q_DECL_HIDDEN RhiManager : public DataManager<RhiManager, void>
+class Q_DECL_HIDDEN RhiManager : public DataManager<RhiManager>
 {
     Q_OBJECT
 public:
@@ -387,7 +182,7 @@ private:
     friend class DataManager;
 
     RhiManager(QQuickWindow *owner)
-        : DataManager<RhiManager, void>(owner) {
+        : DataManager<RhiManager>(owner) {
         Q_ASSERT(owner->findChildren<RhiManager*>(Qt::FindDirectChildrenOnly).size() == 1);
         auto rhi = QSGRhiSupport::instance()->createRhi(owner, owner);
         if (!rhi.rhi)
@@ -406,20 +201,6 @@ private:
         delete renderer;
     }
 
-    static bool check() {
-        Q_UNREACHABLE();
-        return true;
-    }
-
-    static void *create() {
-        Q_UNREACHABLE();
-        return nullptr;
-    }
-
-    static void destroy(void*) {
-        Q_UNREACHABLE();
-    }
-
     struct Rhi {
         QRhi *rhi;
         bool own;
@@ -615,7 +396,10 @@ public:
             pixelSize = size.toSize();
         }
 
-        texture = manager->resolve(texture, ct->format(), pixelSize);
+        // Reuse a slightly larger texture when resizing, only the rendering of the rotated
+        // source needs the exact size for the render target.
+        texture = manager->resolve(texture, ct->format(), pixelSize, !renderData);
+        texturePixelSize = pixelSize;
         if (Q_UNLIKELY(texture.expired())) {
             reset();
             return;
@@ -673,7 +457,7 @@ public:
 
             auto rub = rhi->nextResourceUpdateBatch();
             QRhiTextureCopyDescription desc;
-            desc.setPixelSize(texture->data->pixelSize());
+            desc.setPixelSize(texturePixelSize);
             desc.setSourceTopLeft(sourcePos.toPoint());
             rub->copyTexture(texture->data, ct, desc);
 
@@ -687,8 +471,8 @@ public:
             rhi->endOffscreenFrame();
         }
 
-        if (sgTexture()->rhiTexture() != texture->data)
-            sgTexture()->setTexture(texture->data);
+        if (sgTexture()->rhiTexture() != texture->data || sgTexture()->textureSize() != texturePixelSize)
+            sgTexture()->setTexture(texture->data, texturePixelSize);
         doNotifyTextureChanged();
 
         if (contentNode) {
@@ -785,6 +569,8 @@ private:
     DataManagerPointer<RhiManager> rhi;
     QMatrix4x4 renderMatrix;
     qreal devicePixelRatio;
+    // The used size of the texture, maybe smaller than the texture
+    QSize texturePixelSize;
 
     struct Node {
         Node() {
@@ -824,9 +610,14 @@ private:
     std::unique_ptr<RenderData> renderData;
 
     struct Texture : public QSGDynamicTexture {
-        void setTexture(QRhiTexture *texture) {
+        ~Texture() {
+            if (m_standalone && m_standalone->m_texture)
+                m_standalone->m_texture->deleteLater();
+        }
+
+        void setTexture(QRhiTexture *texture, const QSize &size = {}) {
             if (texture)
-                m_textureSize = texture->pixelSize();
+                m_textureSize = size.isValid() ? size : texture->pixelSize();
             m_texture = texture;
         }
 
@@ -834,6 +625,52 @@ private:
             return true;
         }
 
+        // Only the top-left part of the pooled texture is used, it's like a texture in an atlas
+        bool isAtlasTexture() const override {
+            return m_texture && m_texture->pixelSize() != m_textureSize;
+        }
+
+        QRectF normalizedTextureSubRect() const override {
+            if (!isAtlasTexture())
+                return QRectF(0, 0, 1, 1);
+            const QSize size = m_texture->pixelSize();
+            return QRectF(0, 0, m_textureSize.width() / qreal(size.width()),
+                          m_textureSize.height() / qreal(size.height()));
+        }
+
+        // For the materials can't use the sub-rect, e.g. ShaderEffect, copy the used part to
+        // a standalone texture, it's called in every frame the material is rendered.
+        QSGTexture *removedFromAtlas(QRhiResourceUpdateBatch *resourceUpdates) const override {
+            Q_ASSERT(isAtlasTexture());
+            if (!m_standalone)
+                m_standalone.reset(new Texture);
+
+            auto standalone = m_standalone.get();
+            if (!standalone->m_texture || standalone->m_texture->pixelSize() != m_textureSize
+                || standalone->m_texture->format() != m_texture->format()) {
+                if (standalone->m_texture)
+                    standalone->m_texture->deleteLater();
+                auto newTexture = m_texture->rhi()->newTexture(m_texture->format(), m_textureSize);
+                if (!newTexture->create()) {
+                    delete newTexture;
+                    newTexture = nullptr;
+                }
+                standalone->setTexture(newTexture);
+            }
+
+            if (standalone->m_texture && resourceUpdates) {
+                QRhiTextureCopyDescription desc;
+                desc.setPixelSize(m_textureSize);
+                resourceUpdates->copyTexture(standalone->m_texture, m_texture, desc);
+            }
+
+            standalone->setFiltering(filtering());
+            standalone->setMipmapFiltering(QSGTexture::None);
+            standalone->setHorizontalWrapMode(horizontalWrapMode());
+            standalone->setVerticalWrapMode(verticalWrapMode());
+            return standalone;
+        }
+
         qint64 comparisonKey() const override {
             if (m_texture)
                 return qint64(m_texture);
@@ -859,6 +696,7 @@ private:
 
         QRhiTexture *m_texture = nullptr;
         QSize m_textureSize;
+        mutable std::unique_ptr<Texture> m_standalone;
     };
 
     inline Texture *sgTexture() const {
@@ -877,19 +715,20 @@ WRenderBufferNode *WRenderBufferNode::createRhiNode(QQuickItem *item)
     return node;
 }
 
-class Q_DECL_HIDDEN QImageManager : public DataManager<QImageManager, QImage, QImage::Format, const QSize&>
+class Q_DECL_HIDDEN QImageManager : public WResourcePool<QImageManager, QImage, QImage::Format>
 {
     Q_OBJECT
 
     friend class DataManager;
+    friend class WResourcePool;
 
     QImageManager(QQuickWindow *owner)
-        : DataManager<QImageManager, QImage, QImage::Format, const QSize&>(owner) {
+        : WResourcePool<QImageManager, QImage, QImage::Format>(owner) {
         Q_ASSERT(owner->findChildren<QImageManager*>(Qt::FindDirectChildrenOnly).size() == 1);
     }
 
-    static bool check(QImage *image, QImage::Format format, const QSize &size) {
-        return image->format() == format && image->size() == size;
+    static qint64 bytesOf(QImage::Format format, const QSize &size) {
+        return qint64(size.width()) * size.height() * QImage::toPixelFormat(format).bitsPerPixel() / 8;
     }
 
     QImage *create(QImage::Format format, const QSize &size) {
@@ -903,6 +742,10 @@ class Q_DECL_HIDDEN QImageManager : public DataManager<QImageManager, QImage, QI
 
 class Q_DECL_HIDDEN SoftwareNode : public WRenderBufferNode {
 public:
+    static inline std::atomic_uint64_t softwareCopiedBytes = 0;
+    // The outputs maybe rendered in parallel, see WOutputRenderWindow::parallelRendering
+    static inline QMutex managerMutex;
+
     SoftwareNode(QQuickItem *item)
         : WRenderBufferNode(item, new QSGPlainTexture)
     {
@@ -925,7 +768,6 @@ public:
     }
 
     void render(const RenderState *state) override {
-        Q_UNUSED(state)
         auto window = renderWindow();
         if (!window)
             return;
@@ -938,14 +780,17 @@ public:
         // const auto sgRenderer = currentRenderer ? currentRenderer->currentRenderer() : nullptr;
         const auto matrix = /*(sgRenderer && sgRenderer->renderTarget().paintDevice == p->device())
             ? currentRenderer->currentWorldTransform() * (*this->matrix()) :*/ *this->matrix();
-        const auto oldManager = manager;
-        manager = QImageManager::resolve(manager, window);
-
-        if (oldManager != manager) {
-            texture()->setTexture(nullptr);
-            if (oldManager)
-                oldManager->release(image);
-            image.reset();
+        {
+            QMutexLocker locker(&managerMutex);
+            const auto oldManager = manager;
+            manager = QImageManager::resolve(manager, window);
+
+            if (oldManager != manager) {
+                texture()->setTexture(nullptr);
+                if (oldManager)
+                    oldManager->release(image);
+                image.reset();
+            }
         }
 
         const bool hasRotation = matrix.flags().testAnyFlags(QMatrix4x4::Rotation2D | QMatrix4x4::Rotation);
@@ -981,30 +826,69 @@ public:
             return;
         }
 
-        if (Q_UNLIKELY(sourceImage.isNull())) {
-            image = manager->resolve(image, QImage::Format_RGB30, pixelSize);
-        } else {
-            image = manager->resolve(image, sourceImage.format(), pixelSize);
+        {
+            QMutexLocker locker(&managerMutex);
+            if (Q_UNLIKELY(sourceImage.isNull())) {
+                image = manager->resolve(image, QImage::Format_RGB30, pixelSize);
+            } else {
+                image = manager->resolve(image, sourceImage.format(), pixelSize);
+            }
+        }
+
+        if (Q_UNLIKELY(this->image.expired())) {
+            reset();
+            return;
         }
 
         auto image = this->image.lock();
-        painter.begin(image->data);
-        painter.setRenderHint(QPainter::SmoothPixmapTransform);
-        painter.setCompositionMode(QPainter::CompositionMode_Source);
-        auto transform = matrix.toTransform().inverted();
-        QTransform resetPos;
-        resetPos.translate((dpr - 1) * transform.dx(),
-                           (dpr - 1) * transform.dy());
-        painter.setTransform(transform * resetPos);
-
-        // TODO: copy damage area from the previous frame
-        if (Q_UNLIKELY(sourceImage.isNull())) {
-            painter.drawPixmap(sourcePixmap.rect(), sourcePixmap, sourcePixmap.rect());
+        const auto renderer = window->currentRenderer();
+        const auto sgRenderer = renderer ? renderer->currentRenderer() : nullptr;
+        const QRect sourceRect = Q_UNLIKELY(sourceImage.isNull()) ? sourcePixmap.rect() : sourceImage.rect();
+        // Don't let the texture share the image, otherwise the painter will detach it
+        texture()->setImage(QImage());
+
+        // The software renderer only repaints its dirty region, and the clip region is the
+        // part of it that covers this node. If the image still holds the contents of the last
+        // frame of the same renderer, the pixels outside the clip region are not changed.
+        QRegion copyRegion;
+        if (sgRenderer && sgRenderer == lastCopy.renderer && matrix == lastCopy.matrix
+            && qFuzzyCompare(dpr, lastCopy.devicePixelRatio)
+            && image->data->cacheKey() == lastCopy.imageKey && state->clipRegion()) {
+            for (const QRect &r : *state->clipRegion())
+                copyRegion += QRectF(QPointF(r.topLeft()) * dpr, QSizeF(r.size()) * dpr).toAlignedRect();
+            copyRegion &= sourceRect;
         } else {
-            painter.drawImage(sourceImage.rect(), sourceImage, sourceImage.rect());
+            copyRegion = sourceRect;
+        }
+
+        if (!copyRegion.isEmpty()) {
+            painter.begin(image->data);
+            painter.setRenderHint(QPainter::SmoothPixmapTransform);
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            auto transform = matrix.toTransform().inverted();
+            QTransform resetPos;
+            resetPos.translate((dpr - 1) * transform.dx(),
+                               (dpr - 1) * transform.dy());
+            painter.setTransform(transform * resetPos);
+
+            qint64 pixels = 0;
+            for (const QRect &r : std::as_const(copyRegion)) {
+                if (Q_UNLIKELY(sourceImage.isNull())) {
+                    painter.drawPixmap(r, sourcePixmap, r);
+                } else {
+                    painter.drawImage(r, sourceImage, r);
+                }
+                pixels += qint64(r.width()) * r.height();
+            }
+
+            painter.end();
+            softwareCopiedBytes.fetch_add(pixels * image->data->depth() / 8, std::memory_order_relaxed);
         }
 
-        painter.end();
+        lastCopy.renderer = sgRenderer;
+        lastCopy.matrix = matrix;
+        lastCopy.devicePixelRatio = dpr;
+        lastCopy.imageKey = image->data->cacheKey();
 
         texture()->setImage(*image->data);
         // Ensuse always render on software renderer
@@ -1021,13 +905,17 @@ private:
         if (!texture()->image().isNull() && notifyTexture)
             doNotifyTextureChanged();
         texture()->setTexture(nullptr);
-        if (manager)
+        if (manager) {
+            QMutexLocker locker(&managerMutex);
             manager->release(image);
+        }
         image.reset();
+        lastCopy.renderer = nullptr;
     }
 
     void destroy() {
         reset(false);
+        QMutexLocker locker(&managerMutex);
         manager = nullptr;
     }
 
@@ -1035,6 +923,14 @@ private:
     DataManagerPointer<QImageManager> manager;
     std::weak_ptr<QImageManager::Data> image;
     QPainter painter;
+
+    // The states of the last copy, the image is outdated if any of them is changed
+    struct {
+        const QSGRenderer *renderer = nullptr;
+        QMatrix4x4 matrix;
+        qreal devicePixelRatio = 0;
+        qint64 imageKey = 0;
+    } lastCopy;
 };
 
 WRenderBufferNode *WRenderBufferNode::createSoftwareNode(QQuickItem *item)
@@ -1043,6 +939,21 @@ WRenderBufferNode *WRenderBufferNode::createSoftwareNode(QQuickItem *item)
     return node;
 }
 
+WResourcePoolStats WRenderBufferNode::resourcePoolStats(QQuickWindow *window)
+{
+    WResourcePoolStats stats;
+    if (auto manager = RhiTextureManager::get(window))
+        stats += manager->stats();
+    if (auto manager = QImageManager::get(window))
+        stats += manager->stats();
+    return stats;
+}
+
+quint64 WRenderBufferNode::softwareCopiedBytes()
+{
+    return SoftwareNode::softwareCopiedBytes.load(std::memory_order_relaxed);
+}
+
 QRectF WRenderBufferNode::rect() const
 {
     return QRectF(0, 0, m_item->width(), m_item->height());
@@ -1083,6 +994,8 @@ WOutputRenderWindow *WRenderBufferNode::renderWindow() const
     return rw;
 }
 
+// The ratio of the output being rendered, so the texture is sized for that output. Out of
+// the outputs, e.g. in a QQuickItemLayer, it's the highest ratio of the window.
 qreal WRenderBufferNode::effectiveDevicePixelRatio() const
 {
     auto window = renderWindow();
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <wglobal.h>
+#include "wresourcepool_p.h"
 #include <QSGRenderNode>
 #include <QPointer>
 #include <QImage>
@@ -11,6 +12,7 @@
 
 QT_BEGIN_NAMESPACE
 class QQuickItem;
+class QQuickWindow;
 class QSGTexture;
 QT_END_NAMESPACE
 
@@ -26,6 +28,10 @@ public:
 
     static WRenderBufferNode *createRhiNode(QQuickItem *item);
     static WRenderBufferNode *createSoftwareNode(QQuickItem *item);
+    // The total bytes copied from the render target by the software nodes
+    static quint64 softwareCopiedBytes();
+    // The resources of the nodes are shared in the pools of the window
+    static WResourcePoolStats resourcePoolStats(QQuickWindow *window);
 
     QRectF rect() const override;
     RenderingFlags flags() const override;
@@ -0,0 +1,402 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QObject>
+#include <QPointer>
+#include <QQuickWindow>
+#include <QRunnable>
+#include <QHash>
+#include <QSize>
+
+#include <memory>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+class Q_DECL_HIDDEN DataManagerBase : public QObject
+{
+public:
+    mutable QAtomicInt ref;
+
+    explicit DataManagerBase(QQuickWindow *owner)
+        : QObject(owner) {}
+};
+
+template <class T>
+class Q_DECL_HIDDEN DataManagerPointer
+{
+    static_assert(std::is_base_of<DataManagerBase, T>::value);
+public:
+    DataManagerPointer() noexcept = default;
+    constexpr DataManagerPointer(std::nullptr_t) noexcept : DataManagerPointer{} {}
+    inline DataManagerPointer(T *p) : pointer(p) {
+        if (pointer)
+            pointer->ref.ref();
+    }
+
+    DataManagerPointer(DataManagerPointer<T> &&other) noexcept
+        : pointer(std::exchange(other.pointer, nullptr)) {}
+
+    DataManagerPointer(const DataManagerPointer<T> &other) noexcept
+        : pointer(other.pointer) {
+        ref();
+    }
+
+    DataManagerPointer &operator=(const DataManagerPointer<T> &other) noexcept
+    {
+        deref();
+        pointer = other.pointer;
+        ref();
+        return *this;
+    }
+
+    DataManagerPointer &operator=(DataManagerPointer<T> &&other) noexcept
+    {
+        pointer = std::exchange(other.pointer, nullptr);
+        return *this;
+    }
+
+    ~DataManagerPointer() {
+        deref();
+    }
+
+    inline DataManagerPointer<T> &operator=(T* p) {
+        deref();
+        pointer = p;
+        ref();
+        return *this;
+    }
+
+    T* data() const noexcept
+    { return pointer; }
+    T* get() const noexcept
+    { return data(); }
+    T* operator->() const noexcept
+    { return data(); }
+    T& operator*() const noexcept
+    { return *data(); }
+    operator T*() const noexcept
+    { return data(); }
+
+    bool isNull() const noexcept
+    { return pointer.isNull(); }
+
+    bool operator==(T *other) const noexcept
+    { return pointer == other; }
+    bool operator!=(T *other) const noexcept
+    { return pointer != other; }
+
+private:
+    void deref() {
+        if (!pointer)
+            return;
+        pointer->ref.deref();
+        if (pointer->ref == 0) {
+            pointer->DataManagerBase::deleteLater();
+            pointer.clear();
+        }
+    }
+
+    void ref() {
+        if (pointer)
+            pointer->ref.ref();
+    }
+
+    QPointer<T> pointer;
+};
+
+// Only one instance of Derive for a QQuickWindow, it's destroyed after all
+// DataManagerPointer of it are released.
+template <class Derive>
+class Q_DECL_HIDDEN DataManager : public DataManagerBase
+{
+public:
+    static DataManagerPointer<Derive> get(QQuickWindow *owner) {
+        return owner->findChild<Derive*>({}, Qt::FindDirectChildrenOnly);
+    }
+
+    static DataManagerPointer<Derive> resolve(const DataManagerPointer<Derive> &other, QQuickWindow *owner) {
+        static_assert(&Derive::metaObject);
+        Q_ASSERT(owner);
+        if (other && other->owner() == owner)
+            return other;
+        {
+            Derive *other = get(owner);
+            if (!other)
+                other = new Derive(owner);
+            return other;
+        }
+    }
+
+    inline QQuickWindow *owner() const {
+        return static_cast<QQuickWindow*>(parent());
+    }
+
+protected:
+    DataManager(QQuickWindow *owner)
+        : DataManagerBase(owner) {
+        Q_ASSERT(owner->findChildren<Derive*>(Qt::FindDirectChildrenOnly).size() == 0);
+    }
+
+    using QObject::deleteLater;
+};
+
+struct WResourcePoolStats
+{
+    quint64 hits = 0;
+    quint64 misses = 0;
+    quint64 evictions = 0;
+    // The bytes of all resources, and the part of them not used by anyone
+    qint64 bytes = 0;
+    qint64 idleBytes = 0;
+
+    inline WResourcePoolStats &operator+=(const WResourcePoolStats &other) {
+        hits += other.hits;
+        misses += other.misses;
+        evictions += other.evictions;
+        bytes += other.bytes;
+        idleBytes += other.idleBytes;
+        return *this;
+    }
+};
+
+// A pool of the sized resources (textures, images...) shared by the users in a QQuickWindow.
+// The resources are bucketed by the format and the size rounded up to SizeGranularity, so
+// resolving doesn't need to walk all resources. A resource is only used by one user at the
+// same time. The idle resources are destroyed after maxIdleFrames, and in LRU order once the
+// total bytes exceed the budget.
+//
+// Derive needs to provide:
+//   DataType *create(Format format, const QSize &size);
+//   static void destroy(DataType *data);
+//   static qint64 bytesOf(Format format, const QSize &size);
+template <class Derive, class DataType, typename Format>
+class Q_DECL_HIDDEN WResourcePool : public DataManager<Derive>
+{
+public:
+    static constexpr int SizeGranularity = 64;
+    using DataManager<Derive>::resolve;
+
+    struct Data {
+        DataType *data = nullptr;
+        Format format;
+        // The allocated size, maybe larger than the requested size, see resolve
+        QSize size;
+        qint64 bytes = 0;
+        const WResourcePool *pool = nullptr;
+        bool inUse = false;
+        int idleFrames = 0;
+        quint64 lastUsed = 0;
+    };
+
+    // Returns data if it's still fit, otherwise releases it and returns an idle resource or
+    // a new one. If allowLarger is true, the returned resource maybe larger than the size
+    // (less than SizeGranularity pixels), the user must only use the sub-rect of it.
+    std::weak_ptr<Data> resolve(std::weak_ptr<Data> data, Format format, const QSize &size,
+                                bool allowLarger = false) {
+        if (Q_UNLIKELY(size.isEmpty())) {
+            release(data);
+            return {};
+        }
+        tryClean();
+
+        if (auto d = data.lock(); d && d->pool == this) {
+            if (fits(*d, format, size, allowLarger))
+                return data;
+            release(data);
+        }
+
+        auto &bucket = buckets[bucketKey(format, size)];
+        for (const auto &d : std::as_const(bucket)) {
+            if (!d->inUse && fits(*d, format, size, allowLarger)) {
+                ++m_stats.hits;
+                m_stats.idleBytes -= d->bytes;
+                use(d.get());
+                return d;
+            }
+        }
+
+        ++m_stats.misses;
+        const QSize allocSize = allowLarger ? roundUp(size) : size;
+        auto newData = std::make_shared<Data>();
+        newData->data = self()->create(format, allocSize);
+        if (!newData->data)
+            return {};
+
+        newData->format = format;
+        newData->size = allocSize;
+        newData->bytes = Derive::bytesOf(format, allocSize);
+        newData->pool = this;
+        bucket.append(newData);
+        m_stats.bytes += newData->bytes;
+        use(newData.get());
+        evict();
+
+        return newData;
+    }
+
+    inline void release(std::weak_ptr<Data> data) {
+        auto d = data.lock();
+        if (!d || d->pool != this || !d->inUse)
+            return;
+
+        d->inUse = false;
+        d->idleFrames = 0;
+        d->lastUsed = ++m_serial;
+        m_stats.idleBytes += d->bytes;
+        evict();
+        tryClean();
+    }
+
+    inline const WResourcePoolStats &stats() const {
+        return m_stats;
+    }
+
+    inline qint64 budget() const {
+        return m_budget;
+    }
+    void setBudget(qint64 bytes) {
+        m_budget = bytes;
+        evict();
+    }
+
+    inline int maxIdleFrames() const {
+        return m_maxIdleFrames;
+    }
+    inline void setMaxIdleFrames(int frames) {
+        m_maxIdleFrames = frames;
+    }
+
+    static qint64 defaultBudget() {
+        // In MiB
+        static qint64 budget = qEnvironmentVariableIsSet("WAYLIB_RESOURCE_POOL_BUDGET")
+                                   ? qEnvironmentVariableIntValue("WAYLIB_RESOURCE_POOL_BUDGET")
+                                   : 256;
+        return budget * 1024 * 1024;
+    }
+
+protected:
+    struct CleanJob : public QRunnable {
+        CleanJob(WResourcePool *pool)
+            : pool(pool) {}
+
+        void run() override {
+            if (!pool)
+                return;
+
+            pool->cleanJob = nullptr;
+            pool->cleanIdleData();
+        }
+
+        QPointer<WResourcePool> pool;
+    };
+
+    inline void tryClean() {
+        if (Q_LIKELY(!cleanJob)) {
+            cleanJob = new CleanJob(this);
+            this->owner()->scheduleRenderJob(cleanJob, QQuickWindow::AfterRenderingStage);
+        }
+    }
+
+    inline Derive *self() {
+        return static_cast<Derive*>(this);
+    }
+
+    WResourcePool(QQuickWindow *owner)
+        : DataManager<Derive>(owner) {}
+
+    ~WResourcePool() {
+        for (const auto &bucket : std::as_const(buckets)) {
+            for (const auto &d : bucket) {
+                d->pool = nullptr;
+                Derive::destroy(d->data);
+            }
+        }
+    }
+
+private:
+    static inline QSize roundUp(const QSize &size) {
+        return QSize((size.width() + SizeGranularity - 1) / SizeGranularity * SizeGranularity,
+                     (size.height() + SizeGranularity - 1) / SizeGranularity * SizeGranularity);
+    }
+
+    static inline quint64 bucketKey(Format format, const QSize &size) {
+        const QSize rounded = roundUp(size) / SizeGranularity;
+        return (quint64(format) << 48) | (quint64(rounded.width() & 0xffffff) << 24)
+               | quint64(rounded.height() & 0xffffff);
+    }
+
+    static inline bool fits(const Data &d, Format format, const QSize &size, bool allowLarger) {
+        if (d.format != format)
+            return false;
+        if (!allowLarger)
+            return d.size == size;
+        return d.size.width() >= size.width() && d.size.height() >= size.height()
+               && roundUp(d.size) == roundUp(size);
+    }
+
+    inline void use(Data *d) {
+        d->inUse = true;
+        d->idleFrames = 0;
+        d->lastUsed = ++m_serial;
+    }
+
+    void destroyData(quint64 key, const std::shared_ptr<Data> &d) {
+        m_stats.bytes -= d->bytes;
+        if (!d->inUse)
+            m_stats.idleBytes -= d->bytes;
+        d->pool = nullptr;
+        Derive::destroy(d->data);
+        d->data = nullptr;
+
+        auto it = buckets.find(key);
+        Q_ASSERT(it != buckets.end());
+        it->removeOne(d);
+        if (it->isEmpty())
+            buckets.erase(it);
+    }
+
+    void evict() {
+        while (m_stats.bytes > m_budget && m_stats.idleBytes > 0) {
+            quint64 lruKey = 0;
+            std::shared_ptr<Data> lru;
+            for (auto it = buckets.cbegin(); it != buckets.cend(); ++it) {
+                for (const auto &d : it.value()) {
+                    if (!d->inUse && (!lru || d->lastUsed < lru->lastUsed)) {
+                        lru = d;
+                        lruKey = it.key();
+                    }
+                }
+            }
+
+            Q_ASSERT(lru);
+            destroyData(lruKey, lru);
+            ++m_stats.evictions;
+        }
+    }
+
+    void cleanIdleData() {
+        QList<std::pair<quint64, std::shared_ptr<Data>>> list;
+        for (auto it = buckets.cbegin(); it != buckets.cend(); ++it) {
+            for (const auto &d : it.value()) {
+                if (!d->inUse && ++d->idleFrames > m_maxIdleFrames)
+                    list.append({it.key(), d});
+            }
+        }
+
+        for (const auto &i : std::as_const(list))
+            destroyData(i.first, i.second);
+    }
+
+    QHash<quint64, QList<std::shared_ptr<Data>>> buckets;
+    QRunnable *cleanJob = nullptr;
+    WResourcePoolStats m_stats;
+    qint64 m_budget = defaultBudget();
+    int m_maxIdleFrames = 60;
+    quint64 m_serial = 0;
+};
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,228 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#define protected public
+#define private public
+#include <private/qsgrenderer_p.h>
+#include <private/qsgsoftwarerenderer_p.h>
+#include <private/qsgsoftwarerenderablenode_p.h>
+#include <private/qsgsoftwarecontext_p.h>
+#undef protected
+#undef private
+
+#include "wsoftwaretilerenderer_p.h"
+#include "wqmlhelper_p.h"
+
+#include <QPainter>
+#include <QPaintEngine>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QMutex>
+
+#include <atomic>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// In the device pixels, the tiles are the full rows of the damaged region to keep
+// the scanlines of a tile continuous in the memory
+static constexpr int TileHeight = 64;
+
+// Separate from the thread pool of the parallel rendering, the outputs rendered in
+// parallel wait for their tiles in it
+Q_GLOBAL_STATIC(QThreadPool, tileThreadPool)
+
+// The glyph caches of the font engines are shared and not thread safe, and the
+// nodes not known to be reentrant are painted one by one too
+Q_GLOBAL_STATIC(QMutex, nodeMutex)
+
+// The nodes update their cached pixmaps lazily in painting, e.g. the mirrored pixmap
+// of the image nodes, they're reentrant after the caches are updated
+static inline bool needsWarmup(QSGSoftwareRenderableNode::NodeType type)
+{
+    switch (type) {
+    case QSGSoftwareRenderableNode::Image:
+    case QSGSoftwareRenderableNode::Rectangle:
+    case QSGSoftwareRenderableNode::NinePatch:
+    case QSGSoftwareRenderableNode::SimpleImage:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// The nodes only read their states and textures in painting
+static inline bool isReentrant(QSGSoftwareRenderableNode::NodeType type)
+{
+    switch (type) {
+    case QSGSoftwareRenderableNode::SimpleRect:
+    case QSGSoftwareRenderableNode::SimpleTexture:
+    case QSGSoftwareRenderableNode::SimpleRectangle:
+        return true;
+    default:
+        return needsWarmup(type);
+    }
+}
+
+static void paintNodes(QSGSoftwareRenderer *renderer, QPaintDevice *device)
+{
+    QPainter painter(device);
+    painter.setRenderHint(QPainter::Antialiasing);
+    auto rc = static_cast<QSGSoftwareRenderContext*>(renderer->context());
+    QPainter *prevPainter = std::exchange(rc->m_activePainter, &painter);
+
+    renderer->m_flushRegion = renderer->renderNodes(&painter);
+    rc->m_activePainter = prevPainter;
+}
+
+// Same as QSGSoftwareRenderableNode::renderNode, but the node is not changed, so it
+// can be painted again for the other tiles
+static void paintNode(const QSGSoftwareRenderableNode *node, QPainter *painter, bool forceOpaque)
+{
+    QSGSoftwareRenderableNode copy(*node);
+    if (!isReentrant(node->type())) {
+        QMutexLocker locker(nodeMutex());
+        copy.renderNode(painter, forceOpaque);
+    } else {
+        copy.renderNode(painter, forceOpaque);
+    }
+}
+
+void WSoftwareTileRenderer::renderScene(QSGRenderer *r, int threads, bool concurrent)
+{
+    auto renderer = static_cast<QSGSoftwareRenderer*>(r);
+    if (!renderer->rootNode())
+        return;
+
+    // See QSGRenderer::renderScene and QSGSoftwareRenderer::render
+    renderer->m_is_rendering = true;
+    renderer->preprocess();
+
+    auto rt = static_cast<WImageRenderTarget*>(renderer->m_rt.paintDevice);
+    Q_ASSERT(rt);
+    const QImage &image = *rt;
+    const qreal dpr = image.devicePixelRatio();
+    renderer->setBackgroundColor(renderer->clearColor());
+    renderer->setBackgroundRect(QRect(0, 0, image.width() / dpr, image.height() / dpr), dpr);
+    renderer->buildRenderList();
+    renderer->optimizeRenderList();
+
+    const auto &nodes = renderer->m_renderableNodes;
+    // The bounding rects of the dirty regions, empty if the node will not be painted
+    QList<QRect> nodeRects(nodes.size());
+    QRegion flushRegion;
+    bool hasRenderNode = false;
+    for (int i = 0; i < nodes.size(); ++i) {
+        auto node = nodes.at(i);
+        if (node->type() == QSGSoftwareRenderableNode::RenderNode) {
+            hasRenderNode = true;
+            break;
+        }
+
+        if (!node->m_isDirty || qFuzzyIsNull(node->m_opacity) || node->m_dirtyRegion.isEmpty())
+            continue;
+        nodeRects[i] = node->m_dirtyRegion.boundingRect();
+        flushRegion += node->m_dirtyRegion;
+    }
+
+    QList<QRegion> tiles;
+    if (!hasRenderNode) {
+        // The pixels partially covered by the dirty region are painted too
+        QRegion deviceRegion;
+        for (const QRect &r : std::as_const(flushRegion))
+            deviceRegion += QRectF(QPointF(r.topLeft()) * dpr, QSizeF(r.size()) * dpr).toAlignedRect();
+        deviceRegion &= image.rect();
+
+        const QRect bounds = deviceRegion.boundingRect();
+        for (int y = bounds.top(); y <= bounds.bottom(); y += TileHeight) {
+            const QRegion tile = deviceRegion & QRect(bounds.left(), y, bounds.width(), TileHeight);
+            if (!tile.isEmpty())
+                tiles.append(tile);
+        }
+    }
+
+    // The QSGRenderNode is painted by the painter of the render context
+    if (hasRenderNode || tiles.isEmpty() || (tiles.size() < 2 && !concurrent)) {
+        if (concurrent) {
+            // The glyph and the other not reentrant nodes can't be locked one by one in QSGSoftwareRenderer
+            QMutexLocker locker(nodeMutex());
+            paintNodes(renderer, rt);
+        } else {
+            paintNodes(renderer, rt);
+        }
+        renderer->m_is_rendering = false;
+        renderer->m_changed_emitted = false;
+        return;
+    }
+
+    // Don't detach the image, paint to the memory of the buffer
+    uchar *bits = const_cast<uchar*>(image.constBits());
+    auto paintTile = [&] (int index) {
+        const QRegion &tile = tiles.at(index);
+        const QRect tileRect = tile.boundingRect();
+        const QRect logicalRect = QRectF(QPointF(tileRect.topLeft()) / dpr,
+                                         QSizeF(tileRect.size()) / dpr).toAlignedRect();
+
+        QImage target(bits, image.width(), image.height(), image.bytesPerLine(), image.format());
+        target.setDevicePixelRatio(dpr);
+        // The clip of the nodes is replaced by them, only the system clip is kept
+        target.paintEngine()->setSystemClip(tile);
+
+        QPainter painter(&target);
+        painter.setRenderHint(QPainter::Antialiasing);
+        for (int i = 0; i < nodes.size(); ++i) {
+            if (nodeRects.at(i).intersects(logicalRect))
+                paintNode(nodes.at(i), &painter, i == 0);
+        }
+    };
+
+    // The lazily updated pixmaps of the nodes are updated in painting, let them
+    // be updated in the current thread before painting the tiles. The nodes are
+    // shared by the outputs rendered concurrently.
+    {
+        QImage warmup(1, 1, image.format());
+        warmup.setDevicePixelRatio(dpr);
+        QPainter painter(&warmup);
+        QMutexLocker locker(concurrent ? nodeMutex() : nullptr);
+        for (int i = 0; i < nodes.size(); ++i) {
+            if (!nodeRects.at(i).isEmpty() && needsWarmup(nodes.at(i)->type()))
+                paintNode(nodes.at(i), &painter, false);
+        }
+    }
+
+    // The tiles are taken by the threads in order, the current thread paints too
+    std::atomic_int nextTile = 0;
+    auto paintTiles = [&] {
+        for (int i = nextTile++; i < tiles.size(); i = nextTile++)
+            paintTile(i);
+    };
+
+    const int workers = qMin(threads, int(tiles.size())) - 1;
+    auto pool = tileThreadPool();
+    if (pool->maxThreadCount() < workers)
+        pool->setMaxThreadCount(workers);
+
+    QSemaphore finished;
+    for (int i = 0; i < workers; ++i) {
+        pool->start([&paintTiles, &finished] {
+            paintTiles();
+            finished.release();
+        });
+    }
+    paintTiles();
+    finished.acquire(workers);
+
+    // Same as the changes of QSGSoftwareRenderableNode::renderNode
+    for (int i = 0; i < nodes.size(); ++i) {
+        auto node = nodes.at(i);
+        if (!nodeRects.at(i).isEmpty())
+            node->m_previousDirtyRegion = QRegion(node->m_boundingRectMax);
+        node->m_isDirty = false;
+        node->m_dirtyRegion = QRegion();
+    }
+
+    renderer->m_flushRegion = flushRegion;
+    renderer->m_is_rendering = false;
+    renderer->m_changed_emitted = false;
+}
+
+WAYLIB_SERVER_END_NAMESPACE
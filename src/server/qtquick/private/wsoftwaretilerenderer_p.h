@@ -0,0 +1,26 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+QT_BEGIN_NAMESPACE
+class QSGRenderer;
+QT_END_NAMESPACE
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// Same as QSGRenderer::renderScene for the QSGSoftwareRenderer, but the dirty region
+// is split into the tiles, and they're painted by multiple threads directly into the
+// QImage of the render target. Every tile paints all dirty nodes clipped to itself.
+class Q_DECL_HIDDEN WSoftwareTileRenderer
+{
+public:
+    // Must be a QSGSoftwareRenderer rendering to a WImageRenderTarget. The concurrent
+    // is true if the other renderers maybe painting in the other threads at the same
+    // time, the glyph nodes are painted with a lock even if there is only one tile.
+    static void renderScene(QSGRenderer *renderer, int threads, bool concurrent = false);
+};
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,456 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "wframestats.h"
+#include "woutputviewport.h"
+#include "woutput.h"
+#include "wbufferrenderer_p.h"
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QMetaEnum>
+#include <QMutex>
+#include <QPointer>
+#include <QtMath>
+#include <private/qobject_p.h>
+
+#include <algorithm>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+Q_LOGGING_CATEGORY(wlcFrameStats, "waylib.server.framestats", QtInfoMsg)
+
+static constexpr int PhaseCount = WFrameStats::Frame + 1;
+
+static inline int percentileIndex(qreal percent, int size)
+{
+    return qBound(0, qCeil(percent / 100 * size) - 1, size - 1);
+}
+
+class Q_DECL_HIDDEN WFrameStatsPrivate : public QObjectPrivate
+{
+public:
+    WFrameStatsPrivate()
+        : enabled(dumpToLog())
+    {
+
+    }
+
+    // Dump the summary to log every historySize frames, and enable the stats by default
+    static bool dumpToLog() {
+        static bool on = qEnvironmentVariableIsSet("WAYLIB_FRAME_STATS");
+        return on;
+    }
+
+    // A ring buffer of the recent samples, in nanoseconds
+    struct Samples {
+        QList<qint64> values;
+        int next = 0;
+        // The sorted copy of values for the percentiles, updated after adding samples
+        mutable QList<qint64> sorted;
+        mutable bool sortedIsDirty = false;
+
+        inline void add(qint64 value, int maxSize) {
+            if (values.size() < maxSize) {
+                values.append(value);
+                next = values.size() % maxSize;
+            } else {
+                values[next] = value;
+                next = (next + 1) % maxSize;
+            }
+            sortedIsDirty = true;
+        }
+
+        inline qint64 last() const {
+            if (values.isEmpty())
+                return 0;
+            return values.at((next + values.size() - 1) % values.size());
+        }
+
+        qint64 percentile(qreal percent) const {
+            if (values.isEmpty())
+                return 0;
+
+            if (sortedIsDirty) {
+                sorted = values;
+                std::sort(sorted.begin(), sorted.end());
+                sortedIsDirty = false;
+            }
+            return sorted.at(percentileIndex(percent, sorted.size()));
+        }
+    };
+
+    struct Stats {
+        Samples samples[PhaseCount];
+        qint64 current[PhaseCount] = {};
+        quint64 frameCount = 0;
+        quint64 missedFrames = 0;
+        qint64 refreshPeriod = 0;
+        bool inFrame = false;
+
+        inline void begin() {
+            std::fill(std::begin(current), std::end(current), 0);
+            inFrame = true;
+        }
+
+        inline qint64 outputTime() const {
+            return current[WFrameStats::Render] + current[WFrameStats::Composite]
+                   + current[WFrameStats::Commit];
+        }
+    };
+
+    struct RendererStats {
+        QPointer<WBufferRenderer> renderer;
+        Samples samples;
+        quint64 frameCount = 0;
+    };
+
+    inline const Stats *stats(const WOutputViewport *output) const {
+        if (!output)
+            return &global;
+        auto it = outputs.constFind(output);
+        return it == outputs.constEnd() ? nullptr : &it.value();
+    }
+
+    void clear();
+    void takeRendererTimes();
+    QString summary(const Stats &stats) const;
+
+    W_DECLARE_PUBLIC(WFrameStats)
+
+    bool enabled;
+    bool inFrame = false;
+    int historySize = 300;
+    QElapsedTimer frameTimer;
+    Stats global;
+    QHash<const WOutputViewport*, Stats> outputs;
+
+    // The renderers maybe rendered in the render threads, their times are
+    // moved to the renderers in endFrame.
+    QMutex rendererMutex;
+    bool recordRenderers = enabled;
+    QList<std::pair<const WBufferRenderer*, qint64>> pendingRendererTimes;
+    QHash<const WBufferRenderer*, RendererStats> renderers;
+};
+
+void WFrameStatsPrivate::clear()
+{
+    global = {};
+    for (auto &i : outputs) {
+        const auto refreshPeriod = i.refreshPeriod;
+        i = {};
+        i.refreshPeriod = refreshPeriod;
+    }
+
+    QMutexLocker locker(&rendererMutex);
+    pendingRendererTimes.clear();
+    renderers.clear();
+}
+
+void WFrameStatsPrivate::takeRendererTimes()
+{
+    QList<std::pair<const WBufferRenderer*, qint64>> times;
+    {
+        QMutexLocker locker(&rendererMutex);
+        times.swap(pendingRendererTimes);
+    }
+
+    for (auto i = renderers.begin(); i != renderers.end();) {
+        if (i->renderer)
+            ++i;
+        else
+            i = renderers.erase(i);
+    }
+
+    for (const auto &i : std::as_const(times)) {
+        auto &stats = renderers[i.first];
+        // The renderers are only destroyed by deleteLater in the GUI thread
+        if (!stats.renderer)
+            stats.renderer = const_cast<WBufferRenderer*>(i.first);
+        stats.samples.add(i.second, historySize);
+        ++stats.frameCount;
+    }
+}
+
+QString WFrameStatsPrivate::summary(const Stats &stats) const
+{
+    const auto metaEnum = QMetaEnum::fromType<WFrameStats::Phase>();
+    QString string = QStringLiteral("frames: %1, missed: %2").arg(stats.frameCount).arg(stats.missedFrames);
+
+    for (int i = 0; i < PhaseCount; ++i) {
+        const auto &samples = stats.samples[i];
+        string += QStringLiteral("\n  %1: last %2ms, p50 %3ms, p95 %4ms, p99 %5ms")
+                      .arg(QLatin1String(metaEnum.valueToKey(i)), -10)
+                      .arg(samples.last() / 1e6, 0, 'f', 3)
+                      .arg(samples.percentile(50) / 1e6, 0, 'f', 3)
+                      .arg(samples.percentile(95) / 1e6, 0, 'f', 3)
+                      .arg(samples.percentile(99) / 1e6, 0, 'f', 3);
+    }
+
+    return string;
+}
+
+WFrameStats::WFrameStats(QObject *parent)
+    : QObject(*new WFrameStatsPrivate(), parent)
+{
+
+}
+
+bool WFrameStats::enabled() const
+{
+    Q_D(const WFrameStats);
+    return d->enabled;
+}
+
+void WFrameStats::setEnabled(bool newEnabled)
+{
+    Q_D(WFrameStats);
+    if (d->enabled == newEnabled)
+        return;
+    d->enabled = newEnabled;
+    d->inFrame = false;
+    {
+        QMutexLocker locker(&d->rendererMutex);
+        d->recordRenderers = newEnabled;
+        d->pendingRendererTimes.clear();
+    }
+
+    Q_EMIT enabledChanged();
+}
+
+int WFrameStats::historySize() const
+{
+    Q_D(const WFrameStats);
+    return d->historySize;
+}
+
+void WFrameStats::setHistorySize(int newHistorySize)
+{
+    Q_D(WFrameStats);
+    newHistorySize = qMax(1, newHistorySize);
+    if (d->historySize == newHistorySize)
+        return;
+    d->historySize = newHistorySize;
+    reset();
+
+    Q_EMIT historySizeChanged();
+}
+
+quint64 WFrameStats::frameCount() const
+{
+    Q_D(const WFrameStats);
+    return d->global.frameCount;
+}
+
+quint64 WFrameStats::missedFrames() const
+{
+    Q_D(const WFrameStats);
+    return d->global.missedFrames;
+}
+
+qreal WFrameStats::lastTime(Phase phase, WOutputViewport *output) const
+{
+    Q_D(const WFrameStats);
+    auto stats = d->stats(output);
+    return stats ? stats->samples[phase].last() / 1e6 : 0;
+}
+
+qreal WFrameStats::percentile(Phase phase, qreal percent, WOutputViewport *output) const
+{
+    Q_D(const WFrameStats);
+    auto stats = d->stats(output);
+    return stats ? stats->samples[phase].percentile(qBound(0.0, percent, 100.0)) / 1e6 : 0;
+}
+
+quint64 WFrameStats::frameCountOf(WOutputViewport *output) const
+{
+    Q_D(const WFrameStats);
+    auto stats = d->stats(output);
+    return stats ? stats->frameCount : 0;
+}
+
+quint64 WFrameStats::missedFramesOf(WOutputViewport *output) const
+{
+    Q_D(const WFrameStats);
+    auto stats = d->stats(output);
+    return stats ? stats->missedFrames : 0;
+}
+
+qreal WFrameStats::rendererLastTime(WBufferRenderer *renderer) const
+{
+    Q_D(const WFrameStats);
+    auto it = d->renderers.constFind(renderer);
+    return it == d->renderers.constEnd() ? 0 : it->samples.last() / 1e6;
+}
+
+qreal WFrameStats::rendererPercentile(WBufferRenderer *renderer, qreal percent) const
+{
+    Q_D(const WFrameStats);
+    auto it = d->renderers.constFind(renderer);
+    return it == d->renderers.constEnd() ? 0 : it->samples.percentile(qBound(0.0, percent, 100.0)) / 1e6;
+}
+
+quint64 WFrameStats::rendererFrameCount(WBufferRenderer *renderer) const
+{
+    Q_D(const WFrameStats);
+    auto it = d->renderers.constFind(renderer);
+    return it == d->renderers.constEnd() ? 0 : it->frameCount;
+}
+
+QList<WBufferRenderer*> WFrameStats::renderers() const
+{
+    Q_D(const WFrameStats);
+    QList<WBufferRenderer*> list;
+    list.reserve(d->renderers.size());
+    for (const auto &i : d->renderers) {
+        if (i.renderer)
+            list.append(i.renderer);
+    }
+    return list;
+}
+
+QString WFrameStats::summary() const
+{
+    Q_D(const WFrameStats);
+
+    QString string = d->summary(d->global);
+    for (auto i = d->outputs.constBegin(); i != d->outputs.constEnd(); ++i) {
+        const auto output = i.key()->output();
+        string += QStringLiteral("\n%1: ").arg(output ? output->name() : QStringLiteral("unknown"));
+        string += d->summary(i.value());
+    }
+
+    for (const auto &i : d->renderers) {
+        if (!i.renderer)
+            continue;
+        const auto &samples = i.samples;
+        string += QStringLiteral("\nrenderer %1 (%2): frames %3, last %4ms, p50 %5ms, p95 %6ms, p99 %7ms")
+                      .arg(i.renderer->objectName())
+                      .arg(quintptr(i.renderer.get()), 0, 16)
+                      .arg(i.frameCount)
+                      .arg(samples.last() / 1e6, 0, 'f', 3)
+                      .arg(samples.percentile(50) / 1e6, 0, 'f', 3)
+                      .arg(samples.percentile(95) / 1e6, 0, 'f', 3)
+                      .arg(samples.percentile(99) / 1e6, 0, 'f', 3);
+    }
+
+    return string;
+}
+
+void WFrameStats::reset()
+{
+    Q_D(WFrameStats);
+    d->clear();
+    d->inFrame = false;
+
+    Q_EMIT frameCountChanged();
+    Q_EMIT missedFramesChanged();
+    Q_EMIT updated();
+}
+
+void WFrameStats::beginFrame()
+{
+    Q_D(WFrameStats);
+    Q_ASSERT(d->enabled);
+
+    d->inFrame = true;
+    d->frameTimer.start();
+    d->global.begin();
+    for (auto &i : d->outputs)
+        i.inFrame = false;
+}
+
+void WFrameStats::addTime(Phase phase, qint64 nsecs, const WOutputViewport *output)
+{
+    Q_D(WFrameStats);
+    Q_ASSERT(phase != Frame);
+    if (!d->inFrame)
+        return;
+
+    d->global.current[phase] += nsecs;
+
+    if (output) {
+        auto &stats = d->outputs[output];
+        if (!stats.inFrame)
+            stats.begin();
+        stats.current[phase] += nsecs;
+    }
+}
+
+void WFrameStats::addRendererTime(const WBufferRenderer *renderer, qint64 nsecs)
+{
+    Q_D(WFrameStats);
+    QMutexLocker locker(&d->rendererMutex);
+    if (d->recordRenderers)
+        d->pendingRendererTimes.append({renderer, nsecs});
+}
+
+void WFrameStats::setRefreshRate(const WOutputViewport *output, int mHz)
+{
+    Q_D(WFrameStats);
+    d->outputs[output].refreshPeriod = mHz > 0 ? 1000000000000ll / mHz : 0;
+}
+
+void WFrameStats::endFrame()
+{
+    Q_D(WFrameStats);
+    if (!d->inFrame)
+        return;
+    d->inFrame = false;
+
+    auto &global = d->global;
+    global.current[Frame] = d->frameTimer.nsecsElapsed();
+
+    // The time not belongs to any output is shared by all outputs
+    qint64 sharedTime = global.current[Frame];
+    for (const auto &i : std::as_const(d->outputs)) {
+        if (i.inFrame)
+            sharedTime -= i.outputTime();
+    }
+
+    bool missed = false;
+    for (auto &i : d->outputs) {
+        if (!i.inFrame)
+            continue;
+
+        i.current[Polish] = global.current[Polish];
+        i.current[Sync] = global.current[Sync];
+        i.current[Frame] = sharedTime + i.outputTime();
+        for (int phase = 0; phase < PhaseCount; ++phase)
+            i.samples[phase].add(i.current[phase], d->historySize);
+
+        ++i.frameCount;
+        // Only the CPU time is counted, so it's a lower bound of the missed frames
+        if (i.refreshPeriod > 0 && i.current[Frame] > i.refreshPeriod) {
+            ++i.missedFrames;
+            missed = true;
+        }
+    }
+
+    for (int phase = 0; phase < PhaseCount; ++phase)
+        global.samples[phase].add(global.current[phase], d->historySize);
+    ++global.frameCount;
+    if (missed)
+        ++global.missedFrames;
+
+    d->takeRendererTimes();
+
+    Q_EMIT frameCountChanged();
+    if (missed)
+        Q_EMIT missedFramesChanged();
+
+    // Once per history, the bindings of QML don't need to run in every frame
+    if (global.frameCount % d->historySize == 0) {
+        if (d->dumpToLog())
+            qCInfo(wlcFrameStats).noquote() << summary();
+        Q_EMIT updated();
+    }
+}
+
+void WFrameStats::removeOutput(const WOutputViewport *output)
+{
+    Q_D(WFrameStats);
+    d->outputs.remove(output);
+}
+
+WAYLIB_SERVER_END_NAMESPACE
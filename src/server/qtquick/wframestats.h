@@ -0,0 +1,86 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QObject>
+#include <QQmlEngine>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+class WOutputViewport;
+class WBufferRenderer;
+class WFrameStatsPrivate;
+class WAYLIB_SERVER_EXPORT WFrameStats : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(WFrameStats)
+    Q_PROPERTY(bool enabled READ enabled WRITE setEnabled NOTIFY enabledChanged FINAL)
+    Q_PROPERTY(int historySize READ historySize WRITE setHistorySize NOTIFY historySizeChanged FINAL)
+    Q_PROPERTY(quint64 frameCount READ frameCount NOTIFY frameCountChanged FINAL)
+    Q_PROPERTY(quint64 missedFrames READ missedFrames NOTIFY missedFramesChanged FINAL)
+    QML_NAMED_ELEMENT(FrameStats)
+    QML_UNCREATABLE("FrameStats is only available via OutputRenderWindow.frameStats")
+
+public:
+    enum Phase {
+        Polish,     // QQuickRenderControl::polishItems
+        Sync,       // QQuickRenderControl::sync and the animators
+        Render,     // render the primary buffer of WOutputViewport
+        Composite,  // render and composite the output layers
+        Commit,     // commit the buffer to wlr_output
+        Frame,      // the whole frame
+    };
+    Q_ENUM(Phase)
+
+    explicit WFrameStats(QObject *parent = nullptr);
+
+    bool enabled() const;
+    void setEnabled(bool newEnabled);
+
+    int historySize() const;
+    void setHistorySize(int newHistorySize);
+
+    quint64 frameCount() const;
+    quint64 missedFrames() const;
+
+    // The times are in milliseconds, if output is nullptr, returns the time of all outputs.
+    Q_INVOKABLE qreal lastTime(WAYLIB_SERVER_NAMESPACE::WFrameStats::Phase phase,
+                               WAYLIB_SERVER_NAMESPACE::WOutputViewport *output = nullptr) const;
+    Q_INVOKABLE qreal percentile(WAYLIB_SERVER_NAMESPACE::WFrameStats::Phase phase, qreal percent,
+                                 WAYLIB_SERVER_NAMESPACE::WOutputViewport *output = nullptr) const;
+    Q_INVOKABLE quint64 frameCountOf(WAYLIB_SERVER_NAMESPACE::WOutputViewport *output) const;
+    Q_INVOKABLE quint64 missedFramesOf(WAYLIB_SERVER_NAMESPACE::WOutputViewport *output) const;
+    // The times of WBufferRenderer::render, every call is a frame of the renderer
+    Q_INVOKABLE qreal rendererLastTime(WAYLIB_SERVER_NAMESPACE::WBufferRenderer *renderer) const;
+    Q_INVOKABLE qreal rendererPercentile(WAYLIB_SERVER_NAMESPACE::WBufferRenderer *renderer, qreal percent) const;
+    Q_INVOKABLE quint64 rendererFrameCount(WAYLIB_SERVER_NAMESPACE::WBufferRenderer *renderer) const;
+    QList<WBufferRenderer*> renderers() const;
+    Q_INVOKABLE QString summary() const;
+
+public Q_SLOTS:
+    void reset();
+
+Q_SIGNALS:
+    void enabledChanged();
+    void historySizeChanged();
+    void frameCountChanged();
+    void missedFramesChanged();
+    // Emitted once per historySize frames, for the times and the other counters
+    void updated();
+
+private:
+    friend class WOutputRenderWindow;
+    friend class WOutputRenderWindowPrivate;
+    void beginFrame();
+    void addTime(Phase phase, qint64 nsecs, const WOutputViewport *output = nullptr);
+    // Thread safe, the renderers maybe rendered in the render threads
+    void addRendererTime(const WBufferRenderer *renderer, qint64 nsecs);
+    void setRefreshRate(const WOutputViewport *output, int mHz);
+    void endFrame();
+    void removeOutput(const WOutputViewport *output);
+};
+
+WAYLIB_SERVER_END_NAMESPACE
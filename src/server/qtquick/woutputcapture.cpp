@@ -0,0 +1,608 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "woutputcapture.h"
+#include "woutputviewport.h"
+#include "woutputrenderwindow.h"
+#include "woutput.h"
+#include "wtools.h"
+#include "wthreadutils.h"
+#include "woutputviewport_p.h"
+#include "wbufferrenderer_p.h"
+
+#include <qwbuffer.h>
+
+#include <QPointer>
+#include <QCoreApplication>
+#include <QThreadPool>
+#include <QLoggingCategory>
+#include <rhi/qrhi.h>
+#include <private/qobject_p.h>
+#include <private/qquickwindow_p.h>
+
+#include <memory>
+
+QW_USE_NAMESPACE
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+Q_LOGGING_CATEGORY(wlcOutputCapture, "waylib.server.capture", QtInfoMsg)
+
+// The damage of too many rects is read back as its bounding rect
+static constexpr int MaxPatches = 32;
+
+static QImage::Format imageFormatOf(QRhiTexture::Format format)
+{
+    switch (format) {
+    case QRhiTexture::RGBA8:
+        return QImage::Format_RGBA8888_Premultiplied;
+    case QRhiTexture::BGRA8:
+        return QImage::Format_ARGB32_Premultiplied;
+    case QRhiTexture::RGB10A2:
+        return QImage::Format_A2BGR30_Premultiplied;
+    default:
+        return QImage::Format_Invalid;
+    }
+}
+
+// The pixels of a readback, the rects are at the offsets in the memory
+struct Q_DECL_HIDDEN Readback {
+    const uchar *bits = nullptr;
+    qsizetype stride = 0;
+    QImage::Format format = QImage::Format_Invalid;
+    QList<QRect> rects;
+    QList<QPoint> offsets;
+    // Owns the memory of the RHI readback
+    QByteArray storage;
+};
+
+static QList<WOutputCapture::Patch> convertReadback(const Readback &readback, QImage::Format format)
+{
+    QList<WOutputCapture::Patch> patches;
+    patches.reserve(readback.rects.size());
+    const int bytesPerPixel = QImage::toPixelFormat(readback.format).bitsPerPixel() / 8;
+
+    for (int i = 0; i < readback.rects.size(); ++i) {
+        const QRect &rect = readback.rects.at(i);
+        const QPoint &offset = readback.offsets.at(i);
+        const uchar *src = readback.bits + offset.y() * readback.stride + offset.x() * bytesPerPixel;
+
+        QImage image(rect.size(), format);
+        if (!WTools::convertPixels(src, readback.stride, readback.format, image.bits(),
+                                   image.bytesPerLine(), format, rect.size())) {
+            image = QImage(src, rect.width(), rect.height(), readback.stride, readback.format).convertedTo(format);
+        }
+        patches.append({rect, image});
+    }
+
+    return patches;
+}
+
+class Q_DECL_HIDDEN WOutputCapturePrivate : public QObjectPrivate
+{
+public:
+    W_DECLARE_PUBLIC(WOutputCapture)
+
+    static inline WOutputCapturePrivate *get(WOutputCapture *qq) {
+        return qq->d_func();
+    }
+
+    void setRenderer(WBufferRenderer *newRenderer);
+    void onBufferRendered(qw_buffer *buffer, const QRegion &damage);
+    void onAfterRendering();
+    void scheduleReadback();
+    void readback();
+    bool readbackBuffer(qw_buffer *buffer, Readback *result) const;
+    bool readbackTexture(QRhiTexture *texture, const QSize &size, std::shared_ptr<Readback> result);
+    void convert(std::shared_ptr<Readback> result, const QSize &size, qw_buffer *lockedBuffer);
+    void finishReadback(WOutputCapture::Frame frame);
+    void enqueue(WOutputCapture::Frame &&frame);
+    QImage::Format targetFormat(QImage::Format sourceFormat);
+
+    QPointer<WOutputViewport> viewport;
+    QPointer<WBufferRenderer> renderer;
+    QMetaObject::Connection rendererConnection;
+    QMetaObject::Connection windowConnection;
+
+    // The damage not read back, in the pixel coordinates of the buffer
+    QRegion pendingDamage;
+    QSize bufferSize;
+    bool scheduled = false;
+    bool busy = false;
+    // The buffers of the renderer can't be accessed by CPU, they're copied by the GPU
+    // in the frames of the window, see onAfterRendering.
+    bool gpuReadback = false;
+    // Read back in the frame in which it's rendered, its damage is not added again
+    qw_buffer *readInFrame = nullptr;
+    // Increased on subscribing, the readbacks of the old subscription are ignored
+    quint64 generation = 0;
+
+    QList<WOutputCapture::Frame> queue;
+    int queueSize = 3;
+    QImage::Format format = QImage::Format_Invalid;
+    // The cached preferred read format of the output, it's expensive to query
+    QImage::Format readFormat = QImage::Format_Invalid;
+
+    quint64 sequence = 0;
+    quint64 capturedFrames = 0;
+    quint64 droppedFrames = 0;
+    quint64 capturedBytes = 0;
+};
+
+void WOutputCapturePrivate::setRenderer(WBufferRenderer *newRenderer)
+{
+    W_Q(WOutputCapture);
+
+    if (renderer == newRenderer)
+        return;
+
+    if (renderer) {
+        QObject::disconnect(rendererConnection);
+        QObject::disconnect(windowConnection);
+        // Let the direct scanout work again
+        renderer->unlockCacheBuffer(q);
+    }
+
+    renderer = newRenderer;
+    ++generation;
+    pendingDamage = QRegion();
+    bufferSize = QSize();
+    gpuReadback = false;
+    readInFrame = nullptr;
+    readFormat = QImage::Format_Invalid;
+    q->clear();
+
+    if (renderer) {
+        // The buffer of the direct scanout is not rendered by the renderer
+        renderer->lockCacheBuffer(q);
+        rendererConnection = QObject::connect(renderer, &WBufferRenderer::bufferRendered, q,
+                                              [this] (qw_buffer *buffer, const QRegion &damage) {
+            onBufferRendered(buffer, damage);
+        });
+        if (auto window = renderer->window()) {
+            windowConnection = QObject::connect(window, &QQuickWindow::afterRendering, q, [this] {
+                onAfterRendering();
+            }, Qt::DirectConnection);
+        }
+
+        // The first frame before the renderer renders again
+        if (auto buffer = renderer->lastBuffer())
+            onBufferRendered(buffer, QRegion());
+    }
+}
+
+void WOutputCapturePrivate::onBufferRendered(qw_buffer *buffer, const QRegion &damage)
+{
+    if (buffer == std::exchange(readInFrame, nullptr))
+        return;
+
+    const QSize size(buffer->handle()->width, buffer->handle()->height);
+    if (size != bufferSize) {
+        bufferSize = size;
+        pendingDamage = QRect(QPoint(0, 0), size);
+    } else {
+        pendingDamage += damage;
+    }
+
+    if (!pendingDamage.isEmpty())
+        scheduleReadback();
+}
+
+void WOutputCapturePrivate::scheduleReadback()
+{
+    W_Q(WOutputCapture);
+
+    // The damage is merged into the next readback if it's not finished
+    if (scheduled || busy)
+        return;
+    scheduled = true;
+
+    // Don't read back in the render loop, and the buffers rendered in
+    // this frame are merged into one readback.
+    QMetaObject::invokeMethod(q, [this] {
+        readback();
+    }, Qt::QueuedConnection);
+}
+
+void WOutputCapturePrivate::readback()
+{
+    scheduled = false;
+    if (!renderer || pendingDamage.isEmpty())
+        return;
+
+    // Wait for the next endRender if it's rendering, the buffer will be changed
+    qw_buffer *buffer = renderer->lastBuffer();
+    if (!buffer || renderer->currentBuffer())
+        return;
+
+    const QSize size(buffer->handle()->width, buffer->handle()->height);
+    if (size != bufferSize)
+        return;
+
+    if (gpuReadback) {
+        // Read back in the next frame of the window, the output isn't rendered for it
+        if (auto window = qobject_cast<WOutputRenderWindow*>(renderer->window()))
+            window->scheduleRender();
+        return;
+    }
+
+    auto result = std::make_shared<Readback>();
+    QRegion damage = pendingDamage & QRect(QPoint(0, 0), size);
+    if (damage.rectCount() > MaxPatches)
+        damage = damage.boundingRect();
+    result->rects = QList<QRect>(damage.begin(), damage.end());
+
+    if (!readbackBuffer(buffer, result.get())) {
+        // The buffer can't be accessed by CPU, copy the damaged rects by the GPU
+        auto window = qobject_cast<WOutputRenderWindow*>(renderer->window());
+        if (!window || !window->rhi()) {
+            qCWarning(wlcOutputCapture) << "Can't read back the buffer of" << renderer;
+            pendingDamage = QRegion();
+            return;
+        }
+        gpuReadback = true;
+        window->scheduleRender();
+        return;
+    }
+
+    pendingDamage = QRegion();
+    busy = true;
+    // The buffer is not reused by the swapchain until it's unlocked
+    buffer->lock();
+    convert(result, size, buffer);
+}
+
+// In the frame of the window, the texture of the buffer can be copied only when the
+// command buffer of the frame is recording, and the GL context is current.
+void WOutputCapturePrivate::onAfterRendering()
+{
+    if (!renderer || !gpuReadback || busy)
+        return;
+
+    QRegion damage = pendingDamage;
+    QSize size = bufferSize;
+    QRhiTexture *texture = nullptr;
+    qw_buffer *buffer = renderer->currentBuffer();
+    if (buffer) {
+        // Rendered in this frame, bufferRendered is emitted after the frame
+        size = QSize(buffer->handle()->width, buffer->handle()->height);
+        if (size != bufferSize)
+            damage = QRect(QPoint(0, 0), size);
+        else
+            damage += WTools::fromPixmanRegion(&renderer->damageRing()->handle()->current);
+        texture = renderer->currentRenderTarget();
+    } else if (!damage.isEmpty()) {
+        buffer = renderer->lastBuffer();
+        if (!buffer || QSize(buffer->handle()->width, buffer->handle()->height) != size)
+            return;
+        texture = renderer->lastRenderTarget();
+    }
+
+    damage &= QRect(QPoint(0, 0), size);
+    if (!texture || damage.isEmpty())
+        return;
+    if (damage.rectCount() > MaxPatches)
+        damage = damage.boundingRect();
+
+    auto result = std::make_shared<Readback>();
+    result->rects = QList<QRect>(damage.begin(), damage.end());
+    if (!readbackTexture(texture, size, result)) {
+        qCWarning(wlcOutputCapture) << "Can't read back the buffer of" << renderer;
+        return;
+    }
+
+    if (buffer == renderer->currentBuffer())
+        readInFrame = buffer;
+    pendingDamage = QRegion();
+    bufferSize = size;
+    busy = true;
+}
+
+void WOutputCapturePrivate::convert(std::shared_ptr<Readback> result, const QSize &size,
+                                    qw_buffer *lockedBuffer)
+{
+    W_Q(WOutputCapture);
+    const QImage::Format target = targetFormat(result->format);
+
+    // Convert the pixels in the thread pool
+    QThreadPool::globalInstance()->start([result, target, lockedBuffer, size,
+                                          generation = generation,
+                                          capture = QPointer<WOutputCapture>(q)] {
+        WOutputCapture::Frame frame;
+        frame.bufferSize = size;
+        frame.patches = convertReadback(*result, target);
+        for (const auto &patch : std::as_const(frame.patches))
+            frame.damage += patch.rect;
+
+        WThreadUtil::gui().run([frame, lockedBuffer, generation, capture] {
+            if (lockedBuffer)
+                lockedBuffer->unlock();
+            if (!capture)
+                return;
+
+            // The frame of the old subscription
+            auto d = WOutputCapturePrivate::get(capture);
+            d->finishReadback(d->generation == generation ? frame : WOutputCapture::Frame());
+        });
+    });
+}
+
+bool WOutputCapturePrivate::readbackBuffer(qw_buffer *buffer, Readback *result) const
+{
+    void *data;
+    uint32_t drmFormat;
+    size_t stride;
+    if (!wlr_buffer_begin_data_ptr_access(buffer->handle(), WLR_BUFFER_DATA_PTR_ACCESS_READ,
+                                          &data, &drmFormat, &stride)) {
+        return false;
+    }
+    // Same as WRenderHelper, the memory is kept until the buffer is destroyed
+    wlr_buffer_end_data_ptr_access(buffer->handle());
+
+    result->format = WTools::toImageFormat(drmFormat);
+    if (result->format == QImage::Format_Invalid)
+        return false;
+
+    result->bits = static_cast<const uchar*>(data);
+    result->stride = stride;
+    result->offsets.clear();
+    for (const QRect &rect : std::as_const(result->rects))
+        result->offsets.append(rect.topLeft());
+
+    return true;
+}
+
+bool WOutputCapturePrivate::readbackTexture(QRhiTexture *texture, const QSize &size,
+                                            std::shared_ptr<Readback> result)
+{
+    W_Q(WOutputCapture);
+    QRhi *rhi = renderer->window()->rhi();
+    QRhiCommandBuffer *cb = QQuickWindowPrivate::get(renderer->window())->redirect.commandBuffer;
+    if (!cb || !rhi->isRecordingFrame())
+        return false;
+
+    result->format = imageFormatOf(texture->format());
+    if (result->format == QImage::Format_Invalid)
+        return false;
+
+    // Stack the damaged rects in a staging texture, only them are read back
+    QSize stagingSize;
+    for (const QRect &rect : std::as_const(result->rects)) {
+        stagingSize.setWidth(qMax(stagingSize.width(), rect.width()));
+        stagingSize.setHeight(stagingSize.height() + rect.height());
+    }
+
+    if (stagingSize.height() > rhi->resourceLimit(QRhi::TextureSizeMax)) {
+        QRect bounding;
+        for (const QRect &rect : std::as_const(result->rects))
+            bounding |= rect;
+        result->rects = {bounding};
+        stagingSize = bounding.size();
+    }
+
+    std::unique_ptr<QRhiTexture> staging(rhi->newTexture(texture->format(), stagingSize, 1,
+                                                         QRhiTexture::UsedAsTransferSource));
+    if (!staging->create())
+        return false;
+
+    auto ub = rhi->nextResourceUpdateBatch();
+    result->offsets.clear();
+    int y = 0;
+    for (const QRect &rect : std::as_const(result->rects)) {
+        QRhiTextureCopyDescription desc;
+        desc.setSourceTopLeft(rect.topLeft());
+        desc.setPixelSize(rect.size());
+        desc.setDestinationTopLeft(QPoint(0, y));
+        ub->copyTexture(staging.get(), texture, desc);
+        result->offsets.append(QPoint(0, y));
+        y += rect.height();
+    }
+
+    // Completed when the frame is finished by the GPU, maybe in the later frames,
+    // it's kept even if the capture is destroyed before that.
+    auto rb = new QRhiReadbackResult;
+    rb->completed = [rb, result, size, generation = generation,
+                     capture = QPointer<WOutputCapture>(q)] {
+        // Not in the completed function
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [rb] {
+            delete rb;
+        }, Qt::QueuedConnection);
+        if (!capture)
+            return;
+
+        // The frame of the old subscription
+        auto d = WOutputCapturePrivate::get(capture);
+        if (d->generation != generation) {
+            d->finishReadback(WOutputCapture::Frame());
+            return;
+        }
+
+        result->storage = rb->data;
+        result->bits = reinterpret_cast<const uchar*>(result->storage.constData());
+        result->stride = result->storage.size() / qMax(1, rb->pixelSize.height());
+        d->convert(result, size, nullptr);
+    };
+    ub->readBackTexture(QRhiReadbackDescription(staging.get()), rb);
+    cb->resourceUpdate(ub);
+    // Released after the frame is finished
+    staging.release()->deleteLater();
+
+    return true;
+}
+
+void WOutputCapturePrivate::finishReadback(WOutputCapture::Frame frame)
+{
+    busy = false;
+
+    if (!frame.isNull()) {
+        frame.sequence = ++sequence;
+        ++capturedFrames;
+        for (const auto &patch : std::as_const(frame.patches))
+            capturedBytes += patch.image.sizeInBytes();
+        enqueue(std::move(frame));
+    }
+
+    // The damage of the frames rendered while reading back
+    if (!pendingDamage.isEmpty())
+        scheduleReadback();
+}
+
+void WOutputCapturePrivate::enqueue(WOutputCapture::Frame &&frame)
+{
+    W_Q(WOutputCapture);
+
+    while (queue.size() >= queueSize) {
+        // The consumer never gets the dropped frame, keep its pixels not
+        // covered by the next frame to make the patches still complete.
+        WOutputCapture::Frame dropped = queue.takeFirst();
+        WOutputCapture::Frame &next = queue.isEmpty() ? frame : queue.first();
+        ++droppedFrames;
+
+        QList<WOutputCapture::Patch> patches;
+        for (const auto &patch : std::as_const(dropped.patches)) {
+            const QRegion uncovered = QRegion(patch.rect) - next.damage;
+            for (const QRect &rect : uncovered)
+                patches.append({rect, patch.image.copy(rect.translated(-patch.rect.topLeft()))});
+        }
+
+        next.patches = patches + next.patches;
+        next.damage += dropped.damage;
+    }
+
+    queue.append(std::move(frame));
+    Q_EMIT q->pendingFramesChanged();
+    Q_EMIT q->frameAvailable();
+}
+
+QImage::Format WOutputCapturePrivate::targetFormat(QImage::Format sourceFormat)
+{
+    if (format != QImage::Format_Invalid)
+        return format;
+
+    if (readFormat == QImage::Format_Invalid && renderer && renderer->output())
+        readFormat = renderer->output()->preferredReadFormat();
+
+    return readFormat != QImage::Format_Invalid ? readFormat : sourceFormat;
+}
+
+WOutputCapture::WOutputCapture(QObject *parent)
+    : QObject(*new WOutputCapturePrivate(), parent)
+{
+
+}
+
+WOutputCapture::~WOutputCapture()
+{
+    Q_D(WOutputCapture);
+    d->setRenderer(nullptr);
+}
+
+WOutputViewport *WOutputCapture::viewport() const
+{
+    Q_D(const WOutputCapture);
+    return d->viewport;
+}
+
+void WOutputCapture::setViewport(WOutputViewport *newViewport)
+{
+    Q_D(WOutputCapture);
+    if (d->viewport == newViewport)
+        return;
+
+    d->viewport = newViewport;
+    d->setRenderer(newViewport ? WOutputViewportPrivate::get(newViewport)->bufferRenderer : nullptr);
+    Q_EMIT viewportChanged();
+}
+
+WBufferRenderer *WOutputCapture::bufferRenderer() const
+{
+    Q_D(const WOutputCapture);
+    return d->renderer;
+}
+
+void WOutputCapture::setBufferRenderer(WBufferRenderer *renderer)
+{
+    Q_D(WOutputCapture);
+
+    if (d->viewport && WOutputViewportPrivate::get(d->viewport)->bufferRenderer != renderer) {
+        d->viewport = nullptr;
+        Q_EMIT viewportChanged();
+    }
+
+    d->setRenderer(renderer);
+}
+
+int WOutputCapture::queueSize() const
+{
+    Q_D(const WOutputCapture);
+    return d->queueSize;
+}
+
+void WOutputCapture::setQueueSize(int newQueueSize)
+{
+    Q_D(WOutputCapture);
+    newQueueSize = qMax(1, newQueueSize);
+    if (d->queueSize == newQueueSize)
+        return;
+
+    d->queueSize = newQueueSize;
+    Q_EMIT queueSizeChanged();
+}
+
+QImage::Format WOutputCapture::format() const
+{
+    Q_D(const WOutputCapture);
+    return d->format;
+}
+
+void WOutputCapture::setFormat(QImage::Format newFormat)
+{
+    Q_D(WOutputCapture);
+    d->format = newFormat;
+}
+
+int WOutputCapture::pendingFrames() const
+{
+    Q_D(const WOutputCapture);
+    return d->queue.size();
+}
+
+WOutputCapture::Frame WOutputCapture::takeFrame()
+{
+    Q_D(WOutputCapture);
+    if (d->queue.isEmpty())
+        return {};
+
+    Frame frame = d->queue.takeFirst();
+    Q_EMIT pendingFramesChanged();
+    return frame;
+}
+
+quint64 WOutputCapture::capturedFrames() const
+{
+    Q_D(const WOutputCapture);
+    return d->capturedFrames;
+}
+
+quint64 WOutputCapture::droppedFrames() const
+{
+    Q_D(const WOutputCapture);
+    return d->droppedFrames;
+}
+
+quint64 WOutputCapture::capturedBytes() const
+{
+    Q_D(const WOutputCapture);
+    return d->capturedBytes;
+}
+
+void WOutputCapture::clear()
+{
+    Q_D(WOutputCapture);
+    if (d->queue.isEmpty())
+        return;
+
+    d->queue.clear();
+    Q_EMIT pendingFramesChanged();
+}
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,89 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QObject>
+#include <QImage>
+#include <QRegion>
+#include <QQmlEngine>
+
+Q_MOC_INCLUDE(<woutputviewport.h>)
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+class WOutputViewport;
+class WBufferRenderer;
+class WOutputCapturePrivate;
+// Reads back the damaged areas of the buffers rendered by a WBufferRenderer, for the
+// screencast, the remote desktop and the recorder. The first frame contains the whole
+// buffer, the others only the rects changed since the previous frame in the queue.
+class WAYLIB_SERVER_EXPORT WOutputCapture : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(WOutputCapture)
+    Q_PROPERTY(WOutputViewport* viewport READ viewport WRITE setViewport NOTIFY viewportChanged FINAL)
+    Q_PROPERTY(int queueSize READ queueSize WRITE setQueueSize NOTIFY queueSizeChanged FINAL)
+    Q_PROPERTY(int pendingFrames READ pendingFrames NOTIFY pendingFramesChanged FINAL)
+    QML_NAMED_ELEMENT(OutputCapture)
+
+public:
+    struct Patch {
+        // In the pixel coordinates of the buffer
+        QRect rect;
+        QImage image;
+    };
+
+    struct Frame {
+        // Increased for every frame, the gaps are the dropped frames, their patches
+        // are merged into the next frame.
+        quint64 sequence = 0;
+        QSize bufferSize;
+        QRegion damage;
+        // Paint them in order over the previous frame
+        QList<Patch> patches;
+
+        inline bool isNull() const {
+            return bufferSize.isEmpty();
+        }
+    };
+
+    explicit WOutputCapture(QObject *parent = nullptr);
+    ~WOutputCapture();
+
+    // The contents of the output layers and the direct scanout are not in the buffer
+    // of the viewport, the direct scanout is disabled while capturing it.
+    WOutputViewport *viewport() const;
+    void setViewport(WOutputViewport *newViewport);
+
+    WBufferRenderer *bufferRenderer() const;
+    void setBufferRenderer(WBufferRenderer *renderer);
+
+    // The oldest frame is dropped when the queue is full
+    int queueSize() const;
+    void setQueueSize(int newQueueSize);
+
+    // Format_Invalid is the preferred read format of the output
+    QImage::Format format() const;
+    void setFormat(QImage::Format newFormat);
+
+    int pendingFrames() const;
+    Frame takeFrame();
+
+    quint64 capturedFrames() const;
+    quint64 droppedFrames() const;
+    quint64 capturedBytes() const;
+
+public Q_SLOTS:
+    void clear();
+
+Q_SIGNALS:
+    void viewportChanged();
+    void queueSizeChanged();
+    void pendingFramesChanged();
+    void frameAvailable();
+};
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -6,6 +6,7 @@
 #include "woutput.h"
 #include "platformplugin/types.h"
 #include "private/wglobal_p.h"
+#include "woutputlayertestcache_p.h"
 
 #include <qwoutput.h>
 #include <qwrenderer.h>
@@ -24,9 +25,18 @@
 #endif
 #include <private/qquickwindow_p.h>
 
+#include <atomic>
+
 QW_USE_NAMESPACE
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
+// Only the tests of these states can be reused
+static constexpr uint32_t CacheableTestStates = WLR_OUTPUT_STATE_BUFFER | WLR_OUTPUT_STATE_DAMAGE
+                                                | WLR_OUTPUT_STATE_LAYERS;
+
+static std::atomic_uint64_t totalTestCommits = 0;
+static std::atomic_uint64_t totalAvoidedTestCommits = 0;
+
 class Q_DECL_HIDDEN WOutputHelperPrivate : public WObjectPrivate
 {
 public:
@@ -55,6 +65,7 @@ public:
             on_damage();
         });
         output->safeConnect(&WOutput::modeChanged, qq, [this] {
+            testCache.invalidate();
             if (renderHelper)
                 renderHelper->setSize(this->output->size());
         }, Qt::QueuedConnection); // reset buffer on later, because it's rendering
@@ -96,6 +107,8 @@ public:
     QWindow *outputWindow;
     WRenderHelper *renderHelper = nullptr;
 
+    WOutputLayerTestCache testCache;
+
     uint renderable:1;
     uint contentIsDirty:1;
     uint needsFrame:1;
@@ -258,6 +271,11 @@ bool WOutputHelper::commit()
     wlr_output_state state = d->state;
     wlr_output_state_init(&d->state);
     bool ok = d->qwoutput()->commit_state(&state);
+    // The reused test results maybe outdated
+    if (!ok || (state.committed & ~CacheableTestStates))
+        d->testCache.invalidate();
+    else if (state.committed & WLR_OUTPUT_STATE_LAYERS)
+        d->testCache.verifyCommit(d->layersCache, ok);
     wlr_output_state_finish(&state);
 
     return ok;
@@ -272,6 +290,18 @@ bool WOutputHelper::testCommit()
 bool WOutputHelper::testCommit(qw_buffer *buffer, const wlr_output_layer_state_array &layers)
 {
     W_D(WOutputHelper);
+
+    // Only the tests of the layers are cached, the buffers of the direct scanout are from
+    // the clients, the same format doesn't mean they can be scanned out.
+    const bool cacheable = !layers.isEmpty() && !(d->state.committed & ~CacheableTestStates);
+    if (cacheable) {
+        bool ok;
+        if (d->testCache.reuse(buffer ? buffer->handle() : nullptr, layers, &ok)) {
+            totalAvoidedTestCommits.fetch_add(1, std::memory_order_relaxed);
+            return ok;
+        }
+    }
+
     wlr_output_state state = d->state;
 
     if (buffer)
@@ -280,14 +310,28 @@ bool WOutputHelper::testCommit(qw_buffer *buffer, const wlr_output_layer_state_a
         wlr_output_state_set_layers(&state, const_cast<wlr_output_layer_state*>(layers.data()), layers.length());
 
     bool ok = d->qwoutput()->test_state(&state);
+    totalTestCommits.fetch_add(1, std::memory_order_relaxed);
     if (state.committed & WLR_OUTPUT_STATE_BUFFER) {
         Q_ASSERT(buffer);
         buffer->unlock();
     }
 
+    if (cacheable)
+        d->testCache.save(layers, ok);
+
     return ok;
 }
 
+quint64 WOutputHelper::testCommitCount()
+{
+    return totalTestCommits.load(std::memory_order_relaxed);
+}
+
+quint64 WOutputHelper::avoidedTestCommitCount()
+{
+    return totalAvoidedTestCommits.load(std::memory_order_relaxed);
+}
+
 bool WOutputHelper::renderable() const
 {
     W_DC(WOutputHelper);
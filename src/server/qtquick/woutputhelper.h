@@ -60,7 +60,12 @@ public:
     void setLayers(const wlr_output_layer_state_array &layers);
     bool commit();
     bool testCommit();
+    // The results of the layers are reused while the layers and the formats of their buffers
+    // are not changed, it's tested again after the output is changed or the commit is failed.
     bool testCommit(QW_NAMESPACE::qw_buffer *buffer, const wlr_output_layer_state_array &layers);
+    // The number of the test commits issued and avoided by all outputs
+    static quint64 testCommitCount();
+    static quint64 avoidedTestCommitCount();
 
     bool renderable() const;
     bool contentIsDirty() const;
@@ -12,7 +12,17 @@
 #include "woutputlayer.h"
 #include "wbufferrenderer_p.h"
 #include "wquicktextureproxy.h"
+#include "wsgtextureprovider.h"
 #include "weventjunkman.h"
+#include "wtools.h"
+#include "wframestats.h"
+#include "wsurfaceitem.h"
+#include "wsurface.h"
+#include "wserver.h"
+#include "wthreadutils.h"
+#include "wquickocclusionculler_p.h"
+#include "wquickautolayerizer_p.h"
+#include "wquickhittestindex_p.h"
 
 #include "platformplugin/qwlrootsintegration.h"
 #include "platformplugin/qwlrootscreen.h"
@@ -36,7 +46,14 @@
 #include <QOpenGLFunctions>
 #include <QLoggingCategory>
 #include <QRunnable>
+#include <QThreadPool>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QtMath>
 #include <memory>
+#include <limits>
+#include <time.h>
 
 #define protected public
 #define private public
@@ -68,6 +85,7 @@ extern "C" {
 
 #include <drm_fourcc.h>
 #include <limits>
+#include <time.h>
 
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
@@ -119,6 +137,45 @@ private:
     using WQuickTextureProxy::setSourceItem;
 };
 
+// The source item of the mirror proxy, the frames of WOutputViewport::mirrorSource are
+// imported to its own texture provider, the texture provider of the source renderer is
+// shared by the other consumers and must not be changed by the mirrors.
+class Q_DECL_HIDDEN MirrorTextureSource : public QQuickItem
+{
+public:
+    MirrorTextureSource(WOutputRenderWindow *window, QObject *parent)
+        : m_textureProvider(new WSGTextureProvider(window))
+    {
+        setParent(parent);
+    }
+
+    bool isTextureProvider() const override {
+        return true;
+    }
+    QSGTextureProvider *textureProvider() const override {
+        return m_textureProvider.get();
+    }
+    inline WSGTextureProvider *wTextureProvider() const {
+        return m_textureProvider.get();
+    }
+
+private:
+    std::unique_ptr<WSGTextureProvider> m_textureProvider;
+};
+
+// for adaptive frame scheduling
+static constexpr int MinFrameTimeSamples = 10;
+// Keep some time for the commit and the page flip after rendering, in nanoseconds
+static constexpr qint64 FrameDeadlineMargin = 2000000;
+
+// In nanoseconds, the clock of the present events
+static inline qint64 monotonicTime()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec) * 1000000000ll + now.tv_nsec;
+}
+
 class OutputLayer;
 class Q_DECL_HIDDEN OutputHelper : public WOutputHelper
 {
@@ -163,18 +220,29 @@ public:
         : WOutputHelper(output->output(), renderable, contentIsDirty, needsFrame, parent)
         , m_output(output)
     {
-
+        m_deadlineTimer.setSingleShot(true);
+        m_deadlineTimer.setTimerType(Qt::PreciseTimer);
     }
 
     ~OutputHelper()
     {
+        clearScanout();
+        cleanMirror();
         cleanLayerCompositor();
         cleanCursorRender();
         qDeleteAll(m_layers);
     }
 
     inline void init() {
-        connect(this, &OutputHelper::requestRender, renderWindow(), qOverload<>(&WOutputRenderWindow::render));
+        connect(this, &OutputHelper::requestRender, this, &OutputHelper::scheduleFrame);
+        connect(&m_deadlineTimer, &QTimer::timeout, renderWindow(), qOverload<>(&WOutputRenderWindow::render));
+        qwoutput()->safeConnect(&qw_output::notify_present, this, [this] (wlr_output_event_present *event) {
+            if (!event->presented)
+                return;
+            m_lastPresentTime = qint64(event->when.tv_sec) * 1000000000ll + event->when.tv_nsec;
+            m_presentRefresh = event->refresh;
+            updateFixedRateDeadline();
+        });
         connect(this, &OutputHelper::damaged, renderWindow(), &WOutputRenderWindow::scheduleRender);
         // TODO: pre update scale after WOutputHelper::setScale
         output()->output()->safeConnect(&WOutput::scaleChanged, this, &OutputHelper::updateSceneDPR);
@@ -206,6 +274,11 @@ public:
         return m_layers;
     }
 
+    // The layers are composited to the primary buffer in the last frame
+    inline bool hasCompositedLayers() const {
+        return !m_layerProxys.isEmpty();
+    }
+
     inline void invalidate() {
         m_output = nullptr;
     }
@@ -228,28 +301,124 @@ public:
                                  const QSize &pixelSize, uint32_t format,
                                  WBufferRenderer::RenderFlags flags);
     inline void render(WBufferRenderer *renderer, int sourceIndex, const QMatrix4x4 &renderMatrix,
-                       const QRectF &sourceRect, const QRectF &viewportRect, bool preserveColorContents);
+                       const QRectF &sourceRect, const QRectF &viewportRect, bool preserveColorContents,
+                       QRegion *damage = nullptr);
+    // Returns false if there is no buffer to render
+    bool beginRenderPrimaryBuffer();
+    // Only use the states saved in beginRenderPrimaryBuffer, it maybe called in the render thread
+    void renderPrimaryBuffer();
 
     static bool visualizeLayers() {
         static bool on = qEnvironmentVariableIsSet("WAYLIB_VISUALIZE_LAYERS");
         return on;
     }
 
+    static bool directScanoutEnabled() {
+        static bool on = !qEnvironmentVariableIsSet("WAYLIB_DISABLE_DIRECT_SCANOUT");
+        return on;
+    }
+
+    bool tryScanout();
+    void clearScanout();
+    // The client buffer is attached to the output instead of the primary buffer in this frame
+    inline bool isScanout() const {
+        return m_scanoutBuffer;
+    }
+    inline qw_buffer *primaryBuffer() const {
+        return m_scanoutBuffer ? m_scanoutBuffer : bufferRenderer()->currentBuffer();
+    }
+
+    // for WOutputViewport::mirrorSource, the source is always processed before its mirrors
+    OutputHelper *mirrorSource() const;
+    inline void setPendingMirror(OutputHelper *source) {
+        m_pendingMirror = source;
+    }
+    inline OutputHelper *takePendingMirror() {
+        return std::exchange(m_pendingMirror, nullptr);
+    }
+    inline bool hasPendingMirror() const {
+        return m_pendingMirror;
+    }
+    // Creates and places the mirror proxy before synchronizing
+    void prepareMirror(OutputHelper *source);
+    // The buffer displayed by this output after this frame, the renderer is returned by afterRender
+    qw_buffer *frameBuffer(WBufferRenderer *renderer) const;
+    // Attaches the buffer of the source to the output if it can be displayed as is, otherwise
+    // scales it to the primary buffer, the scene is never rendered again for the mirrors.
+    void renderMirror(OutputHelper *source, WBufferRenderer *sourceRenderer, bool allowAttach);
+    bool attachMirror(OutputHelper *source, qw_buffer *buffer);
+    void cleanMirror();
+
+    // Start rendering at the deadline of the refresh cycle instead of the frame event, so
+    // the client commits arrived in this refresh cycle can be presented in the next vblank.
+    // The next vblank is predicted from the timestamp of the last present event.
+    void scheduleFrame();
+    inline bool isWaitingForDeadline() const {
+        return m_deadlineTimer.isActive();
+    }
+    inline void cancelDeadline() {
+        m_deadlineTimer.stop();
+    }
+    // Without the deadline timer, the frame is rendered by the frame event of the next
+    // vblank, the Budgeted dispatch of WServer yields to it as well
+    void updateFixedRateDeadline();
+    // In nanoseconds from now
+    void setServerFrameDeadline(qint64 remaining);
+    // The time from starting the frame to the buffer is committed
+    void addFrameTime(qint64 nsecs);
+    qint64 predictedFrameTime() const;
+
+    // Returns false if the layer is out of the output
+    bool updateLayerGeometry(LayerData *layer, qreal *devicePixelRatio = nullptr);
     qw_buffer *renderLayer(LayerData *layer, bool *dontEndRenderAndReturnNeedsEndRender);
     WBufferRenderer *afterRender();
     WBufferRenderer *compositeLayers(const QVector<LayerData*> layers, bool forceShadowRenderer);
     bool commit(WBufferRenderer *buffer);
     bool tryToHardwareCursor(const LayerData *layer);
+    inline LayerData *hardwareCursorLayer() const {
+        return m_hardwareCursorRenderComplete ? m_hardwareCursorLayer : nullptr;
+    }
+    // Only update the position of the hardware cursor, returns false if the cursor
+    // needs to be rendered again.
+    bool moveHardwareCursor(LayerData *layer);
+    QPoint cursorHotSpot(const LayerData *layer) const;
+    bool moveCursor(const LayerData *layer);
 
 private:
     WOutputViewport *m_output = nullptr;
     QList<LayerData*> m_layers;
     WBufferRenderer *m_lastCommitBuffer = nullptr;
+    // for renderPrimaryBuffer
+    struct {
+        QMatrix4x4 renderMatrix;
+        QRectF sourceRect;
+        QRectF targetRect;
+        bool preserveColorContents = false;
+    } m_primaryRender;
+    // for direct scanout
+    qw_buffer *m_scanoutBuffer = nullptr;
+    QPointer<WSurface> m_scanoutRejectedSurface;
+    bool m_lastCommitIsScanout = false;
+    // for mirror mode
+    OutputHelper *m_pendingMirror = nullptr;
+    QPointer<WQuickTextureProxy> m_mirrorProxy;
+    QPointer<MirrorTextureSource> m_mirrorTexture;
+    QPointer<OutputHelper> m_mirrorRejectedSource;
+    // for adaptive frame scheduling
+    QTimer m_deadlineTimer;
+    // The running mean and mean deviation of the frame times, in nanoseconds
+    qint64 m_frameTimeMean = 0;
+    qint64 m_frameTimeDeviation = 0;
+    int m_frameTimeSamples = 0;
+    // CLOCK_MONOTONIC, in nanoseconds
+    qint64 m_lastPresentTime = 0;
+    int m_presentRefresh = 0;
     // only for render cursor
     QPointer<WBufferRenderer> m_cursorRenderer;
     BufferRendererProxy *m_cursorLayerProxy = nullptr;
     bool m_cursorDirty = false;
     bool m_hardwareCursorRenderComplete = false;
+    LayerData *m_hardwareCursorLayer = nullptr;
 
     // for compositeLayers
     QPointer<WOutputViewport> m_output2;
@@ -405,6 +574,10 @@ public:
         return static_cast<RenderControl*>(q_func()->renderControl());
     }
 
+    inline WFrameStats *activeFrameStats() const {
+        return frameStats->enabled() ? frameStats : nullptr;
+    }
+
     inline bool isInitialized() const {
         return rc()->m_renderWindow;
     }
@@ -420,17 +593,80 @@ public:
     void updateSceneDPR();
     void sortOutputs();
 
-    QVector<std::pair<OutputHelper *, WBufferRenderer *>>
-    doRenderOutputs(const QList<OutputHelper *> &outputs, bool forceRender);
+    QVector<OutputHelper*> beginRenderOutputs(const QList<OutputHelper*> &outputs, bool forceRender,
+                                              QVector<OutputHelper*> *needsRender);
+    void renderOutputs(const QVector<OutputHelper*> &needsRender);
+    void renderPrimaryBuffers(const QVector<OutputHelper*> &needsRender, bool parallel,
+                              QVector<qint64> *renderTimes);
+    QVector<std::pair<OutputHelper*, WBufferRenderer*>>
+    afterRenderOutputs(const QVector<OutputHelper*> &renderResults);
     void doRender(const QList<OutputHelper*> &outputs, bool forceRender, bool doCommit);
+    void endRender(const QVector<std::pair<OutputHelper*, WBufferRenderer*>> &needsCommit, bool doCommit);
     inline void doRender() {
         doRender(outputs, false, true);
     }
 
     inline void pushRenderer(WBufferRenderer *renderer) {
+        // The rendererList is only used in the GUI thread, see currentRenderer
+        if (inParallelRendering || QThread::currentThread() != q_func()->thread()) {
+            threadRenderer = {q_func(), renderer};
+            return;
+        }
         rendererList.push(renderer);
     }
 
+    bool canTrackItemDamages() const;
+    void commitItemDamages(bool tracked);
+
+    static bool cursorFastPathEnabled() {
+        static bool on = !qEnvironmentVariableIsSet("WAYLIB_DISABLE_CURSOR_FAST_PATH");
+        return on;
+    }
+
+    bool moveHardwareCursors();
+
+    static bool occlusionCullingEnabled() {
+        static bool on = !qEnvironmentVariableIsSet("WAYLIB_DISABLE_OCCLUSION_CULLING");
+        return on;
+    }
+
+    void prepareMirrors();
+    void updateOcclusion();
+    QList<QQuickItem*> sceneRoots() const;
+
+    static bool threadedRenderingByDefault() {
+        static bool on = qEnvironmentVariableIsSet("WAYLIB_THREADED_RENDERING");
+        return on;
+    }
+
+    static bool parallelRenderingByDefault() {
+        static bool on = qEnvironmentVariableIsSet("WAYLIB_PARALLEL_RENDERING");
+        return on;
+    }
+
+    static bool adaptiveFrameSchedulingByDefault() {
+        static bool on = qEnvironmentVariableIsSet("WAYLIB_ADAPTIVE_FRAME_SCHEDULING");
+        return on;
+    }
+
+    static int softwareRenderThreadsByDefault() {
+        static int threads = qMax(1, qEnvironmentVariableIntValue("WAYLIB_SOFTWARE_RENDER_THREADS"));
+        return threads;
+    }
+
+    static bool autoLayerizationByDefault() {
+        static bool on = qEnvironmentVariableIsSet("WAYLIB_AUTO_LAYERIZATION");
+        return on;
+    }
+
+    bool canRenderInThread(const QVector<OutputHelper*> &renderResults,
+                           const QVector<OutputHelper*> &needsRender) const;
+    bool canRenderInParallel(const QVector<OutputHelper*> &needsRender) const;
+    void startThreadedRender(const QVector<OutputHelper*> &renderResults,
+                             const QVector<OutputHelper*> &needsRender);
+    void finishThreadedRender(quint64 serial);
+    void waitForRenderThread();
+
     inline void scheduleDoRender() {
         if (!isInitialized())
             return; // Not initialized
@@ -438,6 +674,11 @@ public:
         if (inRendering)
             return;
 
+        if (threadedFrame) {
+            threadedFrame->renderRequested = true;
+            return;
+        }
+
         QCoreApplication::postEvent(q_func(), new QEvent(doRenderEventType));
     }
 
@@ -459,6 +700,62 @@ public:
 #endif
 
     QStack<WBufferRenderer*> rendererList;
+    WFrameStats *frameStats = nullptr;
+
+    // for threaded rendering
+    struct ThreadedFrame {
+        quint64 serial = 0;
+        QVector<OutputHelper*> renderResults;
+        QVector<OutputHelper*> needsRender;
+        QVector<qint64> renderTimes;
+        bool parallel = false;
+        QFuture<void> future;
+        bool renderRequested = false;
+    };
+
+    bool threadedRendering = threadedRenderingByDefault();
+    bool parallelRendering = parallelRenderingByDefault();
+    bool adaptiveFrameScheduling = adaptiveFrameSchedulingByDefault();
+    int softwareRenderThreads = softwareRenderThreadsByDefault();
+    bool autoLayerization = autoLayerizationByDefault();
+    // The start time of the current frame, for OutputHelper::addFrameTime
+    QElapsedTimer frameTimer;
+    QThread *renderThread = nullptr;
+    std::unique_ptr<WThreadUtil> renderThreadUtil;
+    std::unique_ptr<ThreadedFrame> threadedFrame;
+    quint64 threadedFrameSerial = 0;
+
+    // for parallel rendering
+    QThreadPool *renderThreadPool = nullptr;
+    bool inParallelRendering = false;
+    // The renderer of the output rendering in the current thread, the rendererList
+    // can't be shared by the threads. The threads are shared by the windows, so it's
+    // keyed by the window and reset after rendering each output.
+    struct ThreadRenderer {
+        const WOutputRenderWindow *window = nullptr;
+        WBufferRenderer *renderer = nullptr;
+    };
+    static inline thread_local ThreadRenderer threadRenderer;
+
+    struct ItemDamage {
+        QPointer<QQuickItem> item;
+        QRegion region;
+    };
+    struct FrameDamage {
+        quint64 serial;
+        bool tracked;
+        QList<ItemDamage> items;
+    };
+
+    // The cursors moved by moveHardwareCursors, their scene graph are synchronized in next frame
+    QList<QPointer<QQuickItem>> movedCursorItems;
+
+    // damages reported by addDamage, will move to frameDamages in next frame
+    QList<ItemDamage> pendingItemDamages;
+    bool pendingWholeDamage = false;
+    // the recent frames, a renderer missed more frames will repaint whole buffer
+    QList<FrameDamage> frameDamages;
+    quint64 damageSerial = 0;
 };
 
 WOutputRenderWindowPrivate *OutputHelper::renderWindowD() const
@@ -508,6 +805,8 @@ void OutputHelper::detachLayer(OutputLayer *layer)
     int index = indexOfLayer(layer);
     Q_ASSERT(index >= 0);
     auto l = m_layers.takeAt(index);
+    if (m_hardwareCursorLayer == l)
+        m_hardwareCursorLayer = nullptr;
 
     if (m_cursorLayerProxy && m_cursorLayerProxy->sourceItem() == l->renderer) {
         // Clear hardware cursor
@@ -581,10 +880,54 @@ qw_buffer *OutputHelper::beginRender(WBufferRenderer *renderer,
 }
 
 void OutputHelper::render(WBufferRenderer *renderer, int sourceIndex, const QMatrix4x4 &renderMatrix,
-                          const QRectF &sourceRect, const QRectF &targetRect, bool preserveColorContents)
+                          const QRectF &sourceRect, const QRectF &targetRect, bool preserveColorContents,
+                          QRegion *damage)
 {
     renderWindowD()->pushRenderer(renderer);
-    renderer->render(sourceIndex, renderMatrix, sourceRect, targetRect, preserveColorContents);
+    QElapsedTimer timer;
+    timer.start();
+    renderer->render(sourceIndex, renderMatrix, sourceRect, targetRect, preserveColorContents, damage);
+    renderWindowD()->frameStats->addRendererTime(renderer, timer.nsecsElapsed());
+}
+
+bool OutputHelper::beginRenderPrimaryBuffer()
+{
+    // maybe using the other WOutputViewport's QSGTextureProvider
+    if (!output()->depends().isEmpty())
+        renderWindowD()->updateDirtyNodes();
+
+    WBufferRenderer::RenderFlags flags = WBufferRenderer::RedirectOpenGLContextDefaultFrameBufferObject;
+    // The contents from the other WOutputViewport and the software composited
+    // layers can't be tracked by the item damages
+    if (output()->depends().isEmpty() && !hasCompositedLayers() && !m_mirrorProxy)
+        flags |= WBufferRenderer::UseItemDamage | WBufferRenderer::PartialRepaint;
+
+    // The contents of the primary buffers are outdated after the direct scanout
+    if (m_lastCommitIsScanout)
+        bufferRenderer()->damageRing()->add_whole();
+
+    const auto &format = qwoutput()->handle()->render_format;
+    qw_buffer *buffer = beginRender(bufferRenderer(), output()->output()->size(), format, flags);
+    Q_ASSERT(buffer == bufferRenderer()->currentBuffer());
+    if (!buffer)
+        return false;
+    // The primary buffer maybe rendered in the other threads, see renderPrimaryBuffers
+    bufferRenderer()->prepareRender(0);
+
+    // The mirror proxy is placed in the viewport by prepareMirror
+    m_primaryRender.renderMatrix = m_mirrorProxy ? QMatrix4x4() : output()->renderMatrix();
+    m_primaryRender.sourceRect = output()->effectiveSourceRect();
+    m_primaryRender.targetRect = output()->targetRect();
+    m_primaryRender.preserveColorContents = output()->preserveColorContents();
+
+    return true;
+}
+
+void OutputHelper::renderPrimaryBuffer()
+{
+    render(bufferRenderer(), 0, m_primaryRender.renderMatrix,
+           m_primaryRender.sourceRect, m_primaryRender.targetRect,
+           m_primaryRender.preserveColorContents);
 }
 
 static QQuickItem *createVisualRectangle(QQuickItem *target, const QColor &color) {
@@ -603,6 +946,113 @@ static inline QRectF scaleRect(const QRectF &r, qreal xScale, qreal yScale) {
     return QRectF(r.x() * xScale, r.y() * yScale, r.width() * xScale, r.height() * yScale);
 }
 
+bool OutputHelper::updateLayerGeometry(LayerData *layer, qreal *devicePixelRatio)
+{
+    auto source = layer->layer->layer->parent();
+    // The layer buffer is sized by the ratio of this output, not of the window
+    qreal dpr = this->devicePixelRatio();
+    QRectF mapRect, noClipMapRect;
+    // matrix function: map source to WOutputViewport
+    QMatrix4x4 viewportMatrix;
+
+    const auto layerFlags = layer->layer->layer->flags();
+    const bool sizeSensitive = layerFlags & WOutputLayer::SizeSensitive;
+    const bool isRef = layer->mapFrom && layer->mapTo;
+    if (isRef) {
+        viewportMatrix = output()->mapToViewport(layer->mapTo);
+        const auto xScale = layer->mapTo->width() / layer->mapFrom->output()->width();
+        const auto yScale = layer->mapTo->height() / layer->mapFrom->output()->height();
+
+        // geometry relative the other output buffer
+        noClipMapRect = scaleRect(layer->mapFromLayer->noClipMapRect, xScale, yScale);
+        if (sizeSensitive) {
+            mapRect = scaleRect(layer->mapFromLayer->mapRect, xScale, yScale);
+        } else {
+            mapRect = noClipMapRect;
+        }
+    } else {
+        viewportMatrix = output()->mapToViewport(source->parentItem());
+
+        // geometry relative source's parent
+        noClipMapRect = QRectF(source->position(), source->size());
+        mapRect = noClipMapRect;
+    }
+
+    // matrix function: map source to output buffer
+    const auto outputMatrix = viewportMatrix * output()->sourceRectToTargetRectTransfrom();
+    noClipMapRect = outputMatrix.mapRect(noClipMapRect);
+    mapRect = outputMatrix.mapRect(mapRect);
+
+    QTransform revertScaleTransform;
+    if (!sizeSensitive) {
+        const auto scaledPoint1 = viewportMatrix.map(QPointF(0, 0));
+        const auto scaledPoint2 = viewportMatrix.map(QPointF(1, 1)) - scaledPoint1;
+        const auto xScale = 1.0 / std::abs(scaledPoint2.x());
+        const auto yScale = 1.0 / std::abs(scaledPoint2.y());
+
+        if (xScale != 1 || yScale != 1) {
+            revertScaleTransform.scale(xScale, yScale);
+            noClipMapRect.setSize(revertScaleTransform.mapRect(noClipMapRect).size());
+            mapRect.setSize(revertScaleTransform.mapRect(mapRect).size());
+        }
+    } else if (layer->mapFrom) {
+        // This layer's size is strict mode, needs follow the map source's DPR.
+        dpr = layer->mapFrom->devicePixelRatio();
+    }
+
+    // clip to WOutputViewport
+    mapRect = mapRect & QRectF(QPointF(0, 0), output()->size());
+
+    QSize pixelSize;
+    const auto tmpSize = mapRect.size() * dpr;
+
+    if (layerFlags & WOutputLayer::DontClip) {
+        pixelSize.rwidth() = qCeil(tmpSize.width());
+        pixelSize.rheight() = qCeil(tmpSize.height());
+    } else {
+        // Limitation max buffer
+        const auto maxSize = qMax(source->width(), source->height()) * dpr;
+        pixelSize.rwidth() = qCeil(qMin(tmpSize.width(), maxSize));
+        pixelSize.rheight() = qCeil(qMin(tmpSize.height(), maxSize));
+    }
+
+    if (mapRect.isEmpty()) {
+        return false;
+    }
+    Q_ASSERT(!pixelSize.isEmpty());
+
+    QMatrix4x4 renderMatrix = revertScaleTransform * viewportMatrix;
+    if (isRef) {
+        renderMatrix = layer->mapFromLayer->renderMatrix * renderMatrix;
+    }
+
+    // viewportMatrix is relative of the output buffer, but the layer
+    // render buffer's pixelSize is not same as the output buffer, so
+    // needs reset the x,y translate relative the render buffer of the layer.
+    if (!renderMatrix.isIdentity()) {
+        const auto tmp = renderMatrix.mapRect(QRectF(QPointF(0, 0), source->size()));
+        renderMatrix(0, 3) -= tmp.x();
+        renderMatrix(1, 3) -= tmp.y();
+    }
+
+    std::swap(mapRect, layer->mapRect);
+    std::swap(noClipMapRect, layer->noClipMapRect);
+    std::swap(pixelSize, layer->pixelSize);
+    std::swap(renderMatrix, layer->renderMatrix);
+
+    if (layer->pixelSize != pixelSize
+        || layer->mapRect.size() != mapRect.size()
+        || layer->renderMatrix != renderMatrix) {
+        layer->contentsIsDirty = true;
+    }
+
+    layer->mapToOutput = QRect((layer->mapRect.topLeft() * dpr).toPoint(), layer->pixelSize);
+    if (devicePixelRatio)
+        *devicePixelRatio = dpr;
+
+    return true;
+}
+
 qw_buffer *OutputHelper::renderLayer(LayerData *layer, bool *dontEndRenderAndReturnNeedsEndRender)
 {
     auto source = layer->layer->layer->parent();
@@ -632,106 +1082,10 @@ qw_buffer *OutputHelper::renderLayer(LayerData *layer, bool *dontEndRenderAndRet
         });
     }
 
-    qreal dpr = devicePixelRatio();
-
-    {
-        QRectF mapRect, noClipMapRect;
-        // matrix function: map source to WOutputViewport
-        QMatrix4x4 viewportMatrix;
-
-        const auto layerFlags = layer->layer->layer->flags();
-        const bool sizeSensitive = layerFlags & WOutputLayer::SizeSensitive;
-        const bool isRef = layer->mapFrom && layer->mapTo;
-        if (isRef) {
-            viewportMatrix = output()->mapToViewport(layer->mapTo);
-            const auto xScale = layer->mapTo->width() / layer->mapFrom->output()->width();
-            const auto yScale = layer->mapTo->height() / layer->mapFrom->output()->height();
-
-            // geometry relative the other output buffer
-            noClipMapRect = scaleRect(layer->mapFromLayer->noClipMapRect, xScale, yScale);
-            if (sizeSensitive) {
-                mapRect = scaleRect(layer->mapFromLayer->mapRect, xScale, yScale);
-            } else {
-                mapRect = noClipMapRect;
-            }
-        } else {
-            viewportMatrix = output()->mapToViewport(source->parentItem());
-
-            // geometry relative source's parent
-            noClipMapRect = QRectF(source->position(), source->size());
-            mapRect = noClipMapRect;
-        }
-
-        // matrix function: map source to output buffer
-        const auto outputMatrix = viewportMatrix * output()->sourceRectToTargetRectTransfrom();
-        noClipMapRect = outputMatrix.mapRect(noClipMapRect);
-        mapRect = outputMatrix.mapRect(mapRect);
-
-        QTransform revertScaleTransform;
-        if (!sizeSensitive) {
-            const auto scaledPoint1 = viewportMatrix.map(QPointF(0, 0));
-            const auto scaledPoint2 = viewportMatrix.map(QPointF(1, 1)) - scaledPoint1;
-            const auto xScale = 1.0 / std::abs(scaledPoint2.x());
-            const auto yScale = 1.0 / std::abs(scaledPoint2.y());
-
-            if (xScale != 1 || yScale != 1) {
-                revertScaleTransform.scale(xScale, yScale);
-                noClipMapRect.setSize(revertScaleTransform.mapRect(noClipMapRect).size());
-                mapRect.setSize(revertScaleTransform.mapRect(mapRect).size());
-            }
-        } else if (layer->mapFrom) {
-            // This layer's size is strict mode, needs follow the map source's DPR.
-            dpr = layer->mapFrom->devicePixelRatio();
-        }
-
-        // clip to WOutputViewport
-        mapRect = mapRect & QRectF(QPointF(0, 0), output()->size());
-
-        QSize pixelSize;
-        const auto tmpSize = mapRect.size() * dpr;
-
-        if (layerFlags & WOutputLayer::DontClip) {
-            pixelSize.rwidth() = qCeil(tmpSize.width());
-            pixelSize.rheight() = qCeil(tmpSize.height());
-        } else {
-            // Limitation max buffer
-            const auto maxSize = qMax(source->width(), source->height()) * dpr;
-            pixelSize.rwidth() = qCeil(qMin(tmpSize.width(), maxSize));
-            pixelSize.rheight() = qCeil(qMin(tmpSize.height(), maxSize));
-        }
-
-        if (mapRect.isEmpty()) {
-            return nullptr;
-        }
-        Q_ASSERT(!pixelSize.isEmpty());
-
-        QMatrix4x4 renderMatrix = revertScaleTransform * viewportMatrix;
-        if (isRef) {
-            renderMatrix = layer->mapFromLayer->renderMatrix * renderMatrix;
-        }
-
-        // viewportMatrix is relative of the output buffer, but the layer
-        // render buffer's pixelSize is not same as the output buffer, so
-        // needs reset the x,y translate relative the render buffer of the layer.
-        if (!renderMatrix.isIdentity()) {
-            const auto tmp = renderMatrix.mapRect(QRectF(QPointF(0, 0), source->size()));
-            renderMatrix(0, 3) -= tmp.x();
-            renderMatrix(1, 3) -= tmp.y();
-        }
-
-        std::swap(mapRect, layer->mapRect);
-        std::swap(noClipMapRect, layer->noClipMapRect);
-        std::swap(pixelSize, layer->pixelSize);
-        std::swap(renderMatrix, layer->renderMatrix);
-
-        if (layer->pixelSize != pixelSize
-            || layer->mapRect.size() != mapRect.size()
-            || layer->renderMatrix != renderMatrix) {
-            layer->contentsIsDirty = true;
-        }
-    }
+    qreal dpr;
+    if (!updateLayerGeometry(layer, &dpr))
+        return nullptr;
 
-    layer->mapToOutput = QRect((layer->mapRect.topLeft() * dpr).toPoint(), layer->pixelSize);
     auto buffer = layer->renderer->lastBuffer();
 
     if (!buffer || layer->contentsIsDirty) {
@@ -842,7 +1196,7 @@ WBufferRenderer *OutputHelper::afterRender()
         return bufferRenderer();
     }
 
-    const bool ok = WOutputHelper::testCommit(bufferRenderer()->currentBuffer(), layers);
+    const bool ok = WOutputHelper::testCommit(primaryBuffer(), layers);
     int needsSoftwareCompositeBeginIndex = -1;
     int needsSoftwareCompositeEndIndex = -1;
     bool forceShadowRender = false;
@@ -939,6 +1293,13 @@ WBufferRenderer *OutputHelper::afterRender()
         return bufferRenderer();
     }
 
+    if (m_scanoutBuffer) {
+        // The layers can't be composited to the client buffer, the caller
+        // should render the primary buffer and call afterRender again.
+        clearScanout();
+        return nullptr;
+    }
+
     return compositeLayers(needsCompositeLayers, forceShadowRender);
 }
 
@@ -1033,10 +1394,32 @@ WBufferRenderer *OutputHelper::compositeLayers(const QList<LayerData*> layers, b
         }
     } else {
         if (bufferRenderer()->currentBuffer()) {
-            render(bufferRenderer(), 1, {}, m_output->effectiveSourceRect(), m_output->targetRect(), true);
+            // The damage of the primary render is already added, the damages of the
+            // renders here are added once after the final render.
+            QRegion frameDamage;
+            if (bufferRenderer()->isPartialRepaint()) {
+                // The layers are not included in the repaint rect of the primary render,
+                // repaint the whole buffer for the first frame of compositing layers.
+                bufferRenderer()->state.flags &= ~WBufferRenderer::PartialRepaint;
+                QRegion repaintDamage;
+                render(bufferRenderer(), 0, m_output->renderMatrix(),
+                       m_output->effectiveSourceRect(), m_output->targetRect(),
+                       m_output->preserveColorContents(), &repaintDamage);
+            }
+            render(bufferRenderer(), 1, {}, m_output->effectiveSourceRect(), m_output->targetRect(),
+                   true, &frameDamage);
+
+            // The contents of the layers are not included in the item damages
+            for (const LayerData *layer : layers)
+                frameDamage += layer->mapToOutput;
+            pixman_region32_t damage;
+            bool ok = WTools::toPixmanRegion(frameDamage, &damage);
+            Q_ASSERT(ok);
+            bufferRenderer()->damageRing()->add(&damage);
+            pixman_region32_fini(&damage);
         } else {
             // ###(zccrs): Maybe because contents is not dirty, so not do render
-            // in WOutputRenderWindowPrivate::doRenderOutputs, force mark the
+            // in WOutputRenderWindowPrivate::beginRenderOutputs, force mark the
             // contents to dirty here to ensure can render layers in the next frame.
             update();
         }
@@ -1045,17 +1428,261 @@ WBufferRenderer *OutputHelper::compositeLayers(const QList<LayerData*> layers, b
     return bufferRenderer();
 }
 
+bool OutputHelper::tryScanout()
+{
+    clearScanout();
+
+    WSurfaceItemContent *content = nullptr;
+    if (directScanoutEnabled() && !hasCompositedLayers()
+        && !bufferRenderer()->shouldCacheBuffer()) {
+        content = WOutputViewportPrivate::get(output())->scanoutCandidate();
+    }
+
+    WSurface *surface = content ? content->surface() : nullptr;
+    if (!surface) {
+        m_scanoutRejectedSurface = nullptr;
+        return false;
+    }
+
+    // Don't test the buffers of the surface again if the output can't scanout it,
+    // the buffers of a client are usually allocated in the same way.
+    if (m_scanoutRejectedSurface == surface)
+        return false;
+
+    qw_buffer *buffer = surface->buffer();
+    if (!WOutputHelper::testCommit(buffer, {})) {
+        qCDebug(wlcRenderer) << "Can't scanout the buffer of" << surface << "on" << output();
+        m_scanoutRejectedSurface = surface;
+        return false;
+    }
+
+    // Keep the buffer until it's committed, the surface maybe committed a new buffer before it
+    buffer->lock();
+    m_scanoutBuffer = buffer;
+
+    return true;
+}
+
+void OutputHelper::clearScanout()
+{
+    if (!m_scanoutBuffer)
+        return;
+
+    m_scanoutBuffer->unlock();
+    m_scanoutBuffer = nullptr;
+}
+
+OutputHelper *OutputHelper::mirrorSource() const
+{
+    auto source = output()->mirrorSource();
+    return source ? renderWindowD()->getOutputHelper(source) : nullptr;
+}
+
+qw_buffer *OutputHelper::frameBuffer(WBufferRenderer *renderer) const
+{
+    if (m_scanoutBuffer)
+        return m_scanoutBuffer;
+    if (renderer && renderer->currentBuffer())
+        return renderer->currentBuffer();
+    // The client buffer of the last direct scanout maybe already released, and
+    // the renderer of the composited layers maybe already destroyed.
+    if (m_lastCommitIsScanout || m_lastCommitBuffer != bufferRenderer())
+        return nullptr;
+    return bufferRenderer()->lastBuffer();
+}
+
+void OutputHelper::prepareMirror(OutputHelper *source)
+{
+    if (!m_mirrorProxy) {
+        m_mirrorProxy = new WQuickTextureProxy(output());
+        m_mirrorProxy->setSmooth(true);
+        m_mirrorTexture = new MirrorTextureSource(renderWindow(), m_mirrorProxy);
+        m_mirrorProxy->setSourceItem(m_mirrorTexture);
+        WOutputViewportPrivate::get(output())->setMirrorRenderSource(m_mirrorProxy);
+    }
+
+    // The node of the proxy is only created with a texture, the last frame of the source
+    // is used until the source is rendered in this frame, see renderMirror.
+    auto textureProvider = m_mirrorTexture->wTextureProvider();
+    if (!textureProvider->texture()) {
+        if (auto buffer = source->frameBuffer(nullptr))
+            textureProvider->setBuffer(buffer);
+    }
+
+    // Letterbox the frames of the source in this viewport
+    const QSize sourceSize = source->output()->output()->size();
+    const QSizeF area = output()->size();
+    const QSizeF size = QSizeF(sourceSize).scaled(area, Qt::KeepAspectRatio);
+    m_mirrorProxy->setSourceRect(QRectF(QPointF(0, 0), sourceSize));
+    m_mirrorProxy->setSize(size);
+    m_mirrorProxy->setPosition(QPointF(area.width() - size.width(),
+                                       area.height() - size.height()) / 2);
+}
+
+void OutputHelper::renderMirror(OutputHelper *source, WBufferRenderer *sourceRenderer, bool allowAttach)
+{
+    qw_buffer *buffer = source->frameBuffer(sourceRenderer);
+    if (allowAttach && buffer && attachMirror(source, buffer))
+        return;
+    // The proxy is created by prepareMirror before synchronizing
+    if (!m_mirrorTexture)
+        return;
+
+    if (buffer) {
+        auto textureProvider = m_mirrorTexture->wTextureProvider();
+        // The proxy has no node if it had no texture in synchronizing
+        if (!textureProvider->texture())
+            m_mirrorProxy->update();
+        // The same buffer maybe rendered again by the source, e.g. a pixman buffer
+        textureProvider->updateBuffer(buffer, QRect(0, 0, buffer->handle()->width,
+                                                    buffer->handle()->height));
+    }
+
+    if (beginRenderPrimaryBuffer())
+        renderPrimaryBuffer();
+}
+
+bool OutputHelper::attachMirror(OutputHelper *source, qw_buffer *buffer)
+{
+    // The layers of this output can't be composited to the buffer of the source
+    if (!directScanoutEnabled() || hasCompositedLayers() || output()->offscreen())
+        return false;
+
+    if (QSize(buffer->handle()->width, buffer->handle()->height) != output()->output()->size()
+        || source->qwoutput()->handle()->transform != qwoutput()->handle()->transform) {
+        m_mirrorRejectedSource = nullptr;
+        return false;
+    }
+
+    // Same as tryScanout, the buffers of the source are usually allocated in the same way
+    if (m_mirrorRejectedSource == source)
+        return false;
+    if (!WOutputHelper::testCommit(buffer, {})) {
+        qCDebug(wlcRenderer) << "Can't display the buffer of" << source->output() << "on" << output();
+        m_mirrorRejectedSource = source;
+        return false;
+    }
+
+    // The commit path of the direct scanout is reused
+    buffer->lock();
+    m_scanoutBuffer = buffer;
+
+    return true;
+}
+
+void OutputHelper::cleanMirror()
+{
+    m_pendingMirror = nullptr;
+    m_mirrorRejectedSource = nullptr;
+
+    if (!m_mirrorProxy)
+        return;
+
+    if (m_output) {
+        auto d = WOutputViewportPrivate::get(m_output);
+        if (!d->inDestructor)
+            d->setMirrorRenderSource(nullptr);
+    }
+
+    m_mirrorProxy->deleteLater();
+    m_mirrorProxy = nullptr;
+    m_mirrorTexture = nullptr;
+}
+
+void OutputHelper::scheduleFrame()
+{
+    const int refresh = qwoutput()->handle()->refresh;
+    if (!renderWindowD()->adaptiveFrameScheduling || refresh <= 0 || m_lastPresentTime <= 0
+        || m_frameTimeSamples < MinFrameTimeSamples) {
+        renderWindow()->render();
+        return;
+    }
+
+    const qint64 nowTime = monotonicTime();
+    const qint64 period = m_presentRefresh > 0 ? m_presentRefresh : 1000000000000ll / refresh;
+    // Not the frame event of a vblank, e.g. the frame scheduled by the idle output
+    if (nowTime - m_lastPresentTime >= period) {
+        renderWindow()->render();
+        return;
+    }
+
+    // Render as late as possible before the next vblank
+    const qint64 deadline = m_lastPresentTime + period - predictedFrameTime() - FrameDeadlineMargin;
+    const qint64 delay = (deadline - nowTime) / 1000000;
+    if (delay <= 0) {
+        renderWindow()->render();
+        return;
+    }
+
+    m_deadlineTimer.start(delay);
+    // Let the Budgeted dispatch of WServer yield to this frame
+    setServerFrameDeadline(delay * 1000000);
+}
+
+void OutputHelper::updateFixedRateDeadline()
+{
+    if (m_presentRefresh <= 0)
+        return;
+    if (renderWindowD()->adaptiveFrameScheduling && m_frameTimeSamples >= MinFrameTimeSamples)
+        return;
+
+    setServerFrameDeadline(m_lastPresentTime + m_presentRefresh - monotonicTime());
+}
+
+void OutputHelper::setServerFrameDeadline(qint64 remaining)
+{
+    if (remaining <= 0)
+        return;
+
+    if (auto server = output()->output()->server()) {
+        QDeadlineTimer deadline(Qt::PreciseTimer);
+        deadline.setPreciseRemainingTime(0, remaining, Qt::PreciseTimer);
+        server->setFrameDeadline(deadline);
+    }
+}
+
+// Same as the estimation of the round-trip time in TCP (RFC 6298)
+void OutputHelper::addFrameTime(qint64 nsecs)
+{
+    if (m_frameTimeSamples == 0) {
+        m_frameTimeMean = nsecs;
+        m_frameTimeDeviation = nsecs / 2;
+    } else {
+        m_frameTimeDeviation += (qAbs(nsecs - m_frameTimeMean) - m_frameTimeDeviation) / 4;
+        m_frameTimeMean += (nsecs - m_frameTimeMean) / 8;
+    }
+
+    if (m_frameTimeSamples < MinFrameTimeSamples)
+        ++m_frameTimeSamples;
+}
+
+qint64 OutputHelper::predictedFrameTime() const
+{
+    // About the p95 to avoid missing the vblank by the occasional slow frames
+    return m_frameTimeMean + 2 * m_frameTimeDeviation;
+}
+
 bool OutputHelper::commit(WBufferRenderer *buffer)
 {
     if (output()->offscreen())
         return true;
 
+    if (m_scanoutBuffer) {
+        setBuffer(m_scanoutBuffer);
+        // The output state holds its own lock of the buffer
+        clearScanout();
+        m_lastCommitBuffer = nullptr;
+        m_lastCommitIsScanout = true;
+        return WOutputHelper::commit();
+    }
+
     if (!buffer || !buffer->currentBuffer()) {
         Q_ASSERT(!this->buffer());
         return WOutputHelper::commit();
     }
 
     setBuffer(buffer->currentBuffer());
+    m_lastCommitIsScanout = false;
 
     if (m_lastCommitBuffer == buffer) {
         if (pixman_region32_not_empty(&buffer->damageRing()->handle()->current))
@@ -1075,6 +1702,7 @@ bool OutputHelper::tryToHardwareCursor(const LayerData *layer)
                           ? layer->renderer->lastBuffer()->handle()
                           : nullptr;
         if (!buffer) {
+            m_hardwareCursorLayer = nullptr;
             if (!m_hardwareCursorRenderComplete)
                 return true;
 
@@ -1149,8 +1777,7 @@ bool OutputHelper::tryToHardwareCursor(const LayerData *layer)
             }
         }
 
-        const auto hotSpot = layer->renderMatrix.map(layer->layer->layer->cursorHotSpot()
-                                                     * devicePixelRatio()).toPoint();
+        const auto hotSpot = cursorHotSpot(layer);
         if (!set_cursor(qwoutput()->handle(), buffer, hotSpot.x(), hotSpot.y())) {
             break;
         } else {
@@ -1158,27 +1785,62 @@ bool OutputHelper::tryToHardwareCursor(const LayerData *layer)
             resetGlState();
         }
 
-        const auto pos = layer->mapToOutput.topLeft() + hotSpot;
-        wlr_box cleanTransform {.x = pos.x(), .y = pos.y()};
-        const auto outputSize = output()->output()->size();
-        // the layer->mapRect has been transform in renderLayer, but
-        // wlroot's move_cursor also will transform the cursor's position.
-        // so revert transform here.
-        wlr_box_transform(&cleanTransform, &cleanTransform,
-                          qwoutput()->handle()->transform,
-                          outputSize.width(), outputSize.height());
-        if (!move_cursor(qwoutput()->handle(), cleanTransform.x, cleanTransform.y)) {
+        if (!moveCursor(layer)) {
             break;
         }
 
+        m_hardwareCursorLayer = const_cast<LayerData*>(layer);
         return true;
     } while (false);
 
+    m_hardwareCursorLayer = nullptr;
     resetGlState();
 
     return false;
 }
 
+QPoint OutputHelper::cursorHotSpot(const LayerData *layer) const
+{
+    return layer->renderMatrix.map(layer->layer->layer->cursorHotSpot() * devicePixelRatio()).toPoint();
+}
+
+bool OutputHelper::moveCursor(const LayerData *layer)
+{
+    auto move_cursor = qwoutput()->handle()->impl->move_cursor;
+    if (!move_cursor)
+        return false;
+
+    const auto pos = layer->mapToOutput.topLeft() + cursorHotSpot(layer);
+    wlr_box cleanTransform {.x = pos.x(), .y = pos.y()};
+    const auto outputSize = output()->output()->size();
+    // the layer->mapRect has been transform in renderLayer, but
+    // wlroot's move_cursor also will transform the cursor's position.
+    // so revert transform here.
+    wlr_box_transform(&cleanTransform, &cleanTransform,
+                      qwoutput()->handle()->transform,
+                      outputSize.width(), outputSize.height());
+    return move_cursor(qwoutput()->handle(), cleanTransform.x, cleanTransform.y);
+}
+
+bool OutputHelper::moveHardwareCursor(LayerData *layer)
+{
+    Q_ASSERT(layer == hardwareCursorLayer());
+    if (layer->contentsIsDirty || m_cursorDirty)
+        return false;
+
+    // The position of the item is changed without synchronizing the scene graph,
+    // it's fine for the contents of the layer, its renderer doesn't use the position.
+    if (!updateLayerGeometry(layer) || layer->contentsIsDirty)
+        return false;
+
+    if (!moveCursor(layer)) {
+        layer->contentsIsDirty = true;
+        return false;
+    }
+
+    return true;
+}
+
 int WOutputRenderWindowPrivate::indexOfOutputHelper(const WOutputViewport *output) const
 {
     for (int i = 0; i < outputs.size(); ++i) {
@@ -1264,6 +1926,9 @@ void WOutputRenderWindowPrivate::init(OutputHelper *helper)
     QObject::connect(helper->output(), &WOutputViewport::dependsChanged, helper, [this] {
         sortOutputs();
     });
+    QObject::connect(helper->output(), &WOutputViewport::mirrorSourceChanged, helper, [this] {
+        sortOutputs();
+    });
 
     for (auto layer : std::as_const(layers)) {
         if (layer->outputs().contains(helper->output())) {
@@ -1370,18 +2035,24 @@ void WOutputRenderWindowPrivate::sortOutputs()
 {
     std::stable_sort(outputs.begin(), outputs.end(),
                      [] (const OutputHelper *o1, const OutputHelper *o2) {
-        return o2->output()->depends().contains(o1->output());
+        return o2->output()->depends().contains(o1->output())
+               || o2->output()->mirrorSource() == o1->output();
     });
 }
 
-QVector<std::pair<OutputHelper*, WBufferRenderer*>>
-WOutputRenderWindowPrivate::doRenderOutputs(const QList<OutputHelper*> &outputs, bool forceRender)
+QVector<OutputHelper*>
+WOutputRenderWindowPrivate::beginRenderOutputs(const QList<OutputHelper*> &outputs, bool forceRender,
+                                               QVector<OutputHelper*> *needsRender)
 {
     QVector<OutputHelper*> renderResults;
     renderResults.reserve(outputs.size());
+    auto stats = activeFrameStats();
+    QElapsedTimer timer;
+
     for (OutputHelper *helper : std::as_const(outputs)) {
         if (Q_LIKELY(!forceRender)) {
             if (!helper->renderable()
+                || helper->isWaitingForDeadline()
                 || Q_UNLIKELY(!WOutputViewportPrivate::get(helper->output())->renderable())
                 || !helper->output()->output()->isEnabled())
                 continue;
@@ -1395,31 +2066,130 @@ WOutputRenderWindowPrivate::doRenderOutputs(const QList<OutputHelper*> &outputs,
 
         Q_ASSERT(helper->output()->output()->scale() <= helper->output()->devicePixelRatio());
 
-        const auto &format = helper->qwoutput()->handle()->render_format;
-        const auto renderMatrix = helper->output()->renderMatrix();
-
-        // maybe using the other WOutputViewport's QSGTextureProvider
-        if (!helper->output()->depends().isEmpty())
-            updateDirtyNodes();
+        if (stats) {
+            stats->setRefreshRate(helper->output(), helper->qwoutput()->handle()->refresh);
+            timer.start();
+        }
 
-        qw_buffer *buffer = helper->beginRender(helper->bufferRenderer(), helper->output()->output()->size(), format,
-                                                WBufferRenderer::RedirectOpenGLContextDefaultFrameBufferObject);
-        Q_ASSERT(buffer == helper->bufferRenderer()->currentBuffer());
-        if (buffer) {
-            helper->render(helper->bufferRenderer(), 0, renderMatrix,
-                           helper->output()->effectiveSourceRect(),
-                           helper->output()->targetRect(),
-                           helper->output()->preserveColorContents());
+        if (auto source = helper->mirrorSource()) {
+            // Rendered after the source in afterRenderOutputs
+            helper->clearScanout();
+            helper->setPendingMirror(source);
+        } else {
+            bool isScanout = false;
+            if (Q_LIKELY(!forceRender))
+                isScanout = helper->tryScanout();
+            else // The forced render wants the contents of the primary buffer
+                helper->clearScanout();
+
+            if (!isScanout && helper->beginRenderPrimaryBuffer())
+                needsRender->append(helper);
         }
         renderResults.append(helper);
+
+        if (stats)
+            stats->addTime(WFrameStats::Render, timer.nsecsElapsed(), helper->output());
     }
 
+    return renderResults;
+}
+
+void WOutputRenderWindowPrivate::renderOutputs(const QVector<OutputHelper*> &needsRender)
+{
+    QVector<qint64> renderTimes;
+    renderPrimaryBuffers(needsRender, canRenderInParallel(needsRender), &renderTimes);
+
+    if (auto stats = activeFrameStats()) {
+        for (int i = 0; i < needsRender.size(); ++i)
+            stats->addTime(WFrameStats::Render, renderTimes.at(i), needsRender.at(i)->output());
+    }
+}
+
+// Maybe called in the render thread, only the primary buffers are rendered in here,
+// the layers and the commits are handled in afterRenderOutputs in the GUI thread.
+void WOutputRenderWindowPrivate::renderPrimaryBuffers(const QVector<OutputHelper*> &needsRender,
+                                                      bool parallel, QVector<qint64> *renderTimes)
+{
+    renderTimes->resize(needsRender.size());
+
+    auto renderOutput = [&needsRender, renderTimes] (int index) {
+        QElapsedTimer timer;
+        timer.start();
+        needsRender.at(index)->renderPrimaryBuffer();
+        (*renderTimes)[index] = timer.nsecsElapsed();
+        // Set by pushRenderer in the render thread
+        threadRenderer = {};
+    };
+
+    if (!parallel) {
+        for (int i = 0; i < needsRender.size(); ++i)
+            renderOutput(i);
+        return;
+    }
+
+    if (!renderThreadPool) {
+        renderThreadPool = new QThreadPool(q_func());
+        renderThreadPool->setObjectName(QStringLiteral("WaylibRenderThreadPool"));
+    }
+
+    // The glyph caches of the fonts are shared by the outputs
+    for (auto helper : needsRender)
+        helper->bufferRenderer()->state.flags |= WBufferRenderer::ConcurrentRendering;
+
+    inParallelRendering = true;
+    // The first output is rendered in the current thread
+    for (int i = 1; i < needsRender.size(); ++i) {
+        renderThreadPool->start([&renderOutput, i] {
+            renderOutput(i);
+        });
+    }
+
+    renderOutput(0);
+    renderThreadPool->waitForDone();
+    inParallelRendering = false;
+}
+
+QVector<std::pair<OutputHelper*, WBufferRenderer*>>
+WOutputRenderWindowPrivate::afterRenderOutputs(const QVector<OutputHelper*> &renderResults)
+{
+    auto stats = activeFrameStats();
+    QElapsedTimer timer;
+
     QVector<std::pair<OutputHelper*, WBufferRenderer*>> needsCommit;
     needsCommit.reserve(renderResults.size());
-    for (auto helper : std::as_const(renderResults)) {
+    // The buffer of the source in this frame, or nullptr if it's not rendered
+    auto sourceRenderer = [&needsCommit] (const OutputHelper *source) -> WBufferRenderer* {
+        for (const auto &i : std::as_const(needsCommit)) {
+            if (i.first == source)
+                return i.second;
+        }
+        return nullptr;
+    };
+
+    for (auto helper : renderResults) {
+        if (stats)
+            timer.start();
+
+        OutputHelper *mirrorSource = helper->takePendingMirror();
+        if (mirrorSource)
+            helper->renderMirror(mirrorSource, sourceRenderer(mirrorSource), true);
+
+        const bool isScanout = helper->isScanout();
         auto bufferRenderer = helper->afterRender();
+        if (isScanout && !helper->isScanout()) {
+            // Fallback to composite the layers in the primary buffer
+            if (mirrorSource)
+                helper->renderMirror(mirrorSource, sourceRenderer(mirrorSource), false);
+            else if (helper->beginRenderPrimaryBuffer())
+                helper->renderPrimaryBuffer();
+            bufferRenderer = helper->afterRender();
+        }
+
         if (bufferRenderer)
             needsCommit.append({helper, bufferRenderer});
+
+        if (stats)
+            stats->addTime(WFrameStats::Composite, timer.nsecsElapsed(), helper->output());
     }
 
     rendererList.clear();
@@ -1427,6 +2197,168 @@ WOutputRenderWindowPrivate::doRenderOutputs(const QList<OutputHelper*> &outputs,
     return needsCommit;
 }
 
+bool WOutputRenderWindowPrivate::canTrackItemDamages() const
+{
+    if (pendingWholeDamage)
+        return false;
+
+    // The animators update the scene graph nodes directly, the items are not marked dirty.
+    if (!animationController->m_runningAnimators.isEmpty())
+        return false;
+
+    auto hasItemDamage = [this] (const QQuickItem *item) {
+        for (const auto &damage : std::as_const(pendingItemDamages)) {
+            if (damage.item == item)
+                return true;
+        }
+        return false;
+    };
+
+    // Only the contents of the items reported by addDamage are changed
+    for (QQuickItem *item = dirtyItemList; item; item = QQuickItemPrivate::get(item)->nextDirtyItem) {
+        if (QQuickItemPrivate::get(item)->dirtyAttributes != QQuickItemPrivate::Content)
+            return false;
+        if (!hasItemDamage(item))
+            return false;
+    }
+
+    for (const auto &damage : std::as_const(pendingItemDamages)) {
+        // The contents of the item maybe displayed by the other items, e.g. the item
+        // layer, ShaderEffectSource, WQuickTextureProxy and WBufferRenderer.
+        for (QQuickItem *item = damage.item; item; item = item->parentItem()) {
+            auto d = QQuickItemPrivate::get(item);
+            if (d->extra.isAllocated() && d->extra->effectRefCount > 0)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void WOutputRenderWindowPrivate::commitItemDamages(bool tracked)
+{
+    FrameDamage frame {
+        .serial = ++damageSerial,
+        .tracked = tracked,
+    };
+
+    if (tracked)
+        std::swap(frame.items, pendingItemDamages);
+    pendingItemDamages.clear();
+    pendingWholeDamage = false;
+
+    frameDamages.append(std::move(frame));
+    // The outputs with different refresh rate maybe miss some frames
+    while (frameDamages.size() > 8)
+        frameDamages.removeFirst();
+}
+
+// The source items of the outputs
+QList<QQuickItem*> WOutputRenderWindowPrivate::sceneRoots() const
+{
+    QList<QQuickItem*> roots;
+    for (OutputHelper *helper : std::as_const(outputs)) {
+        QQuickItem *root = helper->output()->input();
+        if (!root)
+            root = contentItem;
+        if (!roots.contains(root))
+            roots.append(root);
+    }
+
+    return roots;
+}
+
+void WOutputRenderWindowPrivate::prepareMirrors()
+{
+    for (OutputHelper *helper : std::as_const(outputs)) {
+        if (auto source = helper->mirrorSource())
+            helper->prepareMirror(source);
+        else
+            helper->cleanMirror();
+    }
+}
+
+void WOutputRenderWindowPrivate::updateOcclusion()
+{
+    const qreal max = std::numeric_limits<int>::max();
+    const QRectF unbounded(QPointF(-max, -max), QPointF(max, max));
+
+    QList<std::pair<QQuickItem*, QRectF>> roots;
+    for (OutputHelper *helper : std::as_const(outputs)) {
+        // The mirror shows the scene of its source
+        if (helper->mirrorSource())
+            continue;
+
+        WOutputViewport *viewport = helper->output();
+        QQuickItem *root = viewport->input();
+        if (!root)
+            root = contentItem;
+
+        // The part of the scene shown by the output, in the window coordinates
+        QRectF rect = unbounded;
+        bool invertible = false;
+        const QMatrix4x4 matrix = viewport->mapToViewport(root).inverted(&invertible);
+        if (invertible && matrix.toTransform().isAffine()) {
+            rect = matrix.mapRect(viewport->effectiveSourceRect());
+            rect = QQuickItemPrivate::get(root)->itemToWindowTransform().mapRect(rect);
+        }
+
+        const std::pair<QQuickItem*, QRectF> pair(root, rect);
+        if (!roots.contains(pair))
+            roots.append(pair);
+    }
+
+    WQuickOcclusionCuller::get(q_func())->update(roots);
+}
+
+// Only the hardware cursors are moved, the position of the cursor plane is updated
+// directly, without polishing, synchronizing and rendering the scene.
+bool WOutputRenderWindowPrivate::moveHardwareCursors()
+{
+    if (!cursorFastPathEnabled() || !dirtyItemList || !itemsToPolish.isEmpty()
+        || pendingWholeDamage || !pendingItemDamages.isEmpty()
+        || !animationController->m_runningAnimators.isEmpty()) {
+        return false;
+    }
+
+    QList<std::pair<OutputHelper*, OutputHelper::LayerData*>> cursors;
+    QList<QQuickItem*> items;
+    for (QQuickItem *item = dirtyItemList; item; item = QQuickItemPrivate::get(item)->nextDirtyItem) {
+        if (QQuickItemPrivate::get(item)->dirtyAttributes != QQuickItemPrivate::Position)
+            return false;
+
+        bool isCursor = false;
+        for (OutputHelper *helper : std::as_const(outputs)) {
+            for (auto layer : helper->layers()) {
+                if (layer->layer->layer->parent() != item)
+                    continue;
+                // The cursor is composited by software on this output
+                if (helper->hardwareCursorLayer() != layer)
+                    return false;
+                cursors.append({helper, layer});
+                isCursor = true;
+            }
+        }
+
+        if (!isCursor)
+            return false;
+        items.append(item);
+    }
+
+    for (const auto &i : std::as_const(cursors)) {
+        if (!i.first->moveHardwareCursor(i.second))
+            return false;
+    }
+
+    // Keep them out of the dirty list, otherwise the next moving will not request update
+    for (auto item : std::as_const(items)) {
+        QQuickItemPrivate::get(item)->removeFromDirtyList();
+        movedCursorItems.append(item);
+    }
+
+    return true;
+}
+
 // ###: QQuickAnimatorController::advance symbol not export
 static void QQuickAnimatorController_advance(QQuickAnimatorController *ac)
 {
@@ -1448,26 +2380,90 @@ static void QQuickAnimatorController_advance(QQuickAnimatorController *ac)
 void WOutputRenderWindowPrivate::doRender(const QList<OutputHelper *> &outputs,
                                           bool forceRender, bool doCommit)
 {
+    if (threadedFrame) {
+        if (!forceRender) {
+            // Render again after the current frame is committed
+            threadedFrame->renderRequested = true;
+            return;
+        }
+
+        // The forced render wants the results of rendering synchronously
+        finishThreadedRender(threadedFrame->serial);
+    }
+
+    if (!forceRender && moveHardwareCursors())
+        return;
+
     Q_ASSERT(rendererList.isEmpty());
     Q_ASSERT(!inRendering);
     inRendering = true;
+    frameTimer.start();
 
     W_Q(WOutputRenderWindow);
+    auto stats = activeFrameStats();
+    QElapsedTimer timer;
+    if (stats) {
+        stats->beginFrame();
+        timer.start();
+    }
+
     for (OutputLayer *layer : std::as_const(layers)) {
         layer->beforeRender(q);
     }
 
+    for (const auto &item : std::exchange(movedCursorItems, {})) {
+        if (item)
+            QQuickItemPrivate::get(item)->dirty(QQuickItemPrivate::Position);
+    }
+
     rc()->polishItems();
+    // The mirror proxies are synchronized with the other items
+    prepareMirrors();
+    // The dirty list is cleared in synchronizing
+    if (auto index = q->findChild<WQuickHitTestIndex*>(QString(), Qt::FindDirectChildrenOnly))
+        index->updateDirtyItems();
+    // Before checking the item damages, the culled items are changed
+    if (occlusionCullingEnabled())
+        updateOcclusion();
+    // The items of the changed layers are marked dirty
+    if (autoLayerization)
+        WQuickAutoLayerizer::get(q)->update(sceneRoots(), dirtyItemList);
+    const bool itemDamagesTracked = canTrackItemDamages();
+    if (stats)
+        stats->addTime(WFrameStats::Polish, timer.restart());
 
     if (QSGRendererInterface::isApiRhiBased(WRenderHelper::getGraphicsApi()))
         rc()->beginFrame();
     rc()->sync();
+    // If any item is marked dirty in synchronizing, it maybe using the changed
+    // textures of the damaged items, e.g. ShaderEffect.
+    commitItemDamages(itemDamagesTracked && !dirtyItemList);
 
     QQuickAnimatorController_advance(animationController.get());
+    if (stats)
+        stats->addTime(WFrameStats::Sync, timer.restart());
+
     Q_EMIT q->beforeRendering();
     runAndClearJobs(&beforeRenderingJobs);
 
-    auto needsCommit = doRenderOutputs(outputs, forceRender);
+    QVector<OutputHelper*> needsRender;
+    const auto renderResults = beginRenderOutputs(outputs, forceRender, &needsRender);
+
+    if (doCommit && !forceRender && canRenderInThread(renderResults, needsRender)) {
+        startThreadedRender(renderResults, needsRender);
+        return;
+    }
+
+    renderOutputs(needsRender);
+    endRender(afterRenderOutputs(renderResults), doCommit);
+}
+
+void WOutputRenderWindowPrivate::endRender(const QVector<std::pair<OutputHelper*, WBufferRenderer*>> &needsCommit,
+                                           bool doCommit)
+{
+    W_Q(WOutputRenderWindow);
+    auto stats = activeFrameStats();
+    QElapsedTimer timer;
 
     Q_EMIT q->afterRendering();
     runAndClearJobs(&afterRenderingJobs);
@@ -1477,13 +2473,20 @@ void WOutputRenderWindowPrivate::doRender(const QList<OutputHelper *> &outputs,
 
     if (doCommit) {
         for (auto i : std::as_const(needsCommit)) {
+            if (stats)
+                timer.start();
+
             bool ok = i.first->commit(i.second);
+            if (stats)
+                stats->addTime(WFrameStats::Commit, timer.nsecsElapsed(), i.first->output());
 
             if (i.second->currentBuffer()) {
                 i.second->endRender();
             }
 
             i.first->resetState(ok);
+            if (ok)
+                i.first->addFrameTime(frameTimer.nsecsElapsed());
         }
     }
 
@@ -1498,9 +2501,139 @@ void WOutputRenderWindowPrivate::doRender(const QList<OutputHelper *> &outputs,
         glContext->doneCurrent();
 
     inRendering = false;
+    if (stats)
+        stats->endFrame();
     Q_EMIT q->renderEnd();
 }
 
+bool WOutputRenderWindowPrivate::canRenderInThread(const QVector<OutputHelper*> &renderResults,
+                                                   const QVector<OutputHelper*> &needsRender) const
+{
+    // The wlr_renderer and QtQuick share the same OpenGL context or Vulkan queue, and
+    // wlroots uses it in the GUI thread, only the software renderer has no shared state.
+    if (!threadedRendering || needsRender.isEmpty()
+        || graphicsApi() != QSGRendererInterface::Software) {
+        return false;
+    }
+
+    // The mirrors are rendered after their sources in the same frame, the items maybe
+    // changed by the GUI thread before the threaded frame is finished.
+    for (auto helper : renderResults) {
+        if (helper->hasPendingMirror())
+            return false;
+    }
+
+    for (auto helper : needsRender) {
+        // The textures of the cached buffers are updated in rendering, and they're
+        // used by the other outputs in the same frame.
+        if (!helper->output()->depends().isEmpty() || helper->bufferRenderer()->shouldCacheBuffer())
+            return false;
+    }
+
+    return true;
+}
+
+bool WOutputRenderWindowPrivate::canRenderInParallel(const QVector<OutputHelper*> &needsRender) const
+{
+    // Only the software renderer, QRhi and the wlr_renderer can't be used by multiple threads
+    if (!parallelRendering || needsRender.size() < 2
+        || graphicsApi() != QSGRendererInterface::Software) {
+        return false;
+    }
+
+    QList<QQuickItem*> sources;
+    for (auto helper : needsRender) {
+        if (!helper->output()->depends().isEmpty() || helper->bufferRenderer()->shouldCacheBuffer())
+            return false;
+        sources.append(helper->bufferRenderer()->sourceList());
+    }
+
+    // The scene graph nodes are updated in rendering (e.g. the combined matrix and the
+    // transform of the root node), so the outputs must not render the same nodes.
+    for (int i = 0; i < sources.size(); ++i) {
+        // The window's contentItem, its transform is changed for each output
+        if (!sources.at(i))
+            return false;
+
+        for (int j = i + 1; j < sources.size(); ++j) {
+            if (sources.at(i) == sources.at(j)
+                || sources.at(i)->isAncestorOf(sources.at(j))
+                || sources.at(j)->isAncestorOf(sources.at(i))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void WOutputRenderWindowPrivate::startThreadedRender(const QVector<OutputHelper*> &renderResults,
+                                                     const QVector<OutputHelper*> &needsRender)
+{
+    W_Q(WOutputRenderWindow);
+    Q_ASSERT(!threadedFrame);
+
+    if (!renderThread) {
+        renderThread = new QThread(q);
+        renderThread->setObjectName(QStringLiteral("WaylibRenderThread"));
+        renderThread->start();
+        renderThreadUtil.reset(new WThreadUtil(renderThread));
+    }
+
+    threadedFrame.reset(new ThreadedFrame);
+    auto frame = threadedFrame.get();
+    frame->serial = ++threadedFrameSerial;
+    frame->renderResults = renderResults;
+    frame->needsRender = needsRender;
+    // The items can't be accessed in the render thread
+    frame->parallel = canRenderInParallel(needsRender);
+    // The glyph caches of the fonts maybe used in the GUI thread at the same time
+    for (auto helper : needsRender)
+        helper->bufferRenderer()->state.flags |= WBufferRenderer::ConcurrentRendering;
+
+    // The GUI thread goes back to the event loop, but the scene graph can't be
+    // synchronized until the frame is finished.
+    inRendering = false;
+
+    frame->future = renderThreadUtil->run([this, frame] {
+        renderPrimaryBuffers(frame->needsRender, frame->parallel, &frame->renderTimes);
+
+        // Commit the buffers in the GUI thread, the wlroots objects can't be used in here
+        WThreadUtil::gui().run(q_func(), [this, serial = frame->serial] {
+            finishThreadedRender(serial);
+        });
+    });
+}
+
+void WOutputRenderWindowPrivate::finishThreadedRender(quint64 serial)
+{
+    // Maybe the frame is already finished by a forced render
+    if (!threadedFrame || threadedFrame->serial != serial)
+        return;
+
+    threadedFrame->future.waitForFinished();
+    std::unique_ptr<ThreadedFrame> frame = std::move(threadedFrame);
+    Q_ASSERT(!inRendering);
+    inRendering = true;
+
+    if (auto stats = activeFrameStats()) {
+        for (int i = 0; i < frame->needsRender.size(); ++i)
+            stats->addTime(WFrameStats::Render, frame->renderTimes.at(i), frame->needsRender.at(i)->output());
+    }
+
+    endRender(afterRenderOutputs(frame->renderResults), true);
+
+    // The items maybe changed when the render thread is running
+    if (frame->renderRequested)
+        q_func()->update();
+}
+
+void WOutputRenderWindowPrivate::waitForRenderThread()
+{
+    if (threadedFrame)
+        finishThreadedRender(threadedFrame->serial);
+}
+
 // TODO: Support QWindow::setCursor
 WOutputRenderWindow::WOutputRenderWindow(QObject *parent)
     : QQuickWindow(*new WOutputRenderWindowPrivate(this), new RenderControl())
@@ -1518,10 +2651,20 @@ WOutputRenderWindow::WOutputRenderWindow(QObject *parent)
     // see [QQuickApplicationWindow](qt6/qtdeclarative/src/quicktemplates/qquickapplicationwindow.cpp)
     contentItem()->setFlag(QQuickItem::ItemIsFocusScope);
     contentItem()->setFocus(true);
+
+    Q_D(WOutputRenderWindow);
+    d->frameStats = new WFrameStats(this);
 }
 
 WOutputRenderWindow::~WOutputRenderWindow()
 {
+    Q_D(WOutputRenderWindow);
+    d->waitForRenderThread();
+    if (d->renderThread) {
+        d->renderThread->quit();
+        d->renderThread->wait();
+    }
+
     renderControl()->disconnect(this);
     renderControl()->invalidate();
     renderControl()->deleteLater();
@@ -1589,12 +2732,15 @@ void WOutputRenderWindow::detach(WOutputViewport *output)
         return;
 
     Q_D(WOutputRenderWindow);
+    // The output helper maybe used by the render thread
+    d->waitForRenderThread();
 
     int index = d->indexOfOutputHelper(output);
     Q_ASSERT(index >= 0);
 
     auto outputHelper = d->outputs.takeAt(index);
     const auto hasLayer = !outputHelper->layers().isEmpty();
+    d->frameStats->removeOutput(output);
     outputHelper->invalidate();
     outputHelper->deleteLater();
 
@@ -1771,6 +2917,10 @@ qw_allocator *WOutputRenderWindow::allocator() const
 
 WBufferRenderer *WOutputRenderWindow::currentRenderer() const
 {
+    const auto &threadRenderer = WOutputRenderWindowPrivate::threadRenderer;
+    if (threadRenderer.window == this && threadRenderer.renderer)
+        return threadRenderer.renderer;
+
     Q_D(const WOutputRenderWindow);
     return d->rendererList.isEmpty() ? nullptr : d->rendererList.top();
 }
@@ -1817,6 +2967,152 @@ void WOutputRenderWindow::setDisableLayers(bool newDisableLayers)
     Q_EMIT disableLayersChanged();
 }
 
+bool WOutputRenderWindow::threadedRendering() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->threadedRendering;
+}
+
+void WOutputRenderWindow::setThreadedRendering(bool newThreadedRendering)
+{
+    Q_D(WOutputRenderWindow);
+    if (d->threadedRendering == newThreadedRendering)
+        return;
+    d->waitForRenderThread();
+    d->threadedRendering = newThreadedRendering;
+    Q_EMIT threadedRenderingChanged();
+}
+
+bool WOutputRenderWindow::parallelRendering() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->parallelRendering;
+}
+
+void WOutputRenderWindow::setParallelRendering(bool newParallelRendering)
+{
+    Q_D(WOutputRenderWindow);
+    if (d->parallelRendering == newParallelRendering)
+        return;
+    d->waitForRenderThread();
+    d->parallelRendering = newParallelRendering;
+    Q_EMIT parallelRenderingChanged();
+}
+
+bool WOutputRenderWindow::adaptiveFrameScheduling() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->adaptiveFrameScheduling;
+}
+
+void WOutputRenderWindow::setAdaptiveFrameScheduling(bool newAdaptiveFrameScheduling)
+{
+    Q_D(WOutputRenderWindow);
+    if (d->adaptiveFrameScheduling == newAdaptiveFrameScheduling)
+        return;
+    d->adaptiveFrameScheduling = newAdaptiveFrameScheduling;
+
+    if (!newAdaptiveFrameScheduling) {
+        // Don't wait for the deadline, render the pending frames now
+        for (auto helper : std::as_const(d->outputs))
+            helper->cancelDeadline();
+        d->scheduleDoRender();
+    }
+
+    Q_EMIT adaptiveFrameSchedulingChanged();
+}
+
+int WOutputRenderWindow::softwareRenderThreads() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->softwareRenderThreads;
+}
+
+void WOutputRenderWindow::setSoftwareRenderThreads(int newSoftwareRenderThreads)
+{
+    Q_D(WOutputRenderWindow);
+    newSoftwareRenderThreads = qMax(1, newSoftwareRenderThreads);
+    if (d->softwareRenderThreads == newSoftwareRenderThreads)
+        return;
+    d->softwareRenderThreads = newSoftwareRenderThreads;
+    Q_EMIT softwareRenderThreadsChanged();
+}
+
+bool WOutputRenderWindow::autoLayerization() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->autoLayerization;
+}
+
+void WOutputRenderWindow::setAutoLayerization(bool newAutoLayerization)
+{
+    Q_D(WOutputRenderWindow);
+    if (d->autoLayerization == newAutoLayerization)
+        return;
+    d->autoLayerization = newAutoLayerization;
+
+    if (!newAutoLayerization)
+        WQuickAutoLayerizer::get(this)->clear();
+    update();
+
+    Q_EMIT autoLayerizationChanged();
+}
+
+WFrameStats *WOutputRenderWindow::frameStats() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->frameStats;
+}
+
+void WOutputRenderWindow::addDamage(QQuickItem *item, const QRegion &region)
+{
+    Q_D(WOutputRenderWindow);
+    Q_ASSERT(item && item->window() == this);
+
+    if (region.isEmpty())
+        return;
+
+    for (auto &damage : d->pendingItemDamages) {
+        if (damage.item == item) {
+            damage.region += region;
+            return;
+        }
+    }
+
+    d->pendingItemDamages.append({item, region});
+}
+
+quint64 WOutputRenderWindow::damageSerial() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->damageSerial;
+}
+
+bool WOutputRenderWindow::itemDamages(quint64 sinceSerial, QList<std::pair<QQuickItem*, QRegion>> *damages) const
+{
+    Q_D(const WOutputRenderWindow);
+
+    // Never rendered, or missed the frames that are dropped from history
+    if (sinceSerial == 0 || d->frameDamages.isEmpty()
+        || d->frameDamages.first().serial > sinceSerial + 1) {
+        return false;
+    }
+
+    for (const auto &frame : std::as_const(d->frameDamages)) {
+        if (frame.serial <= sinceSerial)
+            continue;
+        if (!frame.tracked)
+            return false;
+
+        for (const auto &damage : std::as_const(frame.items)) {
+            if (damage.item)
+                damages->append({damage.item.get(), damage.region});
+        }
+    }
+
+    return true;
+}
+
 void WOutputRenderWindow::render()
 {
     Q_D(WOutputRenderWindow);
@@ -1896,6 +3192,10 @@ void WOutputRenderWindow::markItemClipRectDirty(QQuickItem *item)
         QPointer<QQuickItem> item;
     };
 
+    // The clip node is updated without the item marked dirty
+    Q_D(WOutputRenderWindow);
+    d->pendingWholeDamage = true;
+
     // Delay clean the qt rhi textures.
     scheduleRenderJob(new MarkItemClipRectDirtyJob(item),
                       QQuickWindow::AfterSynchronizingStage);
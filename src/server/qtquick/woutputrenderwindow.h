@@ -11,12 +11,14 @@
 #include <QQmlParserStatus>
 
 Q_MOC_INCLUDE(<wquickoutputlayout.h>)
+Q_MOC_INCLUDE(<wframestats.h>)
 
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
 class WOutputViewport;
 class WOutputLayer;
 class WBufferRenderer;
+class WFrameStats;
 class WOutputRenderWindowPrivate;
 class WAYLIB_SERVER_EXPORT WOutputRenderWindow : public QQuickWindow, public QQmlParserStatus
 {
@@ -25,6 +27,12 @@ class WAYLIB_SERVER_EXPORT WOutputRenderWindow : public QQuickWindow, public QQm
     Q_PROPERTY(qreal width READ width WRITE setWidth NOTIFY widthChanged)
     Q_PROPERTY(qreal height READ height WRITE setHeight NOTIFY heightChanged)
     Q_PROPERTY(bool disableLayers READ disableLayers WRITE setDisableLayers NOTIFY disableLayersChanged FINAL)
+    Q_PROPERTY(bool threadedRendering READ threadedRendering WRITE setThreadedRendering NOTIFY threadedRenderingChanged FINAL)
+    Q_PROPERTY(bool parallelRendering READ parallelRendering WRITE setParallelRendering NOTIFY parallelRenderingChanged FINAL)
+    Q_PROPERTY(bool adaptiveFrameScheduling READ adaptiveFrameScheduling WRITE setAdaptiveFrameScheduling NOTIFY adaptiveFrameSchedulingChanged FINAL)
+    Q_PROPERTY(int softwareRenderThreads READ softwareRenderThreads WRITE setSoftwareRenderThreads NOTIFY softwareRenderThreadsChanged FINAL)
+    Q_PROPERTY(bool autoLayerization READ autoLayerization WRITE setAutoLayerization NOTIFY autoLayerizationChanged FINAL)
+    Q_PROPERTY(WFrameStats* frameStats READ frameStats CONSTANT FINAL)
     QML_NAMED_ELEMENT(OutputRenderWindow)
     Q_INTERFACES(QQmlParserStatus)
 
@@ -60,6 +68,35 @@ public:
     bool disableLayers() const;
     void setDisableLayers(bool newDisableLayers);
 
+    // Render the scene graph in a separate thread, only supported by the software renderer.
+    // The scene is synchronized in the GUI thread, and the buffers are committed in the
+    // GUI thread after the render thread finished.
+    bool threadedRendering() const;
+    void setThreadedRendering(bool newThreadedRendering);
+
+    // Render the primary buffers of the outputs in a thread pool, only supported by the
+    // software renderer, and the outputs must not share their source items.
+    bool parallelRendering() const;
+    void setParallelRendering(bool newParallelRendering);
+
+    // Delay rendering after the frame event until the predicted deadline of the refresh
+    // cycle (the p95 of the recent frame times), to reduce the latency of the client commits.
+    bool adaptiveFrameScheduling() const;
+    void setAdaptiveFrameScheduling(bool newAdaptiveFrameScheduling);
+
+    // The number of the threads painting the tiles of the damaged region, only supported
+    // by the software renderer, 1 to paint in the render thread only.
+    int softwareRenderThreads() const;
+    void setSoftwareRenderThreads(int newSoftwareRenderThreads);
+
+    // Render the subtrees not changed in the recent frames into the textures, and draw
+    // them as single quads until they're changed, see WQuickAutoLayerizer.
+    bool autoLayerization() const;
+    void setAutoLayerization(bool newAutoLayerization);
+
+    WFrameStats *frameStats() const;
+    void addDamage(QQuickItem *item, const QRegion &region);
+
 public Q_SLOTS:
     void render();
     void render(WOutputViewport *output, bool doCommit);
@@ -76,6 +113,11 @@ Q_SIGNALS:
     void outputViewportInitialized(WAYLIB_SERVER_NAMESPACE::WOutputViewport *output);
     void initialized();
     void disableLayersChanged();
+    void threadedRenderingChanged();
+    void parallelRenderingChanged();
+    void adaptiveFrameSchedulingChanged();
+    void softwareRenderThreadsChanged();
+    void autoLayerizationChanged();
     void renderEnd();
 
 private:
@@ -87,6 +129,10 @@ private:
     friend class WOutputViewport;
     QList<WOutputLayer*> layers(const WOutputViewport *output) const;
     QList<WOutputLayer*> hardwareLayers(const WOutputViewport *output) const;
+
+    friend class WBufferRenderer;
+    quint64 damageSerial() const;
+    bool itemDamages(quint64 sinceSerial, QList<std::pair<QQuickItem*, QRegion>> *damages) const;
 };
 
 WAYLIB_SERVER_END_NAMESPACE
@@ -6,9 +6,13 @@
 #include "woutput.h"
 #include "wsgtextureprovider.h"
 #include "wbufferrenderer_p.h"
+#include "wsurfaceitem.h"
+#include "wsurface.h"
 
 #include <qwbuffer.h>
 #include <qwswapchain.h>
+#include <qwcompositor.h>
+#include <qwbox.h>
 
 #include <QDebug>
 #include <private/qquickitem_p.h>
@@ -81,7 +85,9 @@ void WOutputViewportPrivate::updateRenderBufferSource()
 
     QList<QQuickItem*> sources;
 
-    if (input) {
+    if (mirrorRenderSource) {
+        sources.append(mirrorRenderSource);
+    } else if (input) {
         sources.append(input);
     } else {
         // the "nullptr" is on behalf of the window's contentItem
@@ -103,6 +109,120 @@ void WOutputViewportPrivate::setExtraRenderSource(QQuickItem *source)
     updateRenderBufferSource();
 }
 
+void WOutputViewportPrivate::setMirrorRenderSource(QQuickItem *source)
+{
+    if (mirrorRenderSource == source)
+        return;
+    mirrorRenderSource = source;
+    updateRenderBufferSource();
+}
+
+// Keep the same order with QSGRenderer, the item painted later is tested first
+static QQuickItem *topmostContentItem(QQuickItem *item, const WOutputViewport *viewport,
+                                      const QRectF &outputRect)
+{
+    auto d = QQuickItemPrivate::get(item);
+    if (item == viewport || !item->isVisible() || d->culled || qFuzzyIsNull(item->opacity()))
+        return nullptr;
+    // The items of the accepted output layers are not painted in the primary buffer
+    if (d->extra.isAllocated() && d->extra->hideRefCount > 0)
+        return nullptr;
+
+    const QRectF rect = viewport->mapToOutput(item, item->boundingRect());
+    if (item->clip() && !rect.intersects(outputRect))
+        return nullptr;
+
+    const auto children = d->paintOrderChildItems();
+    int i = children.size() - 1;
+    for (; i >= 0 && children.at(i)->z() >= 0; --i) {
+        if (auto topmost = topmostContentItem(children.at(i), viewport, outputRect))
+            return topmost;
+    }
+
+    // The contents of an empty item maybe painted outside of its bounding rect
+    if (item->flags().testFlag(QQuickItem::ItemHasContents)
+        && (rect.isEmpty() || rect.intersects(outputRect))) {
+        return item;
+    }
+
+    for (; i >= 0; --i) {
+        if (auto topmost = topmostContentItem(children.at(i), viewport, outputRect))
+            return topmost;
+    }
+
+    return nullptr;
+}
+
+WSurfaceItemContent *WOutputViewportPrivate::scanoutCandidate() const
+{
+    W_QC(WOutputViewport);
+
+    if (!output || !window || offscreen || extraRenderSource || !depends.isEmpty() || mirrorSource)
+        return nullptr;
+    if (output->orientation() != WOutput::Normal)
+        return nullptr;
+
+    const QSize pixelSize = output->size();
+    const QRectF outputRect(QPointF(0, 0), QSizeF(pixelSize) / devicePixelRatio);
+    QQuickItem *root = input ? input : window->contentItem();
+    auto content = qobject_cast<WSurfaceItemContent*>(topmostContentItem(root, q, outputRect));
+    if (!content || !content->live())
+        return nullptr;
+
+    auto surface = content->surface();
+    if (!surface || !surface->mapped() || surface->orientation() != WLR::Transform::Normal)
+        return nullptr;
+    auto buffer = surface->buffer();
+    if (!buffer || QSize(buffer->handle()->width, buffer->handle()->height) != pixelSize)
+        return nullptr;
+
+    // The whole buffer must be displayed without cropping and scaling
+    qw_fbox sourceBox;
+    surface->handle()->get_buffer_source_box(sourceBox);
+    if (sourceBox.toQRectF() != QRectF(QPointF(0, 0), pixelSize))
+        return nullptr;
+
+    // The contents below the surface are invisible only if the surface is opaque
+    const auto &surfaceState = surface->handle()->handle()->current;
+    pixman_box32_t surfaceBox { 0, 0, surfaceState.width, surfaceState.height };
+    if (surfaceState.width <= 0 || surfaceState.height <= 0
+        || pixman_region32_contains_rectangle(&surface->handle()->handle()->opaque_region,
+                                              &surfaceBox) != PIXMAN_REGION_IN) {
+        return nullptr;
+    }
+
+    // Only the translation and the scaling can be done by the output
+    const QTransform transform = (q->mapToViewport(content)
+                                  * q->sourceRectToTargetRectTransfrom()).toTransform();
+    if (transform.type() > QTransform::TxScale || transform.m11() <= 0 || transform.m22() <= 0)
+        return nullptr;
+
+    const QRectF contentRect(content->ignoreBufferOffset() ? QPointF() : QPointF(content->bufferOffset()),
+                             content->size());
+    const QRectF contentOutputRect = transform.mapRect(contentRect);
+    // Allow the error less than half a pixel
+    const qreal epsilon = 0.5 / devicePixelRatio;
+    if (qAbs(contentOutputRect.left() - outputRect.left()) > epsilon
+        || qAbs(contentOutputRect.top() - outputRect.top()) > epsilon
+        || qAbs(contentOutputRect.right() - outputRect.right()) > epsilon
+        || qAbs(contentOutputRect.bottom() - outputRect.bottom()) > epsilon) {
+        return nullptr;
+    }
+
+    // The opacity and the effects of the ancestors are applied in the scene graph
+    for (QQuickItem *item = content; item && item != root->parentItem(); item = item->parentItem()) {
+        auto d = QQuickItemPrivate::get(item);
+        if (item->opacity() < 1.0)
+            return nullptr;
+        if (d->extra.isAllocated() && d->extra->effectRefCount > 0)
+            return nullptr;
+        if (item->clip() && !q->mapToOutput(item, item->boundingRect()).contains(outputRect))
+            return nullptr;
+    }
+
+    return content;
+}
+
 WOutputViewport::WOutputViewport(QQuickItem *parent)
     : QQuickItem(*new WOutputViewportPrivate(), parent)
 {
@@ -493,6 +613,26 @@ void WOutputViewport::setDepends(const QList<WOutputViewport *> &newDepends)
     Q_EMIT dependsChanged();
 }
 
+WOutputViewport *WOutputViewport::mirrorSource() const
+{
+    W_DC(WOutputViewport);
+    return d->mirrorSource;
+}
+
+void WOutputViewport::setMirrorSource(WOutputViewport *newMirrorSource)
+{
+    W_D(WOutputViewport);
+    if (d->mirrorSource == newMirrorSource)
+        return;
+    if (newMirrorSource == this) {
+        qmlWarning(this) << "The \"mirrorSource\" can't be the viewport itself.";
+        return;
+    }
+    d->mirrorSource = newMirrorSource;
+    d->update();
+    Q_EMIT mirrorSourceChanged();
+}
+
 void WOutputViewport::setOutputScale(float scale)
 {
     W_D(WOutputViewport);
@@ -35,6 +35,7 @@ class WAYLIB_SERVER_EXPORT WOutputViewport : public QQuickItem, public virtual W
     Q_PROPERTY(QList<WAYLIB_SERVER_NAMESPACE::WOutputLayer*> layers READ layers NOTIFY layersChanged FINAL)
     Q_PROPERTY(QList<WAYLIB_SERVER_NAMESPACE::WOutputLayer*> hardwareLayers READ hardwareLayers NOTIFY hardwareLayersChanged FINAL)
     Q_PROPERTY(QList<WAYLIB_SERVER_NAMESPACE::WOutputViewport*> depends READ depends WRITE setDepends NOTIFY dependsChanged FINAL)
+    Q_PROPERTY(WAYLIB_SERVER_NAMESPACE::WOutputViewport* mirrorSource READ mirrorSource WRITE setMirrorSource NOTIFY mirrorSourceChanged FINAL)
     QML_NAMED_ELEMENT(OutputViewport)
 
 public:
@@ -103,6 +104,15 @@ public:
     QList<WOutputViewport *> depends() const;
     void setDepends(const QList<WOutputViewport *> &newDepends);
 
+    // Displays the frames of the other viewport instead of rendering the input, the scene
+    // is rendered only once for all mirrors. The buffer of the source is attached to the
+    // output directly if the output can display it as is, otherwise it's scaled to fit
+    // the output and keeps the aspect ratio. The frames are not rotated, the outputs
+    // should have the same orientation. The frames with a mirror aren't rendered in the
+    // render thread of WOutputRenderWindow::threadedRendering.
+    WOutputViewport *mirrorSource() const;
+    void setMirrorSource(WOutputViewport *newMirrorSource);
+
 public Q_SLOTS:
     void setOutputScale(float scale);
     void rotateOutput(WOutput::Transform t);
@@ -126,6 +136,7 @@ Q_SIGNALS:
     void layersChanged();
     void hardwareLayersChanged();
     void dependsChanged();
+    void mirrorSourceChanged();
 
 private:
     void componentComplete() override;
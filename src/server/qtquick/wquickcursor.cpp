@@ -6,7 +6,6 @@
 #include "woutputitem.h"
 #include "wcursorimage.h"
 #include "wsgtextureprovider.h"
-#include "wimagebuffer.h"
 #include "wseat.h"
 #include "wsurfaceitem.h"
 #include "wrenderhelper.h"
@@ -32,17 +31,20 @@ public:
 
     }
 
-    void setImage(const QImage &image) {
-        if (image.isNull()) {
+    // The buffer is owned by the frame cache of WCursorImage and shared with other
+    // cursors, so only the changed buffer needs to be uploaded.
+    void setCursorBuffer(qw_buffer *buffer) {
+        if (this->buffer.get() == buffer)
+            return;
+
+        if (!buffer) {
             resetBuffer();
             return;
         }
 
-        // WImageBufferImpl destroy following qw_buffer
-        auto buffer = qw_buffer::create(new WImageBufferImpl(image),
-                                       image.width(), image.height());
+        buffer->lock();
         this->buffer.reset(buffer);
-        setBuffer(this->buffer.get());
+        setBuffer(buffer);
     }
 
     void setProxy(WSGTextureProvider *proxy) {
@@ -89,7 +91,7 @@ public:
         return WSGTextureProvider::qwBuffer();
     }
 
-    std::unique_ptr<qw_buffer, qw_buffer::droper> buffer;
+    std::unique_ptr<qw_buffer, qw_buffer::unlocker> buffer;
     QPointer<WSGTextureProvider> proxy;
 };
 
@@ -138,6 +140,7 @@ public:
     void enterOutput(WOutput *output);
     void leaveOutput(WOutput *output);
     void updateXCursorManager();
+    void updateCursorScale();
     void onImageChanged();
     void updateCursor();
     void updateImplicitSize();
@@ -153,6 +156,7 @@ public:
 
     WCursor *cursor = nullptr;
     QPointer<WOutput> output;
+    QMetaObject::Connection outputScaleConnection;
     WCursorImage *cursorImage = nullptr;
 
     QPointer<WSurfaceItemContent> cursorSurfaceItem;
@@ -266,7 +270,17 @@ void WQuickCursorPrivate::leaveOutput(WOutput *output)
 void WQuickCursorPrivate::updateXCursorManager()
 {
     cursorImage->setCursorTheme(xcursorThemeName.toLatin1(), getCursorSize());
-    cursorImage->setScale(window ? window->effectiveDevicePixelRatio() : 1.0);
+    updateCursorScale();
+}
+
+void WQuickCursorPrivate::updateCursorScale()
+{
+    // The scene's device pixel ratio is the highest scale of all outputs, the cursor
+    // only needs the scale of the output it's on.
+    if (output)
+        cursorImage->setScale(output->scale());
+    else
+        cursorImage->setScale(window ? window->effectiveDevicePixelRatio() : 1.0);
 }
 
 void WQuickCursorPrivate::onImageChanged()
@@ -376,7 +390,7 @@ WSGTextureProvider *WQuickCursor::wTextureProvider() const
         if (d->cursorSurfaceItem && d->cursorSurfaceItem->surface())
             d->textureProvider->setProxy(d->cursorSurfaceItem->wTextureProvider());
         else
-            d->textureProvider->setImage(d->cursorImage->image());
+            d->textureProvider->setCursorBuffer(d->cursorImage->buffer());
     }
     return d->textureProvider;
 }
@@ -504,7 +518,16 @@ void WQuickCursor::setOutput(WOutput *newOutput)
         d->leaveOutput(d->output);
     }
 
+    if (d->outputScaleConnection)
+        QObject::disconnect(d->outputScaleConnection);
     d->output = newOutput;
+    if (d->output) {
+        d->outputScaleConnection = connect(d->output, &WOutput::scaleChanged, this, [d] {
+            d->updateCursorScale();
+        });
+    }
+    d->updateCursorScale();
+
     Q_EMIT outputChanged();
 }
 
@@ -537,7 +560,7 @@ void WQuickCursor::itemChange(ItemChange change, const ItemChangeData &data)
         if (d->cursor)
             d->cursor->setEventWindow(data.window);
     } else if (change == ItemDevicePixelRatioHasChanged) {
-        d->updateXCursorManager();
+        d->updateCursorScale();
     } else if (change == ItemVisibleHasChanged) {
         // The visible state is set by compositor(following WOutputCursor::visible property on default)
         if (data.boolValue) {
@@ -570,7 +593,7 @@ QSGNode *WQuickCursor::updatePaintNode(QSGNode *node, UpdatePaintNodeData *)
     if (d->cursorSurfaceItem && d->cursorSurfaceItem->surface()) {
         tp->setProxy(d->cursorSurfaceItem->wTextureProvider());
     } else {
-        tp->setImage(d->cursorImage->image());
+        tp->setCursorBuffer(d->cursorImage->buffer());
     }
 
     // Ignore the tp->proxy, Don't use tp->qwBuffer()
@@ -4,11 +4,22 @@
 #include "wsgtextureprovider.h"
 #include "woutputrenderwindow.h"
 #include "wrenderhelper.h"
+#include "wtools.h"
 #include "private/wglobal_p.h"
 
+#include <qwbuffer.h>
+#include <qwtexture.h>
+#include <qwrenderer.h>
+
 #include <rhi/qrhi.h>
 #include <private/qsgplaintexture_p.h>
 
+#include <atomic>
+
+extern "C" {
+#include <wlr/render/pixman.h>
+}
+
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
 #ifdef QT_DEBUG
@@ -17,18 +28,45 @@ Q_LOGGING_CATEGORY(lcQtQuickTexture, "waylib.qtquick.texture", QtDebugMsg);
 Q_LOGGING_CATEGORY(lcQtQuickTexture, "waylib.qtquick.texture", QtInfoMsg);
 #endif
 
+static std::atomic_uint64_t totalUploadedBytes = 0;
+
+// Returns the bytes of the region in the buffer if the renderer copies the buffer to
+// its textures, the pixman renderer uses the memory of the buffer directly.
+static qint64 bytesOfUpload(qw_renderer *renderer, qw_buffer *buffer, const QRegion &region)
+{
+    if (wlr_renderer_is_pixman(renderer->handle()))
+        return 0;
+
+    void *data;
+    uint32_t format;
+    size_t stride;
+    if (!wlr_buffer_begin_data_ptr_access(buffer->handle(), WLR_BUFFER_DATA_PTR_ACCESS_READ,
+                                          &data, &format, &stride))
+        return 0; // dmabuf is imported without copying
+    wlr_buffer_end_data_ptr_access(buffer->handle());
+
+    const int width = buffer->handle()->width;
+    const qint64 bytesPerPixel = width > 0 ? stride / width : 0;
+    qint64 pixels = 0;
+    for (const QRect &r : region)
+        pixels += qint64(r.width()) * r.height();
+    return pixels * bytesPerPixel;
+}
+
 class Q_DECL_HIDDEN WSGTextureProviderPrivate : public WObjectPrivate
 {
 public:
     WSGTextureProviderPrivate(WSGTextureProvider *qq, WOutputRenderWindow *window)
         : WObjectPrivate(qq)
         , window(window)
+        , qtTexture(new QSGPlainTexture)
     {
-        qtTexture.setOwnsTexture(false);
+        qtTexture->setOwnsTexture(false);
     }
 
     ~WSGTextureProviderPrivate() {
         cleanTexture();
+        delete qtTexture;
     }
 
     void cleanTexture() {
@@ -51,14 +89,71 @@ public:
             rhiTexture = nullptr;
         }
 
-        if (ownsTexture && texture)
+        if (texture && window && window->threadedRendering()) {
+            class ThreadedTextureCleanupJob : public QRunnable
+            {
+            public:
+                ThreadedTextureCleanupJob(QSGPlainTexture *qtTexture, qw_texture *texture)
+                    : qtTexture(qtTexture), texture(texture) { }
+                void run() override {
+                    delete qtTexture;
+                    delete texture;
+                }
+                QSGPlainTexture *qtTexture;
+                qw_texture *texture;
+            };
+
+            // The textures maybe painted by the render thread now, they're deleted after
+            // the frame is finished, see WOutputRenderWindowPrivate::finishThreadedRender.
+            window->scheduleRenderJob(new ThreadedTextureCleanupJob(qtTexture, ownsTexture ? texture : nullptr),
+                                      QQuickWindow::AfterRenderingStage);
+            qtTexture = new QSGPlainTexture;
+            qtTexture->setOwnsTexture(false);
+        } else if (ownsTexture && texture) {
             delete texture;
+        }
         texture = nullptr;
     }
 
+    // The owner of the source buffer maybe release it in the GUI thread when the
+    // texture is still used by the render thread, keep it until the next texture.
+    void lockSourceBuffer(qw_buffer *buffer) {
+        if (buffer && window && window->threadedRendering()) {
+            buffer->lock();
+            sourceBufferLocker.reset(buffer);
+        } else {
+            sourceBufferLocker.reset();
+        }
+    }
+
+    // The contents of the buffer out of the damage are the same as the current texture,
+    // only upload the damage area to the texture instead of importing the whole buffer.
+    bool updateTexture(qw_buffer *buffer, const QRegion &damage) {
+        if (!ownsTexture || !texture || !window || !window->renderer())
+            return false;
+        // The texture maybe painted by the render thread now
+        if (window->threadedRendering())
+            return false;
+        if (texture->handle()->width != uint32_t(buffer->handle()->width)
+            || texture->handle()->height != uint32_t(buffer->handle()->height))
+            return false;
+
+        const QRegion region = damage & QRect(0, 0, buffer->handle()->width, buffer->handle()->height);
+        pixman_region32_t pixmanRegion;
+        pixman_region32_init(&pixmanRegion);
+        bool ok = WTools::toPixmanRegion(region, &pixmanRegion);
+        // Fails if the renderer doesn't support or the format is changed
+        ok = ok && wlr_texture_update_from_buffer(texture->handle(), buffer->handle(), &pixmanRegion);
+        pixman_region32_fini(&pixmanRegion);
+
+        if (ok)
+            totalUploadedBytes.fetch_add(bytesOfUpload(window->renderer(), buffer, region), std::memory_order_relaxed);
+        return ok;
+    }
+
     void updateRhiTexture() {
         Q_ASSERT(texture);
-        bool ok = WRenderHelper::makeTexture(window->rhi(), texture, &qtTexture);
+        bool ok = WRenderHelper::makeTexture(window->rhi(), texture, qtTexture);
         if (Q_UNLIKELY(!ok)) {
             qCWarning(lcQtQuickTexture) << "Failed to make texture:" << texture
                                         << ", width height:" << texture->handle()->width
@@ -66,7 +161,7 @@ public:
             return;
         }
 
-        rhiTexture = qtTexture.rhiTexture();
+        rhiTexture = qtTexture->rhiTexture();
     }
 
     W_DECLARE_PUBLIC(WSGTextureProvider)
@@ -77,9 +172,10 @@ public:
     qw_texture *texture = nullptr;
     bool ownsTexture = false;
     qw_buffer *buffer = nullptr;
+    std::unique_ptr<qw_buffer, qw_buffer::unlocker> sourceBufferLocker;
 
-    // qt resources
-    QSGPlainTexture qtTexture;
+    // qt resources, it's replaced instead of updated in the threaded rendering
+    QSGPlainTexture *qtTexture;
     QRhiTexture *rhiTexture = nullptr;
 };
 
@@ -106,6 +202,7 @@ void WSGTextureProvider::setBuffer(qw_buffer *buffer)
     d->cleanTexture();
     d->ownsTexture = true;
     d->buffer = buffer;
+    d->sourceBufferLocker.reset();
 
     if (buffer) {
         Q_ASSERT(d->window);
@@ -117,18 +214,36 @@ void WSGTextureProvider::setBuffer(qw_buffer *buffer)
                                         << ", n_locks:" << buffer->handle()->n_locks;
         } else {
             d->updateRhiTexture();
+            const QRect bufferRect(0, 0, buffer->handle()->width, buffer->handle()->height);
+            totalUploadedBytes.fetch_add(bytesOfUpload(d->window->renderer(), buffer, bufferRect),
+                                    std::memory_order_relaxed);
         }
     }
 
     Q_EMIT textureChanged();
 }
 
+void WSGTextureProvider::updateBuffer(qw_buffer *buffer, const QRegion &damage)
+{
+    W_D(WSGTextureProvider);
+    // The same buffer maybe committed again with the new contents, e.g. a wl_shm buffer
+    if (buffer && (buffer != d->buffer || !damage.isEmpty()) && d->updateTexture(buffer, damage)) {
+        d->buffer = buffer;
+        // The native texture is not changed, but the contents are changed
+        Q_EMIT textureChanged();
+        return;
+    }
+
+    setBuffer(buffer);
+}
+
 void WSGTextureProvider::setTexture(qw_texture *texture, qw_buffer *srcBuffer)
 {
     W_D(WSGTextureProvider);
     d->cleanTexture();
     d->texture = texture;
     d->buffer = srcBuffer;
+    d->lockSourceBuffer(srcBuffer);
     d->ownsTexture = false;
     if (texture)
         d->updateRhiTexture();
@@ -140,6 +255,7 @@ void WSGTextureProvider::invalidate()
 {
     W_D(WSGTextureProvider);
     d->cleanTexture();
+    d->sourceBufferLocker.reset();
     d->window = nullptr;
 
     Q_EMIT textureChanged();
@@ -148,7 +264,7 @@ void WSGTextureProvider::invalidate()
 QSGTexture *WSGTextureProvider::texture() const
 {
     W_DC(WSGTextureProvider);
-    return d->texture ? const_cast<QSGPlainTexture*>(&d->qtTexture) : nullptr;
+    return d->texture ? d->qtTexture : nullptr;
 }
 
 qw_texture *WSGTextureProvider::qwTexture() const
@@ -163,4 +279,9 @@ qw_buffer *WSGTextureProvider::qwBuffer() const
     return d->buffer;
 }
 
+quint64 WSGTextureProvider::uploadedBytes()
+{
+    return totalUploadedBytes.load(std::memory_order_relaxed);
+}
+
 WAYLIB_SERVER_END_NAMESPACE
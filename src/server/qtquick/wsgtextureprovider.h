@@ -6,6 +6,7 @@
 #include <qwglobal.h>
 
 #include <QSGTextureProvider>
+#include <QRegion>
 
 QW_BEGIN_NAMESPACE
 class qw_texture;
@@ -26,12 +27,18 @@ public:
     WOutputRenderWindow *window() const;
 
     void setBuffer(QW_NAMESPACE::qw_buffer *buffer);
+    // Only the damage region (in buffer coordinates) is changed since the current buffer,
+    // updates the texture in place if possible, otherwise same as setBuffer.
+    void updateBuffer(QW_NAMESPACE::qw_buffer *buffer, const QRegion &damage);
     void setTexture(QW_NAMESPACE::qw_texture *texture, QW_NAMESPACE::qw_buffer *srcBuffer);
     void invalidate();
 
     QSGTexture *texture() const override;
     virtual QW_NAMESPACE::qw_texture *qwTexture() const;
     virtual QW_NAMESPACE::qw_buffer *qwBuffer() const;
+
+    // The total bytes copied from the buffers to the textures of the renderer
+    static quint64 uploadedBytes();
 };
 
 WAYLIB_SERVER_END_NAMESPACE
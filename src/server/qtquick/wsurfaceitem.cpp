@@ -10,6 +10,9 @@
 #include "woutputviewport.h"
 #include "wsgtextureprovider.h"
 #include "woutputrenderwindow.h"
+#include "wtools.h"
+#include "wsocket.h"
+#include "private/wclientstats_p.h"
 
 #include <qwcompositor.h>
 #include <qwsubcompositor.h>
@@ -21,6 +24,7 @@
 #include <QQuickWindow>
 #include <QSGImageNode>
 #include <QSGRenderNode>
+#include <QTimer>
 #include <private/qquickitem_p.h>
 
 QW_USE_NAMESPACE
@@ -108,12 +112,17 @@ public:
     WSurfaceItemContentPrivate(WSurfaceItemContent *qq){}
 
     ~WSurfaceItemContentPrivate() {
+        unlockBuffer();
     }
 
     void cleanTextureProvider();
 
     void invalidate() {
         W_Q(WSurfaceItemContent);
+        // Keep the last frame after WSurface destroyed
+        if (!dontCacheLastBuffer)
+            lockBuffer();
+
         if (surface) {
             surface->safeDisconnect(q);
             if (textureProvider) {
@@ -128,7 +137,7 @@ public:
         Q_ASSERT(!updateTextureConnection);
 
         if (dontCacheLastBuffer) {
-            buffer.reset();
+            setBuffer(nullptr);
             cleanTextureProvider();
             q->update();
         }
@@ -146,11 +155,24 @@ public:
 
         Q_ASSERT(!updateTextureConnection);
         updateTextureConnection = surface->safeConnect(&WSurface::bufferChanged, q, [q, this] {
-            buffer.reset(surface->buffer());
-            // lock buffer to ensure the WSurfaceItem can keep the last frame after WSurface destroyed.
-            if (buffer)
-                buffer->lock();
+            const bool wasLocked = bufferLocked;
+            qw_buffer *oldBuffer = buffer;
+            setBuffer(surface->buffer());
+            // The unlocked old buffer is destroyed with its texture by wlroots, don't
+            // keep it in the texture provider until the next updatePaintNode.
+            if (!wasLocked && oldBuffer != buffer && textureProvider) {
+                if (auto texture = surface->handle()->get_texture())
+                    textureProvider->setTexture(qw_texture::from(texture), buffer);
+                else
+                    textureProvider->setBuffer(buffer);
+            }
+            // for WSGTextureProvider::updateBuffer, in buffer coordinates
+            pendingBufferDamage += WTools::fromPixmanRegion(&surface->handle()->handle()->buffer_damage);
+            // The texture is updated after it's uncovered
+            if (occluded)
+                return;
             q->update();
+            addBufferDamage();
         });
 
         updateFrameDoneConnection();
@@ -158,6 +180,49 @@ public:
         q->rendered = true;
     }
 
+    // wlroots updates the texture of a wl_shm buffer in place by the damage of the next
+    // commit (wlr_client_buffer_apply_damage), that fails if the buffer is locked by
+    // others, so it's only locked if the current texture must be kept.
+    bool needsBufferLock() const {
+        if (!live || !surface)
+            return true;
+        auto w = qobject_cast<WOutputRenderWindow*>(window);
+        // The texture maybe painted by the render thread when it's updated
+        return !w || w->threadedRendering();
+    }
+
+    void setBuffer(qw_buffer *newBuffer) {
+        unlockBuffer();
+        buffer = newBuffer;
+        if (needsBufferLock())
+            lockBuffer();
+    }
+
+    void lockBuffer() {
+        if (!buffer || bufferLocked)
+            return;
+        buffer->lock();
+        bufferLocked = true;
+
+        // The client is charged for the memory held by the compositor
+        if (auto client = surface ? surface->waylandClient() : nullptr) {
+            WClientStats::addLockedBuffer(client, buffer->handle());
+            bufferCounted = true;
+        }
+    }
+
+    void unlockBuffer() {
+        if (!bufferLocked)
+            return;
+        Q_ASSERT(buffer);
+        // Before unlocking, the buffer maybe destroyed by that
+        if (bufferCounted)
+            WClientStats::removeLockedBuffer(buffer->handle());
+        bufferCounted = false;
+        bufferLocked = false;
+        buffer->unlock();
+    }
+
     void updateFrameDoneConnection() {
         W_Q(WSurfaceItemContent);
 
@@ -168,13 +233,74 @@ public:
 
         // wayland protocol job should not run in rendering thread, so set context qobject to contentItem
         frameDoneConnection = QObject::connect(q->window(), &QQuickWindow::afterRendering, q, [this, q](){
-            if ((q->rendered || q->isVisible()) && live) {
+            if ((q->rendered || (q->isVisible() && !occluded)) && live) {
                 surface->notifyFrameDone();
                 q->rendered = false;
             }
         }); // if signal is emitted from seperated rendering thread, default QueuedConnection is used
     }
 
+    void addBufferDamage() {
+        W_Q(WSurfaceItemContent);
+
+        auto window = q->outputRenderWindow();
+        if (!window || !live || !surface)
+            return;
+
+        const QRegion damage = surface->bufferDamage();
+        const QSizeF surfaceSize = surface->size();
+        if (damage.isEmpty() || surfaceSize.isEmpty())
+            return;
+
+        // Same as the target geometry in updatePaintNode
+        const QRectF targetGeometry(ignoreBufferOffset ? QPointF() : bufferOffset, q->size());
+        QTransform transform = QTransform::fromScale(targetGeometry.width() / surfaceSize.width(),
+                                                     targetGeometry.height() / surfaceSize.height());
+        transform *= QTransform::fromTranslate(targetGeometry.x(), targetGeometry.y());
+
+        QRegion itemDamage;
+        for (const QRect &r : damage)
+            itemDamage += transform.mapRect(QRectF(r)).toAlignedRect();
+        window->addDamage(q, itemDamage);
+    }
+
+    void setOccluded(bool on) {
+        W_Q(WSurfaceItemContent);
+
+        if (occluded == on)
+            return;
+        occluded = on;
+
+        if (occluded) {
+            // Don't take over the items culled by others, e.g. the item views
+            culledByOcclusion = !culled;
+            if (culledByOcclusion)
+                setCulled(true);
+
+            if (!occludedFrameTimer) {
+                occludedFrameTimer = new QTimer(q);
+                occludedFrameTimer->setInterval(OccludedFrameInterval);
+                QObject::connect(occludedFrameTimer, &QTimer::timeout, q, [this] {
+                    if (surface && live)
+                        surface->notifyFrameDone();
+                });
+            }
+            occludedFrameTimer->start();
+        } else {
+            if (culledByOcclusion)
+                setCulled(false);
+            culledByOcclusion = false;
+
+            if (occludedFrameTimer)
+                occludedFrameTimer->stop();
+            // Apply the buffer committed while it's occluded, the uncovering
+            // damages the whole item.
+            q->update();
+        }
+
+        Q_EMIT q->occludedChanged();
+    }
+
     void updateSurfaceState() {
         if (!surface)
             return;
@@ -202,11 +328,24 @@ public:
 
     QMetaObject::Connection frameDoneConnection;
     mutable WSGTextureProvider *textureProvider = nullptr;
-    std::unique_ptr<qw_buffer, qw_buffer::unlocker> buffer;
+    // Only kept alive by the surface if it isn't locked, see needsBufferLock
+    QPointer<qw_buffer> buffer;
+    bool bufferLocked = false;
+    // The buffer is added to the WClient::Stats of its client
+    bool bufferCounted = false;
+    // The buffer damages since the last updatePaintNode
+    QRegion pendingBufferDamage;
     mutable QMetaObject::Connection updateTextureConnection;
     bool dontCacheLastBuffer = false;
     bool live = true;
     bool ignoreBufferOffset = false;
+
+    // The frame callbacks of the occluded surface
+    static constexpr int OccludedFrameInterval = 1000;
+    QTimer *occludedFrameTimer = nullptr;
+    bool occlusionCulling = true;
+    bool occluded = false;
+    bool culledByOcclusion = false;
 };
 
 
@@ -296,9 +435,9 @@ WSGTextureProvider *WSurfaceItemContent::wTextureProvider() const
         d->textureProvider = new WSGTextureProvider(w);
         if (d->surface) {
             if (auto texture = d->surface->handle()->get_texture()) {
-                d->textureProvider->setTexture(qw_texture::from(texture), d->buffer.get());
+                d->textureProvider->setTexture(qw_texture::from(texture), d->buffer.data());
             } else {
-                d->textureProvider->setBuffer(d->buffer.get());
+                d->textureProvider->setBuffer(d->buffer.data());
             }
         }
     }
@@ -337,7 +476,10 @@ void WSurfaceItemContent::setLive(bool live)
     if (d->live == live)
         return;
     d->live = live;
-    if (live)
+    // The texture of the frozen frame can't be updated in place
+    if (!live)
+        d->lockBuffer();
+    else
         update();
     Q_EMIT liveChanged();
 }
@@ -363,6 +505,35 @@ void WSurfaceItemContent::setIgnoreBufferOffset(bool newIgnoreBufferOffset)
     Q_EMIT ignoreBufferOffsetChanged();
 }
 
+bool WSurfaceItemContent::occlusionCulling() const
+{
+    W_DC(WSurfaceItemContent);
+    return d->occlusionCulling;
+}
+
+void WSurfaceItemContent::setOcclusionCulling(bool newOcclusionCulling)
+{
+    W_D(WSurfaceItemContent);
+    if (d->occlusionCulling == newOcclusionCulling)
+        return;
+    d->occlusionCulling = newOcclusionCulling;
+    if (!newOcclusionCulling)
+        d->setOccluded(false);
+    Q_EMIT occlusionCullingChanged();
+}
+
+bool WSurfaceItemContent::occluded() const
+{
+    W_DC(WSurfaceItemContent);
+    return d->occluded;
+}
+
+void WSurfaceItemContent::setOccluded(bool occluded)
+{
+    W_D(WSurfaceItemContent);
+    d->setOccluded(occluded && d->occlusionCulling);
+}
+
 void WSurfaceItemContent::componentComplete()
 {
     QQuickItem::componentComplete();
@@ -401,10 +572,11 @@ QSGNode *WSurfaceItemContent::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeD
     if (d->live || !tp->texture()) {
         auto texture = d->surface ? d->surface->handle()->get_texture() : nullptr;
         if (texture) {
-            tp->setTexture(qw_texture::from(texture), d->buffer.get());
+            tp->setTexture(qw_texture::from(texture), d->buffer.data());
         } else {
-            tp->setBuffer(d->buffer.get());
+            tp->updateBuffer(d->buffer.data(), d->pendingBufferDamage);
         }
+        d->pendingBufferDamage = QRegion();
     }
 
     if (!tp->texture() || width() <= 0 || height() <= 0) {
@@ -596,6 +768,7 @@ void WSurfaceItem::setFlags(const Flags &newFlags)
     if (auto content = d->getItemContent()) {
         content->setCacheLastBuffer(!newFlags.testFlag(DontCacheLastBuffer));
         content->setLive(!newFlags.testFlag(NonLive));
+        content->setOcclusionCulling(!newFlags.testFlag(DontCullOccluded));
     }
 
     for (auto sub : std::as_const(d->subsurfaces))
@@ -1009,6 +1182,7 @@ void WSurfaceItemPrivate::initForDelegate()
         contentItem->setCacheLastBuffer(!surfaceFlags.testFlag(WSurfaceItem::DontCacheLastBuffer));
         contentItem->setSmooth(q->smooth());
         contentItem->setLive(!q->flags().testFlag(WSurfaceItem::NonLive));
+        contentItem->setOcclusionCulling(!q->flags().testFlag(WSurfaceItem::DontCullOccluded));
         QObject::connect(q, &WSurfaceItem::smoothChanged, contentItem, &WSurfaceItemContent::setSmooth);
         newContentContainer.reset(contentItem);
     } else if (delegateIsDirty) {
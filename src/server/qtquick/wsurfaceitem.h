@@ -31,6 +31,8 @@ class WAYLIB_SERVER_EXPORT WSurfaceItemContent : public QQuickItem, public virtu
     Q_PROPERTY(qreal implicitHeight READ implicitHeight NOTIFY implicitHeightChanged)
     Q_PROPERTY(QPoint bufferOffset READ bufferOffset NOTIFY bufferOffsetChanged FINAL)
     Q_PROPERTY(bool ignoreBufferOffset READ ignoreBufferOffset WRITE setIgnoreBufferOffset NOTIFY ignoreBufferOffsetChanged FINAL)
+    Q_PROPERTY(bool occlusionCulling READ occlusionCulling WRITE setOcclusionCulling NOTIFY occlusionCullingChanged FINAL)
+    Q_PROPERTY(bool occluded READ occluded NOTIFY occludedChanged FINAL)
     QML_NAMED_ELEMENT(SurfaceItemContent)
 
 public:
@@ -56,18 +58,30 @@ public:
     bool ignoreBufferOffset() const;
     void setIgnoreBufferOffset(bool newIgnoreBufferOffset);
 
+    // If the item is covered by the opaque surfaces above it in all outputs, it's not
+    // rendered, not updated, and its frame callbacks are throttled to 1 Hz. Disable it
+    // if the texture of the surface is displayed by other items, e.g. the thumbnails.
+    bool occlusionCulling() const;
+    void setOcclusionCulling(bool newOcclusionCulling);
+    bool occluded() const;
+
 Q_SIGNALS:
     void surfaceChanged();
     void cacheLastBufferChanged();
     void liveChanged();
     void bufferOffsetChanged();
     void ignoreBufferOffsetChanged();
+    void occlusionCullingChanged();
+    void occludedChanged();
 
 private:
     friend class WSurfaceItem;
     friend class WSurfaceItemPrivate;
     friend class WSGTextureProvider;
     friend class WSGRenderFootprintNode;
+    friend class WQuickOcclusionCuller;
+
+    void setOccluded(bool occluded);
 
     void componentComplete() override;
     QSGNode *updatePaintNode(QSGNode *, UpdatePaintNodeData *) override;
@@ -121,6 +135,7 @@ public:
         RejectEvent = 0x2,
         NonLive = 0x4,
         DelegateForSubsurface = 0x8,
+        DontCullOccluded = 0x10,
     };
     Q_ENUM(Flag)
     Q_DECLARE_FLAGS(Flags, Flag)
@@ -3,12 +3,17 @@
 
 #include "wcursorimage.h"
 #include "wcursor.h"
+#include "wimagebuffer.h"
 
 #include <qwxcursormanager.h>
+#include <qwbuffer.h>
 
 #include <QDebug>
 #include <QLoggingCategory>
 #include <QTimer>
+#include <QMutex>
+#include <QThreadPool>
+#include <QCoreApplication>
 #include <private/qobject_p.h>
 
 #include <memory>
@@ -471,6 +476,93 @@ static inline const char *qcursorShapeToType(std::underlying_type_t<WGlobal::Cur
     return nullptr;
 }
 
+// A frame of the cursor, the image doesn't reference the memory of the xcursor theme,
+// so it can be used in any thread.
+struct Q_DECL_HIDDEN WCursorFrame
+{
+    WCursorFrame(const QImage &image, const QPoint &hotSpot, int delay = 0)
+        : image(image)
+        , hotSpot(hotSpot)
+        , delay(delay) {}
+
+    // Only in the GUI thread, the buffer is in the format of the cursor planes
+    // (DRM_FORMAT_ARGB8888), and shared by all outputs.
+    qw_buffer *ensureBuffer() {
+        if (!buffer && !image.isNull()) {
+            // WImageBufferImpl destroy following qw_buffer
+            buffer.reset(qw_buffer::create(new WImageBufferImpl(image),
+                                           image.width(), image.height()));
+        }
+        return buffer.get();
+    }
+
+    const QImage image;
+    const QPoint hotSpot;
+    const int delay;
+    std::unique_ptr<qw_buffer, qw_buffer::droper> buffer;
+};
+
+// The frames of the xcursor themes, shared by all WCursorImage in the process, keyed by
+// (theme, size, shape, scale, frame). The frames of all shapes are built in a thread
+// after the theme is loaded, so changing the shape or playing an animated cursor only
+// swaps the frames.
+class Q_DECL_HIDDEN WCursorFrameCache
+{
+public:
+    static WCursorFrameCache *instance() {
+        static WCursorFrameCache cache;
+        return &cache;
+    }
+
+    static inline QByteArray themeKey(const qw_xcursor_manager *manager) {
+        return QByteArray(manager->handle()->name) + '/' + QByteArray::number(manager->handle()->size);
+    }
+
+    static inline QByteArray frameKey(const QByteArray &themeKey, const char *shape,
+                                      float scale, int frame) {
+        return themeKey + '/' + shape + '@' + QByteArray::number(scale) + '#' + QByteArray::number(frame);
+    }
+
+    static std::shared_ptr<WCursorFrame> createFrame(const wlr_xcursor_image *ximage, float scale) {
+        QImage image = QImage(static_cast<const uchar*>(ximage->buffer),
+                              ximage->width, ximage->height,
+                              QImage::Format_ARGB32_Premultiplied).copy();
+        image.setDevicePixelRatio(scale);
+        return std::make_shared<WCursorFrame>(image, QPoint(ximage->hotspot_x, ximage->hotspot_y),
+                                              ximage->delay);
+    }
+
+    std::shared_ptr<WCursorFrame> frame(const QByteArray &key, const wlr_xcursor_image *ximage, float scale) {
+        {
+            QMutexLocker locker(&mutex);
+            if (auto frame = frames.value(key))
+                return frame;
+        }
+
+        // Not prebuilt yet
+        auto frame = createFrame(ximage, scale);
+        QMutexLocker locker(&mutex);
+        auto it = frames.constFind(key);
+        if (it != frames.constEnd())
+            return it.value();
+        frames.insert(key, frame);
+        return frame;
+    }
+
+    void prebuild(const std::shared_ptr<qw_xcursor_manager> &manager, float scale);
+
+    void removeTheme(const QByteArray &themeKey) {
+        QMutexLocker locker(&mutex);
+        frames.removeIf([prefix = themeKey + '/'] (const auto &it) {
+            return it.key().startsWith(prefix);
+        });
+    }
+
+private:
+    QMutex mutex;
+    QHash<QByteArray, std::shared_ptr<WCursorFrame>> frames;
+};
+
 class Q_DECL_HIDDEN WCursorImagePrivate : public QObjectPrivate {
 public:
     WCursorImagePrivate() {
@@ -480,22 +572,26 @@ public:
     ~WCursorImagePrivate() {
         bool ok = cursorImages.removeOne(this);
         Q_ASSERT(ok);
+        releaseManager();
     }
 
     void setImage(const QImage &image, const QPoint &hotspot);
+    void setFrame(const std::shared_ptr<WCursorFrame> &frame);
+    void setXCursorFrame(int index);
     void updateCursorImage();
     void playXCursor();
+    void releaseManager();
 
     W_DECLARE_PUBLIC(WCursorImage)
 
-    QImage image;// TODO: supports multi threads
-    QPoint hotSpot;
+    std::shared_ptr<WCursorFrame> frame;
 
     QCursor cursor;
     std::shared_ptr<qw_xcursor_manager> manager;
     float scale = 1.0;
 
     wlr_xcursor *xcursor = nullptr;
+    const char *xcursorName = nullptr;
     int currentXCursorImageIndex = 0;
     QTimer *xcursorPlayTimer = nullptr;
 
@@ -503,13 +599,95 @@ public:
 };
 thread_local QList<WCursorImagePrivate*> WCursorImagePrivate::cursorImages;
 
+// Drops the frames of the theme when its last user releases the manager, the
+// users are the WCursorImage and the prebuild tasks
+static void releaseXCursorManager(const std::shared_ptr<qw_xcursor_manager> &manager)
+{
+    if (manager.use_count() > 1)
+        return;
+
+    const QByteArray theme = WCursorFrameCache::themeKey(manager.get());
+    // Another manager maybe loaded the same theme after this one
+    for (auto dd : std::as_const(WCursorImagePrivate::cursorImages)) {
+        if (dd->manager && dd->manager != manager
+            && WCursorFrameCache::themeKey(dd->manager.get()) == theme)
+            return;
+    }
+
+    WCursorFrameCache::instance()->removeTheme(theme);
+}
+
+void WCursorFrameCache::prebuild(const std::shared_ptr<qw_xcursor_manager> &manager, float scale)
+{
+    const QByteArray theme = themeKey(manager.get());
+    QList<std::pair<QByteArray, const wlr_xcursor_image*>> images;
+
+    // Look up the themes in the GUI thread, they're changed by qw_xcursor_manager::load
+    for (int shape = 0; shape <= static_cast<int>(WGlobal::CursorShape::ZoomOut); ++shape) {
+        const char *name = qcursorShapeToType(shape);
+        if (!name || shape == Qt::BlankCursor)
+            continue;
+
+        auto xcursor = getXCursorWithFallback(manager.get(), name, scale);
+        if (!xcursor)
+            continue;
+
+        QMutexLocker locker(&mutex);
+        for (uint i = 0; i < xcursor->image_count; ++i) {
+            auto key = frameKey(theme, name, scale, i);
+            if (!frames.contains(key))
+                images.append({std::move(key), xcursor->images[i]});
+        }
+    }
+
+    if (images.isEmpty())
+        return;
+
+    // The images of the theme are not changed after loading, but the manager must be
+    // alive until they're copied.
+    QThreadPool::globalInstance()->start([this, manager, images = std::move(images), scale] () mutable {
+        for (const auto &i : std::as_const(images)) {
+            auto frame = createFrame(i.second, scale);
+            QMutexLocker locker(&mutex);
+            if (!frames.contains(i.first))
+                frames.insert(i.first, std::move(frame));
+        }
+
+        // Release the manager in the GUI thread, the theme is removed if the
+        // WCursorImage have released it while prebuilding
+        QMetaObject::invokeMethod(qApp, [manager = std::move(manager)] {
+            releaseXCursorManager(manager);
+        }, Qt::QueuedConnection);
+    });
+}
+
 void WCursorImagePrivate::setImage(const QImage &image, const QPoint &hotspot) {
-    this->image = image;
-    this->image.setDevicePixelRatio(scale);
-    this->hotSpot = hotspot;
+    QImage newImage = image;
+    newImage.setDevicePixelRatio(scale);
+    setFrame(newImage.isNull() ? nullptr : std::make_shared<WCursorFrame>(newImage, hotspot));
+}
+
+void WCursorImagePrivate::setFrame(const std::shared_ptr<WCursorFrame> &frame) {
+    this->frame = frame;
     Q_EMIT q_func()->imageChanged();
 }
 
+void WCursorImagePrivate::setXCursorFrame(int index)
+{
+    const auto key = WCursorFrameCache::frameKey(WCursorFrameCache::themeKey(manager.get()),
+                                                 xcursorName, scale, index);
+    setFrame(WCursorFrameCache::instance()->frame(key, xcursor->images[index], scale));
+}
+
+void WCursorImagePrivate::releaseManager()
+{
+    if (!manager)
+        return;
+
+    releaseXCursorManager(manager);
+    manager.reset();
+}
+
 void WCursorImagePrivate::updateCursorImage()
 {
     xcursor = nullptr;
@@ -531,6 +709,7 @@ void WCursorImagePrivate::updateCursorImage()
     }
 
     auto cursorName = qcursorShapeToType(cursor.shape());
+    xcursorName = cursorName;
     if (cursorName) {
         xcursor = getXCursorWithFallback(manager.get(), cursorName, scale);
         if (!xcursor)
@@ -545,11 +724,7 @@ void WCursorImagePrivate::updateCursorImage()
     }
 
     if (xcursor->image_count == 1) {
-        auto ximage = xcursor->images[0];
-        setImage(QImage(static_cast<const uchar*>(ximage->buffer),
-                        ximage->width, ximage->height,
-                        QImage::Format_ARGB32_Premultiplied),
-                 QPoint(ximage->hotspot_x, ximage->hotspot_y));
+        setXCursorFrame(0);
         return;
     }
 
@@ -572,14 +747,11 @@ void WCursorImagePrivate::playXCursor()
     Q_ASSERT(xcursorPlayTimer);
     Q_ASSERT(!xcursorPlayTimer->isActive());
 
-    auto ximage = xcursor->images[currentXCursorImageIndex];
-    setImage(QImage(static_cast<const uchar*>(ximage->buffer),
-                    ximage->width, ximage->height,
-                    QImage::Format_ARGB32_Premultiplied),
-             QPoint(ximage->hotspot_x, ximage->hotspot_y));
+    setXCursorFrame(currentXCursorImageIndex);
+    const int delay = frame->delay;
 
     currentXCursorImageIndex = (currentXCursorImageIndex + 1) % xcursor->image_count;
-    xcursorPlayTimer->start(ximage->delay);
+    xcursorPlayTimer->start(delay);
 }
 
 WCursorImage::WCursorImage(QObject *parent)
@@ -591,13 +763,19 @@ WCursorImage::WCursorImage(QObject *parent)
 QImage WCursorImage::image() const
 {
     Q_D(const WCursorImage);
-    return d->image;
+    return d->frame ? d->frame->image : QImage();
+}
+
+qw_buffer *WCursorImage::buffer() const
+{
+    Q_D(const WCursorImage);
+    return d->frame ? d->frame->ensureBuffer() : nullptr;
 }
 
 QPoint WCursorImage::hotSpot() const
 {
     Q_D(const WCursorImage);
-    return d->hotSpot;
+    return d->frame ? d->frame->hotSpot : QPoint();
 }
 
 QCursor WCursorImage::cursor() const
@@ -629,8 +807,12 @@ void WCursorImage::setScale(float newScale)
     if (qFuzzyCompare(d->scale, newScale))
         return;
     d->scale = newScale;
-    if (d->manager)
-        d->manager->load(d->scale);
+    if (d->manager) {
+        if (d->manager->load(d->scale))
+            WCursorFrameCache::instance()->prebuild(d->manager, d->scale);
+        // The frames of the other scales are cached, switching back is cheap
+        d->updateCursorImage();
+    }
 
     Q_EMIT scaleChanged();
 }
@@ -648,7 +830,7 @@ void WCursorImage::setCursorTheme(const QByteArray &name, uint32_t size)
         return;
     }
 
-    d->manager.reset();
+    d->releaseManager();
     for (auto dd : std::as_const(WCursorImagePrivate::cursorImages)) {
         if (dd == d)
             continue;
@@ -664,6 +846,8 @@ void WCursorImage::setCursorTheme(const QByteArray &name, uint32_t size)
     bool theme_loaded = d->manager->load(d->scale);
     if (!theme_loaded)
         qCCritical(qLcCursorImage) << "Can't load cursor theme:" << name << ", size:" << size;
+    else
+        WCursorFrameCache::instance()->prebuild(d->manager, d->scale);
 
     d->updateCursorImage();
 }
@@ -4,9 +4,14 @@
 #pragma once
 
 #include <wglobal.h>
+#include <qwglobal.h>
 #include <QObject>
 #include <QCursor>
 
+QW_BEGIN_NAMESPACE
+class qw_buffer;
+QW_END_NAMESPACE
+
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
 class WCursorImagePrivate;
@@ -21,6 +26,7 @@ public:
     explicit WCursorImage(QObject *parent = nullptr);
 
     QImage image() const;
+    QW_NAMESPACE::qw_buffer *buffer() const;
     QPoint hotSpot() const;
 
     QCursor cursor() const;
@@ -13,7 +13,7 @@ WImageBufferImpl::WImageBufferImpl(const QImage &bufferImage)
 {
     auto newFormat = WTools::convertToDrmSupportedFormat(bufferImage.format());
     if (newFormat != bufferImage.format()) {
-        image = bufferImage.convertedTo(newFormat);
+        image = WTools::convertImage(bufferImage, newFormat);
     } else {
         image = bufferImage;
     }
@@ -16,6 +16,18 @@ extern "C" {
 #include <pixman.h>
 #include <drm_fourcc.h>
 
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define W_X86_KERNELS
+#define W_TARGET(features) __attribute__((target(features)))
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define W_NEON_KERNELS
+#endif
+
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
 inline QImage::Format toQImageFormat(pixman_format_code_t format, bool &sRGB) {
@@ -209,6 +221,589 @@ QImage::Format WTools::convertToDrmSupportedFormat(QImage::Format format)
     return format;
 }
 
+// The row kernels of convertPixels, the width is in pixels. The 32 bits pixels are
+// read as the native integers, they're only used on the little endian CPUs.
+using RowKernel = void (*)(const uchar *src, uchar *dst, int width);
+
+static void copyRow(const uchar *src, uchar *dst, int width, int bytesPerPixel)
+{
+    memcpy(dst, src, size_t(width) * bytesPerPixel);
+}
+
+// ARGB8888 <-> ABGR8888, the first and the third bytes are swapped
+static void swapRedBlue_scalar(const uchar *src, uchar *dst, int width)
+{
+    auto s = reinterpret_cast<const quint32*>(src);
+    auto d = reinterpret_cast<quint32*>(dst);
+    for (int x = 0; x < width; ++x) {
+        const quint32 p = s[x];
+        d[x] = (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+    }
+}
+
+// XRGB8888 -> RGB888, the 4th byte is dropped, and the first 3 bytes are reversed if Reverse
+template<bool Reverse>
+static void packRgb888_scalar(const uchar *src, uchar *dst, int width)
+{
+    for (int x = 0; x < width; ++x, src += 4, dst += 3) {
+        dst[0] = src[Reverse ? 2 : 0];
+        dst[1] = src[1];
+        dst[2] = src[Reverse ? 0 : 2];
+    }
+}
+
+// 2101010 -> 8888 in the same channel order, same as qConvertA2rgb30ToArgb32
+template<bool Opaque>
+static inline quint32 convert2101010(quint32 p)
+{
+    const quint32 a = Opaque ? 0xff : (p >> 30) * 0x55;
+    return (a << 24) | ((p >> 6) & 0xff0000) | ((p >> 4) & 0xff00) | ((p >> 2) & 0xff);
+}
+
+template<bool Opaque>
+static void convert2101010_scalar(const uchar *src, uchar *dst, int width)
+{
+    auto s = reinterpret_cast<const quint32*>(src);
+    auto d = reinterpret_cast<quint32*>(dst);
+    for (int x = 0; x < width; ++x)
+        d[x] = convert2101010<Opaque>(s[x]);
+}
+
+// The alpha is the 4th byte in both ARGB32 and RGBA8888
+static void premultiply_scalar(const uchar *src, uchar *dst, int width)
+{
+    auto s = reinterpret_cast<const quint32*>(src);
+    auto d = reinterpret_cast<quint32*>(dst);
+    for (int x = 0; x < width; ++x)
+        d[x] = qPremultiply(s[x]);
+}
+
+static void unpremultiply_scalar(const uchar *src, uchar *dst, int width)
+{
+    auto s = reinterpret_cast<const quint32*>(src);
+    auto d = reinterpret_cast<quint32*>(dst);
+    for (int x = 0; x < width; ++x)
+        d[x] = qUnpremultiply(s[x]);
+}
+
+#ifdef W_X86_KERNELS
+W_TARGET("sse4.1")
+static void swapRedBlue_sse4(const uchar *src, uchar *dst, int width)
+{
+    const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_shuffle_epi8(p, mask));
+    }
+    swapRedBlue_scalar(src + x * 4, dst + x * 4, width - x);
+}
+
+W_TARGET("avx2")
+static void swapRedBlue_avx2(const uchar *src, uchar *dst, int width)
+{
+    const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                          2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_shuffle_epi8(p, mask));
+    }
+    swapRedBlue_scalar(src + x * 4, dst + x * 4, width - x);
+}
+
+// The 12 bytes of 4 pixels are stored by a 16 bytes store, the last 4 bytes are
+// overwritten by the next pixels, so it stops before the last 2 pixels of the row.
+template<bool Reverse>
+W_TARGET("sse4.1")
+static void packRgb888_sse4(const uchar *src, uchar *dst, int width)
+{
+    const __m128i mask = Reverse ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                                 : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    int x = 0;
+    for (; x + 6 <= width; x += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 3), _mm_shuffle_epi8(p, mask));
+    }
+    packRgb888_scalar<Reverse>(src + x * 4, dst + x * 3, width - x);
+}
+
+template<bool Reverse>
+W_TARGET("avx2")
+static void packRgb888_avx2(const uchar *src, uchar *dst, int width)
+{
+    const __m256i mask = Reverse
+        ? _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                           2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+        : _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                           0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    int x = 0;
+    for (; x + 10 <= width; x += 8) {
+        const __m256i p = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4)), mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 3), _mm256_castsi256_si128(p));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 3 + 12), _mm256_extracti128_si256(p, 1));
+    }
+    packRgb888_scalar<Reverse>(src + x * 4, dst + x * 3, width - x);
+}
+
+template<bool Opaque>
+W_TARGET("sse4.1")
+static void convert2101010_sse4(const uchar *src, uchar *dst, int width)
+{
+    const __m128i mask0 = _mm_set1_epi32(0xff);
+    const __m128i mask1 = _mm_set1_epi32(0xff00);
+    const __m128i mask2 = _mm_set1_epi32(0xff0000);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        __m128i d = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 2), mask0),
+                                 _mm_and_si128(_mm_srli_epi32(p, 4), mask1));
+        d = _mm_or_si128(d, _mm_and_si128(_mm_srli_epi32(p, 6), mask2));
+        if (Opaque) {
+            d = _mm_or_si128(d, _mm_set1_epi32(int(0xff000000)));
+        } else {
+            const __m128i a = _mm_mullo_epi32(_mm_srli_epi32(p, 30), _mm_set1_epi32(0x55));
+            d = _mm_or_si128(d, _mm_slli_epi32(a, 24));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), d);
+    }
+    convert2101010_scalar<Opaque>(src + x * 4, dst + x * 4, width - x);
+}
+
+template<bool Opaque>
+W_TARGET("avx2")
+static void convert2101010_avx2(const uchar *src, uchar *dst, int width)
+{
+    const __m256i mask0 = _mm256_set1_epi32(0xff);
+    const __m256i mask1 = _mm256_set1_epi32(0xff00);
+    const __m256i mask2 = _mm256_set1_epi32(0xff0000);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+        __m256i d = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(p, 2), mask0),
+                                    _mm256_and_si256(_mm256_srli_epi32(p, 4), mask1));
+        d = _mm256_or_si256(d, _mm256_and_si256(_mm256_srli_epi32(p, 6), mask2));
+        if (Opaque) {
+            d = _mm256_or_si256(d, _mm256_set1_epi32(int(0xff000000)));
+        } else {
+            const __m256i a = _mm256_mullo_epi32(_mm256_srli_epi32(p, 30), _mm256_set1_epi32(0x55));
+            d = _mm256_or_si256(d, _mm256_slli_epi32(a, 24));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), d);
+    }
+    convert2101010_scalar<Opaque>(src + x * 4, dst + x * 4, width - x);
+}
+
+// (c * a + ((c * a) >> 8) + 0x80) >> 8 in the 16 bits lanes, same as qPremultiply
+W_TARGET("sse4.1")
+static inline __m128i premultiply16_sse4(__m128i c)
+{
+    // Broadcast the alpha, the 4th lane of every pixel
+    const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, 0xff), 0xff);
+    const __m128i t = _mm_mullo_epi16(c, a);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), _mm_set1_epi16(0x80)), 8);
+}
+
+W_TARGET("sse4.1")
+static void premultiply_sse4(const uchar *src, uchar *dst, int width)
+{
+    const __m128i alphaMask = _mm_set1_epi32(int(0xff000000));
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        const __m128i lo = premultiply16_sse4(_mm_unpacklo_epi8(p, zero));
+        const __m128i hi = premultiply16_sse4(_mm_unpackhi_epi8(p, zero));
+        const __m128i d = _mm_blendv_epi8(_mm_packus_epi16(lo, hi), p, alphaMask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), d);
+    }
+    premultiply_scalar(src + x * 4, dst + x * 4, width - x);
+}
+
+W_TARGET("avx2")
+static inline __m256i premultiply16_avx2(__m256i c)
+{
+    const __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(c, 0xff), 0xff);
+    const __m256i t = _mm256_mullo_epi16(c, a);
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)),
+                                              _mm256_set1_epi16(0x80)), 8);
+}
+
+W_TARGET("avx2")
+static void premultiply_avx2(const uchar *src, uchar *dst, int width)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xff000000));
+    const __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+        // The unpacking and the packing are in the 128 bits lanes, the order is kept
+        const __m256i lo = premultiply16_avx2(_mm256_unpacklo_epi8(p, zero));
+        const __m256i hi = premultiply16_avx2(_mm256_unpackhi_epi8(p, zero));
+        const __m256i d = _mm256_blendv_epi8(_mm256_packus_epi16(lo, hi), p, alphaMask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), d);
+    }
+    premultiply_scalar(src + x * 4, dst + x * 4, width - x);
+}
+
+// (c * qt_inv_premul_factor[a] + 0x8000) >> 16 in the 32 bits lanes, same as qUnpremultiply
+W_TARGET("sse4.1")
+static void unpremultiply_sse4(const uchar *src, uchar *dst, int width)
+{
+    const __m128i alphaMask = _mm_set1_epi32(int(0xff000000));
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i half = _mm_set1_epi32(0x8000);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        __m128i *d = reinterpret_cast<__m128i*>(dst + x * 4);
+        const __m128i alpha = _mm_and_si128(p, alphaMask);
+        // The opaque pixels are the most common
+        if (_mm_testc_si128(alpha, alphaMask)) {
+            _mm_storeu_si128(d, p);
+            continue;
+        }
+
+        const __m128i inv = _mm_setr_epi32(qt_inv_premul_factor[quint32(_mm_extract_epi32(p, 0)) >> 24],
+                                           qt_inv_premul_factor[quint32(_mm_extract_epi32(p, 1)) >> 24],
+                                           qt_inv_premul_factor[quint32(_mm_extract_epi32(p, 2)) >> 24],
+                                           qt_inv_premul_factor[quint32(_mm_extract_epi32(p, 3)) >> 24]);
+        __m128i r = alpha;
+        for (int shift = 0; shift < 24; shift += 8) {
+            __m128i c = _mm_and_si128(_mm_srli_epi32(p, shift), mask);
+            c = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(c, inv), half), 16);
+            r = _mm_or_si128(r, _mm_slli_epi32(_mm_and_si128(c, mask), shift));
+        }
+        _mm_storeu_si128(d, r);
+    }
+    unpremultiply_scalar(src + x * 4, dst + x * 4, width - x);
+}
+
+W_TARGET("avx2")
+static void unpremultiply_avx2(const uchar *src, uchar *dst, int width)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xff000000));
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    const __m256i half = _mm256_set1_epi32(0x8000);
+    const auto factors = reinterpret_cast<const int*>(qt_inv_premul_factor);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+        __m256i *d = reinterpret_cast<__m256i*>(dst + x * 4);
+        const __m256i alpha = _mm256_and_si256(p, alphaMask);
+        if (_mm256_testc_si256(alpha, alphaMask)) {
+            _mm256_storeu_si256(d, p);
+            continue;
+        }
+
+        const __m256i inv = _mm256_i32gather_epi32(factors, _mm256_srli_epi32(p, 24), 4);
+        __m256i r = alpha;
+        for (int shift = 0; shift < 24; shift += 8) {
+            __m256i c = _mm256_and_si256(_mm256_srli_epi32(p, shift), mask);
+            c = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(c, inv), half), 16);
+            r = _mm256_or_si256(r, _mm256_slli_epi32(_mm256_and_si256(c, mask), shift));
+        }
+        _mm256_storeu_si256(d, r);
+    }
+    unpremultiply_scalar(src + x * 4, dst + x * 4, width - x);
+}
+#endif // W_X86_KERNELS
+
+#ifdef W_NEON_KERNELS
+static void swapRedBlue_neon(const uchar *src, uchar *dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t p = vld4q_u8(src + x * 4);
+        std::swap(p.val[0], p.val[2]);
+        vst4q_u8(dst + x * 4, p);
+    }
+    swapRedBlue_scalar(src + x * 4, dst + x * 4, width - x);
+}
+
+template<bool Reverse>
+static void packRgb888_neon(const uchar *src, uchar *dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16x4_t p = vld4q_u8(src + x * 4);
+        uint8x16x3_t d;
+        d.val[0] = p.val[Reverse ? 2 : 0];
+        d.val[1] = p.val[1];
+        d.val[2] = p.val[Reverse ? 0 : 2];
+        vst3q_u8(dst + x * 3, d);
+    }
+    packRgb888_scalar<Reverse>(src + x * 4, dst + x * 3, width - x);
+}
+
+template<bool Opaque>
+static void convert2101010_neon(const uchar *src, uchar *dst, int width)
+{
+    const uint32x4_t mask0 = vdupq_n_u32(0xff);
+    const uint32x4_t mask1 = vdupq_n_u32(0xff00);
+    const uint32x4_t mask2 = vdupq_n_u32(0xff0000);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const uint32x4_t p = vld1q_u32(reinterpret_cast<const uint32_t*>(src + x * 4));
+        uint32x4_t d = vorrq_u32(vandq_u32(vshrq_n_u32(p, 2), mask0), vandq_u32(vshrq_n_u32(p, 4), mask1));
+        d = vorrq_u32(d, vandq_u32(vshrq_n_u32(p, 6), mask2));
+        if (Opaque)
+            d = vorrq_u32(d, vdupq_n_u32(0xff000000));
+        else
+            d = vorrq_u32(d, vshlq_n_u32(vmulq_n_u32(vshrq_n_u32(p, 30), 0x55), 24));
+        vst1q_u32(reinterpret_cast<uint32_t*>(dst + x * 4), d);
+    }
+    convert2101010_scalar<Opaque>(src + x * 4, dst + x * 4, width - x);
+}
+
+// vraddhn_u16(t, t >> 8) is (t + (t >> 8) + 0x80) >> 8, same as qPremultiply
+static inline uint8x16_t premultiply_neon(uint8x16_t c, uint8x16_t a)
+{
+    const uint16x8_t lo = vmull_u8(vget_low_u8(c), vget_low_u8(a));
+    const uint16x8_t hi = vmull_u8(vget_high_u8(c), vget_high_u8(a));
+    return vcombine_u8(vraddhn_u16(lo, vshrq_n_u16(lo, 8)), vraddhn_u16(hi, vshrq_n_u16(hi, 8)));
+}
+
+static void premultiply_neon(const uchar *src, uchar *dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t p = vld4q_u8(src + x * 4);
+        for (int i = 0; i < 3; ++i)
+            p.val[i] = premultiply_neon(p.val[i], p.val[3]);
+        vst4q_u8(dst + x * 4, p);
+    }
+    premultiply_scalar(src + x * 4, dst + x * 4, width - x);
+}
+
+static void unpremultiply_neon(const uchar *src, uchar *dst, int width)
+{
+    const uint32x4_t mask = vdupq_n_u32(0xff);
+    const uint32x4_t half = vdupq_n_u32(0x8000);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const auto s = reinterpret_cast<const uint32_t*>(src + x * 4);
+        const uint32x4_t p = vld1q_u32(s);
+        const uint32_t factors[4] = {
+            qt_inv_premul_factor[s[0] >> 24], qt_inv_premul_factor[s[1] >> 24],
+            qt_inv_premul_factor[s[2] >> 24], qt_inv_premul_factor[s[3] >> 24],
+        };
+        const uint32x4_t inv = vld1q_u32(factors);
+        uint32x4_t r = vandq_u32(p, vdupq_n_u32(0xff000000));
+        r = vorrq_u32(r, vandq_u32(vshrq_n_u32(vmlaq_u32(half, vandq_u32(p, mask), inv), 16), mask));
+        r = vorrq_u32(r, vshlq_n_u32(vandq_u32(vshrq_n_u32(vmlaq_u32(half, vandq_u32(vshrq_n_u32(p, 8), mask), inv), 16), mask), 8));
+        r = vorrq_u32(r, vshlq_n_u32(vandq_u32(vshrq_n_u32(vmlaq_u32(half, vandq_u32(vshrq_n_u32(p, 16), mask), inv), 16), mask), 16));
+        vst1q_u32(reinterpret_cast<uint32_t*>(dst + x * 4), r);
+    }
+    unpremultiply_scalar(src + x * 4, dst + x * 4, width - x);
+}
+#endif // W_NEON_KERNELS
+
+struct Q_DECL_HIDDEN RowKernels
+{
+    RowKernel swapRedBlue = swapRedBlue_scalar;
+    RowKernel packRgb888 = packRgb888_scalar<false>;
+    RowKernel packRgb888Reversed = packRgb888_scalar<true>;
+    RowKernel convertRgb30 = convert2101010_scalar<true>;
+    RowKernel convertA2Rgb30 = convert2101010_scalar<false>;
+    RowKernel premultiply = premultiply_scalar;
+    RowKernel unpremultiply = unpremultiply_scalar;
+};
+
+static const RowKernels *rowKernelsOf(WTools::PixelKernels kernels)
+{
+    using K = WTools::PixelKernels;
+
+    switch (kernels) {
+#if defined(W_X86_KERNELS)
+    case K::SSE4:
+        if (__builtin_cpu_supports("sse4.1")) {
+            static const RowKernels k = {swapRedBlue_sse4, packRgb888_sse4<false>, packRgb888_sse4<true>,
+                                         convert2101010_sse4<true>, convert2101010_sse4<false>,
+                                         premultiply_sse4, unpremultiply_sse4};
+            return &k;
+        }
+        break;
+    case K::AVX2:
+        if (__builtin_cpu_supports("avx2")) {
+            static const RowKernels k = {swapRedBlue_avx2, packRgb888_avx2<false>, packRgb888_avx2<true>,
+                                         convert2101010_avx2<true>, convert2101010_avx2<false>,
+                                         premultiply_avx2, unpremultiply_avx2};
+            return &k;
+        }
+        break;
+#elif defined(W_NEON_KERNELS)
+    case K::NEON: {
+        static const RowKernels k = {swapRedBlue_neon, packRgb888_neon<false>, packRgb888_neon<true>,
+                                     convert2101010_neon<true>, convert2101010_neon<false>,
+                                     premultiply_neon, unpremultiply_neon};
+        return &k;
+    }
+#endif
+    case K::Scalar: {
+        static const RowKernels k;
+        return &k;
+    }
+    default:
+        break;
+    }
+
+    return nullptr;
+}
+
+static std::atomic<WTools::PixelKernels> &currentPixelKernels()
+{
+    static std::atomic<WTools::PixelKernels> kernels = [] {
+        using K = WTools::PixelKernels;
+        for (auto k : {K::AVX2, K::SSE4, K::NEON}) {
+            if (rowKernelsOf(k))
+                return k;
+        }
+        return K::Scalar;
+    }();
+
+    return kernels;
+}
+
+static const RowKernels &rowKernels()
+{
+    return *rowKernelsOf(currentPixelKernels().load(std::memory_order_relaxed));
+}
+
+static RowKernel rowKernel(QImage::Format from, QImage::Format to)
+{
+    const auto &k = rowKernels();
+    using F = QImage;
+
+    switch (from) {
+    case F::Format_RGB32:
+        if (to == F::Format_RGBX8888)
+            return k.swapRedBlue;
+        if (to == F::Format_RGB888)
+            return k.packRgb888Reversed;
+        if (to == F::Format_BGR888)
+            return k.packRgb888;
+        break;
+    case F::Format_RGBX8888:
+        if (to == F::Format_RGB32)
+            return k.swapRedBlue;
+        if (to == F::Format_RGB888)
+            return k.packRgb888;
+        if (to == F::Format_BGR888)
+            return k.packRgb888Reversed;
+        break;
+    case F::Format_ARGB32:
+        if (to == F::Format_RGBA8888)
+            return k.swapRedBlue;
+        if (to == F::Format_ARGB32_Premultiplied)
+            return k.premultiply;
+        break;
+    case F::Format_RGBA8888:
+        if (to == F::Format_ARGB32)
+            return k.swapRedBlue;
+        if (to == F::Format_RGBA8888_Premultiplied)
+            return k.premultiply;
+        break;
+    case F::Format_ARGB32_Premultiplied:
+        if (to == F::Format_RGBA8888_Premultiplied)
+            return k.swapRedBlue;
+        if (to == F::Format_ARGB32)
+            return k.unpremultiply;
+        break;
+    case F::Format_RGBA8888_Premultiplied:
+        if (to == F::Format_ARGB32_Premultiplied)
+            return k.swapRedBlue;
+        if (to == F::Format_RGBA8888)
+            return k.unpremultiply;
+        break;
+    // The channel order of the 2101010 formats is kept
+    case F::Format_RGB30:
+        if (to == F::Format_RGB32)
+            return k.convertRgb30;
+        break;
+    case F::Format_BGR30:
+        if (to == F::Format_RGBX8888)
+            return k.convertRgb30;
+        break;
+    case F::Format_A2RGB30_Premultiplied:
+        if (to == F::Format_ARGB32_Premultiplied)
+            return k.convertA2Rgb30;
+        break;
+    case F::Format_A2BGR30_Premultiplied:
+        if (to == F::Format_RGBA8888_Premultiplied)
+            return k.convertA2Rgb30;
+        break;
+    default:
+        break;
+    }
+
+    return nullptr;
+}
+
+bool WTools::convertPixels(const uchar *src, qsizetype srcStride, QImage::Format srcFormat,
+                           uchar *dst, qsizetype dstStride, QImage::Format dstFormat,
+                           const QSize &size, bool flipVertically)
+{
+    if (Q_BYTE_ORDER != Q_LITTLE_ENDIAN || size.isEmpty())
+        return false;
+
+    RowKernel kernel = nullptr;
+    const int bytesPerPixel = QImage::toPixelFormat(srcFormat).bitsPerPixel() / 8;
+    if (srcFormat != dstFormat) {
+        kernel = rowKernel(srcFormat, dstFormat);
+        if (!kernel)
+            return false;
+    } else if (bytesPerPixel <= 0) {
+        return false;
+    }
+
+    for (int y = 0; y < size.height(); ++y) {
+        const uchar *s = src + srcStride * (flipVertically ? size.height() - 1 - y : y);
+        uchar *d = dst + dstStride * y;
+        if (kernel)
+            kernel(s, d, size.width());
+        else
+            copyRow(s, d, size.width(), bytesPerPixel);
+    }
+
+    return true;
+}
+
+WTools::PixelKernels WTools::pixelKernels()
+{
+    return currentPixelKernels().load(std::memory_order_relaxed);
+}
+
+bool WTools::setPixelKernels(PixelKernels kernels)
+{
+    if (!rowKernelsOf(kernels))
+        return false;
+
+    currentPixelKernels().store(kernels, std::memory_order_relaxed);
+    return true;
+}
+
+QImage WTools::convertImage(const QImage &image, QImage::Format format, bool flipVertically)
+{
+    if (image.isNull() || (image.format() == format && !flipVertically))
+        return image;
+
+    QImage result(image.size(), format);
+    if (!result.isNull() && convertPixels(image.constBits(), image.bytesPerLine(), image.format(),
+                                          result.bits(), result.bytesPerLine(), format,
+                                          image.size(), flipVertically)) {
+        result.setDevicePixelRatio(image.devicePixelRatio());
+        result.setDotsPerMeterX(image.dotsPerMeterX());
+        result.setDotsPerMeterY(image.dotsPerMeterY());
+        result.setOffset(image.offset());
+        result.setColorSpace(image.colorSpace());
+        return result;
+    }
+
+    const QImage converted = image.convertedTo(format);
+    return flipVertically ? converted.mirrored(false, true) : converted;
+}
+
 uint32_t WTools::shmToDrmFormat(wl_shm_format shmFmt)
 {
     switch (shmFmt) {
@@ -20,10 +20,31 @@ WAYLIB_SERVER_BEGIN_NAMESPACE
 class WAYLIB_SERVER_EXPORT WTools
 {
 public:
+    // The row kernels of convertPixels
+    enum class PixelKernels {
+        Scalar,
+        SSE4,
+        AVX2,
+        NEON,
+    };
+
     static QImage fromPixmanImage(void *image, void *data = nullptr);
     static QImage::Format toImageFormat(uint32_t drmFormat);
     static uint32_t toDrmFormat(QImage::Format format);
     static QImage::Format convertToDrmSupportedFormat(QImage::Format format);
+    // Converts the pixels by the vectorized kernels, selected by the CPU features at runtime,
+    // returns false if the conversion isn't supported by them. The src and dst must not overlap.
+    static bool convertPixels(const uchar *src, qsizetype srcStride, QImage::Format srcFormat,
+                              uchar *dst, qsizetype dstStride, QImage::Format dstFormat,
+                              const QSize &size, bool flipVertically = false);
+    // Same as QImage::convertedTo, and QImage::mirrored if flipVertically, but faster
+    // for the conversions supported by convertPixels.
+    static QImage convertImage(const QImage &image, QImage::Format format, bool flipVertically = false);
+    // The kernels are selected by the CPU features at the first use, the scalar kernels
+    // are the reference of the vectorized ones. The setter is a global switch for the
+    // tests, returns false if the CPU doesn't support the kernels.
+    static PixelKernels pixelKernels();
+    static bool setPixelKernels(PixelKernels kernels);
     static uint32_t shmToDrmFormat(wl_shm_format shmFmt);
     static wl_shm_format drmToShmFormat(uint32_t drmFmt);
     static QRegion fromPixmanRegion(pixman_region32 *region);
@@ -0,0 +1,252 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <wquickhittestindex_p.h>
+
+#include <QTest>
+#include <QQuickWindow>
+#include <QQuickItem>
+
+WAYLIB_SERVER_USE_NAMESPACE
+
+class tst_HitTestIndex : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void topmostItem();
+    void stackingOrder();
+    void moveItem();
+    void hideItem();
+    void addAndRemoveItem();
+    void clipItem();
+    void transformItem();
+    void largeItem();
+    void ignoreNonHoverItem();
+    void exclusiveHoverItem();
+
+private:
+    QQuickItem *createItem(QQuickItem *parent, const QRectF &geometry, bool hover = true);
+
+    QQuickWindow *m_window = nullptr;
+    WQuickHitTestIndex *m_index = nullptr;
+};
+
+void tst_HitTestIndex::init()
+{
+    m_window = new QQuickWindow();
+    m_window->resize(1920, 1080);
+    m_index = WQuickHitTestIndex::get(m_window);
+}
+
+void tst_HitTestIndex::cleanup()
+{
+    delete m_window;
+    m_window = nullptr;
+    m_index = nullptr;
+}
+
+QQuickItem *tst_HitTestIndex::createItem(QQuickItem *parent, const QRectF &geometry, bool hover)
+{
+    auto item = new QQuickItem(parent);
+    item->setPosition(geometry.topLeft());
+    item->setSize(geometry.size());
+    item->setAcceptHoverEvents(hover);
+    return item;
+}
+
+void tst_HitTestIndex::topmostItem()
+{
+    auto window = createItem(m_window->contentItem(), QRectF(100, 100, 400, 300));
+    auto child = createItem(window, QRectF(10, 10, 100, 100));
+
+    // The children are above their parent
+    QCOMPARE(m_index->hoverItemAt(QPointF(150, 150)), child);
+    QCOMPARE(m_index->hoverItemAt(QPointF(300, 300)), window);
+    QCOMPARE(m_index->hoverItemAt(QPointF(50, 50)), nullptr);
+    QCOMPARE(m_index->itemCount(), 2);
+}
+
+void tst_HitTestIndex::stackingOrder()
+{
+    auto bottom = createItem(m_window->contentItem(), QRectF(0, 0, 300, 300));
+    auto top = createItem(m_window->contentItem(), QRectF(100, 100, 300, 300));
+    QCOMPARE(m_index->hoverItemAt(QPointF(200, 200)), top);
+
+    // The stacking order isn't cached
+    bottom->setZ(1);
+    QCOMPARE(m_index->hoverItemAt(QPointF(200, 200)), bottom);
+    bottom->stackBefore(top);
+    bottom->setZ(0);
+    QCOMPARE(m_index->hoverItemAt(QPointF(200, 200)), top);
+
+    // The children of the lower sibling are below the higher sibling
+    auto child = createItem(bottom, QRectF(150, 150, 100, 100));
+    QCOMPARE(m_index->hoverItemAt(QPointF(200, 200)), top);
+    QCOMPARE(m_index->hoverItemAt(QPointF(50, 50)), bottom);
+    top->setZ(-1);
+    QCOMPARE(m_index->hoverItemAt(QPointF(200, 200)), child);
+}
+
+void tst_HitTestIndex::moveItem()
+{
+    auto window = createItem(m_window->contentItem(), QRectF(0, 0, 200, 200));
+    auto child = createItem(window, QRectF(50, 50, 50, 50));
+    QCOMPARE(m_index->hoverItemAt(QPointF(75, 75)), child);
+    QCOMPARE(m_index->updatedSubtreeCount(), 0);
+
+    // Across the cells
+    window->setPosition(QPointF(1000, 600));
+    QCOMPARE(m_index->hoverItemAt(QPointF(75, 75)), nullptr);
+    QCOMPARE(m_index->hoverItemAt(QPointF(1075, 675)), child);
+    QCOMPARE(m_index->hoverItemAt(QPointF(1010, 610)), window);
+    QCOMPARE(m_index->updatedSubtreeCount(), 1);
+
+    child->setSize(QSizeF(150, 150));
+    QCOMPARE(m_index->hoverItemAt(QPointF(1180, 680)), child);
+    QCOMPARE(m_index->updatedSubtreeCount(), 2);
+
+    // Rotated around the center, it's at (115, -15, 20, 150) in the window
+    child->setRotation(90);
+    child->setSize(QSizeF(150, 20));
+    QCOMPARE(m_index->hoverItemAt(QPointF(1125, 650)), child);
+    QCOMPARE(m_index->hoverItemAt(QPointF(1180, 610)), window);
+}
+
+void tst_HitTestIndex::hideItem()
+{
+    auto window = createItem(m_window->contentItem(), QRectF(0, 0, 200, 200));
+    auto child = createItem(window, QRectF(50, 50, 50, 50));
+    QCOMPARE(m_index->hoverItemAt(QPointF(75, 75)), child);
+
+    child->setVisible(false);
+    QCOMPARE(m_index->hoverItemAt(QPointF(75, 75)), window);
+    window->setVisible(false);
+    QCOMPARE(m_index->hoverItemAt(QPointF(75, 75)), nullptr);
+    QCOMPARE(m_index->itemCount(), 0);
+
+    window->setVisible(true);
+    QCOMPARE(m_index->hoverItemAt(QPointF(75, 75)), window);
+    child->setVisible(true);
+    QCOMPARE(m_index->hoverItemAt(QPointF(75, 75)), child);
+}
+
+void tst_HitTestIndex::addAndRemoveItem()
+{
+    auto window = createItem(m_window->contentItem(), QRectF(0, 0, 200, 200));
+    QCOMPARE(m_index->hoverItemAt(QPointF(75, 75)), window);
+
+    // A hover item is added into a subtree without hover item
+    auto container = createItem(m_window->contentItem(), QRectF(0, 0, 1000, 1000), false);
+    auto child = createItem(container, QRectF(50, 50, 50, 50));
+    QCOMPARE(m_index->hoverItemAt(QPointF(75, 75)), child);
+    QCOMPARE(m_index->itemCount(), 2);
+
+    child->setParentItem(window);
+    child->setPosition(QPointF(100, 100));
+    QCOMPARE(m_index->hoverItemAt(QPointF(75, 75)), window);
+    QCOMPARE(m_index->hoverItemAt(QPointF(125, 125)), child);
+
+    child->setParentItem(nullptr);
+    QCOMPARE(m_index->hoverItemAt(QPointF(125, 125)), window);
+    QCOMPARE(m_index->itemCount(), 1);
+    delete child;
+
+    child = createItem(window, QRectF(100, 100, 50, 50));
+    QCOMPARE(m_index->hoverItemAt(QPointF(125, 125)), child);
+    delete child;
+    QCOMPARE(m_index->hoverItemAt(QPointF(125, 125)), window);
+    delete window;
+    QCOMPARE(m_index->hoverItemAt(QPointF(125, 125)), nullptr);
+    QCOMPARE(m_index->itemCount(), 0);
+}
+
+void tst_HitTestIndex::clipItem()
+{
+    auto window = createItem(m_window->contentItem(), QRectF(0, 0, 200, 200));
+    auto child = createItem(window, QRectF(150, 150, 100, 100));
+    QCOMPARE(m_index->hoverItemAt(QPointF(225, 225)), child);
+
+    // The clip isn't notified, it's found in the dirty items of the window
+    window->setClip(true);
+    QCOMPARE(m_index->hoverItemAt(QPointF(225, 225)), nullptr);
+    QCOMPARE(m_index->hoverItemAt(QPointF(175, 175)), child);
+
+    // The clip of the ancestors is kept when the child is updated
+    child->setX(160);
+    QCOMPARE(m_index->hoverItemAt(QPointF(225, 225)), nullptr);
+    QCOMPARE(m_index->hoverItemAt(QPointF(175, 175)), child);
+
+    window->setClip(false);
+    QCOMPARE(m_index->hoverItemAt(QPointF(225, 225)), child);
+}
+
+void tst_HitTestIndex::transformItem()
+{
+    auto window = createItem(m_window->contentItem(), QRectF(0, 0, 200, 200));
+    auto child = createItem(window, QRectF(100, 100, 50, 50));
+    QCOMPARE(m_index->hoverItemAt(QPointF(125, 125)), child);
+
+    // Like the animation of opening a window
+    window->setTransformOrigin(QQuickItem::TopLeft);
+    window->setScale(2);
+    QCOMPARE(m_index->hoverItemAt(QPointF(125, 125)), window);
+    QCOMPARE(m_index->hoverItemAt(QPointF(250, 250)), child);
+    QCOMPARE(m_index->hoverItemAt(QPointF(350, 350)), window);
+
+    window->setScale(1);
+    QCOMPARE(m_index->hoverItemAt(QPointF(125, 125)), child);
+    QCOMPARE(m_index->hoverItemAt(QPointF(250, 250)), nullptr);
+}
+
+void tst_HitTestIndex::largeItem()
+{
+    auto background = createItem(m_window->contentItem(), QRectF(0, 0, 4000, 4000));
+    auto window = createItem(m_window->contentItem(), QRectF(100, 100, 200, 200));
+    QCOMPARE(m_index->hoverItemAt(QPointF(150, 150)), window);
+    QCOMPARE(m_index->hoverItemAt(QPointF(3000, 3000)), background);
+
+    background->setZ(1);
+    QCOMPARE(m_index->hoverItemAt(QPointF(150, 150)), background);
+    background->setSize(QSizeF(100, 100));
+    QCOMPARE(m_index->hoverItemAt(QPointF(150, 150)), window);
+    QCOMPARE(m_index->hoverItemAt(QPointF(3000, 3000)), nullptr);
+}
+
+void tst_HitTestIndex::ignoreNonHoverItem()
+{
+    auto window = createItem(m_window->contentItem(), QRectF(0, 0, 200, 200));
+    auto cursor = createItem(m_window->contentItem(), QRectF(0, 0, 24, 24), false);
+    QCOMPARE(m_index->hoverItemAt(QPointF(10, 10)), window);
+
+    // Like the cursor following the pointer
+    for (int i = 0; i < 100; ++i) {
+        cursor->setPosition(QPointF(i, i));
+        QCOMPARE(m_index->hoverItemAt(QPointF(i, i)), window);
+    }
+    QCOMPARE(m_index->updatedSubtreeCount(), 0);
+}
+
+void tst_HitTestIndex::exclusiveHoverItem()
+{
+    auto window = createItem(m_window->contentItem(), QRectF(0, 0, 400, 400), false);
+    auto surface = createItem(window, QRectF(0, 30, 400, 370));
+    bool exclusive = false;
+    QCOMPARE(m_index->hoverItemAt(QPointF(100, 100), &exclusive), surface);
+    QVERIFY(exclusive);
+
+    // The ancestor needs the HoverMove event, WSeat can't skip QQuickDeliveryAgent
+    window->setAcceptHoverEvents(true);
+    QCOMPARE(m_index->hoverItemAt(QPointF(100, 100), &exclusive), surface);
+    QVERIFY(!exclusive);
+
+    // The title bar is only under the cursor
+    QCOMPARE(m_index->hoverItemAt(QPointF(100, 10), &exclusive), window);
+    QVERIFY(exclusive);
+}
+
+QTEST_MAIN(tst_HitTestIndex)
+#include "tst_hittestindex.moc"
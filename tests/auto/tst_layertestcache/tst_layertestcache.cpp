@@ -0,0 +1,265 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <woutputlayertestcache_p.h>
+#include <wtools.h>
+
+#include <qwbuffer.h>
+#include <qwbufferinterface.h>
+#include <qwoutputlayer.h>
+
+#include <QTest>
+#include <QImage>
+
+#include <memory>
+
+QW_USE_NAMESPACE
+WAYLIB_SERVER_USE_NAMESPACE
+
+// Only the format and the size of the buffers are used by WOutputLayerTestCache
+class ShmBuffer : public qw_buffer_interface
+{
+public:
+    explicit ShmBuffer(const QImage &image)
+        : m_image(image) {}
+
+    QW_INTERFACE(get_shm, bool, wlr_shm_attributes *attribs);
+
+private:
+    QImage m_image;
+};
+
+bool ShmBuffer::get_shm(wlr_shm_attributes *attribs)
+{
+    attribs->fd = -1;
+    attribs->format = WTools::toDrmFormat(m_image.format());
+    attribs->width = m_image.width();
+    attribs->height = m_image.height();
+    attribs->stride = m_image.bytesPerLine();
+    return true;
+}
+
+using Buffer = std::unique_ptr<qw_buffer, qw_buffer::droper>;
+
+class tst_LayerTestCache : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void reuseSameLayers();
+    void retestChangedLayers();
+    void retestChangedBuffers();
+    void retestMovedAcceptedLayers();
+    void holdMovedRejectedLayers();
+    void retestAfterInvalidate();
+    void retestAfterMaxReusedFrames();
+    void retestRejectedOnCommit();
+
+private:
+    static Buffer createBuffer(const QSize &size, QImage::Format format = QImage::Format_ARGB32_Premultiplied);
+    static wlr_output_layer *fakeLayer(int index);
+    wlr_output_layer_state_array layers(int count, const QPoint &offset = {}) const;
+    // Simulates WOutputHelper::testCommit, returns true if the test is reused
+    static bool commit(WOutputLayerTestCache *cache, const wlr_output_layer_state_array &layers,
+                       bool accepted = true);
+
+    Buffer m_primary = createBuffer(QSize(800, 600));
+    Buffer m_layerBuffers[3] = {
+        createBuffer(QSize(100, 100)),
+        createBuffer(QSize(200, 100)),
+        createBuffer(QSize(100, 200)),
+    };
+};
+
+Buffer tst_LayerTestCache::createBuffer(const QSize &size, QImage::Format format)
+{
+    QImage image(size, format);
+    image.fill(Qt::transparent);
+    return Buffer(qw_buffer::create(new ShmBuffer(image), size.width(), size.height()));
+}
+
+wlr_output_layer *tst_LayerTestCache::fakeLayer(int index)
+{
+    // Only the addresses of the layers are used
+    return reinterpret_cast<wlr_output_layer*>(quintptr(0x1000 + index * 0x100));
+}
+
+wlr_output_layer_state_array tst_LayerTestCache::layers(int count, const QPoint &offset) const
+{
+    wlr_output_layer_state_array list;
+    for (int i = 0; i < count; ++i) {
+        wlr_output_layer_state state {};
+        state.layer = fakeLayer(i);
+        state.buffer = m_layerBuffers[i]->handle();
+        state.dst_box = {offset.x() + i * 50, offset.y() + i * 50,
+                         m_layerBuffers[i]->handle()->width, m_layerBuffers[i]->handle()->height};
+        list.append(state);
+    }
+
+    return list;
+}
+
+bool tst_LayerTestCache::commit(WOutputLayerTestCache *cache, const wlr_output_layer_state_array &layers,
+                                bool accepted)
+{
+    bool ok = false;
+    if (cache->reuse(nullptr, layers, &ok))
+        return true;
+
+    auto states = const_cast<wlr_output_layer_state*>(layers.data());
+    for (int i = 0; i < layers.size(); ++i)
+        states[i].accepted = accepted;
+    cache->save(layers, accepted);
+    return false;
+}
+
+void tst_LayerTestCache::reuseSameLayers()
+{
+    WOutputLayerTestCache cache;
+    QVERIFY(!commit(&cache, layers(2)));
+    QVERIFY(cache.isValid());
+
+    auto list = layers(2);
+    bool ok = false;
+    QVERIFY(cache.reuse(m_primary->handle(), list, &ok) == false);
+    // The primary buffer is a part of the structure
+    cache.save(list, true);
+    list = layers(2);
+    QVERIFY(cache.reuse(m_primary->handle(), list, &ok));
+    QVERIFY(ok);
+    QVERIFY(list.at(0).accepted);
+    QVERIFY(list.at(1).accepted);
+}
+
+void tst_LayerTestCache::retestChangedLayers()
+{
+    WOutputLayerTestCache cache;
+    QVERIFY(!commit(&cache, layers(2)));
+    QVERIFY(commit(&cache, layers(2)));
+
+    // A layer is added
+    QVERIFY(!commit(&cache, layers(3)));
+    QVERIFY(commit(&cache, layers(3)));
+
+    // A layer is removed
+    QVERIFY(!commit(&cache, layers(1)));
+    QVERIFY(commit(&cache, layers(1)));
+
+    // The layers are the same but the first one is replaced
+    auto list = layers(1);
+    list[0].layer = fakeLayer(2);
+    QVERIFY(!commit(&cache, list));
+}
+
+void tst_LayerTestCache::retestChangedBuffers()
+{
+    WOutputLayerTestCache cache;
+    QVERIFY(!commit(&cache, layers(2)));
+    QVERIFY(commit(&cache, layers(2)));
+
+    // The buffer is resized, the position and the size of the layer are not changed
+    auto resized = createBuffer(QSize(120, 100));
+    auto list = layers(2);
+    list[1].buffer = resized->handle();
+    QVERIFY(!commit(&cache, list));
+
+    // The format of the buffer is changed
+    auto xrgb = createBuffer(QSize(120, 100), QImage::Format_RGB32);
+    list = layers(2);
+    list[1].buffer = xrgb->handle();
+    QVERIFY(!commit(&cache, list));
+    list = layers(2);
+    list[1].buffer = xrgb->handle();
+    QVERIFY(commit(&cache, list));
+}
+
+void tst_LayerTestCache::retestMovedAcceptedLayers()
+{
+    WOutputLayerTestCache cache;
+    QVERIFY(!commit(&cache, layers(2)));
+
+    // The accepted layers maybe rejected at the new positions
+    QVERIFY(!commit(&cache, layers(2, QPoint(10, 0))));
+    QVERIFY(commit(&cache, layers(2, QPoint(10, 0))));
+    QVERIFY(!commit(&cache, layers(2, QPoint(20, 0))));
+}
+
+void tst_LayerTestCache::holdMovedRejectedLayers()
+{
+    WOutputLayerTestCache cache;
+    QVERIFY(!commit(&cache, layers(2), false));
+
+    // The moving rejected layers aren't tested every frame
+    for (int i = 1; i <= WOutputLayerTestCache::RejectedHoldFrames; ++i) {
+        auto list = layers(2, QPoint(i, 0));
+        bool ok = true;
+        QVERIFY(cache.reuse(nullptr, list, &ok));
+        QVERIFY(!ok);
+        QVERIFY(!list.at(0).accepted);
+        QVERIFY(!list.at(1).accepted);
+    }
+
+    // Tested again when they're moved too long
+    QVERIFY(!commit(&cache, layers(2, QPoint(100, 0))));
+    QVERIFY(commit(&cache, layers(2, QPoint(100, 0))));
+}
+
+void tst_LayerTestCache::retestAfterInvalidate()
+{
+    WOutputLayerTestCache cache;
+    QVERIFY(!commit(&cache, layers(2)));
+    QVERIFY(commit(&cache, layers(2)));
+
+    // e.g. the mode of the output is changed
+    cache.invalidate();
+    QVERIFY(!cache.isValid());
+    QVERIFY(!commit(&cache, layers(2)));
+    QVERIFY(commit(&cache, layers(2)));
+}
+
+void tst_LayerTestCache::retestAfterMaxReusedFrames()
+{
+    WOutputLayerTestCache cache;
+    QVERIFY(!commit(&cache, layers(2)));
+
+    for (int i = 0; i < WOutputLayerTestCache::MaxReusedFrames; ++i)
+        QVERIFY(commit(&cache, layers(2)));
+    QVERIFY(!commit(&cache, layers(2)));
+    QVERIFY(commit(&cache, layers(2)));
+}
+
+void tst_LayerTestCache::retestRejectedOnCommit()
+{
+    WOutputLayerTestCache cache;
+    QVERIFY(!commit(&cache, layers(2)));
+    auto list = layers(2);
+    bool ok = false;
+    QVERIFY(cache.reuse(nullptr, list, &ok));
+    // The same result is reported by the commit
+    cache.verifyCommit(list, true);
+    QVERIFY(cache.isValid());
+
+    // The driver rejects the accepted layer in the real commit
+    list = layers(2);
+    QVERIFY(cache.reuse(nullptr, list, &ok));
+    list[1].accepted = false;
+    cache.verifyCommit(list, true);
+    QVERIFY(!cache.isValid());
+    QVERIFY(!commit(&cache, layers(2), false));
+
+    // The commit is failed
+    QVERIFY(commit(&cache, layers(2), false));
+    cache.verifyCommit(layers(2), false);
+    QVERIFY(!cache.isValid());
+
+    // The rejected layers kept in software composition aren't compared
+    QVERIFY(!commit(&cache, layers(2), false));
+    list = layers(2, QPoint(10, 0));
+    QVERIFY(cache.reuse(nullptr, list, &ok));
+    list[0].accepted = true;
+    cache.verifyCommit(list, true);
+    QVERIFY(cache.isValid());
+}
+
+QTEST_APPLESS_MAIN(tst_LayerTestCache)
+#include "tst_layertestcache.moc"
@@ -0,0 +1,93 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "harness.h"
+#include "syntheticclients.h"
+
+#include <woutputrenderwindow.h>
+#include <wquickocclusionculler_p.h>
+
+#include <QTest>
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QtQml/qqmlextensionplugin.h>
+
+Q_IMPORT_QML_PLUGIN(BenchmarkPlugin)
+
+class tst_Occlusion : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void occludedFrameRate();
+
+private:
+    std::unique_ptr<Harness> m_harness;
+};
+
+static constexpr int ClientCount = 50;
+
+void tst_Occlusion::initTestCase()
+{
+    Harness::Options options;
+    options.windows = ClientCount;
+    // The cascaded clients on the right are partially out of the output
+    options.outputSize = QSize(800, 600);
+    options.clientSize = QSize(128, 128);
+    options.frameDriven = true;
+    options.occluder = true;
+    m_harness.reset(new Harness(options));
+    if (!m_harness->isValid())
+        QSKIP("The renderer isn't available");
+
+    m_harness->start();
+    QVERIFY(m_harness->waitForFrames(10));
+}
+
+void tst_Occlusion::cleanupTestCase()
+{
+    m_harness.reset();
+}
+
+// The clients below the fullscreen occluder get the frame callbacks from the
+// occludedFrameTimer only, about once a second, and commit as rarely as them.
+void tst_Occlusion::occludedFrameRate()
+{
+    auto culler = WQuickOcclusionCuller::get(m_harness->window());
+    QTRY_COMPARE_WITH_TIMEOUT(culler->occludedCount(), ClientCount, 10000);
+
+    auto clients = m_harness->clients();
+    // The frame callbacks requested before being occluded
+    QTest::qWait(1500);
+    clients->takeLatencies();
+    const quint64 commitCount = clients->commitCount();
+
+    QElapsedTimer timer;
+    timer.start();
+    QTest::qWait(3000);
+    const qreal seconds = timer.elapsed() / 1000.0;
+
+    const qreal frameDoneRate = clients->takeLatencies().size() / seconds / ClientCount;
+    const qreal commitRate = (clients->commitCount() - commitCount) / seconds / ClientCount;
+    qInfo() << "Per client, frame callbacks:" << frameDoneRate << "Hz, commits:" << commitRate << "Hz";
+
+    // Not the refresh rate of the output (60 Hz)
+    QVERIFY2(frameDoneRate > 0.5 && frameDoneRate < 2,
+             qPrintable(QString::number(frameDoneRate)));
+    QVERIFY2(commitRate < 2, qPrintable(QString::number(commitRate)));
+    QCOMPARE(culler->occludedCount(), ClientCount);
+}
+
+int main(int argc, char *argv[])
+{
+    Harness::initialize();
+    QGuiApplication app(argc, argv);
+
+    tst_Occlusion test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_occlusion.moc"
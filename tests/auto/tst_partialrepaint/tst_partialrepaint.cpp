@@ -0,0 +1,148 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "harness.h"
+#include "syntheticclients.h"
+
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <woutputcapture.h>
+#include <woutputviewport_p.h>
+#include <wbufferrenderer_p.h>
+
+#include <QTest>
+#include <QGuiApplication>
+#include <QPainter>
+#include <QQuickItem>
+#include <QSGRendererInterface>
+#include <QtQml/qqmlextensionplugin.h>
+
+Q_IMPORT_QML_PLUGIN(BenchmarkPlugin)
+
+// The whole buffer, a new capture reads back the last buffer in its first frame
+static QImage captureBuffer(WOutputViewport *viewport)
+{
+    WOutputCapture capture;
+    capture.setViewport(viewport);
+    if (!QTest::qWaitFor([&capture] { return capture.pendingFrames() > 0; }))
+        return QImage();
+
+    const auto frame = capture.takeFrame();
+    QImage image(frame.bufferSize, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    for (const auto &patch : frame.patches)
+        painter.drawImage(patch.rect.topLeft(), patch.image);
+
+    return image;
+}
+
+class tst_PartialRepaint : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void sameAsFullRepaint();
+
+private:
+    // Until the scene is static
+    void waitForIdle();
+
+    std::unique_ptr<Harness> m_harness;
+    std::unique_ptr<QQuickItem> m_probe;
+};
+
+void tst_PartialRepaint::initTestCase()
+{
+    Harness::Options options;
+    options.windows = 3;
+    options.outputSize = QSize(800, 600);
+    options.clientSize = QSize(128, 128);
+    m_harness.reset(new Harness(options));
+    if (!m_harness->isValid())
+        QSKIP("The gles2 renderer isn't available");
+
+    // Moving it can't be tracked by the item damages, it has no contents
+    m_probe.reset(new QQuickItem(m_harness->window()->contentItem()));
+
+    m_harness->start();
+    QVERIFY(m_harness->waitForFrames(10));
+    if (m_harness->window()->rendererInterface()->graphicsApi() != QSGRendererInterface::OpenGL)
+        QSKIP("PartialRepaint only works on the OpenGLES2 RHI backend");
+}
+
+void tst_PartialRepaint::cleanupTestCase()
+{
+    m_probe.reset();
+    m_harness.reset();
+}
+
+void tst_PartialRepaint::waitForIdle()
+{
+    while (m_harness->waitForFrames(1, 200)) { }
+}
+
+// The buffer partially repainted after the commits of the clients must be the same
+// as the whole buffer repainted, including the buffer-age damage of the older frames.
+void tst_PartialRepaint::sameAsFullRepaint()
+{
+    const auto viewports = m_harness->viewports();
+    QCOMPARE(viewports.size(), 1);
+    auto viewport = viewports.first();
+    auto renderer = WOutputViewportPrivate::get(viewport)->bufferRenderer;
+    QVERIFY(renderer);
+
+    bool partial = false;
+    int renderedBuffers = 0;
+    connect(renderer, &WBufferRenderer::bufferRendered, this, [&partial, &renderedBuffers, renderer] {
+        partial = renderer->isPartialRepaint();
+        ++renderedBuffers;
+    });
+
+    auto clients = m_harness->clients();
+    clients->setPaused(true);
+    waitForIdle();
+
+    // The damage ring keeps the whole damage of the older buffers for some frames
+    for (int i = 0; i < 8; ++i) {
+        clients->step();
+        QVERIFY(m_harness->waitForFrames(1));
+        waitForIdle();
+        if (partial)
+            break;
+    }
+    QVERIFY2(partial, "The buffer is never partially repainted");
+
+    const int bufferCount = renderedBuffers;
+    const QImage partialImage = captureBuffer(viewport);
+    QVERIFY(!partialImage.isNull());
+    // The capture must read the partially repainted buffer, it's read back in
+    // a frame of the window without rendering the output again.
+    QCOMPARE(renderedBuffers, bufferCount);
+
+    m_probe->setPosition(m_probe->position() + QPointF(1, 1));
+    QVERIFY(m_harness->waitForFrames(1));
+    waitForIdle();
+    QVERIFY(!partial);
+
+    const QImage fullImage = captureBuffer(viewport);
+    QVERIFY(!fullImage.isNull());
+    QCOMPARE(partialImage, fullImage);
+
+    clients->setPaused(false);
+}
+
+int main(int argc, char *argv[])
+{
+    Harness::initialize("gles2");
+    QGuiApplication app(argc, argv);
+
+    tst_PartialRepaint test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_partialrepaint.moc"
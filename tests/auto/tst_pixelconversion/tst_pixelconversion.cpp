@@ -0,0 +1,224 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <wtools.h>
+
+#include <QTest>
+#include <QImage>
+#include <QRandomGenerator>
+
+#include <cstring>
+
+WAYLIB_SERVER_USE_NAMESPACE
+
+using PixelKernels = WTools::PixelKernels;
+
+// The conversions supported by WTools::convertPixels
+#define CONVERSION(from, to) {QImage::from, QImage::to, #from, #to}
+static const struct {
+    QImage::Format from;
+    QImage::Format to;
+    const char *fromName;
+    const char *toName;
+} conversions[] = {
+    CONVERSION(Format_RGB32, Format_RGBX8888),
+    CONVERSION(Format_RGB32, Format_RGB888),
+    CONVERSION(Format_RGB32, Format_BGR888),
+    CONVERSION(Format_RGBX8888, Format_RGB32),
+    CONVERSION(Format_RGBX8888, Format_RGB888),
+    CONVERSION(Format_RGBX8888, Format_BGR888),
+    CONVERSION(Format_ARGB32, Format_RGBA8888),
+    CONVERSION(Format_ARGB32, Format_ARGB32_Premultiplied),
+    CONVERSION(Format_RGBA8888, Format_ARGB32),
+    CONVERSION(Format_RGBA8888, Format_RGBA8888_Premultiplied),
+    CONVERSION(Format_ARGB32_Premultiplied, Format_RGBA8888_Premultiplied),
+    CONVERSION(Format_ARGB32_Premultiplied, Format_ARGB32),
+    CONVERSION(Format_RGBA8888_Premultiplied, Format_ARGB32_Premultiplied),
+    CONVERSION(Format_RGBA8888_Premultiplied, Format_RGBA8888),
+    CONVERSION(Format_RGB30, Format_RGB32),
+    CONVERSION(Format_BGR30, Format_RGBX8888),
+    CONVERSION(Format_A2RGB30_Premultiplied, Format_ARGB32_Premultiplied),
+    CONVERSION(Format_A2BGR30_Premultiplied, Format_RGBA8888_Premultiplied),
+};
+#undef CONVERSION
+
+// The tails of the vectors are converted by the scalar kernels
+static const int widths[] = {1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 255, 1027};
+
+static const char *kernelsName(PixelKernels kernels)
+{
+    switch (kernels) {
+    case PixelKernels::Scalar: return "scalar";
+    case PixelKernels::SSE4: return "sse4";
+    case PixelKernels::AVX2: return "avx2";
+    case PixelKernels::NEON: return "neon";
+    }
+    Q_UNREACHABLE();
+}
+
+// Random pixels of all alpha values, the premultiplied formats get the valid pixels
+static QImage randomImage(int width, QImage::Format format)
+{
+    QImage image(width, 4, QImage::Format_ARGB32);
+    for (int y = 0; y < image.height(); ++y) {
+        auto line = reinterpret_cast<quint32*>(image.scanLine(y));
+        QRandomGenerator::global()->fillRange(line, width);
+        line[0] |= 0xff000000;
+        line[width - 1] &= 0x00ffffff;
+    }
+    return image.convertedTo(QImage::Format_ARGB32_Premultiplied).convertedTo(format);
+}
+
+static QImage convert(const QImage &source, QImage::Format format, bool flip)
+{
+    QImage result(source.size(), format);
+    result.fill(0);
+    if (!WTools::convertPixels(source.constBits(), source.bytesPerLine(), source.format(),
+                               result.bits(), result.bytesPerLine(), format,
+                               source.size(), flip)) {
+        return QImage();
+    }
+    return result;
+}
+
+// Compares the pixels only, the padding of the lines isn't written
+static bool samePixels(const QImage &a, const QImage &b)
+{
+    if (a.size() != b.size() || a.format() != b.format())
+        return false;
+
+    const int bytesPerLine = a.width() * a.depth() / 8;
+    for (int y = 0; y < a.height(); ++y) {
+        if (memcmp(a.constScanLine(y), b.constScanLine(y), bytesPerLine) != 0)
+            return false;
+    }
+    return true;
+}
+
+class tst_PixelConversion : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanup();
+
+    void vectorizedKernels_data();
+    void vectorizedKernels();
+    void scalarKernels_data();
+    void scalarKernels();
+
+private:
+    PixelKernels m_defaultKernels = PixelKernels::Scalar;
+    QList<PixelKernels> m_vectorizedKernels;
+};
+
+void tst_PixelConversion::initTestCase()
+{
+    m_defaultKernels = WTools::pixelKernels();
+    for (auto kernels : {PixelKernels::SSE4, PixelKernels::AVX2, PixelKernels::NEON}) {
+        if (WTools::setPixelKernels(kernels))
+            m_vectorizedKernels.append(kernels);
+    }
+    QVERIFY(WTools::setPixelKernels(m_defaultKernels));
+    QVERIFY(WTools::setPixelKernels(PixelKernels::Scalar));
+    QVERIFY(WTools::setPixelKernels(m_defaultKernels));
+}
+
+void tst_PixelConversion::cleanup()
+{
+    WTools::setPixelKernels(m_defaultKernels);
+}
+
+void tst_PixelConversion::vectorizedKernels_data()
+{
+    QTest::addColumn<int>("kernels");
+    QTest::addColumn<int>("from");
+    QTest::addColumn<int>("to");
+    QTest::addColumn<bool>("flip");
+
+    if (m_vectorizedKernels.isEmpty()) {
+        QTest::newRow("scalar only") << int(PixelKernels::Scalar)
+                                     << int(QImage::Format_Invalid) << int(QImage::Format_Invalid) << false;
+        return;
+    }
+
+    for (auto kernels : std::as_const(m_vectorizedKernels)) {
+        for (const auto &c : conversions) {
+            for (bool flip : {false, true}) {
+                QTest::addRow("%s: %s -> %s%s", kernelsName(kernels), c.fromName, c.toName,
+                              flip ? " flipped" : "")
+                    << int(kernels) << int(c.from) << int(c.to) << flip;
+            }
+        }
+    }
+}
+
+// The vectorized kernels must be bit-exact against the scalar kernels
+void tst_PixelConversion::vectorizedKernels()
+{
+    QFETCH(int, kernels);
+    QFETCH(int, from);
+    QFETCH(int, to);
+    QFETCH(bool, flip);
+
+    if (PixelKernels(kernels) == PixelKernels::Scalar)
+        QSKIP("The CPU has no vectorized kernels");
+
+    for (int width : widths) {
+        const QImage source = randomImage(width, QImage::Format(from));
+
+        QVERIFY(WTools::setPixelKernels(PixelKernels::Scalar));
+        const QImage expected = convert(source, QImage::Format(to), flip);
+        QVERIFY(!expected.isNull());
+
+        QVERIFY(WTools::setPixelKernels(PixelKernels(kernels)));
+        const QImage actual = convert(source, QImage::Format(to), flip);
+        QVERIFY(!actual.isNull());
+
+        QVERIFY2(samePixels(actual, expected), qPrintable(QString("width %1").arg(width)));
+    }
+}
+
+void tst_PixelConversion::scalarKernels_data()
+{
+    QTest::addColumn<int>("from");
+    QTest::addColumn<int>("to");
+    QTest::addColumn<bool>("flip");
+
+    for (const auto &c : conversions) {
+        // QImage rounds the 10 bits channels in another way
+        if (QImage::toPixelFormat(c.from).redSize() != 8)
+            continue;
+        for (bool flip : {false, true}) {
+            QTest::addRow("%s -> %s%s", c.fromName, c.toName, flip ? " flipped" : "")
+                << int(c.from) << int(c.to) << flip;
+        }
+    }
+    QTest::newRow("copy flipped") << int(QImage::Format_ARGB32_Premultiplied)
+                                  << int(QImage::Format_ARGB32_Premultiplied) << true;
+}
+
+// The scalar kernels must be the same as QImage, for the 8 bits channels
+void tst_PixelConversion::scalarKernels()
+{
+    QFETCH(int, from);
+    QFETCH(int, to);
+    QFETCH(bool, flip);
+
+    QVERIFY(WTools::setPixelKernels(PixelKernels::Scalar));
+    for (int width : widths) {
+        const QImage source = randomImage(width, QImage::Format(from));
+        QImage expected = source.convertedTo(QImage::Format(to));
+        if (flip)
+            expected = expected.mirrored(false, true);
+
+        const QImage actual = convert(source, QImage::Format(to), flip);
+        QVERIFY(!actual.isNull());
+        QVERIFY2(samePixels(actual, expected), qPrintable(QString("width %1").arg(width)));
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_PixelConversion)
+
+#include "tst_pixelconversion.moc"
@@ -0,0 +1,148 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "harness.h"
+
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <woutputviewport_p.h>
+#include <wsurfaceitem.h>
+#include <wsurface.h>
+
+#include <QTest>
+#include <QGuiApplication>
+#include <QQuickItem>
+#include <QtQml/qqmlextensionplugin.h>
+
+Q_IMPORT_QML_PLUGIN(BenchmarkPlugin)
+
+// An item painted above the surfaces, only its flag is tested
+class ContentItem : public QQuickItem
+{
+public:
+    explicit ContentItem(QQuickItem *parent)
+        : QQuickItem(parent) {
+        setFlag(ItemHasContents);
+    }
+};
+
+static WSurfaceItemContent *findContent(QQuickItem *item, const QSize &size)
+{
+    auto content = qobject_cast<WSurfaceItemContent*>(item);
+    if (content && content->surface() && content->surface()->size() == size)
+        return content;
+
+    for (QQuickItem *child : item->childItems()) {
+        if (auto content = findContent(child, size))
+            return content;
+    }
+
+    return nullptr;
+}
+
+class tst_Scanout : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void opaqueFullscreen();
+    void transformed();
+    void itemAbove();
+
+private:
+    WSurfaceItemContent *candidate() const;
+
+    std::unique_ptr<Harness> m_harness;
+    WOutputViewport *m_viewport = nullptr;
+    QPointer<WSurfaceItemContent> m_occluder;
+};
+
+static constexpr QSize OutputSize(800, 600);
+
+void tst_Scanout::initTestCase()
+{
+    Harness::Options options;
+    options.windows = 1;
+    options.outputSize = OutputSize;
+    options.clientSize = QSize(128, 128);
+    // The fullscreen client with an opaque buffer, mapped above the others
+    options.occluder = true;
+    m_harness.reset(new Harness(options));
+    if (!m_harness->isValid())
+        QSKIP("The renderer isn't available");
+
+    m_harness->start();
+    QVERIFY(m_harness->waitForFrames(10));
+
+    const auto viewports = m_harness->viewports();
+    QCOMPARE(viewports.size(), 1);
+    m_viewport = viewports.first();
+    QVERIFY(m_viewport->input());
+
+    QTRY_VERIFY((m_occluder = findContent(m_viewport->input(), OutputSize)));
+    QTRY_VERIFY(m_occluder->surface()->buffer());
+}
+
+void tst_Scanout::cleanupTestCase()
+{
+    m_harness.reset();
+}
+
+WSurfaceItemContent *tst_Scanout::candidate() const
+{
+    return WOutputViewportPrivate::get(m_viewport)->scanoutCandidate();
+}
+
+void tst_Scanout::opaqueFullscreen()
+{
+    QCOMPARE(candidate(), m_occluder.get());
+}
+
+// Only the buffer displayed as is can be attached to the output
+void tst_Scanout::transformed()
+{
+    QQuickItem *surfaceItem = m_occluder->parentItem();
+    while (surfaceItem && !qobject_cast<WSurfaceItem*>(surfaceItem))
+        surfaceItem = surfaceItem->parentItem();
+    QVERIFY(surfaceItem);
+
+    surfaceItem->setScale(0.5);
+    QCOMPARE(candidate(), nullptr);
+    surfaceItem->setScale(1.0);
+    QCOMPARE(candidate(), m_occluder.get());
+
+    surfaceItem->setTransformOrigin(QQuickItem::Center);
+    surfaceItem->setRotation(90);
+    QCOMPARE(candidate(), nullptr);
+    surfaceItem->setRotation(0);
+    QCOMPARE(candidate(), m_occluder.get());
+}
+
+void tst_Scanout::itemAbove()
+{
+    std::unique_ptr<ContentItem> item(new ContentItem(m_viewport->input()));
+    item->setSize(QSizeF(10, 10));
+    item->setZ(1);
+    QCOMPARE(candidate(), nullptr);
+
+    // Out of the output
+    item->setPosition(QPointF(OutputSize.width(), OutputSize.height()));
+    QCOMPARE(candidate(), m_occluder.get());
+
+    item.reset();
+    QCOMPARE(candidate(), m_occluder.get());
+}
+
+int main(int argc, char *argv[])
+{
+    Harness::initialize();
+    QGuiApplication app(argc, argv);
+
+    tst_Scanout test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_scanout.moc"
@@ -0,0 +1,122 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+import QtQuick
+import Waylib.Server
+import Benchmark
+
+Item {
+    id :root
+
+    OutputRenderWindow {
+        id: renderWindow
+
+        width: outputsContainer.implicitWidth
+        height: outputsContainer.implicitHeight
+
+        Row {
+            id: outputsContainer
+
+            anchors.fill: parent
+
+            DynamicCreatorComponent {
+                id: outputDelegateCreator
+                creator: Helper.outputCreator
+
+                OutputItem {
+                    id: rootOutputItem
+                    required property WaylandOutput waylandOutput
+
+                    output: waylandOutput
+                    devicePixelRatio: waylandOutput.scale
+                    layout: outputLayout
+
+                    OutputViewport {
+                        id: outputViewport
+                        input: contents
+                        output: waylandOutput
+                        devicePixelRatio: rootOutputItem.devicePixelRatio
+                        anchors.centerIn: parent
+                        mirrorSource: Helper.mirrorSource !== outputViewport ? Helper.mirrorSource : null
+                    }
+
+                    Item {
+                        id: contents
+                        anchors.fill: parent
+                        // The mirrors don't render their contents
+                        visible: !outputViewport.mirrorSource
+                        Rectangle {
+                            anchors.fill: parent
+                            color: "black"
+                        }
+                        DynamicCreatorComponent {
+                            id: toplevelComponent
+                            creator: Helper.xdgShellCreator
+
+                            XdgSurfaceItem {
+                                required property WaylandXdgSurface waylandSurface
+                                shellSurface: waylandSurface
+
+                                OutputLayer.enabled: Helper.layers
+                                OutputLayer.outputs: [outputViewport]
+
+                                // Like the server side decorations, drawn above the surface
+                                Rectangle {
+                                    visible: Helper.decorations
+                                    width: parent.width
+                                    height: 24
+                                    color: "steelblue"
+
+                                    Text {
+                                        anchors.centerIn: parent
+                                        text: "waylib-benchmark"
+                                        color: "white"
+                                    }
+                                }
+
+                                Rectangle {
+                                    visible: Helper.decorations
+                                    anchors.fill: parent
+                                    color: "transparent"
+                                    border.color: "gray"
+                                    border.width: 1
+                                }
+                            }
+                        }
+
+                        // Like a clock on the panel, keeps rendering while the windows are occluded
+                        Rectangle {
+                            id: ticker
+                            visible: Helper.ticking
+                            z: 2
+                            width: 16
+                            height: 16
+                            color: "white"
+
+                            Timer {
+                                interval: 16
+                                repeat: true
+                                running: ticker.visible
+                                onTriggered: ticker.x = (ticker.x + 1) % 100
+                            }
+                        }
+
+                        // Like the blur panels, they copy the contents behind them every frame
+                        Repeater {
+                            model: Helper.effects
+
+                            RenderBufferBlitter {
+                                required property int index
+                                x: 100 + index * 150
+                                y: 100 + index * 100
+                                z: 1
+                                width: 400
+                                height: 300
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,46 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic_uint64_t allocations = 0;
+static thread_local bool countAllocations = false;
+
+void *operator new(std::size_t size)
+{
+    if (countAllocations)
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace AllocationCounter {
+
+void start()
+{
+    allocations = 0;
+    countAllocations = true;
+}
+
+quint64 stop()
+{
+    countAllocations = false;
+    return allocations;
+}
+
+}
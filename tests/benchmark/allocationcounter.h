@@ -0,0 +1,15 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <QtGlobal>
+
+// Counts the C++ allocations of the current thread, the C allocations of wlroots are
+// not included. It replaces the global operator new, so it's only linked to the
+// benchmark-allocations binary, see BENCHMARK_COUNT_ALLOCATIONS.
+namespace AllocationCounter {
+void start();
+// Returns the allocations since start
+quint64 stop();
+}
@@ -0,0 +1,92 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "scenario.h"
+#include "harness.h"
+
+#include <WOutput>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <woutputcapture.h>
+
+#include <QPainter>
+
+// The first output is captured, the consumer applies the patches of the frames to
+// its own image every N frames.
+class CaptureScenario : public Scenario
+{
+public:
+    CaptureScenario(Harness *harness, int interval);
+
+    void begin() override;
+    void frame() override;
+    void end(QJsonObject *result) override;
+
+private:
+    int m_interval;
+    int m_frameCount = 0;
+    WOutputCapture m_capture;
+    QImage m_image;
+    quint64 m_takenFrames = 0;
+    quint64 m_startCapturedFrames = 0;
+    quint64 m_startDroppedFrames = 0;
+    quint64 m_startCapturedBytes = 0;
+};
+
+CaptureScenario::CaptureScenario(Harness *harness, int interval)
+    : Scenario(harness)
+    , m_interval(interval)
+{
+    QObject::connect(harness->window(), &WOutputRenderWindow::outputViewportInitialized,
+                     &m_capture, [this] (WOutputViewport *viewport) {
+        if (!m_capture.viewport())
+            m_capture.setViewport(viewport);
+    });
+}
+
+void CaptureScenario::begin()
+{
+    m_takenFrames = 0;
+    m_startCapturedFrames = m_capture.capturedFrames();
+    m_startDroppedFrames = m_capture.droppedFrames();
+    m_startCapturedBytes = m_capture.capturedBytes();
+}
+
+void CaptureScenario::frame()
+{
+    if (++m_frameCount % m_interval != 0)
+        return;
+
+    while (m_capture.pendingFrames() > 0) {
+        const auto frame = m_capture.takeFrame();
+        if (m_image.size() != frame.bufferSize)
+            m_image = QImage(frame.bufferSize, QImage::Format_ARGB32_Premultiplied);
+        QPainter painter(&m_image);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        for (const auto &patch : frame.patches)
+            painter.drawImage(patch.rect.topLeft(), patch.image);
+        ++m_takenFrames;
+    }
+}
+
+void CaptureScenario::end(QJsonObject *result)
+{
+    // Only the damaged rects are read back, compared to the whole buffer
+    const qint64 capturedFrames = m_capture.capturedFrames() - m_startCapturedFrames;
+    const QSize pixelSize = m_capture.viewport() ? m_capture.viewport()->output()->size() : QSize();
+    result->insert("capture", QJsonObject {
+        {"interval", m_interval},
+        {"frames", capturedFrames},
+        {"takenFrames", qint64(m_takenFrames)},
+        {"droppedFrames", qint64(m_capture.droppedFrames() - m_startDroppedFrames)},
+        {"bytesPerFrame", capturedFrames > 0
+                              ? double(m_capture.capturedBytes() - m_startCapturedBytes) / capturedFrames
+                              : 0.0},
+        {"bytesPerFullFrame", qint64(pixelSize.width()) * pixelSize.height() * 4},
+    });
+}
+
+std::unique_ptr<Scenario> createCaptureScenario(Harness *harness, int interval)
+{
+    return std::make_unique<CaptureScenario>(harness, interval);
+}
@@ -0,0 +1,86 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "scenario.h"
+#include "harness.h"
+#include "helper.h"
+
+#include <WServer>
+#include <wsocket.h>
+#include <wclientstatsmodel.h>
+
+// The iterations of WServer::processWaylandEvents in the measured frames
+class DispatchScenario : public Scenario
+{
+public:
+    DispatchScenario(Harness *harness, int budget);
+
+    void begin() override;
+    void end(QJsonObject *result) override;
+
+private:
+    bool m_budgeted;
+    // Keeps the dispatch time of the clients counted
+    WClientStatsModel m_statsModel;
+    WServer::DispatchStats m_startStats;
+    // The dispatch time of the clients, to check the fairness between them
+    QHash<WClient*, qint64> m_startDispatchTimes;
+};
+
+DispatchScenario::DispatchScenario(Harness *harness, int budget)
+    : Scenario(harness)
+    , m_budgeted(budget >= 0)
+{
+    if (m_budgeted) {
+        auto server = harness->helper()->server();
+        server->setDispatchMode(WServer::DispatchMode::Budgeted);
+        server->setDispatchBudget(budget);
+    }
+}
+
+void DispatchScenario::begin()
+{
+    m_startStats = m_harness->helper()->server()->dispatchStats();
+    m_startDispatchTimes.clear();
+    for (auto client : m_harness->helper()->socket()->clients())
+        m_startDispatchTimes.insert(client, client->stats().dispatchTime);
+}
+
+void DispatchScenario::end(QJsonObject *result)
+{
+    const auto &stats = m_harness->helper()->server()->dispatchStats();
+    const qint64 iterations = stats.iterations - m_startStats.iterations;
+
+    qint64 totalClientTime = 0;
+    qint64 maxClientTime = 0;
+    const auto &clients = m_harness->helper()->socket()->clients();
+    for (auto client : clients) {
+        const qint64 time = client->stats().dispatchTime - m_startDispatchTimes.value(client);
+        totalClientTime += time;
+        maxClientTime = qMax(maxClientTime, time);
+    }
+
+    result->insert("dispatch", QJsonObject {
+        {"mode", m_budgeted ? "budgeted" : "unbounded"},
+        {"iterations", iterations},
+        {"rounds", qint64(stats.rounds - m_startStats.rounds)},
+        {"budgetYields", qint64(stats.budgetYields - m_startStats.budgetYields)},
+        {"deadlineYields", qint64(stats.deadlineYields - m_startStats.deadlineYields)},
+        {"avgMs", iterations > 0 ? (stats.totalDuration - m_startStats.totalDuration) / 1e6 / iterations : 0.0},
+        {"maxMs", stats.maxDuration / 1e6},
+        {"maxReadySources", stats.maxReadySources},
+        {"flushedClientsPerIteration", iterations > 0
+                                           ? double(stats.totalFlushedClients - m_startStats.totalFlushedClients) / iterations
+                                           : 0.0},
+        {"clientDispatchMs", totalClientTime / 1e6},
+        // 1 if the time is spent evenly, the number of the clients if only one is served
+        {"maxClientDispatchShare", totalClientTime > 0
+                                       ? double(maxClientTime) * clients.size() / totalClientTime
+                                       : 0.0},
+    });
+}
+
+std::unique_ptr<Scenario> createDispatchScenario(Harness *harness, int budget)
+{
+    return std::make_unique<DispatchScenario>(harness, budget);
+}
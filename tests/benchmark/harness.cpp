@@ -0,0 +1,149 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "harness.h"
+#include "helper.h"
+#include "syntheticclients.h"
+
+#include <WServer>
+#include <wsocket.h>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <wframestats.h>
+
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QQmlApplicationEngine>
+#include <QEventLoop>
+#include <QTimer>
+
+QW_USE_NAMESPACE
+
+void Harness::initialize(const QByteArray &renderer)
+{
+    // Force the headless backend, the renderer can be overridden by the environment
+    qputenv("WLR_BACKENDS", "headless");
+    if (!qEnvironmentVariableIsSet("WLR_RENDERER"))
+        qputenv("WLR_RENDERER", renderer);
+
+    WRenderHelper::setupRendererBackend();
+    qw_log::init();
+    WServer::initializeQPA();
+
+    QGuiApplication::setHighDpiScaleFactorRoundingPolicy(Qt::HighDpiScaleFactorRoundingPolicy::PassThrough);
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+}
+
+QByteArray Harness::renderer()
+{
+    return qgetenv("WLR_RENDERER");
+}
+
+Harness::Harness(const Options &options)
+    : m_options(options)
+    , m_engine(new QQmlApplicationEngine)
+{
+    m_engine->loadFromModule("Benchmark", "Main");
+
+    m_window = m_engine->rootObjects().first()->findChild<WOutputRenderWindow*>();
+    Q_ASSERT(m_window);
+
+    m_helper = m_engine->singletonInstance<Helper*>("Benchmark", "Helper");
+    Q_ASSERT(m_helper);
+
+    m_helper->setLayers(options.layers);
+    m_helper->setEffects(options.effects);
+    m_helper->setScales(options.scales);
+    m_helper->setOccluderIndex(options.occluder ? options.windows : -1);
+    m_helper->setMirror(options.mirror);
+    m_helper->setDecorations(options.decorations);
+    // The occluded clients don't trigger rendering, keep the frames going
+    m_helper->setTicking(options.occluder);
+    m_valid = m_helper->initProtocols(m_window, m_engine.get());
+    if (!m_valid)
+        return;
+
+    QObject::connect(m_window, &WOutputRenderWindow::outputViewportInitialized,
+                     m_window, [this] (WOutputViewport *viewport) {
+        m_viewports.append(viewport);
+    });
+    QObject::connect(m_window, &WOutputRenderWindow::renderEnd, m_window, [this] {
+        ++m_frameCount;
+    });
+}
+
+Harness::~Harness()
+{
+    stop();
+}
+
+void Harness::start()
+{
+    Q_ASSERT(m_valid);
+    m_helper->addOutputs(m_options.outputs, m_options.outputSize, m_options.refresh * 1000);
+    m_window->setDisableLayers(!m_options.layers);
+    m_window->setThreadedRendering(m_options.threaded);
+    m_window->setParallelRendering(m_options.parallel);
+    m_window->setAdaptiveFrameScheduling(m_options.adaptiveScheduling);
+    m_window->setAutoLayerization(m_options.autoLayers);
+    m_window->setSoftwareRenderThreads(m_options.tileThreads);
+    m_window->frameStats()->setHistorySize(m_options.historySize);
+    m_window->frameStats()->setEnabled(true);
+
+    m_clients.reset(new SyntheticClients(m_helper->socket()->fullServerName().toLocal8Bit(),
+                                         m_options.windows, m_options.rate, m_options.clientSize));
+    m_clients->setFrameDriven(m_options.frameDriven);
+    m_clients->setIdleCount(m_options.idle);
+    if (m_options.occluder)
+        m_clients->setOccluder(m_options.outputSize);
+    m_clients->start();
+}
+
+void Harness::stop()
+{
+    if (m_clients)
+        m_clients->stop();
+}
+
+WOutputRenderWindow *Harness::window() const
+{
+    return m_window;
+}
+
+Helper *Harness::helper() const
+{
+    return m_helper;
+}
+
+SyntheticClients *Harness::clients() const
+{
+    return m_clients.get();
+}
+
+QList<WOutputViewport*> Harness::viewports() const
+{
+    QList<WOutputViewport*> list;
+    for (const auto &viewport : m_viewports) {
+        if (viewport)
+            list.append(viewport);
+    }
+    return list;
+}
+
+bool Harness::waitForFrames(int frames, int timeout)
+{
+    const int target = m_frameCount + frames;
+    QEventLoop loop;
+    QTimer::singleShot(timeout, &loop, &QEventLoop::quit);
+    // Connected after the counter of the frames in the constructor
+    auto connection = QObject::connect(m_window, &WOutputRenderWindow::renderEnd, &loop, [&] {
+        if (m_frameCount >= target)
+            loop.quit();
+    });
+    loop.exec();
+    QObject::disconnect(connection);
+
+    return m_frameCount >= target;
+}
@@ -0,0 +1,99 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QList>
+#include <QPointer>
+#include <QSize>
+
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+class QQmlApplicationEngine;
+QT_END_NAMESPACE
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+class WOutputRenderWindow;
+class WOutputViewport;
+WAYLIB_SERVER_END_NAMESPACE
+
+WAYLIB_SERVER_USE_NAMESPACE
+
+class Helper;
+class SyntheticClients;
+// The compositor of the benchmark and the tests, the outputs of the headless backend
+// show the windows of the synthetic clients.
+class Harness
+{
+public:
+    struct Options {
+        int windows = 1;
+        int outputs = 1;
+        QSize outputSize = QSize(1920, 1080);
+        // In Hz
+        int refresh = 60;
+        int rate = 60;
+        QSize clientSize = QSize(256, 256);
+        QList<float> scales = {1};
+        bool layers = false;
+        bool threaded = false;
+        bool parallel = false;
+        bool adaptiveScheduling = false;
+        bool frameDriven = false;
+        bool occluder = false;
+        bool mirror = false;
+        int tileThreads = 1;
+        int idle = 0;
+        bool decorations = false;
+        bool autoLayers = false;
+        int effects = 0;
+        // The frames kept by WFrameStats
+        int historySize = 300;
+    };
+
+    // Must be called before creating QGuiApplication, the renderer is the WLR_RENDERER
+    // of wlroots, "pixman" or "gles2".
+    static void initialize(const QByteArray &renderer = "pixman");
+    static QByteArray renderer();
+
+    explicit Harness(const Options &options);
+    ~Harness();
+
+    // False if the renderer can't be created, e.g. gles2 without the GPU
+    inline bool isValid() const {
+        return m_valid;
+    }
+
+    // Creates the outputs and connects the clients
+    void start();
+    void stop();
+
+    inline const Options &options() const {
+        return m_options;
+    }
+    WOutputRenderWindow *window() const;
+    Helper *helper() const;
+    SyntheticClients *clients() const;
+    // The viewports in the order of the outputs
+    QList<WOutputViewport*> viewports() const;
+
+    // The frames rendered by the window
+    inline int frameCount() const {
+        return m_frameCount;
+    }
+    // Runs the event loop until the frames are rendered, returns false if timeout
+    bool waitForFrames(int frames, int timeout = 10000);
+
+private:
+    Options m_options;
+    std::unique_ptr<QQmlApplicationEngine> m_engine;
+    WOutputRenderWindow *m_window = nullptr;
+    Helper *m_helper = nullptr;
+    std::unique_ptr<SyntheticClients> m_clients;
+    QList<QPointer<WOutputViewport>> m_viewports;
+    int m_frameCount = 0;
+    bool m_valid = false;
+};
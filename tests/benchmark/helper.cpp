@@ -0,0 +1,173 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "helper.h"
+
+#include <WServer>
+#include <wsocket.h>
+#include <WXdgShell>
+#include <WOutput>
+#include <WBackend>
+#include <WXdgSurface>
+#include <wquickoutputlayout.h>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <wqmlcreator_p.h>
+
+#include <qwbackend.h>
+#include <qwdisplay.h>
+#include <qwoutput.h>
+#include <qwcompositor.h>
+#include <qwsubcompositor.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+
+#include <QQmlEngine>
+
+QW_USE_NAMESPACE
+
+Helper::Helper(QObject *parent)
+    : QObject(parent)
+    , m_server(new WServer(this))
+    , m_outputCreator(new WQmlCreator(this))
+    , m_xdgShellCreator(new WQmlCreator(this))
+    , m_outputLayout(new WQuickOutputLayout(this))
+{
+
+}
+
+bool Helper::initProtocols(WOutputRenderWindow *window, QQmlEngine *qmlEngine)
+{
+    m_backend = m_server->attach<WBackend>();
+    m_server->start();
+
+    m_renderer = WRenderHelper::createRenderer(m_backend->handle());
+
+    // The tests of the gles2 renderer are skipped without the GPU
+    if (!m_renderer) {
+        qWarning("Failed to create renderer");
+        return false;
+    }
+
+    m_socket = new WSocket(false);
+    if (m_socket->autoCreate()) {
+        m_server->addSocket(m_socket);
+    } else {
+        delete m_socket;
+        m_socket = nullptr;
+        qFatal("Failed to create socket");
+    }
+
+    connect(m_backend, &WBackend::outputAdded, this, [this, qmlEngine] (WOutput *output) {
+        auto initProperties = qmlEngine->newObject();
+        initProperties.setProperty("waylandOutput", qmlEngine->toScriptValue(output));
+        initProperties.setProperty("layout", qmlEngine->toScriptValue(m_outputLayout));
+        initProperties.setProperty("x", qmlEngine->toScriptValue(m_outputLayout->implicitWidth()));
+
+        m_outputCreator->add(output, initProperties);
+    });
+
+    connect(m_backend, &WBackend::outputRemoved, this, [this] (WOutput *output) {
+        m_outputCreator->removeByOwner(output);
+    });
+
+    m_allocator = qw_allocator::autocreate(*m_backend->handle(), *m_renderer);
+    m_renderer->init_wl_display(*m_server->handle());
+
+    m_compositor = qw_compositor::create(*m_server->handle(), 6, *m_renderer);
+    qw_subcompositor::create(*m_server->handle());
+
+    connect(window, &WOutputRenderWindow::outputViewportInitialized, this, [this] (WOutputViewport *viewport) {
+        WOutput *output = viewport->output();
+        auto qwoutput = output->handle();
+
+        // See tests/manual/live, must commit here to ensure trigger QWOutput::frame signal
+        if (!qwoutput->property("_Enabled").toBool()) {
+            qwoutput->setProperty("_Enabled", true);
+            output->setCustomMode(m_outputSize, m_refresh);
+            if (!m_scales.isEmpty())
+                qwoutput->set_scale(m_scales.at(m_outputCount++ % m_scales.size()));
+            output->enable(true);
+            bool ok = output->commit();
+            Q_ASSERT(ok);
+        }
+
+        if (m_mirror && !m_mirrorSource) {
+            m_mirrorSource = viewport;
+            Q_EMIT mirrorSourceChanged();
+        }
+    });
+    window->init(m_renderer, m_allocator);
+
+    auto *xdgShell = m_server->attach<WXdgShell>();
+
+    connect(xdgShell, &WXdgShell::surfaceAdded, this, [this, qmlEngine](WXdgSurface *surface) {
+        if (surface->isPopup())
+            return;
+
+        // Cascade the windows, a new row every 20 windows
+        const int index = m_surfaceCount++;
+        auto initProperties = qmlEngine->newObject();
+        initProperties.setProperty("waylandSurface", qmlEngine->toScriptValue(surface));
+        if (index == m_occluderIndex) {
+            initProperties.setProperty("x", 0);
+            initProperties.setProperty("y", 0);
+        } else {
+            initProperties.setProperty("x", (index % 20) * 40 + (index / 20) * 10);
+            initProperties.setProperty("y", (index % 20) * 20 + (index / 20) * 10);
+        }
+        m_xdgShellCreator->add(surface, initProperties);
+    });
+    connect(xdgShell, &WXdgShell::surfaceRemoved, m_xdgShellCreator, &WQmlCreator::removeByOwner);
+
+    m_backend->handle()->start();
+    return true;
+}
+
+void Helper::addOutputs(int count, const QSize &size, int refresh)
+{
+    m_outputSize = size;
+    m_refresh = refresh;
+
+    for (int i = 0; i < count; ++i) {
+        qobject_cast<qw_multi_backend*>(m_backend->handle())->for_each_backend([] (wlr_backend *backend, void *data) {
+            if (auto headless = qw_headless_backend::from(backend)) {
+                const QSize &size = *static_cast<QSize*>(data);
+                headless->add_output(size.width(), size.height());
+            }
+        }, &m_outputSize);
+    }
+}
+
+void Helper::setLayers(bool layers)
+{
+    if (m_layers == layers)
+        return;
+    m_layers = layers;
+    Q_EMIT layersChanged();
+}
+
+void Helper::setEffects(int effects)
+{
+    if (m_effects == effects)
+        return;
+    m_effects = effects;
+    Q_EMIT effectsChanged();
+}
+
+void Helper::setTicking(bool ticking)
+{
+    if (m_ticking == ticking)
+        return;
+    m_ticking = ticking;
+    Q_EMIT tickingChanged();
+}
+
+void Helper::setDecorations(bool decorations)
+{
+    if (m_decorations == decorations)
+        return;
+    m_decorations = decorations;
+    Q_EMIT decorationsChanged();
+}
@@ -0,0 +1,127 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+#include <wqmlcreator.h>
+
+#include <QObject>
+#include <QQmlEngine>
+#include <QSize>
+
+Q_MOC_INCLUDE(<woutputviewport.h>)
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+class WServer;
+class WSocket;
+class WOutputRenderWindow;
+class WOutputViewport;
+class WQuickOutputLayout;
+class WBackend;
+WAYLIB_SERVER_END_NAMESPACE
+
+QW_BEGIN_NAMESPACE
+class qw_renderer;
+class qw_allocator;
+class qw_compositor;
+QW_END_NAMESPACE
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+class Q_DECL_HIDDEN Helper : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(WQmlCreator* outputCreator MEMBER m_outputCreator CONSTANT)
+    Q_PROPERTY(WQmlCreator* xdgShellCreator MEMBER m_xdgShellCreator CONSTANT)
+    Q_PROPERTY(bool layers READ layers NOTIFY layersChanged FINAL)
+    Q_PROPERTY(int effects READ effects NOTIFY effectsChanged FINAL)
+    Q_PROPERTY(bool ticking READ ticking NOTIFY tickingChanged FINAL)
+    Q_PROPERTY(bool decorations READ decorations NOTIFY decorationsChanged FINAL)
+    Q_PROPERTY(WOutputViewport* mirrorSource READ mirrorSource NOTIFY mirrorSourceChanged FINAL)
+    QML_ELEMENT
+    QML_SINGLETON
+
+public:
+    explicit Helper(QObject *parent = nullptr);
+
+    bool initProtocols(WOutputRenderWindow *window, QQmlEngine *qmlEngine);
+    void addOutputs(int count, const QSize &size, int refresh);
+    // The scales of the outputs, repeated if there are more outputs
+    inline void setScales(const QList<float> &scales) {
+        m_scales = scales;
+    }
+    // The window at the index is placed at the top left of the first output
+    inline void setOccluderIndex(int index) {
+        m_occluderIndex = index;
+    }
+    // The other outputs mirror the first output
+    inline void setMirror(bool mirror) {
+        m_mirror = mirror;
+    }
+
+    inline WServer *server() const {
+        return m_server;
+    }
+
+    inline WSocket *socket() const {
+        return m_socket;
+    }
+
+    inline bool layers() const {
+        return m_layers;
+    }
+    void setLayers(bool layers);
+
+    inline int effects() const {
+        return m_effects;
+    }
+    void setEffects(int effects);
+
+    inline bool ticking() const {
+        return m_ticking;
+    }
+    void setTicking(bool ticking);
+
+    inline bool decorations() const {
+        return m_decorations;
+    }
+    void setDecorations(bool decorations);
+
+    inline WOutputViewport *mirrorSource() const {
+        return m_mirrorSource;
+    }
+
+Q_SIGNALS:
+    void layersChanged();
+    void effectsChanged();
+    void tickingChanged();
+    void decorationsChanged();
+    void mirrorSourceChanged();
+
+private:
+    WServer *m_server = nullptr;
+    WQmlCreator *m_outputCreator = nullptr;
+    WQmlCreator *m_xdgShellCreator = nullptr;
+
+    WBackend *m_backend = nullptr;
+    qw_renderer *m_renderer = nullptr;
+    qw_allocator *m_allocator = nullptr;
+    qw_compositor *m_compositor = nullptr;
+    WQuickOutputLayout *m_outputLayout = nullptr;
+    WSocket *m_socket = nullptr;
+    WOutputViewport *m_mirrorSource = nullptr;
+
+    QSize m_outputSize;
+    int m_refresh = 0;
+    QList<float> m_scales;
+    int m_outputCount = 0;
+    int m_surfaceCount = 0;
+    int m_occluderIndex = -1;
+    int m_effects = 0;
+    bool m_layers = false;
+    bool m_ticking = false;
+    bool m_decorations = false;
+    bool m_mirror = false;
+};
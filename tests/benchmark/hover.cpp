@@ -0,0 +1,100 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "scenario.h"
+#include "harness.h"
+
+#include <woutputrenderwindow.h>
+#include <wquickhittestindex_p.h>
+
+#include <QElapsedTimer>
+#include <QQuickItem>
+#include <QRandomGenerator>
+
+// Same order as the hover delivery of QQuickDeliveryAgent, the children are tested
+// before their parent, and the children are sorted by the z value.
+static QQuickItem *hoverItemByTreeWalk(QQuickItem *item, const QPointF &scenePos)
+{
+    if (!item->isVisible())
+        return nullptr;
+
+    const QPointF localPos = item->mapFromScene(scenePos);
+    if (item->clip() && !item->contains(localPos))
+        return nullptr;
+
+    auto children = item->childItems();
+    std::stable_sort(children.begin(), children.end(), [] (QQuickItem *a, QQuickItem *b) {
+        return a->z() < b->z();
+    });
+    for (int i = children.size() - 1; i >= 0; --i) {
+        if (auto target = hoverItemByTreeWalk(children.at(i), scenePos))
+            return target;
+    }
+
+    if (item->acceptHoverEvents() && item->contains(localPos))
+        return item;
+    return nullptr;
+}
+
+// The hit-testing rates of the tree walk and WQuickHitTestIndex
+class HoverScenario : public Scenario
+{
+public:
+    HoverScenario(Harness *harness, int events)
+        : Scenario(harness)
+        , m_events(events) {}
+
+    void end(QJsonObject *result) override;
+
+private:
+    int m_events;
+};
+
+void HoverScenario::end(QJsonObject *result)
+{
+    QQuickWindow *window = m_harness->window();
+    QRandomGenerator random(m_events);
+    QList<QPointF> positions;
+    positions.reserve(m_events);
+    for (int i = 0; i < m_events; ++i) {
+        positions.append(QPointF(random.bounded(qreal(window->width())),
+                                 random.bounded(qreal(window->height()))));
+    }
+
+    QList<QQuickItem*> treeWalkResults;
+    treeWalkResults.reserve(m_events);
+    QElapsedTimer timer;
+    timer.start();
+    for (const auto &pos : std::as_const(positions))
+        treeWalkResults.append(hoverItemByTreeWalk(window->contentItem(), pos));
+    const qint64 treeWalkTime = timer.nsecsElapsed();
+
+    auto index = WQuickHitTestIndex::get(window);
+    index->invalidate();
+    timer.restart();
+    index->hoverItemAt(QPointF());
+    const qint64 rebuildTime = timer.nsecsElapsed();
+
+    int mismatches = 0;
+    timer.restart();
+    for (int i = 0; i < m_events; ++i) {
+        if (index->hoverItemAt(positions.at(i)) != treeWalkResults.at(i))
+            ++mismatches;
+    }
+    const qint64 indexTime = timer.nsecsElapsed();
+
+    result->insert("hover", QJsonObject {
+        {"events", m_events},
+        {"indexedItems", index->itemCount()},
+        {"treeWalkEventsPerSecond", m_events / (treeWalkTime / 1e9)},
+        {"indexEventsPerSecond", m_events / (indexTime / 1e9)},
+        {"indexRebuildMs", rebuildTime / 1e6},
+        // The tree walk doesn't know the hover handlers and the stacking of the negative z
+        {"mismatches", mismatches},
+    });
+}
+
+std::unique_ptr<Scenario> createHoverScenario(Harness *harness, int events)
+{
+    return std::make_unique<HoverScenario>(harness, events);
+}
@@ -0,0 +1,177 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// A headless benchmark of the render loop of WOutputRenderWindow, using the
+// headless backend and the pixman renderer. The result is printed as JSON, the
+// scenarios are in their own files, see scenario.h.
+//
+// The benchmark-allocations binary is the same, with the C++ allocations per frame,
+// see allocationcounter.h.
+//
+// Examples:
+//   benchmark --windows 1
+//   benchmark --windows 50 --outputs 2
+//   benchmark --windows 50 --outputs 4 --parallel
+//   benchmark --windows 20 --outputs 3 --scales 2,1,1 --effects 4
+//   benchmark --windows 50 --frame-driven --occluder
+//   benchmark --windows 50 --outputs 2 --mirror
+//   benchmark --windows 50 --idle 45 --decorations --auto-layers
+//   benchmark --windows 50 --client-size 1024x768 --tile-threads 4
+//   benchmark --windows 500 --layers --output result.json
+//   benchmark --windows 200 --hover 100000
+//   benchmark --windows 20 --effects 4
+//   benchmark --texture-upload 100
+//   benchmark --pixel-conversion 20
+//   benchmark --windows 20 --capture 2
+//   benchmark --windows 50 --adaptive-scheduling --dispatch-budget 2000
+
+#include "harness.h"
+#include "scenario.h"
+
+#include <woutputrenderwindow.h>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QFile>
+#include <QtQml/qqmlextensionplugin.h>
+
+#include <vector>
+
+Q_IMPORT_QML_PLUGIN(BenchmarkPlugin)
+
+int main(int argc, char *argv[]) {
+    Harness::initialize();
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption windowsOption("windows", "The number of the synthetic clients.", "count", "1");
+    QCommandLineOption outputsOption("outputs", "The number of the headless outputs.", "count", "1");
+    QCommandLineOption sizeOption("size", "The size of the outputs.", "WxH", "1920x1080");
+    QCommandLineOption refreshOption("refresh", "The refresh rate of the outputs in Hz.", "hz", "60");
+    QCommandLineOption rateOption("rate", "The commit rate of the clients in Hz.", "hz", "60");
+    QCommandLineOption clientSizeOption("client-size", "The buffer size of the clients.", "WxH", "256x256");
+    QCommandLineOption framesOption("frames", "The number of the measured frames.", "count", "600");
+    QCommandLineOption warmupOption("warmup", "The number of the frames before measuring.", "count", "60");
+    QCommandLineOption layersOption("layers", "Put every window to an OutputLayer.");
+    QCommandLineOption threadedOption("threaded", "Render the scene graph in a separate thread.");
+    QCommandLineOption parallelOption("parallel", "Render the outputs in parallel.");
+    QCommandLineOption scalesOption("scales", "The comma separated scales of the outputs.", "list", "1");
+    QCommandLineOption frameDrivenOption("frame-driven", "The clients commit only after their frame callbacks are done.");
+    QCommandLineOption occluderOption("occluder", "Map an opaque window covering the first output above the others.");
+    QCommandLineOption mirrorOption("mirror", "The other outputs mirror the first output.");
+    QCommandLineOption tileThreadsOption("tile-threads", "The threads painting the tiles of the damaged region.", "count", "1");
+    QCommandLineOption idleOption("idle", "The number of the clients committing only once.", "count", "0");
+    QCommandLineOption decorationsOption("decorations", "Draw a title bar and a border on every window.");
+    QCommandLineOption autoLayersOption("auto-layers", "Render the static subtrees into the item layers.");
+    QCommandLineOption adaptiveOption("adaptive-scheduling", "Render at the predicted deadline of the refresh cycle.");
+    QCommandLineOption effectsOption("effects", "The number of the RenderBufferBlitter above the windows.", "count", "0");
+    QCommandLineOption textureUploadOption("texture-upload", "Measure the texture uploading of a 4K terminal after the frames.", "commits");
+    QCommandLineOption pixelConversionOption("pixel-conversion", "Measure the pixel conversions of WTools after the frames.", "iterations");
+    QCommandLineOption hoverOption("hover", "Measure the hit-testing of the hover events after the frames.", "count");
+    QCommandLineOption captureOption("capture", "Capture the first output, the frames are taken every N frames.", "interval");
+    QCommandLineOption dispatchBudgetOption("dispatch-budget", "Dispatch the Wayland events in the Budgeted mode of WServer.", "usecs");
+    QCommandLineOption outputOption("output", "Write the JSON result to the file instead of stdout.", "file");
+    parser.addOptions({
+        windowsOption, outputsOption, sizeOption, refreshOption, rateOption, clientSizeOption,
+        framesOption, warmupOption, layersOption, threadedOption, parallelOption, scalesOption,
+        frameDrivenOption, occluderOption, mirrorOption, tileThreadsOption, idleOption,
+        decorationsOption, autoLayersOption, adaptiveOption, effectsOption,
+        textureUploadOption, pixelConversionOption, hoverOption, captureOption,
+        dispatchBudgetOption, outputOption,
+    });
+    parser.process(app);
+
+    const auto parseSize = [] (const QString &string) {
+        const auto list = string.split('x');
+        return list.size() == 2 ? QSize(list.at(0).toInt(), list.at(1).toInt()) : QSize();
+    };
+
+    Harness::Options options;
+    // Without the clients, the outputs will not be rendered
+    options.windows = qMax(1, parser.value(windowsOption).toInt());
+    options.outputs = qMax(1, parser.value(outputsOption).toInt());
+    options.outputSize = parseSize(parser.value(sizeOption));
+    options.refresh = parser.value(refreshOption).toInt();
+    options.rate = parser.value(rateOption).toInt();
+    options.clientSize = parseSize(parser.value(clientSizeOption));
+    options.layers = parser.isSet(layersOption);
+    options.threaded = parser.isSet(threadedOption);
+    options.parallel = parser.isSet(parallelOption);
+    options.adaptiveScheduling = parser.isSet(adaptiveOption);
+    options.frameDriven = parser.isSet(frameDrivenOption);
+    options.occluder = parser.isSet(occluderOption);
+    options.mirror = parser.isSet(mirrorOption);
+    options.tileThreads = qMax(1, parser.value(tileThreadsOption).toInt());
+    options.idle = qBound(0, parser.value(idleOption).toInt(), options.windows);
+    options.decorations = parser.isSet(decorationsOption);
+    options.autoLayers = parser.isSet(autoLayersOption);
+    options.effects = qMax(0, parser.value(effectsOption).toInt());
+    options.scales.clear();
+    for (const auto &scale : parser.value(scalesOption).split(',')) {
+        options.scales.append(scale.toFloat());
+        if (options.scales.last() <= 0)
+            qFatal("Invalid scale");
+    }
+
+    const int frames = qMax(1, parser.value(framesOption).toInt());
+    const int warmup = qMax(1, parser.value(warmupOption).toInt());
+    options.historySize = frames;
+
+    if (options.outputSize.isEmpty() || options.clientSize.isEmpty())
+        qFatal("Invalid size");
+
+    Harness harness(options);
+    if (!harness.isValid())
+        qFatal("Failed to create the compositor");
+
+    std::vector<std::unique_ptr<Scenario>> scenarios;
+    scenarios.push_back(createRenderLoopScenario(&harness, frames));
+    if (parser.isSet(hoverOption))
+        scenarios.push_back(createHoverScenario(&harness, qMax(1, parser.value(hoverOption).toInt())));
+    if (parser.isSet(textureUploadOption))
+        scenarios.push_back(createTextureUploadScenario(&harness, qMax(1, parser.value(textureUploadOption).toInt())));
+    if (parser.isSet(pixelConversionOption))
+        scenarios.push_back(createPixelConversionScenario(&harness, qMax(1, parser.value(pixelConversionOption).toInt())));
+    if (parser.isSet(captureOption))
+        scenarios.push_back(createCaptureScenario(&harness, qMax(1, parser.value(captureOption).toInt())));
+    scenarios.push_back(createDispatchScenario(&harness, parser.isSet(dispatchBudgetOption)
+                                                             ? qMax(0, parser.value(dispatchBudgetOption).toInt())
+                                                             : -1));
+
+    int frameCount = 0;
+    QObject::connect(harness.window(), &WOutputRenderWindow::renderEnd, &app, [&] {
+        ++frameCount;
+        for (const auto &scenario : scenarios)
+            scenario->frame();
+
+        if (frameCount == warmup) {
+            for (const auto &scenario : scenarios)
+                scenario->begin();
+            return;
+        }
+
+        if (frameCount != warmup + frames)
+            return;
+
+        QJsonObject result;
+        for (const auto &scenario : scenarios)
+            scenario->end(&result);
+
+        const auto json = QJsonDocument(result).toJson();
+        if (parser.isSet(outputOption)) {
+            QFile file(parser.value(outputOption));
+            if (!file.open(QFile::WriteOnly) || file.write(json) != json.size())
+                qCritical() << "Failed to write" << file.fileName();
+        } else {
+            fputs(json.constData(), stdout);
+        }
+
+        harness.stop();
+        app.quit();
+    });
+
+    harness.start();
+    return app.exec();
+}
@@ -0,0 +1,110 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "scenario.h"
+
+#include <wtools.h>
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QJsonArray>
+#include <QRandomGenerator>
+
+WAYLIB_SERVER_USE_NAMESPACE
+
+// The 4K frames converted by WTools::convertImage and QImage, the kernels are
+// verified by tests/auto/tst_pixelconversion.
+class PixelConversionScenario : public Scenario
+{
+public:
+    PixelConversionScenario(Harness *harness, int iterations)
+        : Scenario(harness)
+        , m_iterations(iterations) {}
+
+    void end(QJsonObject *result) override;
+
+private:
+    int m_iterations;
+};
+
+void PixelConversionScenario::end(QJsonObject *result)
+{
+    const QSize size(3840, 2160);
+#define CONVERSION(from, to, flip) {QImage::from, QImage::to, flip, #from, #to}
+    const struct {
+        QImage::Format from;
+        QImage::Format to;
+        bool flip;
+        const char *fromName;
+        const char *toName;
+    } conversions[] = {
+        CONVERSION(Format_ARGB32_Premultiplied, Format_RGBA8888_Premultiplied, false),
+        CONVERSION(Format_RGBA8888, Format_ARGB32, false),
+        CONVERSION(Format_RGB32, Format_RGB888, false),
+        CONVERSION(Format_RGB32, Format_BGR888, false),
+        CONVERSION(Format_RGBX8888, Format_RGB888, false),
+        CONVERSION(Format_RGB30, Format_RGB32, false),
+        CONVERSION(Format_A2BGR30_Premultiplied, Format_RGBA8888_Premultiplied, false),
+        CONVERSION(Format_ARGB32, Format_ARGB32_Premultiplied, false),
+        CONVERSION(Format_RGBA8888_Premultiplied, Format_RGBA8888, false),
+        CONVERSION(Format_ARGB32_Premultiplied, Format_ARGB32_Premultiplied, true),
+        CONVERSION(Format_RGB32, Format_RGBX8888, true),
+    };
+#undef CONVERSION
+
+    QJsonArray results;
+    for (const auto &c : conversions) {
+        QImage source(size, QImage::Format_ARGB32);
+        for (int y = 0; y < size.height(); ++y) {
+            auto line = reinterpret_cast<quint32*>(source.scanLine(y));
+            QRandomGenerator::global()->fillRange(line, size.width());
+            // Some opaque and transparent pixels, like the real contents
+            line[y % size.width()] |= 0xff000000;
+            line[(y * 7) % size.width()] &= 0x00ffffff;
+        }
+        // The premultiplied formats need the valid pixels
+        source = source.convertedTo(QImage::Format_ARGB32_Premultiplied).convertedTo(c.from);
+
+        QImage expected, actual;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < m_iterations; ++i) {
+            expected = source.convertedTo(c.to);
+            if (c.flip)
+                expected = expected.mirrored(false, true);
+        }
+        const qint64 qimageTime = timer.restart();
+        for (int i = 0; i < m_iterations; ++i)
+            actual = WTools::convertImage(source, c.to, c.flip);
+        const qint64 wtoolsTime = timer.nsecsElapsed();
+
+        int maxDifference = 0;
+        const int bytesPerLine = expected.width() * expected.depth() / 8;
+        for (int y = 0; y < size.height(); ++y) {
+            const uchar *e = expected.constScanLine(y);
+            const uchar *a = actual.constScanLine(y);
+            for (int x = 0; x < bytesPerLine; ++x)
+                maxDifference = qMax(maxDifference, qAbs(int(e[x]) - int(a[x])));
+        }
+
+        results.append(QJsonObject {
+            {"from", c.fromName},
+            {"to", c.toName},
+            {"flip", c.flip},
+            {"qimageMs", qimageTime / 1e6 / m_iterations},
+            {"wtoolsMs", wtoolsTime / 1e6 / m_iterations},
+            {"maxDifference", maxDifference},
+        });
+    }
+
+    result->insert("pixelConversion", QJsonObject {
+        {"iterations", m_iterations},
+        {"imageSize", QString("%1x%2").arg(size.width()).arg(size.height())},
+        {"conversions", results},
+    });
+}
+
+std::unique_ptr<Scenario> createPixelConversionScenario(Harness *harness, int iterations)
+{
+    return std::make_unique<PixelConversionScenario>(harness, iterations);
+}
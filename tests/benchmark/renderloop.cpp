@@ -0,0 +1,204 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "scenario.h"
+#include "harness.h"
+#include "syntheticclients.h"
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+#include "allocationcounter.h"
+#endif
+
+#include <WOutput>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <woutputhelper.h>
+#include <wframestats.h>
+#include <wquickocclusionculler_p.h>
+#include <wquickautolayerizer_p.h>
+#include <wrenderbuffernode_p.h>
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QMetaEnum>
+#include <QtMath>
+
+#include <algorithm>
+
+#include <time.h>
+
+static qint64 threadCpuTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// The percentile of the nanosecond samples, in milliseconds like WFrameStats::percentile
+static qreal percentileOf(QList<qint64> samples, qreal percent)
+{
+    if (samples.isEmpty())
+        return 0;
+
+    const int index = qBound(0, qCeil(percent / 100 * samples.size()) - 1, int(samples.size()) - 1);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples.at(index) / 1e6;
+}
+
+class RenderLoopScenario : public Scenario
+{
+public:
+    RenderLoopScenario(Harness *harness, int frames)
+        : Scenario(harness)
+        , m_frames(frames) {}
+
+    void begin() override;
+    void end(QJsonObject *result) override;
+
+private:
+    int m_frames;
+    quint64 m_startCommits = 0;
+    quint64 m_startCopiedBytes = 0;
+    quint64 m_startTestCommits = 0;
+    quint64 m_startAvoidedTestCommits = 0;
+    qint64 m_startCpuTime = 0;
+    QElapsedTimer m_timer;
+};
+
+void RenderLoopScenario::begin()
+{
+    auto clients = m_harness->clients();
+
+    m_harness->window()->frameStats()->reset();
+    clients->takeLatencies();
+    m_startCommits = clients->commitCount();
+    m_startCopiedBytes = WRenderBufferNode::softwareCopiedBytes();
+    m_startTestCommits = WOutputHelper::testCommitCount();
+    m_startAvoidedTestCommits = WOutputHelper::avoidedTestCommitCount();
+    m_startCpuTime = threadCpuTime();
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+    AllocationCounter::start();
+#endif
+    m_timer.start();
+}
+
+void RenderLoopScenario::end(QJsonObject *result)
+{
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+    const quint64 allocations = AllocationCounter::stop();
+#endif
+    const qint64 elapsed = m_timer.nsecsElapsed();
+    const qint64 cpuTime = threadCpuTime() - m_startCpuTime;
+    const auto &options = m_harness->options();
+    auto window = m_harness->window();
+    auto clients = m_harness->clients();
+    const auto latencies = clients->takeLatencies();
+    const auto stats = window->frameStats();
+    const auto pool = WRenderBufferNode::resourcePoolStats(window);
+    const auto autoLayerStats = WQuickAutoLayerizer::get(window)->stats();
+
+    QJsonObject phases;
+    const auto metaEnum = QMetaEnum::fromType<WFrameStats::Phase>();
+    for (int i = 0; i < metaEnum.keyCount(); ++i) {
+        const auto phase = static_cast<WFrameStats::Phase>(metaEnum.value(i));
+        phases.insert(metaEnum.key(i), QJsonObject {
+            {"p50", stats->percentile(phase, 50)},
+            {"p95", stats->percentile(phase, 95)},
+            {"p99", stats->percentile(phase, 99)},
+        });
+    }
+
+    // The scene is rendered at the highest scale, only the cursor of the outputs
+    // follows their own scale.
+    QJsonArray outputList;
+    for (auto viewport : m_harness->viewports()) {
+        const QSize pixelSize = viewport->output()->size();
+        outputList.append(QJsonObject {
+            {"scale", viewport->output()->scale()},
+            {"devicePixelRatio", viewport->devicePixelRatio()},
+            {"pixelSize", QString("%1x%2").arg(pixelSize.width()).arg(pixelSize.height())},
+            {"bytesPerBuffer", qint64(pixelSize.width()) * pixelSize.height() * 4},
+            {"frames", qint64(stats->frameCountOf(viewport))},
+            {"renderMs", QJsonObject {
+                {"p50", stats->percentile(WFrameStats::Render, 50, viewport)},
+                {"p95", stats->percentile(WFrameStats::Render, 95, viewport)},
+            }},
+            // The mirrors are blitted from their sources in this phase
+            {"compositeMs", QJsonObject {
+                {"p50", stats->percentile(WFrameStats::Composite, 50, viewport)},
+                {"p95", stats->percentile(WFrameStats::Composite, 95, viewport)},
+            }},
+        });
+    }
+
+    QStringList scales;
+    for (float scale : options.scales)
+        scales.append(QString::number(scale));
+
+    result->insert("scenario", QJsonObject {
+        {"windows", options.windows},
+        {"outputs", options.outputs},
+        {"outputSize", QString("%1x%2").arg(options.outputSize.width()).arg(options.outputSize.height())},
+        {"refresh", options.refresh},
+        {"commitRate", options.rate},
+        {"clientSize", QString("%1x%2").arg(options.clientSize.width()).arg(options.clientSize.height())},
+        {"layers", options.layers},
+        {"threaded", options.threaded},
+        {"parallel", options.parallel},
+        {"scales", scales.join(',')},
+        {"frameDriven", options.frameDriven},
+        {"occluder", options.occluder},
+        {"mirror", options.mirror},
+        {"tileThreads", options.tileThreads},
+        {"idle", options.idle},
+        {"decorations", options.decorations},
+        {"autoLayers", options.autoLayers},
+        {"adaptiveScheduling", options.adaptiveScheduling},
+        {"effects", options.effects},
+        {"renderer", QString::fromLatin1(Harness::renderer())},
+    });
+    result->insert("frames", m_frames);
+    result->insert("framesPerSecond", m_frames / (elapsed / 1e9));
+    result->insert("cpuTimePerFrameMs", cpuTime / 1e6 / m_frames);
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+    result->insert("allocationsPerFrame", double(allocations) / m_frames);
+#endif
+    // The bytes copied from the render target by the RenderBufferBlitter
+    result->insert("effectCopiedBytesPerFrame",
+                   double(WRenderBufferNode::softwareCopiedBytes() - m_startCopiedBytes) / m_frames);
+    result->insert("resourcePool", QJsonObject {
+        {"hits", qint64(pool.hits)},
+        {"misses", qint64(pool.misses)},
+        {"evictions", qint64(pool.evictions)},
+        {"bytes", pool.bytes},
+        {"idleBytes", pool.idleBytes},
+    });
+    // The atomic tests of the output layers
+    result->insert("testCommits", qint64(WOutputHelper::testCommitCount() - m_startTestCommits));
+    result->insert("avoidedTestCommits",
+                   qint64(WOutputHelper::avoidedTestCommitCount() - m_startAvoidedTestCommits));
+    result->insert("missedFrames", qint64(stats->missedFrames()));
+    result->insert("clientCommits", qint64(clients->commitCount() - m_startCommits));
+    // With --frame-driven and --occluder, the occluded clients commit at 1 Hz
+    result->insert("clientCommitsPerSecond", (clients->commitCount() - m_startCommits) / (elapsed / 1e9));
+    result->insert("occludedSurfaces", WQuickOcclusionCuller::get(window)->occludedCount());
+    // The static windows are drawn from their layers
+    result->insert("autoLayers", QJsonObject {
+        {"layers", autoLayerStats.layers},
+        {"bytes", autoLayerStats.bytes},
+        {"created", qint64(autoLayerStats.created)},
+        {"invalidated", qint64(autoLayerStats.invalidated)},
+    });
+    result->insert("commitToFrameDoneMs", QJsonObject {
+        {"samples", latencies.size()},
+        {"p50", percentileOf(latencies, 50)},
+        {"p95", percentileOf(latencies, 95)},
+        {"p99", percentileOf(latencies, 99)},
+    });
+    result->insert("phasesMs", phases);
+    result->insert("outputs", outputList);
+}
+
+std::unique_ptr<Scenario> createRenderLoopScenario(Harness *harness, int frames)
+{
+    return std::make_unique<RenderLoopScenario>(harness, frames);
+}
@@ -0,0 +1,42 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <QJsonObject>
+
+#include <memory>
+
+class Harness;
+// A measurement of the benchmark, every scenario adds its results to the JSON
+class Scenario
+{
+public:
+    explicit Scenario(Harness *harness)
+        : m_harness(harness) {}
+    virtual ~Scenario() = default;
+
+    // Before the first measured frame
+    virtual void begin() {}
+    // After every frame, including the warmup frames
+    virtual void frame() {}
+    // After the measured frames
+    virtual void end(QJsonObject *result) = 0;
+
+protected:
+    Harness *m_harness;
+};
+
+// The frame rate and the timings of the render loop, see renderloop.cpp
+std::unique_ptr<Scenario> createRenderLoopScenario(Harness *harness, int frames);
+// The hit-testing of the hover events after the frames, see hover.cpp
+std::unique_ptr<Scenario> createHoverScenario(Harness *harness, int events);
+// The texture uploading of a 4K terminal after the frames, see textureupload.cpp
+std::unique_ptr<Scenario> createTextureUploadScenario(Harness *harness, int commits);
+// The pixel conversions of WTools after the frames, see pixelconversion.cpp
+std::unique_ptr<Scenario> createPixelConversionScenario(Harness *harness, int iterations);
+// The capture of the first output, see capture.cpp
+std::unique_ptr<Scenario> createCaptureScenario(Harness *harness, int interval);
+// The dispatching of the Wayland events, the Budgeted mode is used if the budget
+// isn't negative, see dispatch.cpp
+std::unique_ptr<Scenario> createDispatchScenario(Harness *harness, int budget);
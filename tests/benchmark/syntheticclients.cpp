@@ -0,0 +1,379 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "syntheticclients.h"
+
+#include <QDebug>
+
+#include <wayland-client.h>
+#include <xdg-shell-client-protocol.h>
+
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static inline qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Buffer
+{
+    wl_buffer *buffer = nullptr;
+    uint32_t *data = nullptr;
+    bool busy = false;
+};
+
+struct Client
+{
+    std::mutex *mutex = nullptr;
+    QList<qint64> *latencies = nullptr;
+
+    wl_display *display = nullptr;
+    wl_registry *registry = nullptr;
+    wl_compositor *compositor = nullptr;
+    wl_shm *shm = nullptr;
+    xdg_wm_base *wmBase = nullptr;
+
+    wl_surface *surface = nullptr;
+    xdg_surface *xdgSurface = nullptr;
+    xdg_toplevel *toplevel = nullptr;
+    wl_callback *frameCallback = nullptr;
+
+    Buffer buffers[2];
+    void *shmData = nullptr;
+    size_t shmSize = 0;
+    QSize size;
+    bool occluder = false;
+    // Commits only once, like the windows not being used
+    bool idle = false;
+    bool configured = false;
+    qint64 frameCommitTime = 0;
+    uint32_t serial = 0;
+};
+
+static void bufferRelease(void *data, wl_buffer *)
+{
+    static_cast<Buffer*>(data)->busy = false;
+}
+
+static const wl_buffer_listener bufferListener = {
+    .release = bufferRelease,
+};
+
+static void frameDone(void *data, wl_callback *callback, uint32_t)
+{
+    auto client = static_cast<Client*>(data);
+    wl_callback_destroy(callback);
+    client->frameCallback = nullptr;
+
+    const qint64 latency = now() - client->frameCommitTime;
+    std::lock_guard<std::mutex> lock(*client->mutex);
+    client->latencies->append(latency);
+}
+
+static const wl_callback_listener frameListener = {
+    .done = frameDone,
+};
+
+static void wmBasePing(void *, xdg_wm_base *wmBase, uint32_t serial)
+{
+    xdg_wm_base_pong(wmBase, serial);
+}
+
+static const xdg_wm_base_listener wmBaseListener = {
+    .ping = wmBasePing,
+};
+
+static void xdgSurfaceConfigure(void *data, xdg_surface *xdgSurface, uint32_t serial)
+{
+    auto client = static_cast<Client*>(data);
+    xdg_surface_ack_configure(xdgSurface, serial);
+    client->configured = true;
+}
+
+static const xdg_surface_listener xdgSurfaceListener = {
+    .configure = xdgSurfaceConfigure,
+};
+
+static void toplevelConfigure(void *, xdg_toplevel *, int32_t, int32_t, wl_array *) {}
+static void toplevelClose(void *, xdg_toplevel *) {}
+
+static const xdg_toplevel_listener toplevelListener = {
+    .configure = toplevelConfigure,
+    .close = toplevelClose,
+};
+
+static void registryGlobal(void *data, wl_registry *registry, uint32_t name,
+                           const char *interface, uint32_t)
+{
+    auto client = static_cast<Client*>(data);
+
+    if (strcmp(interface, wl_compositor_interface.name) == 0) {
+        client->compositor = static_cast<wl_compositor*>(
+            wl_registry_bind(registry, name, &wl_compositor_interface, 4));
+    } else if (strcmp(interface, wl_shm_interface.name) == 0) {
+        client->shm = static_cast<wl_shm*>(
+            wl_registry_bind(registry, name, &wl_shm_interface, 1));
+    } else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+        client->wmBase = static_cast<xdg_wm_base*>(
+            wl_registry_bind(registry, name, &xdg_wm_base_interface, 1));
+        xdg_wm_base_add_listener(client->wmBase, &wmBaseListener, client);
+    }
+}
+
+static void registryGlobalRemove(void *, wl_registry *, uint32_t) {}
+
+static const wl_registry_listener registryListener = {
+    .global = registryGlobal,
+    .global_remove = registryGlobalRemove,
+};
+
+static bool createBuffers(Client *client, const QSize &size)
+{
+    const int stride = size.width() * 4;
+    const size_t bufferSize = stride * size.height();
+    client->shmSize = bufferSize * 2;
+
+    int fd = memfd_create("waylib-benchmark", MFD_CLOEXEC);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, client->shmSize) < 0) {
+        close(fd);
+        return false;
+    }
+
+    client->shmData = mmap(nullptr, client->shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (client->shmData == MAP_FAILED) {
+        client->shmData = nullptr;
+        close(fd);
+        return false;
+    }
+
+    auto pool = wl_shm_create_pool(client->shm, fd, client->shmSize);
+    for (int i = 0; i < 2; ++i) {
+        auto &buffer = client->buffers[i];
+        buffer.buffer = wl_shm_pool_create_buffer(pool, bufferSize * i, size.width(), size.height(),
+                                                  stride, WL_SHM_FORMAT_XRGB8888);
+        buffer.data = reinterpret_cast<uint32_t*>(static_cast<char*>(client->shmData) + bufferSize * i);
+        wl_buffer_add_listener(buffer.buffer, &bufferListener, &buffer);
+    }
+    wl_shm_pool_destroy(pool);
+    close(fd);
+
+    return true;
+}
+
+static void destroyClient(Client *client)
+{
+    if (client->frameCallback)
+        wl_callback_destroy(client->frameCallback);
+    for (auto &buffer : client->buffers) {
+        if (buffer.buffer)
+            wl_buffer_destroy(buffer.buffer);
+    }
+    if (client->shmData)
+        munmap(client->shmData, client->shmSize);
+    if (client->toplevel)
+        xdg_toplevel_destroy(client->toplevel);
+    if (client->xdgSurface)
+        xdg_surface_destroy(client->xdgSurface);
+    if (client->surface)
+        wl_surface_destroy(client->surface);
+    if (client->wmBase)
+        xdg_wm_base_destroy(client->wmBase);
+    if (client->shm)
+        wl_shm_destroy(client->shm);
+    if (client->compositor)
+        wl_compositor_destroy(client->compositor);
+    if (client->registry)
+        wl_registry_destroy(client->registry);
+    if (client->display)
+        wl_display_disconnect(client->display);
+}
+
+static bool commitFrame(Client *client)
+{
+    const QSize &size = client->size;
+    Buffer *buffer = nullptr;
+    for (auto &b : client->buffers) {
+        if (!b.busy) {
+            buffer = &b;
+            break;
+        }
+    }
+
+    // The compositor is too slow, skip this frame
+    if (!buffer)
+        return false;
+
+    const uint32_t color = 0xff000000 | (client->serial++ * 0x010305);
+    std::fill(buffer->data, buffer->data + size.width() * size.height(), color);
+
+    wl_surface_attach(client->surface, buffer->buffer, 0, 0);
+    wl_surface_damage_buffer(client->surface, 0, 0, size.width(), size.height());
+    if (!client->frameCallback) {
+        client->frameCallback = wl_surface_frame(client->surface);
+        wl_callback_add_listener(client->frameCallback, &frameListener, client);
+        client->frameCommitTime = now();
+    }
+    wl_surface_commit(client->surface);
+    buffer->busy = true;
+
+    return true;
+}
+
+SyntheticClients::SyntheticClients(const QByteArray &socket, int count, int rate, const QSize &size)
+    : m_socket(socket)
+    , m_count(count)
+    , m_rate(qMax(1, rate))
+    , m_size(size)
+{
+
+}
+
+SyntheticClients::~SyntheticClients()
+{
+    stop();
+}
+
+void SyntheticClients::start()
+{
+    Q_ASSERT(!m_thread.joinable());
+    m_quit = false;
+    m_thread = std::thread(&SyntheticClients::run, this);
+}
+
+void SyntheticClients::stop()
+{
+    m_quit = true;
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+QList<qint64> SyntheticClients::takeLatencies()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::exchange(m_latencies, {});
+}
+
+quint64 SyntheticClients::commitCount() const
+{
+    return m_commitCount;
+}
+
+static bool initClient(Client *client, const QByteArray &socket)
+{
+    client->display = wl_display_connect(socket.constData());
+    if (!client->display) {
+        qWarning() << "Failed to connect to" << socket;
+        return false;
+    }
+
+    client->registry = wl_display_get_registry(client->display);
+    wl_registry_add_listener(client->registry, &registryListener, client);
+    wl_display_roundtrip(client->display);
+
+    if (!client->compositor || !client->shm || !client->wmBase || !createBuffers(client, client->size)) {
+        qWarning() << "Failed to initialize the synthetic client";
+        return false;
+    }
+
+    client->surface = wl_compositor_create_surface(client->compositor);
+    client->xdgSurface = xdg_wm_base_get_xdg_surface(client->wmBase, client->surface);
+    xdg_surface_add_listener(client->xdgSurface, &xdgSurfaceListener, client);
+    client->toplevel = xdg_surface_get_toplevel(client->xdgSurface);
+    xdg_toplevel_add_listener(client->toplevel, &toplevelListener, client);
+    xdg_toplevel_set_title(client->toplevel, "waylib-benchmark");
+    wl_surface_commit(client->surface);
+    wl_display_flush(client->display);
+
+    return true;
+}
+
+void SyntheticClients::run()
+{
+    const bool hasOccluder = !m_occluderSize.isEmpty();
+    std::vector<Client> clients(m_count + (hasOccluder ? 1 : 0));
+    std::vector<pollfd> fds;
+    fds.reserve(clients.size());
+
+    for (int i = 0; i < int(clients.size()); ++i) {
+        auto &client = clients[i];
+        client.mutex = &m_mutex;
+        client.latencies = &m_latencies;
+        client.occluder = i == m_count;
+        client.idle = i < m_idleCount;
+        client.size = client.occluder ? m_occluderSize : m_size;
+
+        // Map the occluder after the others, it's stacked above them
+        if (client.occluder) {
+            for (int j = 0; j < i; ++j) {
+                if (clients[j].surface)
+                    wl_display_roundtrip(clients[j].display);
+            }
+        }
+
+        if (!initClient(&client, m_socket))
+            continue;
+
+        fds.push_back({wl_display_get_fd(client.display), POLLIN, 0});
+    }
+
+    const qint64 interval = 1000000000ll / m_rate;
+    qint64 nextFrame = now();
+
+    while (!m_quit) {
+        const qint64 timeout = qMax(0ll, (nextFrame - now()) / 1000000);
+        poll(fds.data(), fds.size(), std::min<qint64>(timeout, 100));
+
+        int fdIndex = 0;
+        for (auto &client : clients) {
+            if (!client.surface)
+                continue;
+
+            if (fds[fdIndex++].revents & POLLIN)
+                wl_display_dispatch(client.display);
+            else
+                wl_display_dispatch_pending(client.display);
+        }
+
+        if (now() >= nextFrame) {
+            bool animating = !m_paused;
+            if (!animating && m_steps > 0) {
+                --m_steps;
+                animating = true;
+            }
+
+            for (auto &client : clients) {
+                if (!client.configured)
+                    continue;
+                // The occluder and the idle clients are static
+                if (client.occluder || client.idle) {
+                    if (client.serial == 0)
+                        commitFrame(&client);
+                    continue;
+                }
+                if (!animating)
+                    continue;
+                // Wait for the previous frame is displayed
+                if (m_frameDriven && client.frameCallback)
+                    continue;
+                if (commitFrame(&client))
+                    ++m_commitCount;
+            }
+            nextFrame += interval;
+        }
+
+        for (auto &client : clients) {
+            if (client.display)
+                wl_display_flush(client.display);
+        }
+    }
+
+    for (auto &client : clients)
+        destroyClient(&client);
+}
@@ -0,0 +1,69 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <QList>
+#include <QSize>
+#include <QByteArray>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Wayland clients running in a separate thread of the compositor process, every
+// client maps a xdg_toplevel and commits a new shm buffer at a fixed rate.
+class SyntheticClients
+{
+public:
+    SyntheticClients(const QByteArray &socket, int count, int rate, const QSize &size);
+    ~SyntheticClients();
+
+    // Commit only after the frame callback is done, like the animating clients
+    inline void setFrameDriven(bool on) {
+        m_frameDriven = on;
+    }
+    // An extra opaque client mapped above the others, it commits only once
+    inline void setOccluder(const QSize &size) {
+        m_occluderSize = size;
+    }
+    // The first clients commit only once
+    inline void setIdleCount(int count) {
+        m_idleCount = count;
+    }
+
+    void start();
+    void stop();
+
+    // The animating clients stop committing, the step commits one frame of
+    // them, for comparing the frames of a static scene.
+    inline void setPaused(bool paused) {
+        m_paused = paused;
+    }
+    inline void step() {
+        ++m_steps;
+    }
+
+    // The nanoseconds from wl_surface.commit to wl_callback.done of the frame callback
+    QList<qint64> takeLatencies();
+    quint64 commitCount() const;
+
+private:
+    void run();
+
+    QByteArray m_socket;
+    int m_count;
+    int m_rate;
+    QSize m_size;
+    QSize m_occluderSize;
+    int m_idleCount = 0;
+    bool m_frameDriven = false;
+
+    std::thread m_thread;
+    std::atomic_bool m_quit = false;
+    std::atomic_bool m_paused = false;
+    std::atomic_int m_steps = 0;
+    std::atomic_uint64_t m_commitCount = 0;
+    std::mutex m_mutex;
+    QList<qint64> m_latencies;
+};
@@ -0,0 +1,79 @@
+// Copyright (C) 2024 UnionTech Software Technology Co., Ltd.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "scenario.h"
+#include "harness.h"
+
+#include <woutputrenderwindow.h>
+#include <wsgtextureprovider.h>
+#include <wimagebuffer.h>
+
+#include <qwbuffer.h>
+
+#include <QElapsedTimer>
+#include <QImage>
+
+QW_USE_NAMESPACE
+
+// A 4K terminal that changes one line of the text in every commit, reports the bytes
+// uploaded to the textures by WSGTextureProvider::updateBuffer.
+class TextureUploadScenario : public Scenario
+{
+public:
+    TextureUploadScenario(Harness *harness, int commits)
+        : Scenario(harness)
+        , m_commits(commits) {}
+
+    void end(QJsonObject *result) override;
+
+private:
+    int m_commits;
+};
+
+void TextureUploadScenario::end(QJsonObject *result)
+{
+    const QSize size(3840, 2160);
+    const int lineHeight = 24;
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::black);
+
+    const auto createBuffer = [] (const QImage &image) {
+        return std::unique_ptr<qw_buffer, qw_buffer::droper>(
+            qw_buffer::create(new WImageBufferImpl(image), image.width(), image.height()));
+    };
+
+    WSGTextureProvider provider(m_harness->window());
+    auto buffer = createBuffer(image);
+    provider.setBuffer(buffer.get());
+
+    const quint64 startBytes = WSGTextureProvider::uploadedBytes();
+    qint64 uploadTime = 0;
+    QElapsedTimer timer;
+    for (int i = 0; i < m_commits; ++i) {
+        const QRect line(0, (i * lineHeight) % (size.height() - lineHeight), size.width(), lineHeight);
+        const quint32 color = i % 2 ? 0xffffffff : 0xff808080;
+        for (int y = line.top(); y <= line.bottom(); ++y)
+            std::fill_n(reinterpret_cast<quint32*>(image.scanLine(y)), size.width(), color);
+        auto newBuffer = createBuffer(image);
+
+        timer.start();
+        provider.updateBuffer(newBuffer.get(), line);
+        uploadTime += timer.nsecsElapsed();
+        buffer = std::move(newBuffer);
+    }
+    provider.setBuffer(nullptr);
+
+    result->insert("textureUpload", QJsonObject {
+        {"commits", m_commits},
+        {"bufferSize", QString("%1x%2").arg(size.width()).arg(size.height())},
+        {"fullBufferBytes", qint64(image.sizeInBytes())},
+        // The pixman renderer uses the memory of the buffers directly, it's always 0
+        {"uploadedBytesPerCommit", double(WSGTextureProvider::uploadedBytes() - startBytes) / m_commits},
+        {"uploadMsPerCommit", uploadTime / 1e6 / m_commits},
+    });
+}
+
+std::unique_ptr<Scenario> createTextureUploadScenario(Harness *harness, int commits)
+{
+    return std::make_unique<TextureUploadScenario>(harness, commits);
+}